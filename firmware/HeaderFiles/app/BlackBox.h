@@ -0,0 +1,74 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Filename: BlackBox.h
+//
+// Description: Records the last events in RAM and copies them to the
+//  EEPROM after a fault or when asked.
+//
+// Author(s): G. Chopcinski (Kg Solutions, LLC)
+//
+// Created for ASL
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef BLACK_BOX_H
+#define BLACK_BOX_H
+
+/* ***************************    Includes     **************************** */
+
+// from stdlib
+#include <stdint.h>
+#include <stdbool.h>
+
+/* ******************************   Macros   ****************************** */
+
+// Event types and what their data byte holds.
+#define BLACKBOX_EVENT_POWER_UP (0x01)      // Reset cause, PCON0 on the 46K40
+#define BLACKBOX_EVENT_STATE (0x02)         // New gp_State
+#define BLACKBOX_EVENT_BUTTONS (0x03)       // New GetUserButtonMask()
+#define BLACKBOX_EVENT_FAULT (0x04)         // FAULT_xxx bits of a failed check
+#define BLACKBOX_EVENT_FAULT_LATCHED (0x05) // GetFailsafeCause()
+#define BLACKBOX_EVENT_CALIBRATION (0x06)   // 1 = gate table saved as well
+#define BLACKBOX_EVENT_SELF_TEST (0x07)     // GetSelfTestFailure()
+#define BLACKBOX_EVENT_GESTURE (0x08)       // GESTURE_xxx recognised
+#define BLACKBOX_EVENT_SPEED_DRIFT (0x09)   // GetNeutralDrift (SPEED_ARRAY), signed counts
+#define BLACKBOX_EVENT_DIRECTION_DRIFT (0x0a) // GetNeutralDrift (DIRECTION_ARRAY), signed counts
+
+// Why the events were copied to the EEPROM.
+#define BLACKBOX_CAUSE_FAULT (0x01)
+#define BLACKBOX_CAUSE_REQUEST (0x02)       // Diagnostics gesture or debugger
+
+// EEPROM image:
+//      0   BLACKBOX_MAGIC, once the rest has been written
+//      1   Copy number, counts up with each copy
+//      2   BLACKBOX_CAUSE_xxx
+//      3   Number of events
+//      4   Events, oldest first. Each is the system tick (ms) little endian,
+//          the type and the data.
+#define BLACKBOX_MAGIC (0xb7)
+#define BLACKBOX_HEADER_SIZE (4)
+#define BLACKBOX_EVENT_SIZE (4)
+#define BLACKBOX_NUM_EVENTS (31)
+#define BLACKBOX_EEPROM_SIZE (BLACKBOX_HEADER_SIZE + (BLACKBOX_NUM_EVENTS * BLACKBOX_EVENT_SIZE))
+
+/* ******************************   Types   ******************************* */
+
+typedef struct
+{
+    uint16_t m_Tick;
+    uint8_t m_Type;
+    uint8_t m_Data;
+} BLACKBOX_EVENT;
+
+/* ***********************   Function Prototypes   ************************ */
+
+void BlackBoxInit (uint8_t eepromAddress);
+void BlackBoxRecord (uint8_t type, uint8_t data);
+void BlackBoxFlush (uint8_t cause);
+void BlackBoxService (uint8_t buttons);
+bool IsBlackBoxFlushing (void);
+
+#endif // BLACK_BOX_H
+
+// end of file.
+//-------------------------------------------------------------------------
@@ -19,17 +19,34 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+// Bit masks used with SendBlueToothSignals(). A set bit means the output
+// is active, i.e. the line to the Bluetooth module is driven low.
+#define BT_FWD_MASK             (0x01)
+#define BT_REV_MASK             (0x02)
+#define BT_LEFT_MASK            (0x04)
+#define BT_RIGHT_MASK           (0x08)
+#define BT_RIGHT_CLICK_OUT_MASK (0x10)
+#define BT_LEFT_CLICK_OUT_MASK  (0x20)
+
+// Proportional (pulse-density modulated) direction outputs.
+// Each PDM slot is BT_PDM_SLOT_MS long and a duty of BT_PDM_FULL_SCALE
+// keeps the output active in every slot.
+#define BT_PDM_SLOT_MS          (20)
+#define BT_PDM_FULL_SCALE       (16)
+
 typedef enum {
-    NO_BT = 0,
-    FWD_BT, REV_BT, LEFT_BT, RIGHT_BT, RIGHT_CLICK_OUT, LEFT_CLICK_OUT
-} BT_DIRECTIONS;
+    BT_PDM_FWD = 0, BT_PDM_REV, BT_PDM_LEFT, BT_PDM_RIGHT,
+    BT_PDM_NUM_DIRECTIONS
+} BT_PDM_DIRECTIONS;
 
 /* ***********************   Function Prototypes   ************************ */
 
 void BluetoothControlInit(void);
 void EnableBluetooth (void);
 void DisableBluetooth (void);
-void SendBlueToothSignal (BT_DIRECTIONS, bool);
+void SendBlueToothSignals (uint8_t activeMask);
+void BluetoothPdmReset (void);
+uint8_t BluetoothPdmSignals (const uint8_t duty[BT_PDM_NUM_DIRECTIONS]);
 bool IsMouseRightClickActive (void);
 void GetMouseClickInputs(void);
 
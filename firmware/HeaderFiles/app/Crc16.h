@@ -0,0 +1,34 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Filename: Crc16.h
+//
+// Description: CRC-16/CCITT (polynomial 0x1021) shared by the telemetry,
+//      the live tuning and the flash self test. The bootloader keeps its
+//      own copy, it is built on its own.
+//
+// Author(s): G. Chopcinski (Kg Solutions, LLC)
+//
+// Created for ASL
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef CRC16_H
+#define CRC16_H
+
+/* ***************************    Includes     **************************** */
+
+// from stdlib
+#include <stdint.h>
+
+/* ******************************   Macros   ****************************** */
+
+#define CRC16_INITIAL (0xffff)          // CRC-16/CCITT-FALSE starts here.
+
+/* ***********************   Function Prototypes   ************************ */
+
+uint16_t Crc16 (uint16_t crc, uint8_t data);
+
+#endif // CRC16_H
+
+// end of file.
+//-------------------------------------------------------------------------
@@ -0,0 +1,49 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Filename: FailsafeMonitor.h
+//
+// Description: Plausibility checks on the joystick readings, e.g. for a
+//      disconnected joystick cable or a shorted pot.
+//
+// Author(s): G. Chopcinski (Kg Solutions, LLC)
+//
+// Created for ASL
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef FAILSAFE_MONITOR_H
+#define FAILSAFE_MONITOR_H
+
+/* ***************************    Includes     **************************** */
+
+// from stdlib
+#include <stdint.h>
+#include <stdbool.h>
+
+/* ******************************   Macros   ****************************** */
+
+// Fault bits returned by FailsafeCheck() and GetFailsafeCause().
+#define FAULT_NONE (0x00)
+#define FAULT_ADC_TIMEOUT (0x01)        // A conversion never finished.
+#define FAULT_RAIL (0x02)               // Reading stuck near 0 or full scale.
+#define FAULT_OUT_OF_GATE (0x04)        // Well past the calibrated travel.
+#define FAULT_SLEW (0x08)               // Moved further than a hand can between readings.
+
+#define FAILSAFE_RAIL_LOW (16)          // Readings below this are at the rail.
+#define FAILSAFE_RAIL_HIGH (1023 - 16)  // .. as are readings above this.
+#define FAILSAFE_GATE_MARGIN (JOYSTICK_RAW_MAX_DEFLECTION / 2)  // Allowed past the calibrated travel.
+#define FAILSAFE_SLEW_LIMIT (300)       // Largest believable change ...
+#define FAILSAFE_SLEW_WINDOW_MS (5)     // .. between readings this close together.
+#define FAILSAFE_PERSISTENCE (3)        // Bad readings in a row that latch the fault.
+
+/* ***********************   Function Prototypes   ************************ */
+
+void FailsafeReset (void);
+uint8_t FailsafeCheck (uint16_t rawSpeed, uint16_t rawDirection);
+bool IsFailsafeLatched (void);
+uint8_t GetFailsafeCause (void);
+
+#endif // FAILSAFE_MONITOR_H
+
+// end of file.
+//-------------------------------------------------------------------------
@@ -0,0 +1,53 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Filename: Gesture.h
+//
+// Description: Recognises joystick gestures that stand in for the
+//  Calibration, User Port and Mode buttons.
+//
+// Author(s): G. Chopcinski (Kg Solutions, LLC)
+//
+// Created for ASL
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef GESTURE_H
+#define GESTURE_H
+
+/* ***************************    Includes     **************************** */
+
+// from stdlib
+#include <stdint.h>
+#include <stdbool.h>
+
+/* ******************************   Macros   ****************************** */
+
+// Gestures returned by GestureUpdate(). Each is returned on one pass only.
+#define GESTURE_NONE (0)
+#define GESTURE_DOUBLE_FLICK (1)        // Out to one side and back, twice.
+#define GESTURE_HOLD_DIRECTION (2)      // Held out to one side.
+
+// Gestures to look for, given to GestureUpdate() on every pass.
+#define GESTURE_ENABLE_REVERSE_HOLD (0x01)      // Reverse is the Mode button, SW2-1 closed.
+#define GESTURE_ENABLE_DOUBLE_FLICK (0x02)
+#define GESTURE_ENABLE_HOLD_DIRECTION (0x04)
+#define GESTURE_ENABLE_EEPROM_MASK (GESTURE_ENABLE_DOUBLE_FLICK | GESTURE_ENABLE_HOLD_DIRECTION)
+
+// Times are in system ticks (ms).
+#ifndef GESTURE_REVERSE_HOLD_MS
+#define GESTURE_REVERSE_HOLD_MS (0)     // Reverse as Mode has always acted at once.
+#endif
+#define GESTURE_HOLD_DIRECTION_MS (3000)
+#define GESTURE_FLICK_MAX_MS (400)      // Out of neutral and back within this ..
+#define GESTURE_FLICK_GAP_MS (600)      // .. and the second within this of the first.
+
+/* ***********************   Function Prototypes   ************************ */
+
+void GestureReset (void);
+uint8_t GestureUpdate (uint16_t rawSpeed, uint16_t rawDirection, uint8_t enabled);
+bool IsReverseHeld (void);
+
+#endif // GESTURE_H
+
+// end of file.
+//-------------------------------------------------------------------------
@@ -0,0 +1,41 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Filename: JoystickGate.h
+//
+// Description: Two dimensional joystick gate calibration. Normalises the
+//      joystick deflection by the shape of the gate so that round, square
+//      and octagonal gates all produce the same demand on the diagonals.
+//
+// Author(s): G. Chopcinski (Kg Solutions, LLC)
+//
+// Created for ASL
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef JOYSTICK_GATE_H
+#define JOYSTICK_GATE_H
+
+/* ***************************    Includes     **************************** */
+
+// from stdlib
+#include <stdint.h>
+#include <stdbool.h>
+
+/* ******************************   Macros   ****************************** */
+
+#define GATE_NUM_SECTORS (16)           // 22.5 degrees per sector.
+#define GATE_EEPROM_SIZE (GATE_NUM_SECTORS + 2) // Gains plus the valid marker.
+
+/* ***********************   Function Prototypes   ************************ */
+
+void GateCalibrationStart (void);
+void GateCalibrationSample (uint16_t rawSpeed, uint16_t rawDirection);
+void GateCalibrationFinish (uint8_t eepromAddress);
+bool GateLoad (uint8_t eepromAddress);
+void GateNormalise (uint16_t *rawSpeed, uint16_t *rawDirection);
+bool IsGateValid (void);
+
+#endif // JOYSTICK_GATE_H
+
+// end of file.
+//-------------------------------------------------------------------------
@@ -0,0 +1,71 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Filename: JoystickType.h
+//
+// Description: Tells the joystick families apart at power up, from the
+//      readings taken while finding the neutral. See JoystickType.c.
+//
+// Author(s): G. Chopcinski (Kg Solutions, LLC)
+//
+// Created for ASL
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef JOYSTICK_TYPE_H
+#define JOYSTICK_TYPE_H
+
+/* ***************************    Includes     **************************** */
+
+// from stdlib
+#include <stdint.h>
+#include <stdbool.h>
+
+// from project
+#include "AnalogInput.h"
+
+/* ******************************   Macros   ****************************** */
+
+#define JOYSTICK_TYPE_STANDARD (0)      // ASL128, ASL130, ASL138: NEUTRAL_MARGIN_STANDARD
+#define JOYSTICK_TYPE_COMPACT (1)       // ASL133, ASL134: NEUTRAL_MARGIN_COMPACT
+#define NUM_JOYSTICK_TYPES (2)
+
+// Compact needs positive evidence, anything else is standard: a calibrated
+// travel too short to leave room for the standard neutral window ..
+#define JOYSTICK_SHORT_TRAVEL (NEUTRAL_MARGIN_STANDARD * 3)
+// .. and a joystick that rests quietly enough for the compact one, with
+// NEUTRAL_MARGIN_COMPACT at least 16 standard deviations of its readings.
+// BootSequence()'s steadiness test lets through about twice this.
+#ifndef JOYSTICK_QUIET_STD_DEV_Q4
+#define JOYSTICK_QUIET_STD_DEV_Q4 (NEUTRAL_MARGIN_COMPACT)  // Standard deviation of the readings * 16
+#endif
+#define JOYSTICK_TYPE_MIN_SAMPLES (32)  // Fewer readings at rest are no evidence.
+
+// A joystick last seen as standard must be inside half the noise limit to
+// be taken as compact, so a borderline one does not change type each time
+// it is powered up.
+#define JOYSTICK_TYPE_HYSTERESIS_SHIFT (1)
+
+/* ******************************   Types   ******************************* */
+
+// What the last classification was made from, for the debugger.
+typedef struct
+{
+    uint8_t m_Type;                     // JOYSTICK_TYPE_xxx
+    uint8_t m_Samples;
+    uint32_t m_VarianceQ8;              // Largest of the two axes, * 256
+    uint16_t m_Travel;                  // Smallest calibrated scale
+} JOYSTICK_TYPE_REPORT;
+
+extern JOYSTICK_TYPE_REPORT g_JoystickType;
+
+/* ***********************   Function Prototypes   ************************ */
+
+void JoystickTypeReset (void);
+void JoystickTypeAddReading (uint16_t speed, uint16_t direction);
+uint8_t JoystickTypeClassify (uint8_t previous);
+uint16_t JoystickTypeMargin (uint8_t type);
+
+#endif // JOYSTICK_TYPE_H
+
+// end of file.
+//-------------------------------------------------------------------------
@@ -0,0 +1,73 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Filename: LiveTune.h
+//
+// Description: Reads and changes settings over the UART while running. See
+//      LiveTune.c for the protocol and tools/livetune.py to use it.
+//
+// Author(s): G. Chopcinski (Kg Solutions, LLC)
+//
+// Created for ASL
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef LIVE_TUNE_H
+#define LIVE_TUNE_H
+
+/* ***************************    Includes     **************************** */
+
+// from stdlib
+#include <stdint.h>
+#include <stdbool.h>
+
+/* ******************************   Macros   ****************************** */
+
+#define TUNE_REQUEST_SIZE (9)           // Sync, command, sequence, parameter, value, CRC.
+
+// Commands
+#define TUNE_CMD_GET (0x01)             // Current value and limits of a parameter.
+#define TUNE_CMD_SET (0x02)             // New value, used from the next pass.
+#define TUNE_CMD_SAVE (0x03)            // Keep all values in the EEPROM.
+
+// Status in the response
+#define TUNE_OK (0x00)
+#define TUNE_ERR_COMMAND (0x01)         // Unknown command.
+#define TUNE_ERR_PARAMETER (0x02)       // No such parameter.
+#define TUNE_ERR_RANGE (0x03)           // Value outside the parameter's limits.
+#define TUNE_HELD (0x04)                // Taken, set once the outputs are at rest.
+
+// Parameter flags
+#define TUNE_FLAG_AT_REST (0x01)        // Only set while the outputs are at rest, see LiveTuneApply().
+
+// Parameter types, for the host to show the value.
+#define TUNE_TYPE_UINT8 (0x01)
+#define TUNE_TYPE_UINT16 (0x02)
+
+#define TUNE_NO_EEPROM (0xff)           // m_EepromAddress of a value that is not saved.
+#define TUNE_MAX_PARAMS (8)
+
+/* ******************************   Types   ******************************* */
+
+// One entry of the parameter table given to LiveTuneInit(). The parameter
+// number on the wire is the index in the table.
+typedef struct
+{
+    uint8_t m_Type;                     // TUNE_TYPE_xxx
+    uint8_t m_Flags;                    // TUNE_FLAG_xxx
+    uint8_t m_EepromAddress;            // 16 bits, or TUNE_NO_EEPROM
+    uint16_t m_Minimum;
+    uint16_t m_Maximum;
+    uint16_t (*m_Get)(void);
+    void (*m_Set)(uint16_t value);      // Only called with a value within the limits.
+} TUNE_PARAM;
+
+/* ***********************   Function Prototypes   ************************ */
+
+void LiveTuneInit (const TUNE_PARAM *params, uint8_t count);
+void LiveTuneApply (bool atRest);
+void LiveTuneService (void);
+
+#endif // LIVE_TUNE_H
+
+// end of file.
+//-------------------------------------------------------------------------
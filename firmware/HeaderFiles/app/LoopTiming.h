@@ -0,0 +1,57 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Filename: LoopTiming.h
+//
+// Description: Control loop period histogram and worst case per state.
+//
+// Author(s): G. Chopcinski (Kg Solutions, LLC)
+//
+// Created for ASL
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef LOOP_TIMING_H
+#define LOOP_TIMING_H
+
+/* ***************************    Includes     **************************** */
+
+// from stdlib
+#include <stdint.h>
+#include <stdbool.h>
+
+/* ******************************   Macros   ****************************** */
+
+// Bin n counts periods of 2^(n-1) to 2^n - 1 fast ticks (BSP_FAST_TICK_NS),
+// the last bin everything longer.
+#define LOOP_TIMING_NUM_BINS (16)
+#define LOOP_TIMING_NUM_STATES (16)     // gp_State values tracked, higher share the last.
+#define LOOP_TIMING_TRANSITION (0)      // Slot of the passes that changed state, NO_STATE's.
+#define LOOP_TIMING_SATURATED (0xffff)  // Period of LOOP_TIMING_WRAP_MS or more.
+#define LOOP_TIMING_WRAP_MS (((65536UL * BSP_FAST_TICK_NS) / 1000000UL) - 10) // Just under the fast tick's wrap.
+
+#define LOOP_TIMING_REPORT_PASSES (250) // Loop passes between telemetry pages.
+#define LOOP_TIMING_VALUES_PER_PAGE (7)
+
+#define LOOP_TIMING_EEPROM_SIZE ((LOOP_TIMING_NUM_BINS + LOOP_TIMING_NUM_STATES) * 2)
+
+/* ******************************   Types   ******************************* */
+
+typedef struct
+{
+    uint16_t m_Histogram[LOOP_TIMING_NUM_BINS];     // Saturates at 0xffff
+    uint16_t m_MaxPeriod[LOOP_TIMING_NUM_STATES];   // Fast ticks, per state
+} LOOP_TIMING_STRUCT;
+
+extern LOOP_TIMING_STRUCT g_LoopTiming;
+
+/* ***********************   Function Prototypes   ************************ */
+
+void LoopTimingReset (void);
+void LoopTimingMark (uint8_t state);
+void LoopTimingReport (void);
+void LoopTimingSave (uint8_t eepromAddress);
+
+#endif // LOOP_TIMING_H
+
+// end of file.
+//-------------------------------------------------------------------------
@@ -0,0 +1,42 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Filename: ResponseCurve.h
+//
+// Description: Joystick response curve shaping.
+//
+// Author(s): G. Chopcinski (Kg Solutions, LLC)
+//
+// Created for ASL
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef RESPONSE_CURVE_H
+#define RESPONSE_CURVE_H
+
+/* ***************************    Includes     **************************** */
+
+// from stdlib
+#include <stdint.h>
+
+/* ******************************   Macros   ****************************** */
+
+// The curves, in the order generated by tools/gen_response_curves.py.
+#define RESPONSE_CURVE_LINEAR (0)
+#define RESPONSE_CURVE_QUADRATIC (1)
+#define RESPONSE_CURVE_CUBIC_BLEND (2)
+#define RESPONSE_CURVE_S_CURVE (3)
+#define NUM_RESPONSE_CURVES (4)
+
+#define RESPONSE_CURVE_BITS (10)            // Deflection and result are Q10.
+#define RESPONSE_CURVE_FULL_SCALE (1 << RESPONSE_CURVE_BITS)
+
+/* ***********************   Function Prototypes   ************************ */
+
+void SetResponseCurve (uint8_t curve);
+uint8_t GetResponseCurve (void);
+uint16_t ApplyResponseCurve (uint16_t deflection);
+
+#endif // RESPONSE_CURVE_H
+
+// end of file.
+//-------------------------------------------------------------------------
@@ -0,0 +1,50 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Filename: ResponseCurveTable.h
+//
+// Description: Joystick response curve tables.
+//
+// GENERATED by tools/gen_response_curves.py, do not edit by hand.
+// Only to be included by ResponseCurve.c.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef RESPONSE_CURVE_TABLE_H
+#define RESPONSE_CURVE_TABLE_H
+
+#define RESPONSE_CURVE_TABLE_COUNT (4)
+#define RESPONSE_CURVE_POINTS (33)
+#define RESPONSE_CURVE_SEGMENT_SHIFT (5)   // Deflection per segment is 2^n.
+
+static const uint16_t g_ResponseCurveTable[RESPONSE_CURVE_TABLE_COUNT][RESPONSE_CURVE_POINTS] =
+{
+    // 0: RESPONSE_CURVE_LINEAR - Linear, as before curves were added.
+    {
+           0,   32,   64,   96,  128,  160,  192,  224,  256,  288,  320,
+         352,  384,  416,  448,  480,  512,  544,  576,  608,  640,  672,
+         704,  736,  768,  800,  832,  864,  896,  928,  960,  992, 1024
+    },
+    // 1: RESPONSE_CURVE_QUADRATIC - Quadratic, finer control at low speed.
+    {
+           0,    1,    4,    9,   16,   25,   36,   49,   64,   81,  100,
+         121,  144,  169,  196,  225,  256,  289,  324,  361,  400,  441,
+         484,  529,  576,  625,  676,  729,  784,  841,  900,  961, 1024
+    },
+    // 2: RESPONSE_CURVE_CUBIC_BLEND - 30% linear plus 70% cubic.
+    {
+           0,   10,   19,   29,   40,   51,   62,   75,   88,  102,  118,
+         135,  153,  173,  194,  218,  243,  271,  300,  332,  367,  404,
+         444,  487,  533,  582,  634,  690,  749,  812,  879,  949, 1024
+    },
+    // 3: RESPONSE_CURVE_S_CURVE - S-curve (smoothstep), soft at both ends.
+    {
+           0,    3,   12,   25,   44,   67,   94,  126,  160,  197,  238,
+         280,  324,  370,  416,  464,  512,  560,  608,  654,  700,  744,
+         786,  827,  864,  898,  930,  957,  980,  999, 1012, 1021, 1024
+    }
+};
+
+#endif // RESPONSE_CURVE_TABLE_H
+
+// end of file.
+//-------------------------------------------------------------------------
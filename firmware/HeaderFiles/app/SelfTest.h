@@ -0,0 +1,77 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Filename: SelfTest.h
+//
+// Description: Background check of the program flash and the RAM.
+//
+// Author(s): G. Chopcinski (Kg Solutions, LLC)
+//
+// Created for ASL
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef SELF_TEST_H
+#define SELF_TEST_H
+
+/* ***************************    Includes     **************************** */
+
+// from stdlib
+#include <stdint.h>
+#include <stdbool.h>
+
+/* ******************************   Macros   ****************************** */
+
+// Failure bits, see GetSelfTestFailure().
+#define SELFTEST_OK (0x00)
+#define SELFTEST_FAIL_FLASH (0x01)      // Flash CRC does not match the one in the image
+#define SELFTEST_FAIL_RAM (0x02)        // A RAM cell did not hold a pattern
+
+// The linker's --checksum option puts a CRC-16/CCITT-FALSE of
+// SELFTEST_FLASH_START to SELFTEST_FLASH_CRC_ADDRESS - 1 at
+// SELFTEST_FLASH_CRC_ADDRESS, low byte first. The unused flash in that
+// range is filled with 0xFFFF (--fill) so the linker sums what the erased
+// chip holds. See configurations.xml.
+#ifdef _18F46K40
+#ifdef NO_BOOTLOADER
+#define SELFTEST_FLASH_START (0x0000UL) // Programmed without the bootloader.
+#else
+#define SELFTEST_FLASH_START (0x0800UL) // After the bootloader, see bootloader/bootloader.c.
+#endif
+#define SELFTEST_FLASH_CRC_ADDRESS (0xfffeUL)
+#define SELFTEST_RAM_END (0x0e00)       // Banks 0 to 13. Bank 14 also holds SFRs.
+#else
+#define SELFTEST_FLASH_START (0x0000UL)
+#define SELFTEST_FLASH_CRC_ADDRESS (0x7ffeUL)
+#define SELFTEST_RAM_END (0x0800)
+#endif
+
+#ifndef SELFTEST_FLASH_SLICE
+#define SELFTEST_FLASH_SLICE (16)       // Flash bytes added to the CRC per call.
+#endif
+#define SELFTEST_RAM_WINDOW (8)         // RAM bytes tested per call, a power of 2.
+
+/* ******************************   Types   ******************************* */
+
+typedef struct
+{
+    uint16_t m_FlashPasses;         // Complete passes over the flash
+    uint16_t m_RamPasses;           // .. and the RAM.
+    uint16_t m_FlashCrc;            // CRC found by the last flash pass
+    uint16_t m_MaxFlashSlice;       // Longest call, in fast ticks (BSP_FAST_TICK_NS)
+    uint16_t m_MaxRamSlice;
+    uint16_t m_FailAddress;         // RAM window or flash CRC address that failed.
+    uint8_t m_Failure;              // SELFTEST_FAIL_xxx
+} SELFTEST_STRUCT;
+
+extern SELFTEST_STRUCT g_SelfTest;
+
+/* ***********************   Function Prototypes   ************************ */
+
+void SelfTestInit (void);
+uint8_t SelfTestService (void);
+uint8_t GetSelfTestFailure (void);
+
+#endif // SELF_TEST_H
+
+// end of file.
+//-------------------------------------------------------------------------
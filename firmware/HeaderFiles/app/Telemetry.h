@@ -0,0 +1,71 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Filename: Telemetry.h
+//
+// Description: Binary telemetry stream on the UART. See Telemetry.c for the
+//      frame layout and tools/telemetry_decode.py to read it.
+//
+// Author(s): G. Chopcinski (Kg Solutions, LLC)
+//
+// Created for ASL
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+/* ***************************    Includes     **************************** */
+
+// from stdlib
+#include <stdint.h>
+#include <stdbool.h>
+
+/* ******************************   Macros   ****************************** */
+
+#define TELEMETRY_SYNC_1 (0xa5)
+#define TELEMETRY_SYNC_2 (0x5a)
+#define TELEMETRY_PAYLOAD_SIZE (16)
+#define TELEMETRY_FRAME_SIZE (TELEMETRY_PAYLOAD_SIZE + 6)   // Sync, type, sequence, payload, CRC.
+
+// Frame types
+#define TELEMETRY_FRAME_SAMPLE (0x01)   // One pass of the control loop.
+#define TELEMETRY_FRAME_TIMING (0x02)   // A page of the loop timing, see LoopTiming.c.
+#define TELEMETRY_FRAME_TUNE (0x03)     // Response to a live tuning request, see LiveTune.c.
+
+#define TELEMETRY_DEFAULT_DECIMATION (8)    // Loop passes per sample frame, 0 = off.
+
+// Flags in the sample frame.
+#define TELEMETRY_FLAG_FAULT_MASK (0x0f)    // FAULT_xxx bits seen since power up.
+#define TELEMETRY_FLAG_GATE (0x10)          // Gate normalisation in use.
+#define TELEMETRY_FLAG_BT_PROPORTIONAL (0x20)
+#define TELEMETRY_FLAG_FAULT_LATCHED (0x80)
+
+/* ******************************   Types   ******************************* */
+
+// The values sent in the sample frames. Filled in by the control loop as it
+// goes.
+typedef struct
+{
+    uint16_t m_RawSpeed;            // As read from the ADC (averaged)
+    uint16_t m_RawDirection;
+    uint16_t m_FilteredSpeed;       // After gate normalisation
+    uint16_t m_FilteredDirection;
+    uint16_t m_SpeedDemand;         // As sent to the DACs
+    uint16_t m_DirectionDemand;
+    uint8_t m_Flags;                // TELEMETRY_FLAG_xxx
+} TELEMETRY_SAMPLE;
+
+extern TELEMETRY_SAMPLE g_TelemetrySample;
+
+/* ***********************   Function Prototypes   ************************ */
+
+void TelemetryInit (void);
+void TelemetrySetDecimation (uint8_t decimation);
+uint8_t TelemetryGetDecimation (void);
+void TelemetryService (uint8_t state);
+bool TelemetrySendFrame (uint8_t type, const uint8_t *payload);
+
+#endif // TELEMETRY_H
+
+// end of file.
+//-------------------------------------------------------------------------
@@ -37,6 +37,13 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+// Bits returned by GetUserButtonMask(). Set = active / closed.
+#define BUTTON_MASK_CALIBRATION (0x01)
+#define BUTTON_MASK_USER_PORT   (0x02)
+#define BUTTON_MASK_MODE        (0x04)  // The Mode button input only.
+#define BUTTON_MASK_SW2_1       (0x08)
+#define BUTTON_MASK_SW2_2       (0x10)
+
 void Read_User_Buttons(void);
 void UserButtonInit(void);
 bool IsCalibrationButtonActive (void);
@@ -44,6 +51,7 @@ bool IsUserPortButtonActive (void);
 bool IsModeButtonActive (void);
 bool IsSW2_1_Closed (void);
 bool IsSW2_2_Closed (void);
+uint8_t GetUserButtonMask (void);
 
 
 #endif	/* USER_BUTTON_H */
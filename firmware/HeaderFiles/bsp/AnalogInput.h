@@ -37,39 +37,149 @@
 
 enum JOYSTICK_CHANNEL_ENUM {SPEED_ARRAY, DIRECTION_ARRAY, NUM_JS_POTS};
 
-// This holds the Joystick information 
+// This holds the Joystick information used by the control loop. The fields
+// are ordered by how often the loop touches them and the array is placed in
+// access RAM (see AnalogInput.c).
 typedef struct 
 {
-    uint16_t m_rawInput;
-    uint16_t m_rawNeutral;
     uint16_t m_rawMinNeutral;
     uint16_t m_rawMaxNuetral;
-    uint16_t m_rawMinimum;
-    uint16_t m_rawMaximum;
+    uint16_t m_rawNeutral;
     uint16_t m_PositiveScale;   // This is used to scale from neutral to Most Positive
     uint16_t m_NegativeScale;   // This is used to scale from neutral to Most Negative
 } JOYSTICK_STRUCT;
 
-extern JOYSTICK_STRUCT Joystick_Data[NUM_JS_POTS];
+extern __near JOYSTICK_STRUCT Joystick_Data[NUM_JS_POTS];
+
+// Joystick information only used while calibrating or establishing neutral.
+// Kept apart from Joystick_Data so it does not take up access RAM.
+typedef struct
+{
+    uint16_t m_rawInput;
+    uint16_t m_rawMinimum;
+    uint16_t m_rawMaximum;
+} JOYSTICK_CAL_STRUCT;
+
+extern JOYSTICK_CAL_STRUCT Joystick_Calibration[NUM_JS_POTS];
+
+// Thresholds derived from Joystick_Data. They only change when the neutral
+// or the calibration changes, so they are computed then by
+// UpdateJoystickThresholds() instead of on every pass through the loop.
+typedef struct
+{
+    uint16_t m_ClampMaximum;    // m_rawNeutral + m_PositiveScale
+    uint16_t m_ClampMinimum;    // m_rawNeutral - m_NegativeScale
+    uint16_t m_HalfPositive;    // m_rawNeutral + m_PositiveScale / 2
+    uint16_t m_HalfNegative;    // m_rawNeutral - m_NegativeScale / 2
+    uint16_t m_CentredMinimum;  // m_rawNeutral - GetNeutralMargin() * 2
+    uint16_t m_CentredMaximum;  // m_rawNeutral + GetNeutralMargin() * 2
+    uint16_t m_PositiveRange;   // Travel from the neutral window to m_ClampMaximum
+    uint16_t m_NegativeRange;   // Travel from the neutral window to m_ClampMinimum
+    uint16_t m_PositiveInverse; // 2^20 / m_PositiveScale
+    uint16_t m_NegativeInverse; // 2^20 / m_NegativeScale
+} JOYSTICK_THRESHOLDS;
+
+extern __near JOYSTICK_THRESHOLDS Joystick_Thresholds[NUM_JS_POTS];
 
 #define NEUTRAL_JOYSTICK_INPUT (0x202)
 
-#ifdef BUILD_FOR_ASL133_ASL134
+// The tuning values below can be given on the command line (-D) to try
+// others without editing the source.
 // The ASL133 and ASL134 joysticks require a much smaller Neutral Area than
-// ... ASL128, ASL130 and ASL138 joysticks.
-#define NEUTRAL_ERROR_MARGIN (0x18)     // The amount of deviation from the Neutral
+// ... ASL128, ASL130 and ASL138 joysticks. Which one is fitted is found at
+// power up, see JoystickType.c.
+#define NEUTRAL_MARGIN_STANDARD (0x40)  // ASL128, ASL130 and ASL138
+#define NEUTRAL_MARGIN_COMPACT (0x18)   // ASL133 and ASL134
+
+// Only the RNet configurations find the joystick type, they define
+// JOYSTICK_AUTO_DETECT as 1. A margin given for the build, or
+// BUILD_FOR_ASL133_ASL134, is used instead of the one for the type found.
+// So is a neutral_margin saved by live tuning, which is how a compact
+// joystick the detection does not recognise gets its window.
+#ifdef NEUTRAL_ERROR_MARGIN
+#undef JOYSTICK_AUTO_DETECT
+#elif defined (BUILD_FOR_ASL133_ASL134)
+#define NEUTRAL_ERROR_MARGIN (NEUTRAL_MARGIN_COMPACT)
+#undef JOYSTICK_AUTO_DETECT
 #else
-#define NEUTRAL_ERROR_MARGIN (0x40)     // The amount of deviation from the Neutral
+#define NEUTRAL_ERROR_MARGIN (NEUTRAL_MARGIN_STANDARD)  // The amount of deviation from the Neutral
+#endif                                  // .. at power up, see SetNeutralMargin().
+#ifndef JOYSTICK_AUTO_DETECT
+#define JOYSTICK_AUTO_DETECT (0)        // 1 = pick the neutral margin for the joystick found.
 #endif
 
+#ifndef JOYSTICK_RAW_MAX_DEFLECTION
 #define JOYSTICK_RAW_MAX_DEFLECTION (220)   // This is the max that the joystick 
                                         // .. input can deviate from neutral.
+#endif
+
+#if (NEUTRAL_ERROR_MARGIN < 1) || ((NEUTRAL_ERROR_MARGIN * 2) >= JOYSTICK_RAW_MAX_DEFLECTION)
+#error "NEUTRAL_ERROR_MARGIN must leave room for a deflection past the centred band"
+#endif
+#if ((NEUTRAL_JOYSTICK_INPUT + JOYSTICK_RAW_MAX_DEFLECTION) > 1023)
+#error "JOYSTICK_RAW_MAX_DEFLECTION does not fit in the ADC range"
+#endif
+#define JOYSTICK_INVERSE_SHIFT (20)     // m_PositiveInverse and m_NegativeInverse are 2^20 / scale.
+
+// ADC conversion modes, see SetAdcMode().
+#define ADC_MODE_NORMAL (0)             // Fosc clock, the CPU waits for the result.
+#define ADC_MODE_LOW_NOISE (1)          // FRC clock, the CPU idles during the conversion.
+#define NUM_ADC_MODES (2)
+
+#ifndef ADC_DEFAULT_MODE
+#define ADC_DEFAULT_MODE (ADC_MODE_NORMAL)
+#endif
+
+#ifndef ADC_NORMAL_SAMPLES
+#define ADC_NORMAL_SAMPLES (10)         // Readings averaged by GetSpeedAndDirection() ..
+#endif
+#define ADC_LOW_NOISE_SAMPLES (4)       // .. in each mode.
+#define ADC_NOISE_SAMPLES (64)          // Readings of each input for MeasureAdcNoise().
+
+// GetSpeedAndDirection() sums the 10 bit readings in 16 bits.
+#if (ADC_NORMAL_SAMPLES < 1) || (ADC_NORMAL_SAMPLES > 64)
+#error "ADC_NORMAL_SAMPLES must be 1 to 64"
+#endif
+
+// Noise on the joystick inputs in one ADC mode, see MeasureAdcNoise().
+typedef struct
+{
+    uint16_t m_Mean[NUM_JS_POTS];
+    uint16_t m_StdDevQ4[NUM_JS_POTS];   // Standard deviation of single readings * 16
+} ADC_NOISE_REPORT;
+
+extern ADC_NOISE_REPORT g_AdcNoise[NUM_ADC_MODES];
+
+// A conversion takes the acquisition time and about 12 TAD, ~30 us from
+// Fosc and at most ~130 us from FRC. The wait for it is timed with the
+// fast tick and given up after ADC_TIMEOUT_US, so it does not depend on
+// F_CPU or on how the poll loop compiles.
+#define ADC_TIMEOUT_US (250)
+#define ADC_TIMEOUT_TICKS (CLOCK_US_TO_FAST_TICKS(ADC_TIMEOUT_US))
+#define ADC_TIMEOUT_READING (0)         // Returned for a conversion that timed out.
+
+// Neutral drift tracking
+#define NEUTRAL_TRACK_SHIFT (6)         // Filter time constant is 2^6 readings.
+#define NEUTRAL_TRACK_REST_BAND (8)     // Joystick is resting within this of neutral
+#define NEUTRAL_TRACK_REST_SAMPLES (50) // .. for this many readings in a row.
+#define NEUTRAL_DRIFT_LIMIT (GetNeutralMargin() / 2)    // Furthest the neutral may drift.
 
 void AnalogInputInit(void);
 uint16_t ReadSpeed (void);
 uint16_t ReadDirection (void);
 void GetSpeedAndDirection (uint16_t *speed, uint16_t *direction);
-bool IsJoystickInNeutral (void);
+bool AdcTimedOut (void);
+void SetAdcMode (uint8_t mode);
+uint8_t GetAdcMode (void);
+void MeasureAdcNoise (void);
+bool IsInNeutralWindow (uint16_t rawSpeed, uint16_t rawDirection);
+void UpdateJoystickThresholds (void);
+void SetNeutralMargin (uint16_t margin);
+uint16_t GetNeutralMargin (void);
+void NeutralTrackerReset (void);
+void NeutralTrackerUpdate (uint16_t rawSpeed, uint16_t rawDirection);
+int16_t GetNeutralDrift (uint8_t axis);
+uint16_t SquareRoot (uint32_t value);
     
 #endif	/* ANALOG_INPUT_H */
 
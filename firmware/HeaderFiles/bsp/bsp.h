@@ -21,6 +21,9 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+// from local
+#include "clock_bsp.h"              // F_CPU, BSP_FAST_TICK_NS
+
 /* ******************************   Macros   ****************************** */
 
 #define GPIO_LOW 		(0)
@@ -30,59 +33,44 @@
 #define GPIO_BIT_INPUT 	(1)
 #define GPIO_BIT_OUTPUT (0)
 
+// A button must read its new level on more than this many passes in a row
+// before it is taken. Can be given on the command line (-D).
+#ifndef MAX_DEBOUNCE
 #define MAX_DEBOUNCE (5) // (8)
+#endif
+
+#if (MAX_DEBOUNCE > 254)
+#error "MAX_DEBOUNCE must fit the 8 bit debounce counters"
+#endif
 
 //-----------------------
 // microsecond delay values
 // NOTE: When calling bspDelayUs, only use these values!
 //
-// Through test (building with opt0/1/2) found that the only flag that gets set is this one.  Unfortunately,
-// it is the same flag set for opt level 1 and 2. There is no difference in flags set between opt 1 and 2.
-#if (__OPTIM_FLAGS & 0x01)
-	// This is optimization level 2
-	#define US_DELAY_20_us 		(4) // Actual: 20 us.  This is the minimum "optimization level common" delay value
-	#define US_DELAY_50_us 		(10) // Actual: 51.6 us
-	#define US_DELAY_75_us 		(19) // Actual: 76.8us
-	#define US_DELAY_100_us 	(28) // Actual: 102 us
-	#define US_DELAY_125_us 	(37) // Actual: 127.2 us
-	#define US_DELAY_150_us 	(45) // Actual: 149.6 us
-	#define US_DELAY_175_us 	(54) // Actual: 174.8us
-	#define US_DELAY_200_us 	(63) // Actual: 200 us
-	#define US_DELAY_225_us 	(72) // Actual: 225.2 us
-	#define US_DELAY_250_us 	(81) // Actual: 250.4 us
-	#define US_DELAY_275_us 	(90) // Actual: 275.6 us
-	#define US_DELAY_300_us 	(99) // Actual: 300.8 us
-	#define US_DELAY_325_us 	(108) // Actual: 326 us
-	#define US_DELAY_350_us 	(117) // Actual: 351.2 us
-	#define US_DELAY_375_us 	(126) // Actual: 376.4 us
-	#define US_DELAY_400_us 	(134) // Actual: 398.8 us
-	#define US_DELAY_425_us 	(144) // Actual: 426.8 us
-	#define US_DELAY_450_us 	(152) // Actual: 449.2 us
-	#define US_DELAY_475_us 	(162) // Actual: 477.2 us
-	#define US_DELAY_500_us 	(171) // Actual: 499.6. us
-#else
-	// This is optimization level 0
-	#define US_DELAY_20_us 		(2) // Actual: 20 us.  This is the minimum "optimization level common" delay value
-	#define US_DELAY_50_us 		(12) // Actual: 50.8 us
-	#define US_DELAY_75_us 		(14) // Actual: 76.4us
-	#define US_DELAY_100_us 	(22) // Actual: 102 us
-	#define US_DELAY_125_us 	(30) // Actual: 127.6 us
-	#define US_DELAY_150_us 	(37) // Actual: 150 us
-	#define US_DELAY_175_us 	(45) // Actual: 175.2us
-	#define US_DELAY_200_us 	(53) // Actual: 201.2 us
-	#define US_DELAY_225_us 	(61) // Actual: 226.8 us
-	#define US_DELAY_250_us 	(69) // Actual: 252.4 us
-	#define US_DELAY_275_us 	(76) // Actual: 274.8 us
-	#define US_DELAY_300_us 	(84) // Actual: 300.4 us
-	#define US_DELAY_325_us 	(92) // Actual: 326 us
-	#define US_DELAY_350_us 	(100) // Actual: 351.6 us
-	#define US_DELAY_375_us 	(108) // Actual: 377.2 us
-	#define US_DELAY_400_us 	(115) // Actual: 399.6 us
-	#define US_DELAY_425_us 	(123) // Actual: 425.2 us
-	#define US_DELAY_450_us 	(131) // Actual: 450.8 us
-	#define US_DELAY_475_us 	(139) // Actual: 476.4 us
-	#define US_DELAY_500_us 	(146) // Actual: 498.8. us
-#endif
+// bspDelayUs() times the delay with the fast tick, so these are fast tick
+// counts worked out from F_CPU and do not depend on the optimisation level.
+// The delay is rounded up to a whole fast tick and the call adds a few us.
+#define US_DELAY_20_us 		CLOCK_US_TO_FAST_TICKS(20)
+#define US_DELAY_50_us 		CLOCK_US_TO_FAST_TICKS(50)
+#define US_DELAY_75_us 		CLOCK_US_TO_FAST_TICKS(75)
+#define US_DELAY_100_us 	CLOCK_US_TO_FAST_TICKS(100)
+#define US_DELAY_125_us 	CLOCK_US_TO_FAST_TICKS(125)
+#define US_DELAY_150_us 	CLOCK_US_TO_FAST_TICKS(150)
+#define US_DELAY_175_us 	CLOCK_US_TO_FAST_TICKS(175)
+#define US_DELAY_200_us 	CLOCK_US_TO_FAST_TICKS(200)
+#define US_DELAY_225_us 	CLOCK_US_TO_FAST_TICKS(225)
+#define US_DELAY_250_us 	CLOCK_US_TO_FAST_TICKS(250)
+#define US_DELAY_275_us 	CLOCK_US_TO_FAST_TICKS(275)
+#define US_DELAY_300_us 	CLOCK_US_TO_FAST_TICKS(300)
+#define US_DELAY_325_us 	CLOCK_US_TO_FAST_TICKS(325)
+#define US_DELAY_350_us 	CLOCK_US_TO_FAST_TICKS(350)
+#define US_DELAY_375_us 	CLOCK_US_TO_FAST_TICKS(375)
+#define US_DELAY_400_us 	CLOCK_US_TO_FAST_TICKS(400)
+#define US_DELAY_425_us 	CLOCK_US_TO_FAST_TICKS(425)
+#define US_DELAY_450_us 	CLOCK_US_TO_FAST_TICKS(450)
+#define US_DELAY_475_us 	CLOCK_US_TO_FAST_TICKS(475)
+#define US_DELAY_500_us 	CLOCK_US_TO_FAST_TICKS(500)
+#define US_DELAY_1000_us 	CLOCK_US_TO_FAST_TICKS(1000)
 
 #define US_DELAY_MIN			US_DELAY_20_us
 
@@ -93,6 +81,8 @@ void bspDisableInterrupts(void);
 void bspEnableInterrupts(void);
 void bspDelayUs(uint16_t delay);
 void bspDelayMs(uint16_t delay);
+uint16_t bspGetSysTick(void);
+uint16_t bspGetFastTick(void);
 
 #endif // BSP_H
 
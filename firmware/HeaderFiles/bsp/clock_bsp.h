@@ -0,0 +1,138 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Filename: clock_bsp.h
+//
+// Description: Selects the CPU clock at build time and derives the timer,
+//  ADC and delay settings from it.
+//
+//  Build with CLOCK_SOURCE set to one of the CLOCK_SOURCE_xxx values. The
+//  oscillator configuration bits (device_xc8.h), the system tick (Timer 2),
+//  the fast tick (Timer 1), the ADC clock and acquisition time, the UART
+//  baud rate and the US_DELAY_xxx values all follow from F_CPU.
+//
+// Author(s): G. Chopcinski (Kg Solutions, LLC)
+//
+// Created for ASL
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef CLOCK_BSP_H
+#define CLOCK_BSP_H
+
+/* ******************************   Macros   ****************************** */
+
+#define CLOCK_SOURCE_HS (0)             // 10 MHz crystal
+#define CLOCK_SOURCE_HS_PLL (1)         // 10 MHz crystal with the 4x PLL, 46K40 only
+#define CLOCK_SOURCE_HFINTOSC (2)       // 64 MHz internal oscillator, 46K40 only
+
+#ifndef CLOCK_SOURCE
+#define CLOCK_SOURCE (CLOCK_SOURCE_HS)
+#endif
+
+#define CLOCK_CRYSTAL_HZ (10000000UL)
+
+#if (CLOCK_SOURCE == CLOCK_SOURCE_HS)
+#define F_CPU (CLOCK_CRYSTAL_HZ)
+#elif (CLOCK_SOURCE == CLOCK_SOURCE_HS_PLL)
+#define F_CPU (4 * CLOCK_CRYSTAL_HZ)
+#elif (CLOCK_SOURCE == CLOCK_SOURCE_HFINTOSC)
+#define F_CPU (64000000UL)
+#else
+#error "Unknown CLOCK_SOURCE"
+#endif
+
+#if !defined(_18F46K40) && (CLOCK_SOURCE != CLOCK_SOURCE_HS)
+#error "Only CLOCK_SOURCE_HS is supported on the PIC18F4550"
+#endif
+
+#if (F_CPU % 1000000UL)
+#error "F_CPU must be a whole number of MHz"
+#endif
+
+#define CLOCK_MHZ (F_CPU / 1000000UL)
+#define CLOCK_TCY_PS (4000000UL / CLOCK_MHZ)    // Instruction cycle, in ps.
+
+//-----------------------
+// System tick, Timer 2 from Fosc/4. The prescaler is the smallest that
+// lets PR2 reach 1 ms.
+#define CLOCK_SYSTICK_HZ (1000UL)
+
+#if ((F_CPU / 4) <= (CLOCK_SYSTICK_HZ * 256UL * 16UL))
+#define CLOCK_TIMER2_PRESCALE (16UL)
+#define CLOCK_TIMER2_CKPS (4)           // T2CON CKPS on the 46K40
+#elif ((F_CPU / 4) <= (CLOCK_SYSTICK_HZ * 256UL * 64UL))
+#define CLOCK_TIMER2_PRESCALE (64UL)
+#define CLOCK_TIMER2_CKPS (6)
+#else
+#error "No Timer 2 prescaler gives the system tick at this F_CPU"
+#endif
+
+#define CLOCK_TIMER2_PR2 (((((F_CPU / 4) / CLOCK_TIMER2_PRESCALE) + (CLOCK_SYSTICK_HZ / 2)) / CLOCK_SYSTICK_HZ) - 1)
+
+//-----------------------
+// Fast tick, Timer 1 from Fosc/4 with a /8 prescaler.
+#define CLOCK_TIMER1_PRESCALE (8UL)
+#define BSP_FAST_TICK_NS ((CLOCK_TIMER1_PRESCALE * 4000UL) / CLOCK_MHZ)
+
+#if (((CLOCK_TIMER1_PRESCALE * 4000UL) % CLOCK_MHZ) != 0)
+#error "The fast tick is not a whole number of ns at this F_CPU"
+#endif
+
+//-----------------------
+// ADC clock, Fosc / CLOCK_ADC_DIVIDER. The divider is the smallest that
+// gives a TAD of at least CLOCK_ADC_TAD_TARGET_NS.
+#define CLOCK_ADC_TAD_TARGET_NS (1600UL)
+
+#ifdef _18F46K40
+// ADCLK: Fosc / (2 * (ADCS + 1)), ADCS is 6 bits.
+#define CLOCK_ADC_ADCS ((((CLOCK_ADC_TAD_TARGET_NS * CLOCK_MHZ) + 1999UL) / 2000UL) - 1)
+#define CLOCK_ADC_DIVIDER (2 * (CLOCK_ADC_ADCS + 1))
+#if (CLOCK_ADC_ADCS > 63)
+#error "The ADC clock can not be divided down far enough"
+#endif
+#define CLOCK_ADC_TAD_MIN_NS (1000UL)   // Data sheet table 37-13, AD27.
+#define CLOCK_ADC_TAD_MAX_NS (9000UL)
+#else
+// ADCON2 ADCS only divides by powers of 2.
+#if ((CLOCK_ADC_TAD_TARGET_NS * CLOCK_MHZ) <= 16000UL)
+#define CLOCK_ADC_DIVIDER (16UL)
+#define CLOCK_ADC_ADCS (0x05)
+#else
+#define CLOCK_ADC_DIVIDER (64UL)
+#define CLOCK_ADC_ADCS (0x06)
+#endif
+#define CLOCK_ADC_TAD_MIN_NS (800UL)    // Data sheet table 28-29, parameter 130.
+#define CLOCK_ADC_TAD_MAX_NS (25000UL)
+#endif
+
+#define CLOCK_ADC_TAD_NS ((CLOCK_ADC_DIVIDER * 1000UL) / CLOCK_MHZ)
+
+#if (CLOCK_ADC_TAD_NS < CLOCK_ADC_TAD_MIN_NS) || (CLOCK_ADC_TAD_NS > CLOCK_ADC_TAD_MAX_NS)
+#error "The ADC clock is outside the data sheet's TAD limits"
+#endif
+
+//-----------------------
+// LTC1257 serial interface (data sheet, timing characteristics): clock
+// high and low at least 350 ns, load pulse at least 150 ns. dacBspSet()
+// changes a line at most once per function call, which takes no less than
+// CLOCK_DAC_MIN_EDGE_CYCLES instruction cycles (CALL, RETURN and the
+// switch), so these have to fit in that.
+#define CLOCK_DAC_MIN_EDGE_CYCLES (8UL)
+#define CLOCK_LTC1257_CLOCK_NS (350UL)
+#define CLOCK_LTC1257_LOAD_NS (150UL)
+
+#if ((CLOCK_DAC_MIN_EDGE_CYCLES * CLOCK_TCY_PS) < (CLOCK_LTC1257_CLOCK_NS * 1000UL))
+#error "F_CPU is too fast for the LTC1257 clock timing"
+#endif
+#if ((CLOCK_DAC_MIN_EDGE_CYCLES * CLOCK_TCY_PS) < (CLOCK_LTC1257_LOAD_NS * 1000UL))
+#error "F_CPU is too fast for the LTC1257 load pulse"
+#endif
+
+//-----------------------
+// Converts microseconds to the fast ticks bspDelayUs() takes, rounded up.
+#define CLOCK_US_TO_FAST_TICKS(us) (((((uint32_t) (us)) * 1000UL) + BSP_FAST_TICK_NS - 1) / BSP_FAST_TICK_NS)
+
+#endif // CLOCK_BSP_H
+
+// end of file.
+//-------------------------------------------------------------------------
@@ -16,13 +16,23 @@
 #define GPIO_BIT_INPUT 	(1)
 #define GPIO_BIT_OUTPUT (0)
 
+#include "clock_bsp.h"          // CLOCK_SOURCE picks the oscillator settings.
+
 /* **************************    Chip Config     ************************** */
 
 #ifdef _18F46K40
 
 	// CONFIG1L
+#if (CLOCK_SOURCE == CLOCK_SOURCE_HFINTOSC)
+	#pragma config FEXTOSC = OFF    // External Oscillator mode Selection bits (Oscillator not enabled)
+	#pragma config RSTOSC = HFINTOSC_64MHZ // Power-up default value for COSC bits (HFINTOSC with HFFRQ = 64 MHz and CDIV = 1:1)
+#elif (CLOCK_SOURCE == CLOCK_SOURCE_HS_PLL)
+	#pragma config FEXTOSC = HS     // External Oscillator mode Selection bits (HS (crystal oscillator) above 8 MHz; PFM set to high power)
+	#pragma config RSTOSC = EXTOSC_4PLL // Power-up default value for COSC bits (EXTOSC with 4x PLL, with EXTOSC operating per FEXTOSC bits)
+#else
 	#pragma config FEXTOSC = HS     // External Oscillator mode Selection bits (HS (crystal oscillator) above 8 MHz; PFM set to high power)
 	#pragma config RSTOSC = EXTOSC  // Power-up default value for COSC bits (EXTOSC operating per FEXTOSC bits (device manufacturing default))
+#endif
 
 	// CONFIG1H
 	#pragma config CLKOUTEN = OFF   // Clock Out Enable bit (CLKOUT function is disabled)
@@ -76,7 +86,11 @@
 
 	// CONFIG4H
 	#pragma config WRTC = OFF       // Configuration Register Write Protection bit (Configuration registers (300000-30000Bh) not write-protected)
-	#pragma config WRTB = OFF       // Boot Block Write Protection bit (Boot Block (000000-0007FFh) not write-protected)
+#ifdef NO_BOOTLOADER
+	#pragma config WRTB = OFF       // Boot Block Write Protection bit (Boot Block (000000-0007FFh) not write-protected, the application starts there)
+#else
+	#pragma config WRTB = ON        // Boot Block Write Protection bit (Boot Block (000000-0007FFh) write-protected, holds the bootloader)
+#endif
 	#pragma config WRTD = OFF       // Data EEPROM Write Protection bit (Data EEPROM not write-protected)
 	#pragma config SCANE = OFF      // Scanner Enable bit (Scanner module is NOT available for use, SCANMD bit is ignored)
 	#pragma config LVP = OFF        // Low Voltage Programming Enable bit (HV on MCLR/VPP must be used for programming)
@@ -28,6 +28,7 @@ void eepromBspInit(void);
 //uint16_t eepromBspSizeOfEeprom(void);
 void EEPROM_writeInt16 (uint8_t address, uint16_t data);
 void EEPROM_readInt16 (uint8_t address, uint16_t *data);
+bool EEPROM_tryWriteByte (uint8_t address, uint8_t data);
 
 #endif // EEPROM_BSP_H
 
@@ -0,0 +1,107 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Filename: hal.h
+//
+// Description: Register access that differs between the PIC18F46K40 and the
+//      PIC18F4550: ADC channel select, pin direction, analog/digital select,
+//      weak pull-ups and the EEPROM (NVM) registers.
+//
+//  These are macros rather than functions so that they compile to the same
+//  register writes as before at any optimisation level, with no calls. Ports
+//  and pins are given as tokens, HAL_PIN_OUTPUT (E, 1) for RE1.
+//
+//  All register names are the ones in <xc.h>, so a host build can supply
+//  its own <xc.h> declaring them as variables and use this file unchanged.
+//
+// Author(s): G. Chopcinski (Kg Solutions, LLC)
+//
+// Created for ASL
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef HAL_H
+#define HAL_H
+
+/* ******************************   Macros   ****************************** */
+
+// Pin direction, the same on both chips.
+#define HAL_PIN_OUTPUT(port, pin) (TRIS##port##bits.TRIS##port##pin = GPIO_BIT_OUTPUT)
+#define HAL_PIN_INPUT(port, pin) (TRIS##port##bits.TRIS##port##pin = GPIO_BIT_INPUT)
+
+#ifdef _18F46K40
+
+#define HAL_PIN_DIGITAL(port, pin) (ANSEL##port##bits.ANSEL##port##pin = 0)
+#define HAL_PIN_PULLUP(port, pin) (WPU##port##bits.WPU##port##pin = 1)
+
+#define HAL_ADC_SELECT(channel) (ADPCHbits.ADPCH = (channel))
+
+// EEPROM. NVMREG = 0 selects the data EEPROM.
+#define HAL_EEPROM_BUSY() (NVMCON1bits.WR)
+#define HAL_EEPROM_SELECT(address) \
+    do { \
+        NVMCON1bits.NVMREG = 0; \
+        NVMADRL = (address); \
+        NVMADRH = 0; /* This application does not use that much EEPROM. */ \
+    } while (0)
+#define HAL_EEPROM_DATA NVMDAT
+#define HAL_EEPROM_READ() (NVMCON1bits.RD = 1)
+#define HAL_EEPROM_WRITE_ENABLE() (NVMCON1bits.WREN = 1)
+#define HAL_EEPROM_WRITE_DISABLE() (NVMCON1bits.WREN = 0)
+#define HAL_EEPROM_UNLOCK_AND_WRITE() \
+    do { \
+        NVMCON2 = 0x55; \
+        NVMCON2 = 0xAA; \
+        NVMCON1bits.WR = 1; \
+    } while (0)
+
+#else // PIC18F4550
+
+// ADCON1bits.PCFG (AnalogInputInit) leaves only AN0 to AN2 analog, every
+// other pin is already digital.
+#define HAL_PIN_DIGITAL(port, pin) ((void) 0)
+
+// The pull-ups are on PORTB only and all enabled together. Pins on other
+// ports need an external pull-up.
+#define HAL_PIN_PULLUP(port, pin) HAL_PULLUP_##port
+#define HAL_PULLUP_A ((void) 0)
+#define HAL_PULLUP_B (INTCON2bits.RBPU = 0)
+#define HAL_PULLUP_C ((void) 0)
+#define HAL_PULLUP_D ((void) 0)
+#define HAL_PULLUP_E ((void) 0)
+
+#define HAL_ADC_SELECT(channel) (ADCON0bits.CHS = (channel))
+
+// EEPROM. CFGS = 0 and EEPGD = 0 select the data EEPROM.
+#define HAL_EEPROM_BUSY() (EECON1bits.WR)
+#define HAL_EEPROM_SELECT(address) \
+    do { \
+        EEADR = (address); \
+        EECON1bits.CFGS = 0; \
+        EECON1bits.EEPGD = 0; \
+    } while (0)
+#define HAL_EEPROM_DATA EEDATA
+#define HAL_EEPROM_READ() \
+    do { \
+        EECON1bits.RD = 1; \
+        Nop(); /* May be required for latency at high frequencies. */ \
+        Nop(); \
+    } while (0)
+#define HAL_EEPROM_WRITE_ENABLE() (EECON1bits.WREN = 1)
+#define HAL_EEPROM_WRITE_DISABLE() \
+    do { \
+        EECON1bits.WREN = 0; \
+        EECON1bits.WR = 0; \
+    } while (0)
+#define HAL_EEPROM_UNLOCK_AND_WRITE() \
+    do { \
+        EECON2 = 0x55; \
+        EECON2 = 0xAA; \
+        EECON1bits.WR = 1; \
+    } while (0)
+
+#endif // _18F46K40
+
+#endif // HAL_H
+
+// end of file.
+//-------------------------------------------------------------------------
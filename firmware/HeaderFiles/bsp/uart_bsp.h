@@ -0,0 +1,39 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Filename: uart_bsp.h
+//
+// Description: Interrupt driven EUSART1 driver for the PIC18F46K40.
+//      TX is on RC6, RX on RC7.
+//
+// Author(s): G. Chopcinski (Kg Solutions, LLC)
+//
+// Created for ASL
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef UART_BSP_H
+#define UART_BSP_H
+
+/* ***************************    Includes     **************************** */
+
+// from stdlib
+#include <stdint.h>
+#include <stdbool.h>
+
+/* ******************************   Macros   ****************************** */
+
+#define UART_BAUD_RATE (115200UL)
+#define UART_TX_BUFFER_SIZE (64)        // Must be a power of 2.
+#define UART_RX_BUFFER_SIZE (32)        // Must be a power of 2.
+
+/* ***********************   Function Prototypes   ************************ */
+
+void uartBspInit(void);
+bool uartBspWrite(const uint8_t *data, uint8_t length);
+bool uartBspRead(uint8_t *data);
+void uartBspIsr(void);
+
+#endif // UART_BSP_H
+
+// end of file.
+//-------------------------------------------------------------------------
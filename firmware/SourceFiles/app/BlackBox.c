@@ -0,0 +1,247 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Filename: BlackBox.c
+//
+// Description: Records the last events in RAM and copies them to the
+//  EEPROM after a fault or when asked.
+//
+//  Events go into a ring of the last BLACKBOX_NUM_EVENTS. Button edges are
+//  found by BlackBoxService(), which is called once per pass through the
+//  control loop; anything else, state changes included, is recorded where
+//  it happens with BlackBoxRecord().
+//
+//  BlackBoxFlush() asks for a copy of the ring in the EEPROM. The copy is
+//  taken on the next BlackBoxService() call, then written a byte at a time
+//  whenever the EEPROM is free, so the control loop never waits on it. The
+//  magic byte is cleared first and written last, so a copy cut short by a
+//  reset is not mistaken for a good one. Bytes that already hold the right
+//  value are not rewritten.
+//
+//  tools/blackbox_decode.py turns an EEPROM dump into a timeline.
+//
+// Author(s): G. Chopcinski (Kg Solutions, LLC)
+//
+// Created for ASL
+//
+//////////////////////////////////////////////////////////////////////////////
+
+/* **************************   Header Files   *************************** */
+
+// NOTE: This must ALWAYS be the first include in a file.
+#include "device_xc8.h"
+
+// from stdlib
+#include <stdint.h>
+#include <stdbool.h>
+
+// from project
+#include "bsp.h"
+#include "eeprom_bsp.h"
+
+// from local
+#include "BlackBox.h"
+
+/* ******************************   Macros   ****************************** */
+
+#define BLACKBOX_IDLE (0xff)            // g_FlushStep when not copying.
+
+/* ***********************   File Scope Variables   *********************** */
+
+static BLACKBOX_EVENT g_Events[BLACKBOX_NUM_EVENTS];
+static uint8_t g_Head;                  // Where the next event goes
+static uint8_t g_Count;
+
+static uint8_t g_LastButtons;
+
+static uint8_t g_EepromAddress;
+static uint8_t g_Image[BLACKBOX_EEPROM_SIZE];
+static uint8_t g_FlushStep;             // 0 clears the magic, then g_Image[1..], then the magic.
+static uint8_t g_FlushCause;            // Copy asked for, 0 = none.
+static uint8_t g_CopyNumber;
+
+/* ***********************   Function Prototypes   ************************ */
+
+static void TakeCopy (void);
+
+/* *******************   Public Function Definitions   ******************** */
+
+//-------------------------------
+// Function: BlackBoxInit
+//
+// Description: Empties the ring and records the power up. Copies go to the
+//  BLACKBOX_EEPROM_SIZE bytes from eepromAddress.
+//
+//-------------------------------
+void BlackBoxInit (uint8_t eepromAddress)
+{
+    uint16_t header;
+    uint8_t resetCause;
+
+    g_Head = 0;
+    g_Count = 0;
+    g_LastButtons = 0;
+    g_FlushStep = BLACKBOX_IDLE;
+    g_FlushCause = 0;
+
+    // Carry on numbering from the copy already there.
+    g_EepromAddress = eepromAddress;
+    EEPROM_readInt16 (eepromAddress, &header);
+    g_CopyNumber = ((uint8_t) header == BLACKBOX_MAGIC) ? (uint8_t) (header >> 8) : 0;
+
+#ifdef _18F46K40
+    resetCause = PCON0;
+    PCON0 = 0x3f;                       // Rearm the flags for the next reset.
+#else
+    resetCause = 0;
+#endif
+    BlackBoxRecord (BLACKBOX_EVENT_POWER_UP, resetCause);
+}
+
+//-------------------------------
+// Function: BlackBoxRecord
+//
+// Description: Adds an event to the ring, overwriting the oldest once it is
+//  full. An event the same as the last one is dropped so that a fault seen
+//  on every pass does not push everything else out.
+//
+//-------------------------------
+void BlackBoxRecord (uint8_t type, uint8_t data)
+{
+    BLACKBOX_EVENT *event;
+    uint8_t last;
+
+    if (g_Count != 0)
+    {
+        last = (g_Head == 0) ? (BLACKBOX_NUM_EVENTS - 1) : (g_Head - 1);
+        if ((g_Events[last].m_Type == type) && (g_Events[last].m_Data == data))
+            return;
+    }
+
+    event = &g_Events[g_Head];
+    event->m_Tick = bspGetSysTick();
+    event->m_Type = type;
+    event->m_Data = data;
+
+    if (++g_Head >= BLACKBOX_NUM_EVENTS)
+        g_Head = 0;
+    if (g_Count < BLACKBOX_NUM_EVENTS)
+        ++g_Count;
+}
+
+//-------------------------------
+// Function: BlackBoxFlush
+//
+// Description: Asks for the ring to be copied to the EEPROM. If a copy is
+//  being written, another is taken once it is done.
+//
+//-------------------------------
+void BlackBoxFlush (uint8_t cause)
+{
+    g_FlushCause = cause;
+}
+
+//-------------------------------
+// Function: BlackBoxService
+//
+// Description: Call once per pass through the control loop with the
+//  buttons. Records any change in them and moves the EEPROM copy on by at
+//  most one byte.
+//
+//-------------------------------
+void BlackBoxService (uint8_t buttons)
+{
+    uint8_t address, data;
+
+    if (buttons != g_LastButtons)
+    {
+        g_LastButtons = buttons;
+        BlackBoxRecord (BLACKBOX_EVENT_BUTTONS, buttons);
+    }
+
+    if (g_FlushStep == BLACKBOX_IDLE)
+    {
+        if (g_FlushCause == 0)
+            return;
+        TakeCopy();
+    }
+
+    if (g_FlushStep < BLACKBOX_EEPROM_SIZE)
+    {
+        address = g_EepromAddress + g_FlushStep;
+        data = (g_FlushStep == 0) ? 0 : g_Image[g_FlushStep];
+    }
+    else
+    {
+        address = g_EepromAddress;
+        data = BLACKBOX_MAGIC;
+    }
+
+    if (EEPROM_tryWriteByte (address, data))
+    {
+        if (g_FlushStep < BLACKBOX_EEPROM_SIZE)
+            ++g_FlushStep;
+        else
+            g_FlushStep = BLACKBOX_IDLE;
+    }
+}
+
+//-------------------------------
+// Function: IsBlackBoxFlushing
+//
+// Description: Returns true while a copy is waiting or being written.
+//
+//-------------------------------
+bool IsBlackBoxFlushing (void)
+{
+    return ((g_FlushStep != BLACKBOX_IDLE) || (g_FlushCause != 0));
+}
+
+/* ********************   Private Function Definitions   ****************** */
+
+//-------------------------------
+// Function: TakeCopy
+//
+// Description: Fills g_Image from the ring, oldest event first, and starts
+//  writing it.
+//
+//-------------------------------
+static void TakeCopy (void)
+{
+    const BLACKBOX_EVENT *event;
+    uint8_t i, index, offset;
+
+    g_Image[0] = BLACKBOX_MAGIC;
+    g_Image[1] = ++g_CopyNumber;
+    g_Image[2] = g_FlushCause;
+    g_Image[3] = g_Count;
+
+    index = (g_Head >= g_Count) ? (g_Head - g_Count) : (g_Head + BLACKBOX_NUM_EVENTS - g_Count);
+    offset = BLACKBOX_HEADER_SIZE;
+    for (i = 0; i < BLACKBOX_NUM_EVENTS; ++i)
+    {
+        if (i < g_Count)
+        {
+            event = &g_Events[index];
+            g_Image[offset] = (uint8_t) event->m_Tick;
+            g_Image[offset + 1] = (uint8_t) (event->m_Tick >> 8);
+            g_Image[offset + 2] = event->m_Type;
+            g_Image[offset + 3] = event->m_Data;
+            if (++index >= BLACKBOX_NUM_EVENTS)
+                index = 0;
+        }
+        else
+        {
+            g_Image[offset] = 0;
+            g_Image[offset + 1] = 0;
+            g_Image[offset + 2] = 0;
+            g_Image[offset + 3] = 0;
+        }
+        offset += BLACKBOX_EVENT_SIZE;
+    }
+
+    g_FlushCause = 0;
+    g_FlushStep = 0;
+}
+
+// end of file.
+//-------------------------------------------------------------------------
@@ -17,6 +17,7 @@
 #include "device_xc8.h"
 
 #include "bsp.h"
+#include "hal.h"
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -25,9 +26,17 @@
 //------------------------------------------------------------------------------
 // File Global variables.
 
-static uint8_t g_MouseClick_DebounceCounter;
-static bool g_MouseClick_State;
-static bool g_MouseClicksEnabled;
+// Read on every pass through the control loop, so kept in access RAM.
+static __near bool g_MouseClick_State;
+static __near bool g_MouseClicksEnabled;
+
+// Pulse-density modulator state for the proportional direction outputs.
+static uint8_t g_PdmAccumulator[BT_PDM_NUM_DIRECTIONS];
+static uint8_t g_PdmSignals;
+static uint16_t g_PdmSlotStart;
+
+static const uint8_t g_PdmMasks[BT_PDM_NUM_DIRECTIONS] =
+    {BT_FWD_MASK, BT_REV_MASK, BT_LEFT_MASK, BT_RIGHT_MASK};
 
 //------------------------------------------------------------------------------
 // Forward Declarations
@@ -38,16 +47,16 @@ void wait10msec (void);
 //------------------------------------------------------------------------------
 void BluetoothControlInit(void)
 {
-    TRISEbits.TRISE1 = GPIO_BIT_OUTPUT;    // D1
-    ANSELEbits.ANSELE1 = 0;
-    TRISDbits.TRISD3 = GPIO_BIT_OUTPUT;    // D2
-    ANSELDbits.ANSELD3 = 0;
-    TRISCbits.TRISC2 = GPIO_BIT_OUTPUT;    // D3
-    ANSELCbits.ANSELC2 = 0;
-    TRISCbits.TRISC1 = GPIO_BIT_OUTPUT;    // D4
-    ANSELCbits.ANSELC1 = 0;
-    TRISAbits.TRISA5 = GPIO_BIT_OUTPUT;    // LEFT_CLK_OUT
-    ANSELAbits.ANSELA5 = 0;
+    HAL_PIN_OUTPUT(E, 1);       // D1
+    HAL_PIN_DIGITAL(E, 1);
+    HAL_PIN_OUTPUT(D, 3);       // D2
+    HAL_PIN_DIGITAL(D, 3);
+    HAL_PIN_OUTPUT(C, 2);       // D3
+    HAL_PIN_DIGITAL(C, 2);
+    HAL_PIN_OUTPUT(C, 1);       // D4
+    HAL_PIN_DIGITAL(C, 1);
+    HAL_PIN_OUTPUT(A, 5);       // LEFT_CLK_OUT
+    HAL_PIN_DIGITAL(A, 5);
 
     // Set all Bluetooth control lines high
     LATEbits.LATE1 = GPIO_HIGH;      
@@ -58,16 +67,15 @@ void BluetoothControlInit(void)
 
 #ifndef DEBUG
     // Left Click to BT module. This is shared with some debugging pin
-    TRISAbits.TRISA4 = GPIO_BIT_INPUT;
-    ANSELAbits.ANSELA4 = 0; // Allow Digital control to operate correctly.
-    WPUAbits.WPUA4 = 1;     // Enable a weak pull-up
+    HAL_PIN_INPUT(A, 4);
+    HAL_PIN_DIGITAL(A, 4);      // Allow Digital control to operate correctly.
+    HAL_PIN_PULLUP(A, 4);       // Enable a weak pull-up
     //LATAbits.LATA4 = GPIO_HIGH;
     
     // Right Click input, shared with PGC
-    TRISBbits.TRISB6 = GPIO_BIT_INPUT;
-    ANSELBbits.ANSELB6 = 0;         // Ensure it is setup for Digital
-    WPUBbits.WPUB6 = 1;             // Enable a weak pully-up
-    g_MouseClick_DebounceCounter = 0;
+    HAL_PIN_INPUT(B, 6);
+    HAL_PIN_DIGITAL(B, 6);      // Ensure it is setup for Digital
+    HAL_PIN_PULLUP(B, 6);       // Enable a weak pully-up
     g_MouseClick_State = PORTBbits.RB6;
     g_MouseClicksEnabled = (PORTBbits.RB6 ? true : false);   // If low then RT MOUSE CLICKS are disabled.
                                     // .. because the input is held low via a single mono
@@ -103,35 +111,89 @@ bool IsMouseRightClickActive (void)
         return false;
 }
 
+//-------------------------------------------------------------------------
+// Drive all of the Bluetooth outputs from one bit mask (BT_xxx_MASK).
+// The new latch image of each port is built first and then each port is
+// written once, back to back. The lines of a diagonal still change a few
+// instruction cycles apart, one port after another, but no longer with
+// the rest of the pass in between.
 //-------------------------------------------------------------------------
 
-void SendBlueToothSignal (BT_DIRECTIONS whichOne, bool active)
+void SendBlueToothSignals (uint8_t activeMask)
 {
-    switch (whichOne)
-    {
-        case FWD_BT:
-            LATDbits.LATD3 = active;
-            break;
-        case REV_BT:
-            LATCbits.LATC2 = active;
-            break;
-        case LEFT_BT:
-            LATEbits.LATE1 = active;
-            break;
-        case RIGHT_BT:
-            LATCbits.LATC1 = active;
-            break;
-        case LEFT_CLICK_OUT:
-            LATAbits.LATA5 = active;
-            break;
-        case RIGHT_CLICK_OUT:
+    uint8_t portA, portC, portD, portE;
+
+    // Start with every Bluetooth line inactive (high).
+    portA = LATA | _LATA_LATA5_MASK;
+    portC = LATC | (_LATC_LATC2_MASK | _LATC_LATC1_MASK);
+    portD = LATD | _LATD_LATD3_MASK;
+    portE = LATE | _LATE_LATE1_MASK;
+
+    if (activeMask & BT_FWD_MASK)
+        portD &= (uint8_t) ~_LATD_LATD3_MASK;
+    if (activeMask & BT_REV_MASK)
+        portC &= (uint8_t) ~_LATC_LATC2_MASK;
+    if (activeMask & BT_LEFT_MASK)
+        portE &= (uint8_t) ~_LATE_LATE1_MASK;
+    if (activeMask & BT_RIGHT_MASK)
+        portC &= (uint8_t) ~_LATC_LATC1_MASK;
+    if (activeMask & BT_LEFT_CLICK_OUT_MASK)
+        portA &= (uint8_t) ~_LATA_LATA5_MASK;
 #ifndef DEBUG
-            LATAbits.LATA4 = active;
+    portA |= _LATA_LATA4_MASK;
+    if (activeMask & BT_RIGHT_CLICK_OUT_MASK)
+        portA &= (uint8_t) ~_LATA_LATA4_MASK;
 #endif
-            break;
-        default:
-            break;
-    } // end switch
+
+    // The direction lines are on C, D and E; write them back to back.
+    LATC = portC;
+    LATD = portD;
+    LATE = portE;
+    LATA = portA;
+}
+
+//-------------------------------------------------------------------------
+// Restart the pulse-density modulator with all outputs inactive.
+//-------------------------------------------------------------------------
+
+void BluetoothPdmReset (void)
+{
+    uint8_t i;
+
+    for (i = 0; i < BT_PDM_NUM_DIRECTIONS; ++i)
+        g_PdmAccumulator[i] = 0;
+    g_PdmSignals = 0;
+    g_PdmSlotStart = bspGetSysTick();
+}
+
+//-------------------------------------------------------------------------
+// Pulse-density modulate the direction outputs. "duty" holds the wanted
+// duty for each direction, 0 to BT_PDM_FULL_SCALE. The modulator advances
+// once per BT_PDM_SLOT_MS of system tick, independent of the loop rate,
+// and the returned BT_xxx_MASK bits are meant for SendBlueToothSignals().
+//-------------------------------------------------------------------------
+
+uint8_t BluetoothPdmSignals (const uint8_t duty[BT_PDM_NUM_DIRECTIONS])
+{
+    uint8_t i;
+    uint16_t now;
+
+    now = bspGetSysTick();
+    if ((uint16_t)(now - g_PdmSlotStart) >= BT_PDM_SLOT_MS)
+    {
+        g_PdmSlotStart = now;
+        g_PdmSignals = 0;
+        for (i = 0; i < BT_PDM_NUM_DIRECTIONS; ++i)
+        {
+            g_PdmAccumulator[i] += duty[i];
+            if (g_PdmAccumulator[i] >= BT_PDM_FULL_SCALE)
+            {
+                g_PdmAccumulator[i] -= BT_PDM_FULL_SCALE;
+                g_PdmSignals |= g_PdmMasks[i];
+            }
+        }
+    }
+    return g_PdmSignals;
 }
 
 //-------------------------------------------------------------------------
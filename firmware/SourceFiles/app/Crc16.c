@@ -0,0 +1,45 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Filename: Crc16.c
+//
+// Description: CRC-16/CCITT (polynomial 0x1021), one byte at a time and
+//  without a table or a bit loop. Started from CRC16_INITIAL it gives the
+//  CRC-16/CCITT-FALSE of the telemetry frames, the live tuning requests
+//  and the linker's --checksum.
+//
+// Author(s): G. Chopcinski (Kg Solutions, LLC)
+//
+// Created for ASL
+//
+//////////////////////////////////////////////////////////////////////////////
+
+/* **************************   Header Files   *************************** */
+
+// NOTE: This must ALWAYS be the first include in a file.
+#include "device_xc8.h"
+
+// from stdlib
+#include <stdint.h>
+
+// from local
+#include "Crc16.h"
+
+/* *******************   Public Function Definitions   ******************** */
+
+//-------------------------------
+// Function: Crc16
+//
+// Description: Adds a byte to a CRC and returns the new CRC.
+//
+//-------------------------------
+uint16_t Crc16 (uint16_t crc, uint8_t data)
+{
+    uint8_t x;
+
+    x = (uint8_t) (crc >> 8) ^ data;
+    x ^= x >> 4;
+    return (crc << 8) ^ ((uint16_t) x << 12) ^ ((uint16_t) x << 5) ^ x;
+}
+
+// end of file.
+//-------------------------------------------------------------------------
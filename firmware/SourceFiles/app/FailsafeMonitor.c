@@ -0,0 +1,172 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Filename: FailsafeMonitor.c
+//
+// Description: Plausibility checks on the joystick readings.
+//
+//  FailsafeCheck() is called with every reading the drive or Bluetooth
+//  outputs are computed from. A reading that fails any check must not be
+//  used: the caller puts its outputs to neutral on that same pass through
+//  the control loop. FAILSAFE_PERSISTENCE bad readings in a row latch the
+//  fault, which is only cleared by a power cycle.
+//
+//  Since the ADC waits are bounded (see AnalogInput.c), the time from a
+//  fault to neutral outputs is at most one pass of the control loop.
+//
+// Author(s): G. Chopcinski (Kg Solutions, LLC)
+//
+// Created for ASL
+//
+//////////////////////////////////////////////////////////////////////////////
+
+/* **************************   Header Files   *************************** */
+
+// NOTE: This must ALWAYS be the first include in a file.
+#include "device_xc8.h"
+
+// from stdlib
+#include <stdint.h>
+#include <stdbool.h>
+
+// from project
+#include "bsp.h"
+#include "AnalogInput.h"
+
+// from local
+#include "FailsafeMonitor.h"
+
+/* ***********************   File Scope Variables   *********************** */
+
+static uint16_t g_LastSpeed;
+static uint16_t g_LastDirection;
+static uint16_t g_LastTick;
+static bool g_HaveLastReading;
+static uint8_t g_BadCount;
+static bool g_Latched;
+static uint8_t g_Cause;
+
+/* ***********************   Function Prototypes   ************************ */
+
+static uint8_t CheckAxis (uint8_t axis, uint16_t reading, uint16_t lastReading, bool checkSlew);
+
+/* *******************   Public Function Definitions   ******************** */
+
+//-------------------------------
+// Function: FailsafeReset
+//
+// Description: Forgets the previous reading and the count of bad readings.
+//  Call when starting to use the joystick readings, e.g. on entering the
+//  driving state. An ADC timeout from before, e.g. at power up or in
+//  calibration where nothing checks the readings, is dropped too. A latched
+//  fault stays latched.
+//
+//-------------------------------
+void FailsafeReset (void)
+{
+    g_HaveLastReading = false;
+    g_BadCount = 0;
+    (void) AdcTimedOut();
+}
+
+//-------------------------------
+// Function: FailsafeCheck
+//
+// Description: Checks a pair of joystick readings.
+//
+// Returns: FAULT_NONE if the readings can be used, else the FAULT_xxx bits
+//  that failed.
+//
+//-------------------------------
+uint8_t FailsafeCheck (uint16_t rawSpeed, uint16_t rawDirection)
+{
+    uint8_t faults;
+    uint16_t now;
+    bool checkSlew;
+
+    now = bspGetSysTick();
+
+    // Slew is only meaningful between readings close together in time.
+    checkSlew = g_HaveLastReading && ((uint16_t) (now - g_LastTick) <= FAILSAFE_SLEW_WINDOW_MS);
+
+    faults = FAULT_NONE;
+    if (AdcTimedOut())
+        faults |= FAULT_ADC_TIMEOUT;
+    faults |= CheckAxis (SPEED_ARRAY, rawSpeed, g_LastSpeed, checkSlew);
+    faults |= CheckAxis (DIRECTION_ARRAY, rawDirection, g_LastDirection, checkSlew);
+
+    g_LastSpeed = rawSpeed;
+    g_LastDirection = rawDirection;
+    g_LastTick = now;
+    g_HaveLastReading = true;
+
+    if (faults == FAULT_NONE)
+    {
+        g_BadCount = 0;
+    }
+    else
+    {
+        g_Cause |= faults;
+        if (++g_BadCount >= FAILSAFE_PERSISTENCE)
+            g_Latched = true;
+    }
+
+    return faults;
+}
+
+//-------------------------------
+// Function: IsFailsafeLatched
+//
+// Description: Returns true once a fault has persisted.
+//
+//-------------------------------
+bool IsFailsafeLatched (void)
+{
+    return g_Latched;
+}
+
+//-------------------------------
+// Function: GetFailsafeCause
+//
+// Description: Returns every FAULT_xxx bit seen since power up.
+//
+//-------------------------------
+uint8_t GetFailsafeCause (void)
+{
+    return g_Cause;
+}
+
+/* ********************   Private Function Definitions   ****************** */
+
+//-------------------------------
+// Function: CheckAxis
+//
+// Description: Checks one axis' reading against the rails, the calibrated
+//  travel and, if asked, the previous reading.
+//
+//-------------------------------
+static uint8_t CheckAxis (uint8_t axis, uint16_t reading, uint16_t lastReading, bool checkSlew)
+{
+    uint8_t faults;
+    uint16_t change;
+
+    faults = FAULT_NONE;
+
+    if ((reading < FAILSAFE_RAIL_LOW) || (reading > FAILSAFE_RAIL_HIGH))
+        faults |= FAULT_RAIL;
+
+    if ((reading > Joystick_Thresholds[axis].m_ClampMaximum + FAILSAFE_GATE_MARGIN)
+    || (reading + FAILSAFE_GATE_MARGIN < Joystick_Thresholds[axis].m_ClampMinimum))
+        faults |= FAULT_OUT_OF_GATE;
+
+    if (checkSlew)
+    {
+        change = (reading > lastReading) ? (reading - lastReading) : (lastReading - reading);
+        if (change > FAILSAFE_SLEW_LIMIT)
+            faults |= FAULT_SLEW;
+    }
+
+    return faults;
+}
+
+// end of file.
+//-------------------------------------------------------------------------
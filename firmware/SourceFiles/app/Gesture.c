@@ -0,0 +1,252 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Filename: Gesture.c
+//
+// Description: Recognises joystick gestures that stand in for the
+//  Calibration, User Port and Mode buttons.
+//
+//  GestureUpdate() is given the joystick reading the control loop took for
+//  this pass. The reading is put in a zone: the neutral window, out to one
+//  side (past half travel with the other axis centred), or in between.
+//  Only zone changes and the time spent in the current zone are tracked,
+//  so each call costs the same whatever the gesture.
+//
+//  - Reverse hold: in the reverse zone for GESTURE_REVERSE_HOLD_MS. This
+//    is a level, IsReverseHeld(), like the Mode button it stands in for.
+//
+//  - Hold direction: in one of the side zones for GESTURE_HOLD_DIRECTION_MS.
+//    Returned once per hold.
+//
+//  - Double flick: out of neutral to one side zone and back within
+//    GESTURE_FLICK_MAX_MS, then the same again starting within
+//    GESTURE_FLICK_GAP_MS.
+//
+//  What each gesture does is up to the state it is seen in, see main.c.
+//
+// Author(s): G. Chopcinski (Kg Solutions, LLC)
+//
+// Created for ASL
+//
+//////////////////////////////////////////////////////////////////////////////
+
+/* **************************   Header Files   *************************** */
+
+// NOTE: This must ALWAYS be the first include in a file.
+#include "device_xc8.h"
+
+// from stdlib
+#include <stdint.h>
+#include <stdbool.h>
+
+// from project
+#include "bsp.h"
+#include "AnalogInput.h"
+
+// from local
+#include "Gesture.h"
+
+/* ******************************   Macros   ****************************** */
+
+#define ZONE_NEUTRAL (0)
+#define ZONE_BETWEEN (1)                // Out of neutral, not out to one side.
+#define ZONE_FORWARD (2)
+#define ZONE_REVERSE (3)
+#define ZONE_LEFT (4)
+#define ZONE_RIGHT (5)
+#define ZONE_MIXED (6)                  // g_TripZone only, more than one side.
+
+#define IS_SIDE_ZONE(zone) (((zone) >= ZONE_FORWARD) && ((zone) <= ZONE_RIGHT))
+
+/* ***********************   File Scope Variables   *********************** */
+
+static uint8_t g_Zone;
+static uint16_t g_ZoneStartMs;
+static bool g_ZoneHeld;                 // Hold direction already returned.
+static bool g_ReverseHeld;
+
+static uint8_t g_TripZone;              // Side zone reached since leaving neutral.
+static uint16_t g_TripStartMs;
+static uint8_t g_FlickZone;             // Side of the last flick, ZONE_NEUTRAL = none.
+static uint16_t g_FlickEndMs;
+
+/* ***********************   Function Prototypes   ************************ */
+
+static uint8_t Classify (uint16_t rawSpeed, uint16_t rawDirection);
+static uint8_t EndTrip (uint16_t now, uint8_t enabled);
+
+/* *******************   Public Function Definitions   ******************** */
+
+//-------------------------------
+// Function: GestureReset
+//
+// Description: Forgets any gesture in progress.
+//
+//-------------------------------
+void GestureReset (void)
+{
+    g_Zone = ZONE_NEUTRAL;
+    g_ZoneStartMs = bspGetSysTick();
+    g_ZoneHeld = false;
+    g_ReverseHeld = false;
+    g_TripZone = ZONE_NEUTRAL;
+    g_FlickZone = ZONE_NEUTRAL;
+}
+
+//-------------------------------
+// Function: GestureUpdate
+//
+// Description: Call once per pass through the control loop with the
+//  joystick reading and the GESTURE_ENABLE_xxx bits.
+//
+// Returns: The GESTURE_xxx that finished on this pass.
+//
+//-------------------------------
+uint8_t GestureUpdate (uint16_t rawSpeed, uint16_t rawDirection, uint8_t enabled)
+{
+    uint8_t zone, gesture;
+    uint16_t now;
+
+    now = bspGetSysTick();
+    zone = Classify (rawSpeed, rawDirection);
+    gesture = GESTURE_NONE;
+
+    if (zone != g_Zone)
+    {
+        if (zone == ZONE_NEUTRAL)
+        {
+            gesture = EndTrip (now, enabled);
+        }
+        else if (g_Zone == ZONE_NEUTRAL)
+        {
+            g_TripZone = ZONE_BETWEEN;
+            g_TripStartMs = now;
+        }
+
+        if (IS_SIDE_ZONE(zone))
+        {
+            if (g_TripZone == ZONE_BETWEEN)
+                g_TripZone = zone;
+            else if (g_TripZone != zone)
+                g_TripZone = ZONE_MIXED;
+        }
+
+        g_Zone = zone;
+        g_ZoneStartMs = now;
+        g_ZoneHeld = false;
+        g_ReverseHeld = false;
+    }
+    else if (IS_SIDE_ZONE(zone) && (g_ZoneHeld == false)
+        && ((uint16_t) (now - g_ZoneStartMs) >= GESTURE_HOLD_DIRECTION_MS))
+    {
+        // Flagged rather than timed from here on, the tick wraps.
+        g_ZoneHeld = true;
+        if (enabled & GESTURE_ENABLE_HOLD_DIRECTION)
+            gesture = GESTURE_HOLD_DIRECTION;
+    }
+
+#if (GESTURE_REVERSE_HOLD_MS > 0)
+    if ((zone == ZONE_REVERSE) && ((uint16_t) (now - g_ZoneStartMs) >= GESTURE_REVERSE_HOLD_MS))
+        g_ReverseHeld = true;
+#else
+    if (zone == ZONE_REVERSE)           // No hold, a uint16_t is always >= 0.
+        g_ReverseHeld = true;
+#endif
+    if ((enabled & GESTURE_ENABLE_REVERSE_HOLD) == 0)
+        g_ReverseHeld = false;
+
+    // A first flick left waiting too long no longer counts.
+    if ((g_FlickZone != ZONE_NEUTRAL) && (zone == ZONE_NEUTRAL)
+        && ((uint16_t) (now - g_FlickEndMs) > GESTURE_FLICK_GAP_MS))
+    {
+        g_FlickZone = ZONE_NEUTRAL;
+    }
+
+    return gesture;
+}
+
+//-------------------------------
+// Function: IsReverseHeld
+//
+// Description: Returns true while the reverse hold is enabled and the
+//  joystick has been in the reverse zone for GESTURE_REVERSE_HOLD_MS.
+//
+//-------------------------------
+bool IsReverseHeld (void)
+{
+    return g_ReverseHeld;
+}
+
+/* ********************   Private Function Definitions   ****************** */
+
+//-------------------------------
+// Function: Classify
+//
+// Description: Returns the ZONE_xxx of a reading. The reverse zone is the
+//  one the Mode switch used before this module: direction centred and
+//  speed below neutral and past half travel.
+//
+//-------------------------------
+static uint8_t Classify (uint16_t rawSpeed, uint16_t rawDirection)
+{
+    if (IsInNeutralWindow (rawSpeed, rawDirection))
+        return ZONE_NEUTRAL;
+
+    if ((rawDirection > Joystick_Thresholds[DIRECTION_ARRAY].m_CentredMinimum)
+        && (rawDirection < Joystick_Thresholds[DIRECTION_ARRAY].m_CentredMaximum))
+    {
+        if ((rawSpeed > Joystick_Data[SPEED_ARRAY].m_rawMaxNuetral)
+            && (rawSpeed > Joystick_Thresholds[SPEED_ARRAY].m_HalfPositive))
+            return ZONE_FORWARD;
+        if ((rawSpeed < Joystick_Data[SPEED_ARRAY].m_rawMinNeutral)
+            && (rawSpeed < Joystick_Thresholds[SPEED_ARRAY].m_HalfNegative))
+            return ZONE_REVERSE;
+    }
+
+    if ((rawSpeed > Joystick_Thresholds[SPEED_ARRAY].m_CentredMinimum)
+        && (rawSpeed < Joystick_Thresholds[SPEED_ARRAY].m_CentredMaximum))
+    {
+        if ((rawDirection > Joystick_Data[DIRECTION_ARRAY].m_rawMaxNuetral)
+            && (rawDirection > Joystick_Thresholds[DIRECTION_ARRAY].m_HalfPositive))
+            return ZONE_RIGHT;
+        if ((rawDirection < Joystick_Data[DIRECTION_ARRAY].m_rawMinNeutral)
+            && (rawDirection < Joystick_Thresholds[DIRECTION_ARRAY].m_HalfNegative))
+            return ZONE_LEFT;
+    }
+
+    return ZONE_BETWEEN;
+}
+
+//-------------------------------
+// Function: EndTrip
+//
+// Description: The joystick is back in neutral. A quick trip out to a
+//  single side is a flick, and a second flick to the same side soon after
+//  the first is a double flick.
+//
+// Returns: GESTURE_DOUBLE_FLICK or GESTURE_NONE.
+//
+//-------------------------------
+static uint8_t EndTrip (uint16_t now, uint8_t enabled)
+{
+    if ((IS_SIDE_ZONE(g_TripZone) == false)
+        || ((uint16_t) (now - g_TripStartMs) > GESTURE_FLICK_MAX_MS))
+    {
+        g_FlickZone = ZONE_NEUTRAL;
+        return GESTURE_NONE;
+    }
+
+    if ((g_FlickZone == g_TripZone) && ((uint16_t) (g_TripStartMs - g_FlickEndMs) <= GESTURE_FLICK_GAP_MS))
+    {
+        g_FlickZone = ZONE_NEUTRAL;
+        if (enabled & GESTURE_ENABLE_DOUBLE_FLICK)
+            return GESTURE_DOUBLE_FLICK;
+        return GESTURE_NONE;
+    }
+
+    g_FlickZone = g_TripZone;
+    g_FlickEndMs = now;
+    return GESTURE_NONE;
+}
+
+// end of file.
+//-------------------------------------------------------------------------
@@ -0,0 +1,267 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Filename: JoystickGate.c
+//
+// Description: Two dimensional joystick gate calibration.
+//
+//  While calibrating, the largest radius reached in each of 16 angular
+//  sectors is recorded. From these, and the per-axis scales, a gain is
+//  worked out for each sector that brings the gate's edge onto the ellipse
+//  described by the per-axis scales. E.g. a square gate's corners are
+//  pulled in to the circle so the diagonals no longer over-drive, a round
+//  gate is left as it is.
+//
+//  At run time, GateNormalise() finds the sector of the deflection with a
+//  few integer compares and applies that sector's gain, so the cost per
+//  loop is fixed.
+//
+// Author(s): G. Chopcinski (Kg Solutions, LLC)
+//
+// Created for ASL
+//
+//////////////////////////////////////////////////////////////////////////////
+
+/* **************************   Header Files   *************************** */
+
+// NOTE: This must ALWAYS be the first include in a file.
+#include "device_xc8.h"
+
+// from stdlib
+#include <stdint.h>
+#include <stdbool.h>
+
+// from project
+#include "AnalogInput.h"
+#include "eeprom_bsp.h"
+
+// from local
+#include "JoystickGate.h"
+
+/* ******************************   Macros   ****************************** */
+
+#define GATE_UNITY_GAIN (128)           // Gains are stored as Q7.
+#define GATE_MIN_GAIN (64)              // 0.5
+#define GATE_MAX_GAIN (170)             // 1.33
+
+#define GATE_VALID_DATA (0x6a7e)        // Marks a valid gain table in EEPROM.
+
+/* ***********************   File Scope Variables   *********************** */
+
+static uint16_t g_SectorRadius[GATE_NUM_SECTORS];   // Used while calibrating.
+static uint8_t g_SectorGain[GATE_NUM_SECTORS];
+static bool g_GateValid;
+
+// |cos| and |sin| of the centre of the sectors in a quadrant, Q7.
+static const uint8_t g_SectorCos[4] = {126, 106, 71, 25};
+static const uint8_t g_SectorSin[4] = {25, 71, 106, 126};
+
+/* ***********************   Function Prototypes   ************************ */
+
+static uint8_t FindSector (int16_t dx, int16_t dy);
+
+/* *******************   Public Function Definitions   ******************** */
+
+//-------------------------------
+// Function: GateCalibrationStart
+//
+// Description: Clears the recorded gate shape. Call when entering calibration.
+//
+//-------------------------------
+void GateCalibrationStart (void)
+{
+    uint8_t i;
+
+    for (i = 0; i < GATE_NUM_SECTORS; ++i)
+        g_SectorRadius[i] = 0;
+}
+
+//-------------------------------
+// Function: GateCalibrationSample
+//
+// Description: Records the largest radius seen in the sector of this reading.
+//
+//-------------------------------
+void GateCalibrationSample (uint16_t rawSpeed, uint16_t rawDirection)
+{
+    int16_t dx, dy;
+    uint16_t radius;
+    uint8_t sector;
+
+    dx = (int16_t) (rawDirection - Joystick_Data[DIRECTION_ARRAY].m_rawNeutral);
+    dy = (int16_t) (rawSpeed - Joystick_Data[SPEED_ARRAY].m_rawNeutral);
+
+    radius = SquareRoot (((int32_t) dx * dx) + ((int32_t) dy * dy));
+    sector = FindSector (dx, dy);
+    if (radius > g_SectorRadius[sector])
+        g_SectorRadius[sector] = radius;
+}
+
+//-------------------------------
+// Function: GateCalibrationFinish
+//
+// Description: Works out the gain of each sector from the recorded gate shape
+//  and the per-axis scales in Joystick_Data, and stores the gains in EEPROM.
+//
+// A sector the joystick never reached at least 3/4 of the expected radius
+// in is taken as not swept and is left at unity gain.
+//
+//-------------------------------
+void GateCalibrationFinish (uint8_t eepromAddress)
+{
+    uint8_t sector, quadrant, k;
+    uint16_t sx, sy, expected, gain;
+    uint32_t a, b;
+
+    for (sector = 0; sector < GATE_NUM_SECTORS; ++sector)
+    {
+        // Sectors count anti-clockwise from full right; pick the scales
+        // of the quadrant the sector is in.
+        quadrant = sector >> 2;
+        k = (quadrant & 1) ? (3 - (sector & 3)) : (sector & 3);
+        sx = ((quadrant == 0) || (quadrant == 3)) ? Joystick_Data[DIRECTION_ARRAY].m_PositiveScale
+                                                  : Joystick_Data[DIRECTION_ARRAY].m_NegativeScale;
+        sy = (quadrant < 2) ? Joystick_Data[SPEED_ARRAY].m_PositiveScale
+                            : Joystick_Data[SPEED_ARRAY].m_NegativeScale;
+
+        // Radius of the ellipse through the per-axis scales at the
+        // centre of the sector.
+        a = (uint32_t) sy * g_SectorCos[k];
+        b = (uint32_t) sx * g_SectorSin[k];
+        expected = (uint16_t) (((uint32_t) sx * sy * GATE_UNITY_GAIN) / (SquareRoot ((a * a) + (b * b)) + 1));
+
+        gain = GATE_UNITY_GAIN;
+        if ((g_SectorRadius[sector] * 4) >= (expected * 3))
+        {
+            gain = (uint16_t) (((uint32_t) expected * GATE_UNITY_GAIN) / g_SectorRadius[sector]);
+            if (gain < GATE_MIN_GAIN)
+                gain = GATE_MIN_GAIN;
+            if (gain > GATE_MAX_GAIN)
+                gain = GATE_MAX_GAIN;
+        }
+        g_SectorGain[sector] = (uint8_t) gain;
+    }
+
+    for (sector = 0; sector < GATE_NUM_SECTORS; sector += 2)
+    {
+        EEPROM_writeInt16 (eepromAddress + sector,
+            (uint16_t) g_SectorGain[sector] | ((uint16_t) g_SectorGain[sector + 1] << 8));
+    }
+    EEPROM_writeInt16 (eepromAddress + GATE_NUM_SECTORS, GATE_VALID_DATA);
+
+    g_GateValid = true;
+}
+
+//-------------------------------
+// Function: GateLoad
+//
+// Description: Reads the gain table from EEPROM. If there is no valid table,
+//  e.g. the joystick was calibrated before this feature existed, the
+//  normalisation is switched off.
+//
+// Returns: true if a valid table was loaded.
+//
+//-------------------------------
+bool GateLoad (uint8_t eepromAddress)
+{
+    uint8_t sector;
+    uint16_t data;
+
+    g_GateValid = false;
+
+    EEPROM_readInt16 (eepromAddress + GATE_NUM_SECTORS, &data);
+    if (data != GATE_VALID_DATA)
+        return false;
+
+    for (sector = 0; sector < GATE_NUM_SECTORS; sector += 2)
+    {
+        EEPROM_readInt16 (eepromAddress + sector, &data);
+        g_SectorGain[sector] = (uint8_t) data;
+        g_SectorGain[sector + 1] = (uint8_t) (data >> 8);
+    }
+
+    // Sanity check the gains.
+    for (sector = 0; sector < GATE_NUM_SECTORS; ++sector)
+    {
+        if ((g_SectorGain[sector] < GATE_MIN_GAIN) || (g_SectorGain[sector] > GATE_MAX_GAIN))
+            return false;
+    }
+
+    g_GateValid = true;
+    return true;
+}
+
+//-------------------------------
+// Function: GateNormalise
+//
+// Description: Scales the joystick deflection by the gain of its sector.
+//  Readings inside the neutral window are left alone so the neutral
+//  window behaves as before.
+//
+//-------------------------------
+void GateNormalise (uint16_t *rawSpeed, uint16_t *rawDirection)
+{
+    int16_t dx, dy;
+    int32_t scaled;
+    uint8_t gain;
+
+    if (g_GateValid == false)
+        return;
+
+    if (IsInNeutralWindow (*rawSpeed, *rawDirection))
+        return;
+
+    dx = (int16_t) (*rawDirection - Joystick_Data[DIRECTION_ARRAY].m_rawNeutral);
+    dy = (int16_t) (*rawSpeed - Joystick_Data[SPEED_ARRAY].m_rawNeutral);
+    gain = g_SectorGain[FindSector (dx, dy)];
+
+    scaled = (int32_t) Joystick_Data[DIRECTION_ARRAY].m_rawNeutral + (((int32_t) dx * gain) / GATE_UNITY_GAIN);
+    *rawDirection = (scaled < 0) ? 0 : (uint16_t) scaled;
+
+    scaled = (int32_t) Joystick_Data[SPEED_ARRAY].m_rawNeutral + (((int32_t) dy * gain) / GATE_UNITY_GAIN);
+    *rawSpeed = (scaled < 0) ? 0 : (uint16_t) scaled;
+}
+
+//-------------------------------
+// Function: IsGateValid
+//
+// Description: Returns true if GateNormalise() is correcting the readings.
+//
+//-------------------------------
+bool IsGateValid (void)
+{
+    return g_GateValid;
+}
+
+/* ********************   Private Function Definitions   ****************** */
+
+//-------------------------------
+// Function: FindSector
+//
+// Description: Returns the 22.5 degree sector, 0 to 15 counting anti-clockwise
+//  from full right, that the deflection (dx = direction, dy = speed) is in.
+//  tan(22.5) is taken as 5/12.
+//
+//-------------------------------
+static uint8_t FindSector (int16_t dx, int16_t dy)
+{
+    uint16_t ax, ay;
+    uint8_t q;
+
+    ax = (uint16_t) ((dx < 0) ? -dx : dx);
+    ay = (uint16_t) ((dy < 0) ? -dy : dy);
+
+    // Sector within the quadrant, 0 (on the direction axis) to 3 (on the
+    // speed axis).
+    if (ay <= ax)
+        q = ((ay * 12) >= (ax * 5)) ? 1 : 0;
+    else
+        q = ((ax * 12) >= (ay * 5)) ? 2 : 3;
+
+    if (dy >= 0)
+        return (dx >= 0) ? q : (7 - q);
+    else
+        return (dx < 0) ? (8 + q) : (15 - q);
+}
+
+// end of file.
+//-------------------------------------------------------------------------
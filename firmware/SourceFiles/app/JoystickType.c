@@ -0,0 +1,171 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Filename: JoystickType.c
+//
+// Description: Tells the joystick families apart at power up, so one image
+//  can pick the right neutral window for any of them. Only the RNet
+//  configurations do so, they build with JOYSTICK_AUTO_DETECT 1; the others
+//  keep the window of AnalogInput.h.
+//
+//  The ASL133 and ASL134 (compact) need a much smaller neutral window than
+//  the ASL128, ASL130 and ASL138 (standard). The families have not been
+//  measured side by side, so neither the resting noise nor the neutral
+//  offset is taken as a sign of one: only what the window itself needs is
+//  used, and a joystick with no evidence for the compact window keeps the
+//  standard one.
+//
+//  A joystick is compact only when both:
+//      - its calibrated travel, the smallest of the scales, is shorter than
+//        JOYSTICK_SHORT_TRAVEL, too short to leave room for the standard
+//        window,
+//      - it rests quietly enough for the compact window, the standard
+//        deviation of its readings at most JOYSTICK_QUIET_STD_DEV_Q4.
+//  Anything else, too few readings or no calibration included, is standard.
+//
+//  BootSequence() hands every reading taken at rest in the neutral window to
+//  JoystickTypeAddReading(), ahead of the steadiness test it averages the
+//  neutral through, which would hide the noise. Nothing extra is read, so
+//  the power up takes no longer.
+//
+//  A compact joystick that is not recognised gets its window from a
+//  neutral_margin saved by live tuning, see SetTuneNeutralMargin() in
+//  main.c.
+//
+// Author(s): G. Chopcinski (Kg Solutions, LLC)
+//
+// Created for ASL
+//
+//////////////////////////////////////////////////////////////////////////////
+
+/* **************************   Header Files   *************************** */
+
+// NOTE: This must ALWAYS be the first include in a file.
+#include "device_xc8.h"
+
+// from stdlib
+#include <stdint.h>
+#include <stdbool.h>
+
+// from project
+#include "AnalogInput.h"
+
+// from local
+#include "JoystickType.h"
+
+/* ******************************   Macros   ****************************** */
+
+#define JOYSTICK_TYPE_MAX_SAMPLES (64)  // The 10 bit readings are summed in 16 bits.
+
+/* ***********************   Global Variables ***************************** */
+
+JOYSTICK_TYPE_REPORT g_JoystickType;
+
+/* ***********************   File Scope Variables   *********************** */
+
+static uint8_t g_Samples;
+static uint16_t g_Sum[NUM_JS_POTS];
+static uint32_t g_SumOfSquares[NUM_JS_POTS];
+
+/* *******************   Public Function Definitions   ******************** */
+
+//-------------------------------
+// Function: JoystickTypeReset
+//
+// Description: Forgets the readings so far. Call it whenever the neutral
+//  search starts over.
+//
+//-------------------------------
+void JoystickTypeReset (void)
+{
+    uint8_t axis;
+
+    g_Samples = 0;
+    for (axis = 0; axis < NUM_JS_POTS; ++axis)
+    {
+        g_Sum[axis] = 0;
+        g_SumOfSquares[axis] = 0;
+    }
+}
+
+//-------------------------------
+// Function: JoystickTypeAddReading
+//
+// Description: Adds a reading of the joystick at rest. Readings past
+//  JOYSTICK_TYPE_MAX_SAMPLES are ignored.
+//
+//-------------------------------
+void JoystickTypeAddReading (uint16_t speed, uint16_t direction)
+{
+    if (g_Samples >= JOYSTICK_TYPE_MAX_SAMPLES)
+        return;
+
+    g_Sum[SPEED_ARRAY] += speed;
+    g_SumOfSquares[SPEED_ARRAY] += (uint32_t) speed * speed;
+    g_Sum[DIRECTION_ARRAY] += direction;
+    g_SumOfSquares[DIRECTION_ARRAY] += (uint32_t) direction * direction;
+    ++g_Samples;
+}
+
+//-------------------------------
+// Function: JoystickTypeClassify
+//
+// Description: Returns the JOYSTICK_TYPE_xxx of the joystick from the
+//  readings added and the calibration in Joystick_Data. previous is the
+//  type found last time, it sets how quiet the joystick must be to be
+//  compact. The figures used are left in g_JoystickType.
+//
+//-------------------------------
+uint8_t JoystickTypeClassify (uint8_t previous)
+{
+    uint8_t axis;
+    uint16_t travel, limit;
+    uint32_t variance;
+
+    g_JoystickType.m_Samples = g_Samples;
+    g_JoystickType.m_VarianceQ8 = 0;
+    g_JoystickType.m_Travel = 0xffff;
+    g_JoystickType.m_Type = JOYSTICK_TYPE_STANDARD;
+
+    if (g_Samples < JOYSTICK_TYPE_MIN_SAMPLES)
+        return g_JoystickType.m_Type;
+
+    for (axis = 0; axis < NUM_JS_POTS; ++axis)
+    {
+        // N * variance, then variance * 256 to compare with the limit * 16 squared.
+        variance = g_SumOfSquares[axis] - (((uint32_t) g_Sum[axis] * g_Sum[axis]) / g_Samples);
+        variance = (variance * 256) / g_Samples;
+        if (variance > g_JoystickType.m_VarianceQ8)
+            g_JoystickType.m_VarianceQ8 = variance;
+
+        travel = Joystick_Data[axis].m_PositiveScale;
+        if (Joystick_Data[axis].m_NegativeScale < travel)
+            travel = Joystick_Data[axis].m_NegativeScale;
+        if (travel < g_JoystickType.m_Travel)
+            g_JoystickType.m_Travel = travel;
+    }
+
+    limit = JOYSTICK_QUIET_STD_DEV_Q4;
+    if (previous != JOYSTICK_TYPE_COMPACT)
+        limit >>= JOYSTICK_TYPE_HYSTERESIS_SHIFT;
+
+    if ((g_JoystickType.m_Travel < JOYSTICK_SHORT_TRAVEL)
+        && (g_JoystickType.m_VarianceQ8 <= ((uint32_t) limit * limit)))
+        g_JoystickType.m_Type = JOYSTICK_TYPE_COMPACT;
+
+    return g_JoystickType.m_Type;
+}
+
+//-------------------------------
+// Function: JoystickTypeMargin
+//
+// Description: Returns the neutral margin, see SetNeutralMargin(), for a
+//  JOYSTICK_TYPE_xxx.
+//
+//-------------------------------
+uint16_t JoystickTypeMargin (uint8_t type)
+{
+    return (type == JOYSTICK_TYPE_COMPACT) ? NEUTRAL_MARGIN_COMPACT : NEUTRAL_MARGIN_STANDARD;
+}
+
+// end of file.
+//-------------------------------------------------------------------------
@@ -0,0 +1,370 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Filename: LiveTune.c
+//
+// Description: Reads and changes settings over the UART while running.
+//
+//  The settings are a table of parameters given by the application, each
+//  with a type, limits, an EEPROM address and functions to get and set it.
+//  At power up each saved value is checked against its limits again, as a
+//  byte may have been lost or a save cut short, and only set if within them.
+//
+//  Requests are TUNE_REQUEST_SIZE bytes, multi-byte values little endian:
+//      0   sync TELEMETRY_SYNC_1
+//      1   sync TELEMETRY_SYNC_2
+//      2   command, TUNE_CMD_xxx
+//      3   sequence number, returned in the response
+//      4   parameter number
+//      5   value (TUNE_CMD_SET)
+//      7   CRC-16/CCITT-FALSE of bytes 2 to 6
+//
+//  Each request is answered with a telemetry frame of type
+//  TELEMETRY_FRAME_TUNE (see Telemetry.c) with the payload:
+//      0   command             1   sequence number
+//      2   status, TUNE_OK, TUNE_HELD or TUNE_ERR_xxx
+//      3   parameter number    4   value
+//      6   type, TUNE_TYPE_xxx 7   number of parameters
+//      8   minimum             10  maximum
+//      12  1 if the parameter is saved in the EEPROM
+//  A request with a bad CRC is not answered, the host sends it again.
+//
+//  LiveTuneService() is called once per pass through the control loop and
+//  handles whatever has been received, without waiting. A new value is
+//  only held until LiveTuneApply() at the top of the next pass, so the
+//  control code never sees a setting change part way through a pass, and
+//  the values received in one pass are used together. A parameter flagged
+//  TUNE_FLAG_AT_REST is held longer, until a pass the application says its
+//  outputs are at rest, and its SET and GET are answered TUNE_HELD until
+//  then. A save keeps a held value, not the one in use. A save writes one
+//  EEPROM byte per pass, as the black box does, and is answered when it is
+//  done. Requests wait in the UART buffer while a response can not be
+//  queued or a save is in progress.
+//
+//  tools/livetune.py is the host side.
+//
+// Author(s): G. Chopcinski (Kg Solutions, LLC)
+//
+// Created for ASL
+//
+//////////////////////////////////////////////////////////////////////////////
+
+/* **************************   Header Files   *************************** */
+
+// NOTE: This must ALWAYS be the first include in a file.
+#include "device_xc8.h"
+
+// from stdlib
+#include <stdint.h>
+#include <stdbool.h>
+
+// from project
+#include "uart_bsp.h"
+#include "Crc16.h"
+#include "eeprom_bsp.h"
+#include "Telemetry.h"
+
+// from local
+#include "LiveTune.h"
+
+/* ******************************   Macros   ****************************** */
+
+#define TUNE_SAVE_IDLE (0xff)           // g_SaveStep when not saving.
+
+/* ***********************   File Scope Variables   *********************** */
+
+static const TUNE_PARAM *g_Params;
+static uint8_t g_Count;
+
+static uint16_t g_Pending[TUNE_MAX_PARAMS];
+static uint8_t g_PendingMask;           // Bit n = g_Pending[n] is waiting.
+static bool g_AtRest;                   // As given to the last LiveTuneApply().
+
+static uint8_t g_Request[TUNE_REQUEST_SIZE];
+static uint8_t g_RequestLength;         // Bytes of g_Request received so far.
+
+static uint8_t g_Response[TELEMETRY_PAYLOAD_SIZE];
+static bool g_ResponseWaiting;
+
+static uint8_t g_SaveStep;              // Parameter * 2 + byte, or TUNE_SAVE_IDLE.
+static uint8_t g_SaveSequence;
+
+/* ***********************   Function Prototypes   ************************ */
+
+static bool IsInLimits (const TUNE_PARAM *param, uint16_t value);
+static bool IsHeld (uint8_t param);
+static void ReceiveByte (uint8_t data);
+static void HandleRequest (void);
+static void SaveNextByte (void);
+static void Respond (uint8_t command, uint8_t sequence, uint8_t status, uint8_t param, uint16_t value);
+
+/* *******************   Public Function Definitions   ******************** */
+
+//-------------------------------
+// Function: LiveTuneInit
+//
+// Description: Takes the parameter table, which must stay in place, and
+//  sets the parameters saved in the EEPROM. Only the first TUNE_MAX_PARAMS
+//  entries are used.
+//
+//-------------------------------
+void LiveTuneInit (const TUNE_PARAM *params, uint8_t count)
+{
+    uint8_t i;
+    uint16_t value;
+
+    g_Params = params;
+    g_Count = (count > TUNE_MAX_PARAMS) ? TUNE_MAX_PARAMS : count;
+    g_PendingMask = 0;
+    g_AtRest = true;
+    g_RequestLength = 0;
+    g_ResponseWaiting = false;
+    g_SaveStep = TUNE_SAVE_IDLE;
+
+    // An erased or never saved value is outside the limits and not used.
+    for (i = 0; i < g_Count; ++i)
+    {
+        if (g_Params[i].m_EepromAddress == TUNE_NO_EEPROM)
+            continue;
+        EEPROM_readInt16 (g_Params[i].m_EepromAddress, &value);
+        if (IsInLimits (&g_Params[i], value))
+            g_Params[i].m_Set (value);
+    }
+}
+
+//-------------------------------
+// Function: LiveTuneApply
+//
+// Description: Call at the top of each pass through the control loop, before
+//  anything uses the settings. Sets the values received since the last call,
+//  except those flagged TUNE_FLAG_AT_REST when atRest is false, which wait
+//  for a pass where it is true.
+//
+//-------------------------------
+void LiveTuneApply (bool atRest)
+{
+    uint8_t i, bit;
+
+    g_AtRest = atRest;
+    if (g_PendingMask == 0)
+        return;
+
+    for (i = 0, bit = 0x01; i < g_Count; ++i, bit <<= 1)
+    {
+        if ((g_PendingMask & bit) && (atRest || !(g_Params[i].m_Flags & TUNE_FLAG_AT_REST)))
+        {
+            g_Params[i].m_Set (g_Pending[i]);
+            g_PendingMask &= ~bit;
+        }
+    }
+}
+
+//-------------------------------
+// Function: LiveTuneService
+//
+// Description: Call once per pass through the control loop. Moves a save on
+//  by one byte, sends a response that did not fit last time and handles
+//  the bytes received.
+//
+//-------------------------------
+void LiveTuneService (void)
+{
+    uint8_t data;
+
+    if (g_SaveStep != TUNE_SAVE_IDLE)
+    {
+        SaveNextByte();
+        if (g_SaveStep != TUNE_SAVE_IDLE)
+            return;
+    }
+
+    if (g_ResponseWaiting)
+    {
+        if (TelemetrySendFrame (TELEMETRY_FRAME_TUNE, g_Response) == false)
+            return;
+        g_ResponseWaiting = false;
+    }
+
+    while ((g_ResponseWaiting == false) && (g_SaveStep == TUNE_SAVE_IDLE) && uartBspRead (&data))
+        ReceiveByte (data);
+}
+
+/* ********************   Private Function Definitions   ****************** */
+
+static bool IsInLimits (const TUNE_PARAM *param, uint16_t value)
+{
+    return (value >= param->m_Minimum) && (value <= param->m_Maximum);
+}
+
+// A value waiting for the outputs to be at rest.
+static bool IsHeld (uint8_t param)
+{
+    return (g_PendingMask & (1 << param)) && (g_Params[param].m_Flags & TUNE_FLAG_AT_REST) && !g_AtRest;
+}
+
+//-------------------------------
+// Function: ReceiveByte
+//
+// Description: Adds a byte to the request being received, looking for the
+//  sync bytes first, and handles the request once it is complete.
+//
+//-------------------------------
+static void ReceiveByte (uint8_t data)
+{
+    uint16_t crc;
+    uint8_t i;
+
+    if ((g_RequestLength == 0) && (data != TELEMETRY_SYNC_1))
+        return;
+    if ((g_RequestLength == 1) && (data != TELEMETRY_SYNC_2))
+    {
+        g_RequestLength = (data == TELEMETRY_SYNC_1) ? 1 : 0;
+        return;
+    }
+
+    g_Request[g_RequestLength++] = data;
+    if (g_RequestLength < TUNE_REQUEST_SIZE)
+        return;
+    g_RequestLength = 0;
+
+    crc = CRC16_INITIAL;
+    for (i = 2; i < TUNE_REQUEST_SIZE - 2; ++i)
+        crc = Crc16 (crc, g_Request[i]);
+    if (crc != (g_Request[TUNE_REQUEST_SIZE - 2] | ((uint16_t) g_Request[TUNE_REQUEST_SIZE - 1] << 8)))
+        return;
+
+    HandleRequest();
+}
+
+//-------------------------------
+// Function: HandleRequest
+//
+// Description: Carries out the request in g_Request and queues the
+//  response, except for a save which is answered when it is done.
+//
+//-------------------------------
+static void HandleRequest (void)
+{
+    uint8_t command, sequence, param, status;
+    uint16_t value;
+
+    command = g_Request[2];
+    sequence = g_Request[3];
+    param = g_Request[4];
+    value = g_Request[5] | ((uint16_t) g_Request[6] << 8);
+
+    status = TUNE_OK;
+    switch (command)
+    {
+        case TUNE_CMD_GET:
+            if (param >= g_Count)
+                status = TUNE_ERR_PARAMETER;
+            else if (g_PendingMask & (1 << param))
+                value = g_Pending[param];
+            else
+                value = g_Params[param].m_Get();
+            if ((status == TUNE_OK) && IsHeld (param))
+                status = TUNE_HELD;
+            break;
+
+        case TUNE_CMD_SET:
+            if (param >= g_Count)
+            {
+                status = TUNE_ERR_PARAMETER;
+            }
+            else if (IsInLimits (&g_Params[param], value) == false)
+            {
+                status = TUNE_ERR_RANGE;
+            }
+            else
+            {
+                g_Pending[param] = value;
+                g_PendingMask |= (1 << param);
+                if (IsHeld (param))
+                    status = TUNE_HELD;
+            }
+            break;
+
+        case TUNE_CMD_SAVE:
+            g_SaveSequence = sequence;
+            g_SaveStep = 0;
+            return;
+
+        default:
+            status = TUNE_ERR_COMMAND;
+            break;
+    }
+
+    Respond (command, sequence, status, param, value);
+}
+
+//-------------------------------
+// Function: SaveNextByte
+//
+// Description: Writes the next byte of the saved parameters, if the EEPROM
+//  is free, and answers the save request after the last one.
+//
+//-------------------------------
+static void SaveNextByte (void)
+{
+    const TUNE_PARAM *param;
+    uint16_t value;
+
+    // Skip the parameters that are not saved.
+    while (((g_SaveStep >> 1) < g_Count) && (g_Params[g_SaveStep >> 1].m_EepromAddress == TUNE_NO_EEPROM))
+        g_SaveStep += 2;
+
+    if ((g_SaveStep >> 1) >= g_Count)
+    {
+        g_SaveStep = TUNE_SAVE_IDLE;
+        Respond (TUNE_CMD_SAVE, g_SaveSequence, TUNE_OK, 0, 0);
+        return;
+    }
+
+    param = &g_Params[g_SaveStep >> 1];
+    if (g_PendingMask & (1 << (g_SaveStep >> 1)))
+        value = g_Pending[g_SaveStep >> 1];     // Held, it is the value asked for.
+    else
+        value = param->m_Get();
+    if (g_SaveStep & 1)
+        value >>= 8;
+
+    if (EEPROM_tryWriteByte (param->m_EepromAddress + (g_SaveStep & 1), (uint8_t) value))
+        ++g_SaveStep;
+}
+
+//-------------------------------
+// Function: Respond
+//
+// Description: Builds a response and queues it, or keeps it for the next
+//  pass if the UART buffer is full.
+//
+//-------------------------------
+static void Respond (uint8_t command, uint8_t sequence, uint8_t status, uint8_t param, uint16_t value)
+{
+    uint8_t i;
+
+    for (i = 0; i < TELEMETRY_PAYLOAD_SIZE; ++i)
+        g_Response[i] = 0;
+
+    g_Response[0] = command;
+    g_Response[1] = sequence;
+    g_Response[2] = status;
+    g_Response[3] = param;
+    g_Response[4] = (uint8_t) value;
+    g_Response[5] = (uint8_t) (value >> 8);
+    g_Response[7] = g_Count;
+    if (param < g_Count)
+    {
+        g_Response[6] = g_Params[param].m_Type;
+        g_Response[8] = (uint8_t) g_Params[param].m_Minimum;
+        g_Response[9] = (uint8_t) (g_Params[param].m_Minimum >> 8);
+        g_Response[10] = (uint8_t) g_Params[param].m_Maximum;
+        g_Response[11] = (uint8_t) (g_Params[param].m_Maximum >> 8);
+        g_Response[12] = (g_Params[param].m_EepromAddress != TUNE_NO_EEPROM);
+    }
+
+    g_ResponseWaiting = (TelemetrySendFrame (TELEMETRY_FRAME_TUNE, g_Response) == false);
+}
+
+// end of file.
+//-------------------------------------------------------------------------
@@ -0,0 +1,188 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Filename: LoopTiming.c
+//
+// Description: Control loop period histogram and worst case per state.
+//
+//  LoopTimingMark() is called at the top of every pass through the control
+//  loop. It times the pass that just ended with the free running fast tick
+//  and charges it to the state that pass ran, or to LOOP_TIMING_TRANSITION
+//  if the pass changed state. The results are in
+//  g_LoopTiming, for the debugger, the telemetry stream (TELEMETRY_FRAME_TIMING)
+//  or a copy saved in the EEPROM.
+//
+//  Timing frame payload:
+//      0   page, 0 to LOOP_TIMING_NUM_PAGES - 1
+//      1   LOOP_TIMING_NUM_PAGES
+//      2   7 values, little endian. g_LoopTiming, taken as a uint16_t array,
+//          from index page * 7. Values past the end are 0.
+//
+// Author(s): G. Chopcinski (Kg Solutions, LLC)
+//
+// Created for ASL
+//
+//////////////////////////////////////////////////////////////////////////////
+
+/* **************************   Header Files   *************************** */
+
+// NOTE: This must ALWAYS be the first include in a file.
+#include "device_xc8.h"
+
+// from stdlib
+#include <stdint.h>
+#include <stdbool.h>
+
+// from project
+#include "bsp.h"
+#include "eeprom_bsp.h"
+#include "Telemetry.h"
+
+// from local
+#include "LoopTiming.h"
+
+/* ******************************   Macros   ****************************** */
+
+#define LOOP_TIMING_NUM_VALUES (LOOP_TIMING_NUM_BINS + LOOP_TIMING_NUM_STATES)
+#define LOOP_TIMING_NUM_PAGES ((LOOP_TIMING_NUM_VALUES + LOOP_TIMING_VALUES_PER_PAGE - 1) / LOOP_TIMING_VALUES_PER_PAGE)
+
+#if ((2 + (2 * LOOP_TIMING_VALUES_PER_PAGE)) > TELEMETRY_PAYLOAD_SIZE)
+#error "LOOP_TIMING_VALUES_PER_PAGE does not fit a telemetry frame"
+#endif
+
+/* ***********************   Global Variables ***************************** */
+
+LOOP_TIMING_STRUCT g_LoopTiming;
+
+/* ***********************   File Scope Variables   *********************** */
+
+static uint16_t g_LastMark;             // Fast tick at the last mark
+static uint16_t g_LastMarkMs;           // System tick at the last mark
+static bool g_Started;
+
+static uint8_t g_ReportCount;
+static uint8_t g_ReportPage;
+
+// Number of bits needed for 0 to 15.
+static const uint8_t g_NibbleBits[16] = {0, 1, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4};
+
+/* *******************   Public Function Definitions   ******************** */
+
+//-------------------------------
+// Function: LoopTimingReset
+//
+// Description: Clears the histogram and the maximums.
+//
+//-------------------------------
+void LoopTimingReset (void)
+{
+    uint8_t i;
+
+    for (i = 0; i < LOOP_TIMING_NUM_BINS; ++i)
+        g_LoopTiming.m_Histogram[i] = 0;
+    for (i = 0; i < LOOP_TIMING_NUM_STATES; ++i)
+        g_LoopTiming.m_MaxPeriod[i] = 0;
+    g_Started = false;
+}
+
+//-------------------------------
+// Function: LoopTimingMark
+//
+// Description: Call at the top of every pass through the control loop with
+//  the state the pass that just ended ran, LOOP_TIMING_TRANSITION if it
+//  changed state. The first call only starts the timing.
+//
+//-------------------------------
+void LoopTimingMark (uint8_t state)
+{
+    uint16_t now, nowMs, period;
+    uint8_t bin, high;
+
+    now = bspGetFastTick();
+    nowMs = bspGetSysTick();
+
+    if (g_Started)
+    {
+        period = now - g_LastMark;
+        if ((uint16_t) (nowMs - g_LastMarkMs) >= LOOP_TIMING_WRAP_MS)
+            period = LOOP_TIMING_SATURATED;     // The fast tick may have wrapped.
+
+        // The bin is the number of bits in the period.
+        high = (uint8_t) (period >> 8);
+        if (high != 0)
+            bin = (high & 0xf0) ? (12 + g_NibbleBits[high >> 4]) : (8 + g_NibbleBits[high]);
+        else
+            bin = ((uint8_t) period & 0xf0) ? (4 + g_NibbleBits[(uint8_t) period >> 4]) : g_NibbleBits[(uint8_t) period];
+        if (bin >= LOOP_TIMING_NUM_BINS)
+            bin = LOOP_TIMING_NUM_BINS - 1;
+
+        if (g_LoopTiming.m_Histogram[bin] != 0xffff)
+            ++g_LoopTiming.m_Histogram[bin];
+        if (state >= LOOP_TIMING_NUM_STATES)
+            state = LOOP_TIMING_NUM_STATES - 1;
+        if (period > g_LoopTiming.m_MaxPeriod[state])
+            g_LoopTiming.m_MaxPeriod[state] = period;
+    }
+
+    g_LastMark = now;
+    g_LastMarkMs = nowMs;
+    g_Started = true;
+}
+
+//-------------------------------
+// Function: LoopTimingReport
+//
+// Description: Call once per pass through the control loop. Every
+//  LOOP_TIMING_REPORT_PASSES calls, sends the next page of g_LoopTiming on
+//  the telemetry stream.
+//
+//-------------------------------
+void LoopTimingReport (void)
+{
+    uint8_t payload[TELEMETRY_PAYLOAD_SIZE];
+    const uint16_t *values;
+    uint8_t i, index;
+
+    if (++g_ReportCount < LOOP_TIMING_REPORT_PASSES)
+        return;
+    g_ReportCount = 0;
+
+    values = (const uint16_t *) &g_LoopTiming;
+    payload[0] = g_ReportPage;
+    payload[1] = LOOP_TIMING_NUM_PAGES;
+    index = g_ReportPage * LOOP_TIMING_VALUES_PER_PAGE;
+    for (i = 0; i < LOOP_TIMING_VALUES_PER_PAGE; ++i, ++index)
+    {
+        payload[2 + (2 * i)] = (index < LOOP_TIMING_NUM_VALUES) ? (uint8_t) values[index] : 0;
+        payload[3 + (2 * i)] = (index < LOOP_TIMING_NUM_VALUES) ? (uint8_t) (values[index] >> 8) : 0;
+    }
+    for (i = 2 + (2 * LOOP_TIMING_VALUES_PER_PAGE); i < TELEMETRY_PAYLOAD_SIZE; ++i)
+        payload[i] = 0;
+
+    // Only move on once the page has gone.
+    if (TelemetrySendFrame (TELEMETRY_FRAME_TIMING, payload))
+    {
+        if (++g_ReportPage >= LOOP_TIMING_NUM_PAGES)
+            g_ReportPage = 0;
+    }
+}
+
+//-------------------------------
+// Function: LoopTimingSave
+//
+// Description: Copies g_LoopTiming to the EEPROM, LOOP_TIMING_EEPROM_SIZE
+//  bytes from eepromAddress. This takes a while, so only call it when not
+//  driving.
+//
+//-------------------------------
+void LoopTimingSave (uint8_t eepromAddress)
+{
+    const uint16_t *values;
+    uint8_t i;
+
+    values = (const uint16_t *) &g_LoopTiming;
+    for (i = 0; i < LOOP_TIMING_NUM_VALUES; ++i)
+        EEPROM_writeInt16 (eepromAddress + (2 * i), values[i]);
+}
+
+// end of file.
+//-------------------------------------------------------------------------
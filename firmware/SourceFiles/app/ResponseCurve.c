@@ -0,0 +1,97 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Filename: ResponseCurve.c
+//
+// Description: Joystick response curve shaping. The curves are const tables
+//      in flash generated by tools/gen_response_curves.py. Applying a curve
+//      is one table lookup and a linear interpolation.
+//
+// Author(s): G. Chopcinski (Kg Solutions, LLC)
+//
+// Created for ASL
+//
+//////////////////////////////////////////////////////////////////////////////
+
+/* **************************   Header Files   *************************** */
+
+// NOTE: This must ALWAYS be the first include in a file.
+#include "device_xc8.h"
+
+// from stdlib
+#include <stdint.h>
+
+// from local
+#include "ResponseCurve.h"
+#include "ResponseCurveTable.h"
+
+#if (RESPONSE_CURVE_TABLE_COUNT != NUM_RESPONSE_CURVES)
+#error "ResponseCurveTable.h does not match ResponseCurve.h, run tools/gen_response_curves.py"
+#endif
+
+#if (((RESPONSE_CURVE_POINTS - 1) << RESPONSE_CURVE_SEGMENT_SHIFT) != RESPONSE_CURVE_FULL_SCALE)
+#error "ResponseCurveTable.h does not span RESPONSE_CURVE_FULL_SCALE"
+#endif
+
+/* ***********************   File Scope Variables   *********************** */
+
+static const uint16_t *g_ActiveCurve = g_ResponseCurveTable[RESPONSE_CURVE_LINEAR];
+static uint8_t g_ActiveCurveIndex = RESPONSE_CURVE_LINEAR;
+
+/* *******************   Public Function Definitions   ******************** */
+
+//-------------------------------
+// Function: SetResponseCurve
+//
+// Description: Selects the curve. Anything unknown, e.g. an erased EEPROM,
+//  selects the linear curve.
+//
+//-------------------------------
+void SetResponseCurve (uint8_t curve)
+{
+    if (curve >= NUM_RESPONSE_CURVES)
+        curve = RESPONSE_CURVE_LINEAR;
+
+    g_ActiveCurveIndex = curve;
+    g_ActiveCurve = g_ResponseCurveTable[curve];
+}
+
+//-------------------------------
+// Function: GetResponseCurve
+//
+// Description: Returns the selected curve.
+//
+//-------------------------------
+uint8_t GetResponseCurve (void)
+{
+    return g_ActiveCurveIndex;
+}
+
+//-------------------------------
+// Function: ApplyResponseCurve
+//
+// Description: Maps the deflection, 0 (neutral) to RESPONSE_CURVE_FULL_SCALE,
+//  through the selected curve.
+//
+// Returns: The shaped deflection, 0 to RESPONSE_CURVE_FULL_SCALE.
+//
+//-------------------------------
+uint16_t ApplyResponseCurve (uint16_t deflection)
+{
+    uint8_t segment;
+    uint8_t fraction;
+    uint16_t low, high;
+
+    if (deflection >= RESPONSE_CURVE_FULL_SCALE)
+        return g_ActiveCurve[RESPONSE_CURVE_POINTS - 1];
+
+    segment = (uint8_t) (deflection >> RESPONSE_CURVE_SEGMENT_SHIFT);
+    fraction = (uint8_t) (deflection & ((1 << RESPONSE_CURVE_SEGMENT_SHIFT) - 1));
+    low = g_ActiveCurve[segment];
+    high = g_ActiveCurve[segment + 1];
+
+    // The curves never fall, so high >= low.
+    return low + (uint16_t) (((high - low) * fraction) >> RESPONSE_CURVE_SEGMENT_SHIFT);
+}
+
+// end of file.
+//-------------------------------------------------------------------------
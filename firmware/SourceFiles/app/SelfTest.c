@@ -0,0 +1,396 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Filename: SelfTest.c
+//
+// Description: Background check of the program flash and the RAM.
+//
+//  SelfTestService() is called once per pass through the control loop and
+//  does a small, bounded piece of work each time, alternating between:
+//
+//  - the flash: SELFTEST_FLASH_SLICE more bytes are read with table reads
+//    and added to a CRC-16/CCITT-FALSE. At the end of the flash the CRC is
+//    compared with the one the linker put in the image.
+//
+//  - the RAM: the next SELFTEST_RAM_WINDOW bytes are copied aside, given a
+//    March C- test with 0x00 and 0xff and put back, all with interrupts
+//    masked. While the window holds test patterns nothing is kept in RAM,
+//    everything needed is in the FSRs, PROD, TABLAT and WREG. That part is
+//    written in assembly so the compiler can not put a temporary in the
+//    window under test. The host build, which has no PIC instructions,
+//    runs the same steps in C.
+//
+//  The longest call of each kind is kept in g_SelfTest. A failure stops
+//  both tests and stays until the power is cycled.
+//
+// Author(s): G. Chopcinski (Kg Solutions, LLC)
+//
+// Created for ASL
+//
+//////////////////////////////////////////////////////////////////////////////
+
+/* **************************   Header Files   *************************** */
+
+// NOTE: This must ALWAYS be the first include in a file.
+#include "device_xc8.h"
+
+// from stdlib
+#include <stdint.h>
+#include <stdbool.h>
+
+// from project
+#include "bsp.h"
+#include "Crc16.h"
+
+// from local
+#include "SelfTest.h"
+
+/* ******************************   Macros   ****************************** */
+
+#define RAM_WINDOW_MASK (SELFTEST_RAM_WINDOW - 1)
+
+// Puts a macro's value in an inline assembly string.
+#define ASM_TEXT(x) #x
+#define ASM_VALUE(x) ASM_TEXT(x)
+
+#if (SELFTEST_RAM_WINDOW & RAM_WINDOW_MASK) || (SELFTEST_RAM_END & RAM_WINDOW_MASK)
+#error "SELFTEST_RAM_WINDOW must be a power of 2 that divides SELFTEST_RAM_END"
+#endif
+
+/* ***********************   Global Variables ***************************** */
+
+SELFTEST_STRUCT g_SelfTest;
+
+/* ***********************   File Scope Variables   *********************** */
+
+static uint32_t g_FlashAddress;         // Next byte to add to the CRC
+static uint16_t g_FlashCrc;
+static uint16_t g_RamAddress;           // Next window to test
+static bool g_RamTurn;
+
+// The window is copied to whichever end of this does not overlap it.
+static uint8_t g_RamSave[3 * SELFTEST_RAM_WINDOW];
+
+/* ***********************   Function Prototypes   ************************ */
+
+static void FlashSlice (void);
+static void RamSlice (void);
+static uint8_t ReadFlashByte (uint32_t address);
+
+/* *******************   Public Function Definitions   ******************** */
+
+//-------------------------------
+// Function: SelfTestInit
+//
+// Description: Starts both tests from the beginning.
+//
+//-------------------------------
+void SelfTestInit (void)
+{
+    g_SelfTest.m_FlashPasses = 0;
+    g_SelfTest.m_RamPasses = 0;
+    g_SelfTest.m_FlashCrc = 0;
+    g_SelfTest.m_MaxFlashSlice = 0;
+    g_SelfTest.m_MaxRamSlice = 0;
+    g_SelfTest.m_FailAddress = 0;
+    g_SelfTest.m_Failure = SELFTEST_OK;
+
+    g_FlashAddress = SELFTEST_FLASH_START;
+    g_FlashCrc = CRC16_INITIAL;
+    g_RamAddress = 0;
+    g_RamTurn = false;
+}
+
+//-------------------------------
+// Function: SelfTestService
+//
+// Description: Call once per pass through the control loop. Does the next
+//  slice of one of the tests and returns the SELFTEST_FAIL_xxx bits.
+//
+//-------------------------------
+uint8_t SelfTestService (void)
+{
+    uint16_t start, period;
+
+    if (g_SelfTest.m_Failure != SELFTEST_OK)
+        return g_SelfTest.m_Failure;
+
+    start = bspGetFastTick();
+    if (g_RamTurn)
+    {
+        RamSlice();
+        period = bspGetFastTick() - start;
+        if (period > g_SelfTest.m_MaxRamSlice)
+            g_SelfTest.m_MaxRamSlice = period;
+    }
+    else
+    {
+        FlashSlice();
+        period = bspGetFastTick() - start;
+        if (period > g_SelfTest.m_MaxFlashSlice)
+            g_SelfTest.m_MaxFlashSlice = period;
+    }
+    g_RamTurn = !g_RamTurn;
+
+    return g_SelfTest.m_Failure;
+}
+
+//-------------------------------
+// Function: GetSelfTestFailure
+//
+// Description: Returns the SELFTEST_FAIL_xxx bits.
+//
+//-------------------------------
+uint8_t GetSelfTestFailure (void)
+{
+    return g_SelfTest.m_Failure;
+}
+
+/* ********************   Private Function Definitions   ****************** */
+
+//-------------------------------
+// Function: FlashSlice
+//
+// Description: Adds the next SELFTEST_FLASH_SLICE bytes of flash to the CRC
+//  and checks it at the end of the flash.
+//
+//-------------------------------
+static void FlashSlice (void)
+{
+    uint16_t stored;
+    uint8_t i;
+
+    for (i = 0; i < SELFTEST_FLASH_SLICE; ++i)
+    {
+        g_FlashCrc = Crc16 (g_FlashCrc, ReadFlashByte (g_FlashAddress));
+        if (++g_FlashAddress < SELFTEST_FLASH_CRC_ADDRESS)
+            continue;
+
+        stored = ReadFlashByte (SELFTEST_FLASH_CRC_ADDRESS);
+        stored |= (uint16_t) ReadFlashByte (SELFTEST_FLASH_CRC_ADDRESS + 1) << 8;
+        g_SelfTest.m_FlashCrc = g_FlashCrc;
+        ++g_SelfTest.m_FlashPasses;
+
+#ifndef DEBUG   // Debug builds have no CRC and the debugger's code is at the top of the flash.
+        if (g_FlashCrc != stored)
+        {
+            g_SelfTest.m_FailAddress = (uint16_t) SELFTEST_FLASH_CRC_ADDRESS;
+            g_SelfTest.m_Failure |= SELFTEST_FAIL_FLASH;
+        }
+#endif
+
+        g_FlashAddress = SELFTEST_FLASH_START;
+        g_FlashCrc = CRC16_INITIAL;
+        break;
+    }
+}
+
+//-------------------------------
+// Function: RamSlice
+//
+// Description: Tests the next SELFTEST_RAM_WINDOW bytes of RAM without
+//  changing what they hold.
+//
+//-------------------------------
+static void RamSlice (void)
+{
+    uint16_t save;
+    uint8_t start_gie_state;
+    bool failed;
+
+    // Copy the window to a part of g_RamSave outside it.
+    save = (uint16_t) g_RamSave;
+    if ((g_RamAddress < (save + SELFTEST_RAM_WINDOW)) && (save < (g_RamAddress + SELFTEST_RAM_WINDOW)))
+        save += 2 * SELFTEST_RAM_WINDOW;
+
+    start_gie_state = INTCONbits.GIE;
+    INTCONbits.GIE = 0;
+
+    // PROD = window, FSR1 = copy, TABLAT = failed. FSR0 and FSR2 walk them.
+    PROD = g_RamAddress;
+    FSR1 = save;
+    TABLAT = 0;
+
+#ifdef __XC8
+    asm("movff PRODL, FSR0L");
+    asm("movff PRODH, FSR0H");
+    asm("movff FSR1L, FSR2L");
+    asm("movff FSR1H, FSR2H");
+    asm("RamCopyOut:");
+    asm("movff POSTINC0, POSTINC2");
+    asm("movf FSR0L, w");
+    asm("andlw " ASM_VALUE(RAM_WINDOW_MASK));
+    asm("bnz RamCopyOut");
+
+    // March C-: up w0, up r0 w1, up r1 w0, down r0 w1, down r1 w0, up r0
+    asm("movff PRODL, FSR0L");
+    asm("movff PRODH, FSR0H");
+    asm("RamUpW0:");
+    asm("clrf POSTINC0");
+    asm("movf FSR0L, w");
+    asm("andlw " ASM_VALUE(RAM_WINDOW_MASK));
+    asm("bnz RamUpW0");
+
+    asm("movff PRODL, FSR0L");
+    asm("movff PRODH, FSR0H");
+    asm("RamUpR0W1:");
+    asm("movf INDF0, w");
+    asm("btfss STATUS, 2");             // Z
+    asm("setf TABLAT");
+    asm("setf POSTINC0");
+    asm("movf FSR0L, w");
+    asm("andlw " ASM_VALUE(RAM_WINDOW_MASK));
+    asm("bnz RamUpR0W1");
+
+    asm("movff PRODL, FSR0L");
+    asm("movff PRODH, FSR0H");
+    asm("RamUpR1W0:");
+    asm("comf INDF0, w");
+    asm("btfss STATUS, 2");
+    asm("setf TABLAT");
+    asm("clrf POSTINC0");
+    asm("movf FSR0L, w");
+    asm("andlw " ASM_VALUE(RAM_WINDOW_MASK));
+    asm("bnz RamUpR1W0");
+
+    asm("movf POSTDEC0, w");            // Back to the last byte of the window.
+    asm("movff FSR0L, FSR2L");
+    asm("movff FSR0H, FSR2H");
+    asm("RamDownR0W1:");
+    asm("movf INDF0, w");
+    asm("btfss STATUS, 2");
+    asm("setf TABLAT");
+    asm("setf POSTDEC0");
+    asm("movf FSR0L, w");
+    asm("andlw " ASM_VALUE(RAM_WINDOW_MASK));
+    asm("xorlw " ASM_VALUE(RAM_WINDOW_MASK));
+    asm("bnz RamDownR0W1");
+
+    asm("movff FSR2L, FSR0L");
+    asm("movff FSR2H, FSR0H");
+    asm("RamDownR1W0:");
+    asm("comf INDF0, w");
+    asm("btfss STATUS, 2");
+    asm("setf TABLAT");
+    asm("clrf POSTDEC0");
+    asm("movf FSR0L, w");
+    asm("andlw " ASM_VALUE(RAM_WINDOW_MASK));
+    asm("xorlw " ASM_VALUE(RAM_WINDOW_MASK));
+    asm("bnz RamDownR1W0");
+
+    asm("movff PRODL, FSR0L");
+    asm("movff PRODH, FSR0H");
+    asm("RamUpR0:");
+    asm("movf POSTINC0, w");
+    asm("btfss STATUS, 2");
+    asm("setf TABLAT");
+    asm("movf FSR0L, w");
+    asm("andlw " ASM_VALUE(RAM_WINDOW_MASK));
+    asm("bnz RamUpR0");
+
+    // Put the window back.
+    asm("movff PRODL, FSR0L");
+    asm("movff PRODH, FSR0H");
+    asm("movff FSR1L, FSR2L");
+    asm("movff FSR1H, FSR2H");
+    asm("RamCopyBack:");
+    asm("movff POSTINC2, POSTINC0");
+    asm("movf FSR0L, w");
+    asm("andlw " ASM_VALUE(RAM_WINDOW_MASK));
+    asm("bnz RamCopyBack");
+#else
+    FSR0 = PROD;
+    FSR2 = FSR1;
+    do { POSTINC2 = POSTINC0; } while (FSR0L & RAM_WINDOW_MASK);
+
+    // March C-: up w0, up r0 w1, up r1 w0, down r0 w1, down r1 w0, up r0
+    FSR0 = PROD;
+    do { POSTINC0 = 0x00; } while (FSR0L & RAM_WINDOW_MASK);
+
+    FSR0 = PROD;
+    do
+    {
+        if (INDF0 != 0x00)
+            TABLAT = 1;
+        POSTINC0 = 0xff;
+    } while (FSR0L & RAM_WINDOW_MASK);
+
+    FSR0 = PROD;
+    do
+    {
+        if (INDF0 != 0xff)
+            TABLAT = 1;
+        POSTINC0 = 0x00;
+    } while (FSR0L & RAM_WINDOW_MASK);
+
+    (void) POSTDEC0;                    // Back to the last byte of the window.
+    FSR2 = FSR0;
+    do
+    {
+        if (INDF0 != 0x00)
+            TABLAT = 1;
+        POSTDEC0 = 0xff;
+    } while ((FSR0L & RAM_WINDOW_MASK) != RAM_WINDOW_MASK);
+
+    FSR0 = FSR2;
+    do
+    {
+        if (INDF0 != 0xff)
+            TABLAT = 1;
+        POSTDEC0 = 0x00;
+    } while ((FSR0L & RAM_WINDOW_MASK) != RAM_WINDOW_MASK);
+
+    FSR0 = PROD;
+    do
+    {
+        if (POSTINC0 != 0x00)
+            TABLAT = 1;
+    } while (FSR0L & RAM_WINDOW_MASK);
+
+    // Put the window back.
+    FSR0 = PROD;
+    FSR2 = FSR1;
+    do { POSTINC0 = POSTINC2; } while (FSR0L & RAM_WINDOW_MASK);
+
+#endif
+
+    failed = (TABLAT != 0);
+    INTCONbits.GIE = start_gie_state;
+
+    if (failed)
+    {
+        g_SelfTest.m_FailAddress = g_RamAddress;
+        g_SelfTest.m_Failure |= SELFTEST_FAIL_RAM;
+        return;
+    }
+
+    g_RamAddress += SELFTEST_RAM_WINDOW;
+    if (g_RamAddress >= SELFTEST_RAM_END)
+    {
+        g_RamAddress = 0;
+        ++g_SelfTest.m_RamPasses;
+    }
+}
+
+//-------------------------------
+// Function: ReadFlashByte
+//
+// Description: Reads a byte of program memory. Interrupts are masked so an
+//  interrupt that reads a const table can not move TBLPTR in between.
+//
+//-------------------------------
+static uint8_t ReadFlashByte (uint32_t address)
+{
+    uint8_t start_gie_state, data;
+
+    start_gie_state = INTCONbits.GIE;
+    INTCONbits.GIE = 0;
+    TBLPTR = address;
+    asm("TBLRD*");
+    data = TABLAT;
+    INTCONbits.GIE = start_gie_state;
+
+    return data;
+}
+
+// end of file.
+//-------------------------------------------------------------------------
@@ -0,0 +1,189 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Filename: Telemetry.c
+//
+// Description: Binary telemetry stream on the UART.
+//
+//  Every frame is TELEMETRY_FRAME_SIZE bytes, multi-byte values are little
+//  endian:
+//      0   sync TELEMETRY_SYNC_1
+//      1   sync TELEMETRY_SYNC_2
+//      2   frame type, TELEMETRY_FRAME_xxx
+//      3   sequence number, counts every frame whether sent or dropped
+//      4   payload, TELEMETRY_PAYLOAD_SIZE bytes
+//      20  CRC-16/CCITT-FALSE of bytes 2 to 19
+//
+//  Sample frame payload:
+//      0   gp_State
+//      1   buttons, BUTTON_MASK_xxx
+//      2   raw speed           4   raw direction
+//      6   filtered speed      8   filtered direction
+//      10  speed demand        12  direction demand
+//      14  flags, TELEMETRY_FLAG_xxx
+//      15  response curve
+//
+//  Tune frames answer requests received on the UART, see LiveTune.c.
+//
+//  Frames are queued to the UART driver, which sends them from its
+//  interrupt. If there is no room the frame is dropped, so telemetry
+//  never holds up the control loop. The gap in the sequence numbers shows
+//  the host how many frames were lost.
+//
+// Author(s): G. Chopcinski (Kg Solutions, LLC)
+//
+// Created for ASL
+//
+//////////////////////////////////////////////////////////////////////////////
+
+/* **************************   Header Files   *************************** */
+
+// NOTE: This must ALWAYS be the first include in a file.
+#include "device_xc8.h"
+
+// from stdlib
+#include <stdint.h>
+#include <stdbool.h>
+
+// from project
+#include "uart_bsp.h"
+#include "Crc16.h"
+#include "UserButton.h"
+#include "ResponseCurve.h"
+
+// from local
+#include "Telemetry.h"
+
+#if (TELEMETRY_FRAME_SIZE >= UART_TX_BUFFER_SIZE)
+#error "A telemetry frame does not fit in the UART buffer"
+#endif
+
+/* ***********************   Global Variables ***************************** */
+
+TELEMETRY_SAMPLE g_TelemetrySample;
+
+/* ***********************   File Scope Variables   *********************** */
+
+static uint8_t g_Sequence;
+static uint8_t g_Decimation;
+static uint8_t g_DecimationCount;
+
+/* ***********************   Function Prototypes   ************************ */
+
+static void PutInt16 (uint8_t *buffer, uint16_t value);
+
+/* *******************   Public Function Definitions   ******************** */
+
+//-------------------------------
+// Function: TelemetryInit
+//
+// Description: Starts the UART and the telemetry at the default rate.
+//
+//-------------------------------
+void TelemetryInit (void)
+{
+    uartBspInit();
+    g_Sequence = 0;
+    TelemetrySetDecimation (TELEMETRY_DEFAULT_DECIMATION);
+}
+
+//-------------------------------
+// Function: TelemetrySetDecimation
+//
+// Description: Sends a sample frame every "decimation" passes of the
+//  control loop. 0 stops the sample frames.
+//
+//-------------------------------
+void TelemetrySetDecimation (uint8_t decimation)
+{
+    g_Decimation = decimation;
+    g_DecimationCount = 0;
+}
+
+//-------------------------------
+// Function: TelemetryGetDecimation
+//
+// Description: Returns the loop passes per sample frame, 0 = off.
+//
+//-------------------------------
+uint8_t TelemetryGetDecimation (void)
+{
+    return g_Decimation;
+}
+
+//-------------------------------
+// Function: TelemetryService
+//
+// Description: Call once per pass of the control loop. Sends a sample frame
+//  from g_TelemetrySample when one is due.
+//
+//-------------------------------
+void TelemetryService (uint8_t state)
+{
+    uint8_t payload[TELEMETRY_PAYLOAD_SIZE];
+
+    if (g_Decimation == 0)
+        return;
+    if (++g_DecimationCount < g_Decimation)
+        return;
+    g_DecimationCount = 0;
+
+    payload[0] = state;
+    payload[1] = GetUserButtonMask();
+    PutInt16 (&payload[2], g_TelemetrySample.m_RawSpeed);
+    PutInt16 (&payload[4], g_TelemetrySample.m_RawDirection);
+    PutInt16 (&payload[6], g_TelemetrySample.m_FilteredSpeed);
+    PutInt16 (&payload[8], g_TelemetrySample.m_FilteredDirection);
+    PutInt16 (&payload[10], g_TelemetrySample.m_SpeedDemand);
+    PutInt16 (&payload[12], g_TelemetrySample.m_DirectionDemand);
+    payload[14] = g_TelemetrySample.m_Flags;
+    payload[15] = GetResponseCurve();
+
+    (void) TelemetrySendFrame (TELEMETRY_FRAME_SAMPLE, payload);
+}
+
+//-------------------------------
+// Function: TelemetrySendFrame
+//
+// Description: Frames TELEMETRY_PAYLOAD_SIZE bytes of payload and queues
+//  them to the UART.
+//
+// Returns: true if queued, false if dropped for lack of room.
+//
+//-------------------------------
+bool TelemetrySendFrame (uint8_t type, const uint8_t *payload)
+{
+    uint8_t frame[TELEMETRY_FRAME_SIZE];
+    uint8_t i;
+    uint16_t crc;
+
+    frame[0] = TELEMETRY_SYNC_1;
+    frame[1] = TELEMETRY_SYNC_2;
+    frame[2] = type;
+    frame[3] = g_Sequence++;
+    for (i = 0; i < TELEMETRY_PAYLOAD_SIZE; ++i)
+        frame[4 + i] = payload[i];
+
+    crc = CRC16_INITIAL;
+    for (i = 2; i < TELEMETRY_FRAME_SIZE - 2; ++i)
+        crc = Crc16 (crc, frame[i]);
+    PutInt16 (&frame[TELEMETRY_FRAME_SIZE - 2], crc);
+
+    return uartBspWrite (frame, TELEMETRY_FRAME_SIZE);
+}
+
+/* ********************   Private Function Definitions   ****************** */
+
+//-------------------------------
+// Function: PutInt16
+//
+// Description: Stores a 16 bit value little endian.
+//
+//-------------------------------
+static void PutInt16 (uint8_t *buffer, uint16_t value)
+{
+    buffer[0] = (uint8_t) value;
+    buffer[1] = (uint8_t) (value >> 8);
+}
+
+// end of file.
+//-------------------------------------------------------------------------
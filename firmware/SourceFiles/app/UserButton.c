@@ -13,7 +13,7 @@
 #include "device_xc8.h"
 
 #include "bsp.h"
-#include "AnalogInput.h"
+#include "hal.h"
 #include "UserButton.h"
 #include "BluetoothControl.h"
 
@@ -44,14 +44,16 @@ typedef struct {
 
 //BUTTON_STRUCT g_ButtonInfo [MAX_BUTTONS];
 
-static uint8_t g_CalButton_DebounceCounter;
-static bool g_CalButtonState;
+// The debounce state is updated on every pass through the control loop, so
+// it is placed in access RAM.
+static __near uint8_t g_CalButton_DebounceCounter;
+static __near bool g_CalButtonState;
 
-static uint8_t g_UserPort_DebounceCounter;
-static bool g_UserPort_State;
+static __near uint8_t g_UserPort_DebounceCounter;
+static __near bool g_UserPort_State;
 
-static uint8_t g_ModeButton_DebounceCounter;
-static bool g_ModeButton_State;
+static __near uint8_t g_ModeButton_DebounceCounter;
+static __near bool g_ModeButton_State;
 
 //------------------------------------------------------------------------------
 // Forward Prototype Declarations
@@ -63,41 +65,40 @@ static bool g_ModeButton_State;
 void UserButtonInit(void)
 {
     // Initialize the Calibration Button input
-    TRISBbits.TRISB2 = GPIO_BIT_INPUT;
-    ANSELBbits.ANSELB2 = 0;         // Ensure it's a digital input.
-    WPUBbits.WPUB2 = 1;             // Enable weak pullup.
+    HAL_PIN_INPUT(B, 2);
+    HAL_PIN_DIGITAL(B, 2);      // Ensure it's a digital input.
+    HAL_PIN_PULLUP(B, 2);       // Enable weak pullup.
     g_CalButton_DebounceCounter = 0;
     g_CalButtonState = PORTBbits.RB2;
 
 #ifdef USE_JOYSTICK_MODE_SWITCH    
     //Initialize the Mode Button on the Joystick
-    TRISBbits.TRISB0 = GPIO_BIT_INPUT;
-    ANSELBbits.ANSELB0 = 0;         // Ensure the analog process does not interfere.
-    WPUBbits.WPUB0 = 1;             // Enable weak pullup.
+    HAL_PIN_INPUT(B, 0);
+    HAL_PIN_DIGITAL(B, 0);      // Ensure the analog process does not interfere.
+    HAL_PIN_PULLUP(B, 0);       // Enable weak pullup.
     g_ModeButton_DebounceCounter = 0;
     g_ModeButton_State = PORTBbits.RB0;
 #endif
     
     // Initialize the SW2 DIP Switches, No need to debounce DIP switches
-    TRISBbits.TRISB1 = GPIO_BIT_INPUT;  // SW2-1
-    ANSELBbits.ANSELB1 = 0;         // Ensure it's a digital input.
-    WPUBbits.WPUB1 = 1;             // Enable weak pullup.
+    HAL_PIN_INPUT(B, 1);        // SW2-1
+    HAL_PIN_DIGITAL(B, 1);      // Ensure it's a digital input.
+    HAL_PIN_PULLUP(B, 1);       // Enable weak pullup.
 
-    TRISBbits.TRISB5 = GPIO_BIT_INPUT;  // SW2-2
-    ANSELBbits.ANSELB5 = 0;         // Ensure it's a digital input.
-    WPUBbits.WPUB5 = 1;             // Enable weak pullup.
+    HAL_PIN_INPUT(B, 5);        // SW2-2
+    HAL_PIN_DIGITAL(B, 5);      // Ensure it's a digital input.
+    HAL_PIN_PULLUP(B, 5);       // Enable weak pullup.
 
 #ifndef DEBUG
     // Setup USER PORT as input.
     // Unfortunately, PIN RB6 is shared with PGD programming pin
-    TRISBbits.TRISB7 = GPIO_BIT_INPUT;  // USER PORT
-    ANSELBbits.ANSELB7 = 0;         // Ensure it is setup for Digital
-    WPUBbits.WPUB7 = 1;             // Enable a weak pully-up.
+    HAL_PIN_INPUT(B, 7);        // USER PORT
+    HAL_PIN_DIGITAL(B, 7);      // Ensure it is setup for Digital
+    HAL_PIN_PULLUP(B, 7);       // Enable a weak pully-up.
     g_UserPort_State = PORTBbits.RB7;
     g_UserPort_DebounceCounter = 0;
 #else
     g_UserPort_State = true;    // 1=Switch is Open, 0=Switch is closed
-    g_MouseClick_State = true;
 
 #endif    
 }
@@ -120,36 +121,8 @@ bool IsUserPortButtonActive (void)
 
 bool IsModeButtonActive (void)
 {
-#ifdef USE_JOYSTICK_MODE_SWITCH    
-    uint16_t rawSpeed, rawDirection;
-    uint16_t deflection;
-    bool reverseIsActive;
-   
-    reverseIsActive = false;
-    if (IsSW2_1_Closed())  // Are we using Reverse as a Mode Switch? YES!
-    {
-        GetSpeedAndDirection (&rawSpeed, &rawDirection);
-        // Don't process Reverse if Direction is active.
-        if ((rawDirection > (Joystick_Data[DIRECTION_ARRAY].m_rawNeutral - (NEUTRAL_ERROR_MARGIN * 2)))
-        && (rawDirection < (Joystick_Data[DIRECTION_ARRAY].m_rawNeutral + (NEUTRAL_ERROR_MARGIN * 2))))
-        {
-            if (rawSpeed < Joystick_Data[SPEED_ARRAY].m_rawMinNeutral)
-            {
-                if (rawSpeed < (Joystick_Data[SPEED_ARRAY].m_rawNeutral - Joystick_Data[SPEED_ARRAY].m_NegativeScale))
-                    rawSpeed = Joystick_Data[SPEED_ARRAY].m_rawNeutral - Joystick_Data[SPEED_ARRAY].m_NegativeScale;
-                deflection =  Joystick_Data[SPEED_ARRAY].m_rawNeutral - rawSpeed;
-                if (deflection > (Joystick_Data[SPEED_ARRAY].m_NegativeScale / 2))
-                {
-                    reverseIsActive = true;
-                }
-            }
-        }
-    }
-    if (reverseIsActive)
-        return true;
-#endif
-    
-    // Otherwise return the Joystick's Mode Button state.
+    // Reverse as a Mode switch (SW2-1) is recognised by the gesture
+    // engine, see IsReverseHeld().
     return (g_ModeButton_State ? false : true);     // Closed is active low
 }
 
@@ -167,6 +140,28 @@ bool IsSW2_2_Closed (void)
     return (PORTBbits.RB5 ? false : true);
 }
 
+//------------------------------------------------------------------------------
+// Returns the debounced buttons and the DIP switches as BUTTON_MASK_xxx bits.
+//------------------------------------------------------------------------------
+
+uint8_t GetUserButtonMask (void)
+{
+    uint8_t mask = 0;
+
+    if (g_CalButtonState == false)
+        mask |= BUTTON_MASK_CALIBRATION;
+    if (g_UserPort_State == false)
+        mask |= BUTTON_MASK_USER_PORT;
+    if (g_ModeButton_State == false)
+        mask |= BUTTON_MASK_MODE;
+    if (IsSW2_1_Closed())
+        mask |= BUTTON_MASK_SW2_1;
+    if (IsSW2_2_Closed())
+        mask |= BUTTON_MASK_SW2_2;
+
+    return mask;
+}
+
 //------------------------------------------------------------------------------
 
 void Read_User_Buttons (void)
@@ -21,6 +21,7 @@
 
 // from local
 #include "bsp.h"
+#include "hal.h"
 #include "beeper.h"
 
 /* ******************************   Types   ******************************* */
@@ -33,8 +34,8 @@
 //-------------------------------
 void beeperInit(void)
 {
-    TRISDbits.TRISD0 = GPIO_BIT_OUTPUT;
-    ANSELDbits.ANSELD0 = 0;     // Disable Analog feature to allow digital to operate correctly.
+    HAL_PIN_OUTPUT(D, 0);
+    HAL_PIN_DIGITAL(D, 0);      // Disable Analog feature to allow digital to operate correctly.
     LATDbits.LATD0 = GPIO_HIGH;     // Turn the beeper off.
 }
 
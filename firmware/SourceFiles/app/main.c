@@ -14,6 +14,7 @@
 // from stdlib
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 //#include "user_assert.h"
 
 /* **************************   Header Files   *************************** */
@@ -27,6 +28,16 @@
 #include "AnalogInput.h"
 #include "UserButton.h"
 #include "BluetoothControl.h"
+#include "JoystickGate.h"
+#include "ResponseCurve.h"
+#include "FailsafeMonitor.h"
+#include "Telemetry.h"
+#include "LoopTiming.h"
+#include "BlackBox.h"
+#include "SelfTest.h"
+#include "Gesture.h"
+#include "LiveTune.h"
+#include "JoystickType.h"
 
 
 /* ******************************   Macros   ****************************** */
@@ -111,6 +122,12 @@
 #assert
 #endif
 
+#define JOYSTICK_DEMAND_SWING (630)     // DAC counts from neutral at full deflection.
+
+// Live tuning may move the neutral demand this far, see g_TuneParams.
+#define TUNE_NEUTRAL_DEMAND_MIN (NEUTRAL_DEMAND_OUTPUT - 100)
+#define TUNE_NEUTRAL_DEMAND_MAX (NEUTRAL_DEMAND_OUTPUT + 100)
+
 enum STATE_ENUM {
     NO_STATE = 0,
     POWERUP_STATE,
@@ -127,7 +144,11 @@ enum STATE_ENUM {
     ENTER_CALIBRATION_STATE,
     DO_JOYSTICK_CALIBRATION_STATE,
     EXIT_JOYSTICK_CALIBRATION_STATE,
-}  gp_State;
+    FAULT_STATE,
+    NUM_STATES
+};
+
+__near enum STATE_ENUM gp_State;      // Checked on every pass, keep it in access RAM.
 
 // Define the locations in EEPROM
 #define EEPROM_SPEED_LOWER_SCALE 0
@@ -138,37 +159,203 @@ enum STATE_ENUM {
 #define EEPROM_VALID_DATA2 (0xaa55)
 #define EEPROM_1st_CHECK (EEPROM_DIRECTION_UPPER_SCALE + 2)
 #define EEPROM_2nd_CHECK (EEPROM_1st_CHECK + 2)
+#define EEPROM_BT_MODE (EEPROM_2nd_CHECK + 2)
+#define EEPROM_BT_MODE_PROPORTIONAL (0x5aa5)    // Anything else is switched mode.
+#define EEPROM_GATE_TABLE (EEPROM_BT_MODE + 2)  // GATE_EEPROM_SIZE bytes.
+#define EEPROM_RESPONSE_CURVE (EEPROM_GATE_TABLE + GATE_EEPROM_SIZE) // RESPONSE_CURVE_xxx, else linear.
+#define EEPROM_GESTURES (EEPROM_RESPONSE_CURVE + 2) // GESTURE_ENABLE_xxx bits, the high byte their complement.
+#define EEPROM_TUNING (EEPROM_GESTURES + 2)     // Live tuning values, see g_TuneParams.
+#define EEPROM_TUNING_SIZE (8)
+#define EEPROM_JOYSTICK_TYPE (EEPROM_TUNING + EEPROM_TUNING_SIZE) // JOYSTICK_TYPE_xxx found, the high byte its complement.
+#define EEPROM_BOOT_TOLERANCE (EEPROM_JOYSTICK_TYPE + 2) // Live tuned, see g_BootStableTolerance.
+#define EEPROM_LOOP_TIMING (0x40)       // LOOP_TIMING_EEPROM_SIZE bytes, see SaveDiagnostics().
+#define EEPROM_BLACKBOX (0x80)          // BLACKBOX_EEPROM_SIZE bytes, written by BlackBoxService().
+
+#if ((EEPROM_BOOT_TOLERANCE + 2) > EEPROM_LOOP_TIMING) || ((EEPROM_LOOP_TIMING + LOOP_TIMING_EEPROM_SIZE) > EEPROM_BLACKBOX) \
+    || ((EEPROM_BLACKBOX + BLACKBOX_EEPROM_SIZE) > 0x100)
+#error "EEPROM map overlaps"
+#endif
+
+// The hold gesture only ends a calibration once the joystick has been out
+// at least this far every way, see IsCalibrationExitGesture().
+#define CALIBRATION_MIN_SCALE (JOYSTICK_RAW_MAX_DEFLECTION / 8)
+
+// Fault state beeper chirp. Times are in system ticks (ms).
+#define FAULT_CHIRP_PERIOD_MS (2048)    // Must be a power of 2.
+#define FAULT_CHIRP_MS (64)
+
+// Power up timing. Times are in system ticks (ms).
+#define BOOT_BEEP_MS (75)               // Length of each start up beep.
+#define BOOT_MIN_SETTLE_MS (250)        // Earliest time a neutral is accepted.
+#define BOOT_MAX_SETTLE_MS (1000)       // Latest wait for steady readings, see BootSequence().
+#define BOOT_ADC_WARMUP_SAMPLES (4)     // Readings discarded while the ADC settles.
+#define BOOT_STABLE_SAMPLES (32)        // Steady readings needed to accept the neutral.
+#ifndef BOOT_STABLE_TOLERANCE
+#define BOOT_STABLE_TOLERANCE (8)       // Largest change allowed between steady readings, live tuned.
+#endif
+#define BOOT_MEASURE_ADC_NOISE (0)      // 1 = measure the ADC noise at power up, see g_AdcNoise.
+
+// Records when each power up milestone was reached, in ms after reset.
+typedef struct
+{
+    uint16_t m_EepromLoadedMs;
+    uint16_t m_AdcWarmMs;
+    uint16_t m_NeutralStableMs;
+    uint16_t m_DriveReadyMs;
+} BOOT_TIMING_STRUCT;
+
+// What each state does, see g_StateHandlers. Any handler may be NULL.
+// m_Entry runs once when the state is entered, m_Tick on every pass while
+// in it and m_Exit once when it is left. Handlers move to another state
+// with ChangeState(), which takes effect as soon as the handler returns.
+typedef struct
+{
+    void (*m_Entry)(void);
+    void (*m_Tick)(void);
+    void (*m_Exit)(void);
+} STATE_HANDLERS_STRUCT;
+
+// Transitions followed in one pass, any more wait for the next pass. The
+// longest chain is a state that moves through an announce state.
+#define STATE_MAX_CHAIN (4)
 
 /* ***********************   Function Prototypes   ************************ */
 
 static void AnnunceEnterDriverState (void);
 static void EnterDrivingState (void);
 static void DrivingState (void);
+static void LeaveDrivingState (void);
 static void AnnounceEnterBluetoothState (void);
 static void EnterBluetoothState (void);
 static void BluetoothControlState (void);
 static void EnterModeChangeState (void);
 static void ModeChangeState (void);
 static void ExitModeChangeState (void);
+static void LeaveModeChangeState (void);
 
 static void EnterCalibrationState(void);
 static void JoystickCalibrationState(void);
 static void ExitCalibrationState(void);
-
+static void FaultState (void);
+static bool IsModeActive (void);
+static bool IsCalibrationExitGesture (void);
+static void ChangeState (enum STATE_ENUM next);
+static void RunStateMachine (void);
+static void FollowTransitions (void);
+static void TraceStateChange (uint8_t state);
+static void RecordNeutralDrift (void);
+static uint8_t TelemetryFlags (void);
+static void SaveDiagnostics (void);
+static void SaveBtModeService (void);
+
+static uint16_t DemandOffset (uint16_t deflection, uint16_t inverse);
+static uint8_t BluetoothDuty (uint16_t deflection, uint16_t range);
 static void SetTPI_Demands (uint16_t speedDemand, uint16_t directionDemand);
 bool InitializeJoystickData (void);
+uint8_t GetDemandGuardTrips (void);
+static void BootSequence (void);
 static void EstablishJoystickNeutral(void);
+static void SetJoystickNeutral (uint16_t speed, uint16_t direction);
+
+static uint16_t GetNeutralDemand (void);
+static void SetNeutralDemand (uint16_t value);
+static uint16_t GetDacSwing (void);
+static void SetDacSwing (uint16_t value);
+static uint16_t GetTuneNeutralMargin (void);
+static void SetTuneNeutralMargin (uint16_t value);
+static uint16_t GetTuneAdcMode (void);
+static void SetTuneAdcMode (uint16_t value);
+static uint16_t GetTuneResponseCurve (void);
+static void SetTuneResponseCurve (uint16_t value);
+static uint16_t GetTuneDecimation (void);
+static void SetTuneDecimation (uint16_t value);
+static uint16_t GetTuneBootTolerance (void);
+static void SetTuneBootTolerance (uint16_t value);
+static uint16_t GetTuneSaveDiagnostics (void);
+static void SetTuneSaveDiagnostics (uint16_t value);
 
 /* ***********************   Global Variables ***************************** */
 
+static bool g_BtProportional;           // true = proportional cursor speed.
+static bool g_BtModeButtonLatched;      // Calibration button seen in Bluetooth state.
+static uint8_t g_BtModeBytesToSave;     // Of EEPROM_BT_MODE, written by SaveBtModeService().
+
+BOOT_TIMING_STRUCT g_BootTiming;        // Power up instrumentation.
+static uint8_t g_BootStableTolerance;   // BOOT_STABLE_TOLERANCE unless live tuned.
+
+volatile bool g_SaveDiagnosticsRequest; // Set with the debugger or live tuning to save the diagnostics.
+static int8_t g_RecordedDrift[NUM_JS_POTS]; // Last put in the black box, see RecordNeutralDrift().
+static bool g_CalibrationExitArmed;     // Hold gesture seen, ends the calibration at neutral.
+static uint8_t g_DemandGuardTrips;      // Demands SetTPI_Demands() forced to neutral, saturates.
+
+// The joystick is read once at the top of each pass. Every state and the
+// gesture engine work from this reading.
+static uint16_t g_RawSpeed, g_RawDirection;
+static uint8_t g_Gesture;               // GESTURE_xxx finished on this pass.
+static uint8_t g_GestureEnables;        // GESTURE_ENABLE_xxx bits from the EEPROM.
+
+// The drive demands at rest and their limits. Set from the build's
+// NEUTRAL_DEMAND_OUTPUT, MIN_DAC_OUTPUT and MAX_DAC_OUTPUT and changed by
+// live tuning.
+static uint16_t g_NeutralDemand;
+static uint16_t g_MinDacOutput, g_MaxDacOutput;
+
+// The neutral margin for the joystick found at power up, and the one set by
+// live tuning in its place, 0 = none.
+static uint16_t g_AutoNeutralMargin;
+static uint16_t g_TunedNeutralMargin;
+
+static enum STATE_ENUM g_NextState;     // Asked for by ChangeState(), NO_STATE = stay.
+static bool g_StateMoved;               // A change of state was followed this pass.
+static void (*g_StateTraceHook)(uint8_t state); // Told of each new state, NULL = not traced.
+
+// Indexed by enum STATE_ENUM. The announce states and the pseudo states
+// that only lead on to the next one do their work on entry, so the chain
+// is followed in a single pass.
+static const STATE_HANDLERS_STRUCT g_StateHandlers[NUM_STATES] =
+{
+    // m_Entry                      m_Tick                      m_Exit
+    { NULL,                         NULL,                       NULL },                 // NO_STATE
+    { NULL,                         EstablishJoystickNeutral,   NULL },                 // POWERUP_STATE
+    { AnnunceEnterDriverState,      NULL,                       NULL },                 // ANNOUNCE_ENTER_DRIVING_STATE
+    { NULL,                         EnterDrivingState,          NULL },                 // ENTER_DRIVING_STATE
+    { NULL,                         DrivingState,               LeaveDrivingState },    // DRIVING_STATE
+    { AnnounceEnterBluetoothState,  NULL,                       NULL },                 // ANNOUNCE_ENTER_BLUETOOTH_STATE
+    { NULL,                         EnterBluetoothState,        NULL },                 // ENTER_BLUETOOTH_STATE
+    { NULL,                         BluetoothControlState,      NULL },                 // BLUETOOTH_STATE
+    { NULL,                         NULL,                       NULL },                 // EXIT_BLUETOOTH_STATE, not used
+    { EnterModeChangeState,         NULL,                       NULL },                 // ENTER_MODE_CHANGE_STATE
+    { NULL,                         ModeChangeState,            LeaveModeChangeState }, // MODE_CHANGE_STATE
+    { ExitModeChangeState,          NULL,                       NULL },                 // EXIT_MODE_CHANGE_STATE
+    { NULL,                         EnterCalibrationState,      NULL },                 // ENTER_CALIBRATION_STATE
+    { NULL,                         JoystickCalibrationState,   NULL },                 // DO_JOYSTICK_CALIBRATION_STATE
+    { NULL,                         ExitCalibrationState,       NULL },                 // EXIT_JOYSTICK_CALIBRATION_STATE
+    { NULL,                         FaultState,                 NULL },                 // FAULT_STATE
+};
+
+// The values that may be changed over the UART, see LiveTune.c. The index
+// is the parameter number used by tools/livetune.py, add to the end only.
+// The neutral demand and the swing move the DAC outputs, and a smaller
+// margin can take a joystick at rest out of the neutral window, so they
+// are TUNE_FLAG_AT_REST: held until a pass outside the driving state.
+static const TUNE_PARAM g_TuneParams[] =
+{
+    // m_Type           m_Flags             m_EepromAddress         m_Minimum               m_Maximum                               m_Get                   m_Set
+    { TUNE_TYPE_UINT16, TUNE_FLAG_AT_REST,  EEPROM_TUNING,          TUNE_NEUTRAL_DEMAND_MIN, TUNE_NEUTRAL_DEMAND_MAX,               GetNeutralDemand,       SetNeutralDemand },
+    { TUNE_TYPE_UINT16, TUNE_FLAG_AT_REST,  EEPROM_TUNING + 2,      0,                      JOYSTICK_DEMAND_SWING,                  GetDacSwing,            SetDacSwing },
+    { TUNE_TYPE_UINT16, TUNE_FLAG_AT_REST,  EEPROM_TUNING + 4,      0,                      (JOYSTICK_RAW_MAX_DEFLECTION / 2) - 1,  GetTuneNeutralMargin,   SetTuneNeutralMargin }, // 0 = for the joystick type
+    { TUNE_TYPE_UINT8,  0,                  EEPROM_TUNING + 6,      0,                      NUM_ADC_MODES - 1,                      GetTuneAdcMode,         SetTuneAdcMode },
+    { TUNE_TYPE_UINT8,  0,                  EEPROM_RESPONSE_CURVE,  0,                      NUM_RESPONSE_CURVES - 1,                GetTuneResponseCurve,   SetTuneResponseCurve },
+    { TUNE_TYPE_UINT8,  0,                  TUNE_NO_EEPROM,         0,                      0xff,                                   GetTuneDecimation,      SetTuneDecimation },
+    { TUNE_TYPE_UINT8,  0,                  EEPROM_BOOT_TOLERANCE,  1,                      NEUTRAL_MARGIN_STANDARD,                GetTuneBootTolerance,   SetTuneBootTolerance }, // Used at the next power up
+    { TUNE_TYPE_UINT8,  0,                  TUNE_NO_EEPROM,         0,                      1,                                      GetTuneSaveDiagnostics, SetTuneSaveDiagnostics }, // 1 = save, see SaveDiagnostics()
+};
+
 
 //------------------------------------------------------------------------------
 
 int main (void)
 {
-    int i;
-    bool eepromStatus;
-    
 	//UTRDIS = 1; 						//	USB transceiver disable 
     bspInitCore();
     beeperInit();
@@ -178,90 +365,85 @@ int main (void)
     BluetoothControlInit();
     AnalogInputInit();
     UserButtonInit();
+    TelemetryInit();
+    BlackBoxInit (EEPROM_BLACKBOX);
+
+    g_NeutralDemand = NEUTRAL_DEMAND_OUTPUT;
+    g_MinDacOutput = MIN_DAC_OUTPUT;
+    g_MaxDacOutput = MAX_DAC_OUTPUT;
+    g_AutoNeutralMargin = NEUTRAL_ERROR_MARGIN;
+    g_TunedNeutralMargin = 0;
+    g_BootStableTolerance = BOOT_STABLE_TOLERANCE;
+    LiveTuneInit (g_TuneParams, sizeof (g_TuneParams) / sizeof (g_TuneParams[0]));
+    bspEnableInterrupts();  // Starts the system tick.
     
-    dacBspSet (DAC_SELECT_FORWARD_BACKWARD, NEUTRAL_DEMAND_OUTPUT);
-    dacBspSet (DAC_SELECT_LEFT_RIGHT, NEUTRAL_DEMAND_OUTPUT);
+    dacBspSet (DAC_SELECT_FORWARD_BACKWARD, g_NeutralDemand);
+    dacBspSet (DAC_SELECT_LEFT_RIGHT, g_NeutralDemand);
 
-    // Short breather to allow board to power up normally.
-    for (i = 0; i < 2000; ++i)
-        bspDelayUs (US_DELAY_500_us);
+    // Check the EEPROM, beep, warm up the ADC and find the joystick's
+    // neutral, all at the same time. The DACs stay at neutral throughout.
+    BootSequence();
 
-    eepromStatus = InitializeJoystickData();
-    if (eepromStatus == false)     // EEPROM data is bad
-    {
-        TurnBeeper(BEEPER_ON);
-        for (i = 0; i < 150; ++i)
-        {
-            Read_User_Buttons();  // Get and debounce the User Buttons.
-            bspDelayUs (US_DELAY_500_us);
-        }
-        TurnBeeper(BEEPER_OFF);
-        for (i = 0; i < 150; ++i)   // add a short off delay
-            bspDelayUs (US_DELAY_500_us);
-    }
+    // Every state change from here on goes in the black box.
+    g_StateTraceHook = TraceStateChange;
+    ChangeState (ENTER_DRIVING_STATE);
+    FollowTransitions();
 
-    // Announce the startup
-    TurnBeeper(BEEPER_ON);
-    for (i = 0; i < 150; ++i)
-    {
-        Read_User_Buttons();  // Get and debounce the User Buttons.
-        bspDelayUs (US_DELAY_500_us);
-    }
-    TurnBeeper(BEEPER_OFF);
-    
-    dacBspSet (DAC_SELECT_FORWARD_BACKWARD, NEUTRAL_DEMAND_OUTPUT);
-    dacBspSet (DAC_SELECT_LEFT_RIGHT, NEUTRAL_DEMAND_OUTPUT);
-
-    gp_State = POWERUP_STATE;
+    GestureReset();
+    LoopTimingReset();
+    SelfTestInit();
 
     while (1)
     {
+        // The entry and exit handlers run inside a pass, and the
+        // announcements block in theirs, so a pass that changed state is
+        // not charged to either state.
+        LoopTimingMark (g_StateMoved ? LOOP_TIMING_TRANSITION : gp_State);
+        g_StateMoved = false;
+
+        // Settings changed over the UART take effect here, between passes.
+        // Those that move the outputs wait while driving: the next entry
+        // into driving starts from neutral with them.
+        LiveTuneApply (gp_State != DRIVING_STATE);
+
         Read_User_Buttons();  // Get and debounce the User Buttons.
 
-        switch (gp_State)
+        GetSpeedAndDirection (&g_RawSpeed, &g_RawDirection);
+        g_Gesture = GestureUpdate (g_RawSpeed, g_RawDirection,
+            g_GestureEnables | (IsSW2_1_Closed() ? GESTURE_ENABLE_REVERSE_HOLD : 0));
+        if (g_Gesture != GESTURE_NONE)
+            BlackBoxRecord (BLACKBOX_EVENT_GESTURE, g_Gesture);
+
+        RunStateMachine();
+
+        // Report this pass on the telemetry stream.
+        g_TelemetrySample.m_Flags = TelemetryFlags();
+        TelemetryService (gp_State);
+        LoopTimingReport();
+        LiveTuneService();
+
+        // Note any button edge, and write the black box to the EEPROM a
+        // byte at a time when it has been asked for.
+        BlackBoxService (GetUserButtonMask());
+        SaveBtModeService();
+
+        // Check a little more of the flash or the RAM. A failure stops
+        // everything until the power is cycled.
+        if ((SelfTestService() != SELFTEST_OK) && (gp_State != FAULT_STATE))
+        {
+            BlackBoxRecord (BLACKBOX_EVENT_SELF_TEST, GetSelfTestFailure());
+            BlackBoxFlush (BLACKBOX_CAUSE_FAULT);
+            ChangeState (FAULT_STATE);  // Taken at the start of the next pass.
+        }
+
+        // The save blocks while the loop timing is written, so a request
+        // waits until the outputs are not being driven.
+        if (g_SaveDiagnosticsRequest && (gp_State != DRIVING_STATE) && (gp_State != BLUETOOTH_STATE))
         {
-            case POWERUP_STATE:
-                EstablishJoystickNeutral();
-                break;
-            case ANNOUNCE_ENTER_DRIVING_STATE:
-                AnnunceEnterDriverState();
-                break;
-            case ENTER_DRIVING_STATE:
-                EnterDrivingState();
-                break;
-            case DRIVING_STATE:
-                DrivingState();
-                break;
-            case ANNOUNCE_ENTER_BLUETOOTH_STATE:
-                AnnounceEnterBluetoothState();
-                break;
-            case ENTER_BLUETOOTH_STATE:
-                EnterBluetoothState();
-                break;
-            case BLUETOOTH_STATE:
-                BluetoothControlState();
-                break;
-            case ENTER_MODE_CHANGE_STATE:
-                EnterModeChangeState();
-                break;
-            case MODE_CHANGE_STATE:
-                ModeChangeState();
-                break;
-            case EXIT_MODE_CHANGE_STATE:
-                ExitModeChangeState();
-                break;
-            case ENTER_CALIBRATION_STATE:
-                EnterCalibrationState();
-                break;
-            case DO_JOYSTICK_CALIBRATION_STATE:
-                JoystickCalibrationState();
-                break;
-            case EXIT_JOYSTICK_CALIBRATION_STATE:
-                ExitCalibrationState();
-                break;
-            default:
-                break;
+            g_SaveDiagnosticsRequest = false;
+            SaveDiagnostics();
         }
+
         bspDelayUs (US_DELAY_100_us);
     }
 }
@@ -275,116 +457,156 @@ static void AnnunceEnterDriverState (void)
     bspDelayMs (500);
     TurnBeeper(BEEPER_OFF);
 
-    gp_State = ENTER_DRIVING_STATE;
+    ChangeState (ENTER_DRIVING_STATE);
 }
 
 //------------------------------------------------------------------------------
 // This function waits for the Joystick to be in neutral and no buttons are
-// active.
+// active. Holding the joystick out to one side meanwhile starts a
+// calibration, as the Calibration button would.
 //------------------------------------------------------------------------------
 static void EnterDrivingState (void)
 {
-    if (IsJoystickInNeutral())
+    if (g_Gesture == GESTURE_HOLD_DIRECTION)
+    {
+        ChangeState (ENTER_CALIBRATION_STATE);
+    }
+    else if (IsInNeutralWindow (g_RawSpeed, g_RawDirection))
     {
         if (IsUserPortButtonActive() == false)
         {
             if (IsCalibrationButtonActive() == false)
             {
-                gp_State = DRIVING_STATE;
+                if (g_BootTiming.m_DriveReadyMs == 0)
+                    g_BootTiming.m_DriveReadyMs = bspGetSysTick();
+                FailsafeReset();
+                ChangeState (DRIVING_STATE);
             }
         }
     }
 }
 
+//------------------------------------------------------------------------------
+// This function converts a deflection from neutral into the DAC counts to
+// add to or take from the neutral demand. "inverse" is the axis' 
+// m_PositiveInverse or m_NegativeInverse. The deflection is normalised
+// and passed through the selected response curve.
+//------------------------------------------------------------------------------
+
+static uint16_t DemandOffset (uint16_t deflection, uint16_t inverse)
+{
+    uint32_t normalised;
+
+    normalised = ((uint32_t) deflection * inverse) >> (JOYSTICK_INVERSE_SHIFT - RESPONSE_CURVE_BITS);
+    if (normalised > RESPONSE_CURVE_FULL_SCALE)
+        normalised = RESPONSE_CURVE_FULL_SCALE;
+
+    return (uint16_t) (((uint32_t) ApplyResponseCurve ((uint16_t) normalised) * JOYSTICK_DEMAND_SWING) >> RESPONSE_CURVE_BITS);
+}
+
 //------------------------------------------------------------------------------
 // This function translates the Joystick's Speed and Direction Analog Input
 // signals into the voltage expected by the LiNX TPI board.
-// In the calculations below, here's what the hard-coded number represent.
-//  "240.0f" is the expected max deflection of the Analog Inputs from Neutral.
-//  "630.0f" is the factor to convert the Analog Inputs to DAC bits.
 //------------------------------------------------------------------------------
 
 static void DrivingState (void)
 {
     uint16_t rawSpeed, rawDirection;
-    float offset, demand;
     uint16_t int_SpeedDemand, int_DirectionDemand; 
     bool stillDriving = true;
+    uint8_t faults;
     
-    int_SpeedDemand = NEUTRAL_DEMAND_OUTPUT;
-    int_DirectionDemand = NEUTRAL_DEMAND_OUTPUT;
+    int_SpeedDemand = g_NeutralDemand;
+    int_DirectionDemand = g_NeutralDemand;
     
     // Shall we do some calibration?
     if (IsCalibrationButtonActive())
     {
-        gp_State = ENTER_CALIBRATION_STATE;
+        ChangeState (ENTER_CALIBRATION_STATE);
         stillDriving = false;   // Let's stop driving if we are.
     }
     
     // Shall we change to Bluetooth Mode?
-    if (IsUserPortButtonActive())
+    if (IsUserPortButtonActive() || (g_Gesture == GESTURE_DOUBLE_FLICK))
     {
-        gp_State = ANNOUNCE_ENTER_BLUETOOTH_STATE;
+        ChangeState (ANNOUNCE_ENTER_BLUETOOTH_STATE);
         stillDriving = false;   // Let's stop driving if we are.
     }
     
     // Shall we change Modes
-    if (IsModeButtonActive())
+    if (IsModeActive())
     {
-        gp_State = ENTER_MODE_CHANGE_STATE;
+        ChangeState (ENTER_MODE_CHANGE_STATE);
         stillDriving = false;   // Let's stop driving if we are.
     }
 
     if (stillDriving)
     {
-        GetSpeedAndDirection (&rawSpeed, &rawDirection);
+        rawSpeed = g_RawSpeed;
+        rawDirection = g_RawDirection;
+        g_TelemetrySample.m_RawSpeed = rawSpeed;
+        g_TelemetrySample.m_RawDirection = rawDirection;
+
+        // A reading that is not believable is not used, the demands stay
+        // at neutral. If it persists, stop until the power is cycled.
+        faults = FailsafeCheck (rawSpeed, rawDirection);
+        if (faults != FAULT_NONE)
+        {
+            BlackBoxRecord (BLACKBOX_EVENT_FAULT, faults);
+            if (IsFailsafeLatched())
+            {
+                BlackBoxRecord (BLACKBOX_EVENT_FAULT_LATCHED, GetFailsafeCause());
+                BlackBoxFlush (BLACKBOX_CAUSE_FAULT);
+                ChangeState (FAULT_STATE);
+            }
+            stillDriving = false;
+        }
+    }
+
+    if (stillDriving)
+    {
+        // Follow any slow drift of the neutral while the joystick rests.
+        NeutralTrackerUpdate (rawSpeed, rawDirection);
+
+        // Correct the diagonals for the shape of the joystick's gate.
+        GateNormalise (&rawSpeed, &rawDirection);
+        g_TelemetrySample.m_FilteredSpeed = rawSpeed;
+        g_TelemetrySample.m_FilteredDirection = rawDirection;
 
         // Process the Joystick Speed signal
         if (rawSpeed > Joystick_Data[SPEED_ARRAY].m_rawMaxNuetral)
         {
-            if (rawSpeed > (Joystick_Data[SPEED_ARRAY].m_PositiveScale + Joystick_Data[SPEED_ARRAY].m_rawNeutral))
-                rawSpeed = Joystick_Data[SPEED_ARRAY].m_PositiveScale + Joystick_Data[SPEED_ARRAY].m_rawNeutral;
-            demand = (float) NEUTRAL_DEMAND_OUTPUT; 
-            offset = rawSpeed - Joystick_Data[SPEED_ARRAY].m_rawNeutral;
-            offset = (offset / (float)Joystick_Data[SPEED_ARRAY].m_PositiveScale) * 630.0f;
-            demand += offset;
-            int_SpeedDemand = (uint16_t) demand;
+            if (rawSpeed > Joystick_Thresholds[SPEED_ARRAY].m_ClampMaximum)
+                rawSpeed = Joystick_Thresholds[SPEED_ARRAY].m_ClampMaximum;
+            int_SpeedDemand = g_NeutralDemand
+                + DemandOffset (rawSpeed - Joystick_Data[SPEED_ARRAY].m_rawNeutral, Joystick_Thresholds[SPEED_ARRAY].m_PositiveInverse);
         }
         else if (rawSpeed < Joystick_Data[SPEED_ARRAY].m_rawMinNeutral)
         {
             if (IsSW2_1_Closed() == false)  // Are we using Reverse as a Mode Switch? NO!
             {
-                if (rawSpeed < (Joystick_Data[SPEED_ARRAY].m_rawNeutral - Joystick_Data[SPEED_ARRAY].m_NegativeScale))
-                    rawSpeed = Joystick_Data[SPEED_ARRAY].m_rawNeutral - Joystick_Data[SPEED_ARRAY].m_NegativeScale;
-                demand = (float) NEUTRAL_DEMAND_OUTPUT; 
-                offset = Joystick_Data[SPEED_ARRAY].m_rawNeutral - rawSpeed;
-                offset = (offset / (float) Joystick_Data[SPEED_ARRAY].m_NegativeScale) * 630.0f;
-                demand -= offset;
-                int_SpeedDemand = (uint16_t) demand;
+                if (rawSpeed < Joystick_Thresholds[SPEED_ARRAY].m_ClampMinimum)
+                    rawSpeed = Joystick_Thresholds[SPEED_ARRAY].m_ClampMinimum;
+                int_SpeedDemand = g_NeutralDemand
+                    - DemandOffset (Joystick_Data[SPEED_ARRAY].m_rawNeutral - rawSpeed, Joystick_Thresholds[SPEED_ARRAY].m_NegativeInverse);
             }
         }
         // Process the Joystick Directional signal
         if (rawDirection > Joystick_Data[DIRECTION_ARRAY].m_rawMaxNuetral)
         {
             // Check to see if the joystick is past the calibrated value.
-            if (rawDirection > (Joystick_Data[DIRECTION_ARRAY].m_PositiveScale + Joystick_Data[DIRECTION_ARRAY].m_rawNeutral))
-                rawDirection = Joystick_Data[DIRECTION_ARRAY].m_PositiveScale + Joystick_Data[DIRECTION_ARRAY].m_rawNeutral;
-            demand = (float) NEUTRAL_DEMAND_OUTPUT; 
-            offset = rawDirection - Joystick_Data[DIRECTION_ARRAY].m_rawNeutral;
-            offset = (offset / (float)Joystick_Data[DIRECTION_ARRAY].m_PositiveScale) * 630.0f;
-            demand += offset;
-            int_DirectionDemand = (uint16_t) demand;
+            if (rawDirection > Joystick_Thresholds[DIRECTION_ARRAY].m_ClampMaximum)
+                rawDirection = Joystick_Thresholds[DIRECTION_ARRAY].m_ClampMaximum;
+            int_DirectionDemand = g_NeutralDemand
+                + DemandOffset (rawDirection - Joystick_Data[DIRECTION_ARRAY].m_rawNeutral, Joystick_Thresholds[DIRECTION_ARRAY].m_PositiveInverse);
         }
         else if (rawDirection < Joystick_Data[DIRECTION_ARRAY].m_rawMinNeutral)
         {
             // Check to see if the joystick is past the calibrated value.
-            if (rawDirection < (Joystick_Data[DIRECTION_ARRAY].m_rawNeutral - Joystick_Data[DIRECTION_ARRAY].m_NegativeScale))
-                rawDirection = Joystick_Data[DIRECTION_ARRAY].m_rawNeutral - Joystick_Data[DIRECTION_ARRAY].m_NegativeScale;
-            demand = (float) NEUTRAL_DEMAND_OUTPUT; 
-            offset = Joystick_Data[DIRECTION_ARRAY].m_rawNeutral - rawDirection;
-            offset = (offset / (float)Joystick_Data[DIRECTION_ARRAY].m_NegativeScale) * 630.0f;
-            demand -= offset;
-            int_DirectionDemand = (uint16_t) demand;
+            if (rawDirection < Joystick_Thresholds[DIRECTION_ARRAY].m_ClampMinimum)
+                rawDirection = Joystick_Thresholds[DIRECTION_ARRAY].m_ClampMinimum;
+            int_DirectionDemand = g_NeutralDemand
+                - DemandOffset (Joystick_Data[DIRECTION_ARRAY].m_rawNeutral - rawDirection, Joystick_Thresholds[DIRECTION_ARRAY].m_NegativeInverse);
         }
     }
     
@@ -392,6 +614,13 @@ static void DrivingState (void)
     SetTPI_Demands (int_SpeedDemand, int_DirectionDemand);
 }
 
+//------------------------------------------------------------------------------
+
+static void LeaveDrivingState (void)
+{
+    RecordNeutralDrift();
+}
+
 //------------------------------------------------------------------------------
 static void AnnounceEnterBluetoothState (void)
 {
@@ -401,7 +630,7 @@ static void AnnounceEnterBluetoothState (void)
     bspDelayMs (2000);
     TurnBeeper(BEEPER_OFF);
     
-    gp_State = ENTER_BLUETOOTH_STATE;
+    ChangeState (ENTER_BLUETOOTH_STATE);
 }
 
 //------------------------------------------------------------------------------
@@ -409,7 +638,10 @@ static void EnterBluetoothState (void)
 {
     if (IsUserPortButtonActive() == false)
     {
-        gp_State = BLUETOOTH_STATE;
+        g_BtModeButtonLatched = IsCalibrationButtonActive();
+        BluetoothPdmReset();
+        FailsafeReset();
+        ChangeState (BLUETOOTH_STATE);
     }
 }
 
@@ -418,91 +650,340 @@ static void EnterBluetoothState (void)
 static void BluetoothControlState (void)
 {
     uint16_t rawSpeed, rawDirection;
+    uint8_t btSignals, faults;
+    uint8_t duty[BT_PDM_NUM_DIRECTIONS];
 
-    if (IsUserPortButtonActive())
+    if (IsUserPortButtonActive() || (g_Gesture == GESTURE_DOUBLE_FLICK))
     {
         DisableBluetooth();
-        gp_State = ANNOUNCE_ENTER_DRIVING_STATE; // This checks for neutral and no switches
-                                        // ... before allowing to drive
+        ChangeState (ANNOUNCE_ENTER_DRIVING_STATE); // This checks for neutral and no switches
+                                                    // ... before allowing to drive
     }
     
-    if (IsMouseRightClickActive ())
+    // The Calibration button toggles between switched and proportional
+    // cursor speed. The beeper sounds while the button is held and the
+    // choice is kept in the EEPROM.
+    if (IsCalibrationButtonActive())
     {
-        SendBlueToothSignal (LEFT_CLICK_OUT, GPIO_LOW);
+        if (g_BtModeButtonLatched == false)
+        {
+            g_BtModeButtonLatched = true;
+            g_BtProportional = (g_BtProportional ? false : true);
+            g_BtModeBytesToSave = 2;    // Saved by SaveBtModeService().
+            BluetoothPdmReset();
+            TurnBeeper(BEEPER_ON);
+        }
     }
-    else
+    else if (g_BtModeButtonLatched)
     {
-        SendBlueToothSignal (LEFT_CLICK_OUT, GPIO_HIGH);
+        g_BtModeButtonLatched = false;
+        TurnBeeper(BEEPER_OFF);
     }
-    
-    // Determine which joystick direction is active and send signal
-    // to Bluetooth module.
-    GetSpeedAndDirection (&rawSpeed, &rawDirection);
 
-    // Process SPEED demand
-    if (rawSpeed > (Joystick_Data[SPEED_ARRAY].m_rawNeutral + (Joystick_Data[SPEED_ARRAY].m_PositiveScale / 2)))
+    // Collect all of the active outputs and send them to the Bluetooth
+    // module in one go.
+    btSignals = 0;
+
+    if (IsMouseRightClickActive ())
     {
-        SendBlueToothSignal (FWD_BT, GPIO_LOW); // Forward is active
+        btSignals |= BT_LEFT_CLICK_OUT_MASK;
     }
-    else
+    
+    // Determine which joystick direction is active and send signal
+    // to Bluetooth module.
+    rawSpeed = g_RawSpeed;
+    rawDirection = g_RawDirection;
+    g_TelemetrySample.m_RawSpeed = rawSpeed;
+    g_TelemetrySample.m_RawDirection = rawDirection;
+    g_TelemetrySample.m_FilteredSpeed = rawSpeed;
+    g_TelemetrySample.m_FilteredDirection = rawDirection;
+
+    // As when driving, a reading that is not believable moves nothing.
+    faults = FailsafeCheck (rawSpeed, rawDirection);
+    if (faults != FAULT_NONE)
     {
-        SendBlueToothSignal (FWD_BT, GPIO_HIGH);    // Forward is NOT active
+        BlackBoxRecord (BLACKBOX_EVENT_FAULT, faults);
+        if (IsFailsafeLatched())
+        {
+            BlackBoxRecord (BLACKBOX_EVENT_FAULT_LATCHED, GetFailsafeCause());
+            BlackBoxFlush (BLACKBOX_CAUSE_FAULT);
+            TurnBeeper(BEEPER_OFF);
+            ChangeState (FAULT_STATE);
+        }
+        SendBlueToothSignals (btSignals & ~(BT_FWD_MASK | BT_REV_MASK | BT_LEFT_MASK | BT_RIGHT_MASK));
+        return;
     }
 
-    if (rawSpeed < (Joystick_Data[SPEED_ARRAY].m_rawNeutral - (Joystick_Data[SPEED_ARRAY].m_NegativeScale / 2)))
+    if (g_BtProportional)
     {
-        SendBlueToothSignal (REV_BT, GPIO_LOW); // Reverse is active
+        // The further the joystick is past the neutral window, the more
+        // often the direction output is active.
+        duty[BT_PDM_FWD] = 0;
+        duty[BT_PDM_REV] = 0;
+        duty[BT_PDM_LEFT] = 0;
+        duty[BT_PDM_RIGHT] = 0;
+
+        if (rawSpeed > Joystick_Data[SPEED_ARRAY].m_rawMaxNuetral)
+            duty[BT_PDM_FWD] = BluetoothDuty (rawSpeed - Joystick_Data[SPEED_ARRAY].m_rawMaxNuetral,
+                                              Joystick_Thresholds[SPEED_ARRAY].m_PositiveRange);
+        else if (rawSpeed < Joystick_Data[SPEED_ARRAY].m_rawMinNeutral)
+            duty[BT_PDM_REV] = BluetoothDuty (Joystick_Data[SPEED_ARRAY].m_rawMinNeutral - rawSpeed,
+                                              Joystick_Thresholds[SPEED_ARRAY].m_NegativeRange);
+
+        if (rawDirection > Joystick_Data[DIRECTION_ARRAY].m_rawMaxNuetral)
+            duty[BT_PDM_RIGHT] = BluetoothDuty (rawDirection - Joystick_Data[DIRECTION_ARRAY].m_rawMaxNuetral,
+                                                Joystick_Thresholds[DIRECTION_ARRAY].m_PositiveRange);
+        else if (rawDirection < Joystick_Data[DIRECTION_ARRAY].m_rawMinNeutral)
+            duty[BT_PDM_LEFT] = BluetoothDuty (Joystick_Data[DIRECTION_ARRAY].m_rawMinNeutral - rawDirection,
+                                               Joystick_Thresholds[DIRECTION_ARRAY].m_NegativeRange);
+
+        btSignals |= BluetoothPdmSignals (duty);
     }
     else
     {
-        SendBlueToothSignal (REV_BT, GPIO_HIGH);    // Reverse is not active
+        // Process SPEED demand
+        if (rawSpeed > Joystick_Thresholds[SPEED_ARRAY].m_HalfPositive)
+        {
+            btSignals |= BT_FWD_MASK;   // Forward is active
+        }
+
+        if (rawSpeed < Joystick_Thresholds[SPEED_ARRAY].m_HalfNegative)
+        {
+            btSignals |= BT_REV_MASK;   // Reverse is active
+        }
+
+        // Process DIRECTION demand
+        if (rawDirection > Joystick_Thresholds[DIRECTION_ARRAY].m_HalfPositive)
+        {
+            btSignals |= BT_RIGHT_MASK; // Right is active
+        }
+
+        if (rawDirection < Joystick_Thresholds[DIRECTION_ARRAY].m_HalfNegative)
+        {
+            btSignals |= BT_LEFT_MASK;  // Left is active
+        }
     }
-        
-    // Process DIRECTION demand
-    if (rawDirection > (Joystick_Data[DIRECTION_ARRAY].m_rawNeutral + (Joystick_Data[DIRECTION_ARRAY].m_PositiveScale / 2)))
+
+    SendBlueToothSignals (btSignals);
+}
+
+//------------------------------------------------------------------------------
+// The joystick readings failed the failsafe checks for too long. The drive
+// demands are held at neutral, the Bluetooth outputs are released and the
+// beeper chirps until the power is cycled.
+//------------------------------------------------------------------------------
+
+static void FaultState (void)
+{
+    SetTPI_Demands (g_NeutralDemand, g_NeutralDemand);
+    SendBlueToothSignals (0);
+
+    if ((bspGetSysTick() & (FAULT_CHIRP_PERIOD_MS - 1)) < FAULT_CHIRP_MS)
+        TurnBeeper(BEEPER_ON);
+    else
+        TurnBeeper(BEEPER_OFF);
+}
+
+//------------------------------------------------------------------------------
+// This function returns true while the Mode button is pressed, or the
+// joystick is held in reverse with SW2-1 closed.
+//------------------------------------------------------------------------------
+
+static bool IsModeActive (void)
+{
+    return (IsModeButtonActive() || IsReverseHeld());
+}
+
+//------------------------------------------------------------------------------
+// This function asks for a move to another state. The last call before the
+// handler returns wins.
+//------------------------------------------------------------------------------
+
+static void ChangeState (enum STATE_ENUM next)
+{
+    g_NextState = next;
+}
+
+//------------------------------------------------------------------------------
+// This function runs the current state for one pass: it takes any move
+// asked for since the last pass, runs the state's tick handler and takes
+// any move that asked for.
+//------------------------------------------------------------------------------
+
+static void RunStateMachine (void)
+{
+    FollowTransitions();
+
+    if (g_StateHandlers[gp_State].m_Tick != NULL)
+        g_StateHandlers[gp_State].m_Tick();
+
+    FollowTransitions();
+}
+
+//------------------------------------------------------------------------------
+// This function moves to the state asked for: the old state's exit handler,
+// then the new state's entry handler. An entry handler may ask for another
+// move, which is followed at once, up to STATE_MAX_CHAIN moves.
+//------------------------------------------------------------------------------
+
+static void FollowTransitions (void)
+{
+    enum STATE_ENUM next;
+    uint8_t i;
+
+    for (i = 0; (i < STATE_MAX_CHAIN) && (g_NextState != NO_STATE); ++i)
     {
-        SendBlueToothSignal (RIGHT_BT, GPIO_LOW);   // Right is active
+        next = g_NextState;
+        g_NextState = NO_STATE;
+
+        if (g_StateHandlers[gp_State].m_Exit != NULL)
+            g_StateHandlers[gp_State].m_Exit();
+
+        gp_State = next;
+        g_StateMoved = true;
+        if (g_StateTraceHook != NULL)
+            g_StateTraceHook ((uint8_t) next);
+
+        if (g_StateHandlers[next].m_Entry != NULL)
+            g_StateHandlers[next].m_Entry();
     }
-    else
+}
+
+//------------------------------------------------------------------------------
+// This function is the state trace hook. Each new state goes in the black
+// box, which stamps it with the system tick.
+//------------------------------------------------------------------------------
+
+static void TraceStateChange (uint8_t state)
+{
+    BlackBoxRecord (BLACKBOX_EVENT_STATE, state);
+}
+
+//------------------------------------------------------------------------------
+// This function puts the neutral drift followed while driving, see
+// NeutralTrackerUpdate(), in the black box for each axis whose drift has
+// changed since it was last put there. It runs on leaving the driving state,
+// before the black box copy of a fault there is taken.
+//------------------------------------------------------------------------------
+
+static void RecordNeutralDrift (void)
+{
+    uint8_t axis;
+    int8_t drift;
+
+    for (axis = 0; axis < NUM_JS_POTS; ++axis)
     {
-        SendBlueToothSignal (RIGHT_BT, GPIO_HIGH);  // Right is NOT active
+        drift = (int8_t) GetNeutralDrift (axis);    // At most NEUTRAL_DRIFT_LIMIT.
+        if (drift != g_RecordedDrift[axis])
+        {
+            g_RecordedDrift[axis] = drift;
+            BlackBoxRecord ((axis == SPEED_ARRAY) ? BLACKBOX_EVENT_SPEED_DRIFT : BLACKBOX_EVENT_DIRECTION_DRIFT,
+                            (uint8_t) drift);
+        }
     }
-        
-    if (rawDirection < (Joystick_Data[DIRECTION_ARRAY].m_rawNeutral - (Joystick_Data[DIRECTION_ARRAY].m_NegativeScale / 2)))
+}
+
+//------------------------------------------------------------------------------
+// This function saves the diagnostics to the EEPROM for reading back with
+// the programmer. It blocks while the loop timing is written, the black box
+// follows in the background.
+//------------------------------------------------------------------------------
+
+static void SaveDiagnostics (void)
+{
+    LoopTimingSave (EEPROM_LOOP_TIMING);
+    BlackBoxFlush (BLACKBOX_CAUSE_REQUEST);
+}
+
+//------------------------------------------------------------------------------
+// This function saves the Bluetooth cursor mode a byte per pass once it has
+// been toggled, so the loop and the cursor outputs never wait on the
+// EEPROM. A byte the EEPROM is too busy to take is tried on the next pass.
+//------------------------------------------------------------------------------
+
+static void SaveBtModeService (void)
+{
+    uint16_t mode;
+
+    if (g_BtModeBytesToSave == 0)
+        return;
+
+    mode = (g_BtProportional ? EEPROM_BT_MODE_PROPORTIONAL : 0);
+    if (g_BtModeBytesToSave == 2)
     {
-        SendBlueToothSignal (LEFT_BT, GPIO_LOW);    // Left is active
+        if (EEPROM_tryWriteByte (EEPROM_BT_MODE, (uint8_t) mode))
+            g_BtModeBytesToSave = 1;
     }
-    else
+    else if (EEPROM_tryWriteByte (EEPROM_BT_MODE + 1, (uint8_t) (mode >> 8)))
     {
-        SendBlueToothSignal (LEFT_BT, GPIO_HIGH);    // Left is NOT active
+        g_BtModeBytesToSave = 0;
     }
 }
 
+//------------------------------------------------------------------------------
+// This function collects the TELEMETRY_FLAG_xxx bits for the telemetry stream.
+//------------------------------------------------------------------------------
+
+static uint8_t TelemetryFlags (void)
+{
+    uint8_t flags;
+
+    flags = GetFailsafeCause() & TELEMETRY_FLAG_FAULT_MASK;
+    if (IsGateValid())
+        flags |= TELEMETRY_FLAG_GATE;
+    if (g_BtProportional)
+        flags |= TELEMETRY_FLAG_BT_PROPORTIONAL;
+    if (IsFailsafeLatched())
+        flags |= TELEMETRY_FLAG_FAULT_LATCHED;
+
+    return flags;
+}
+
+//------------------------------------------------------------------------------
+// This function returns the Bluetooth PDM duty for a deflection past the
+// neutral window. "range" is the usable travel on that side of neutral,
+// see Joystick_Thresholds. The result is 0 to BT_PDM_FULL_SCALE.
+//------------------------------------------------------------------------------
+
+static uint8_t BluetoothDuty (uint16_t deflection, uint16_t range)
+{
+    if (deflection >= range)
+        return BT_PDM_FULL_SCALE;
+
+    return (uint8_t) ((deflection * BT_PDM_FULL_SCALE) / range);
+}
+
 //------------------------------------------------------------------------------
 
 static void EnterModeChangeState (void)
 {
     SetResetOutput (GPIO_HIGH);
-    gp_State = MODE_CHANGE_STATE;
+    ChangeState (MODE_CHANGE_STATE);
 }
 
 //------------------------------------------------------------------------------
 
 static void ModeChangeState (void)
 {
-    if (IsModeButtonActive() == false)
+    if (IsModeActive() == false)
     {
-        gp_State = EXIT_MODE_CHANGE_STATE;
-        SetResetOutput (GPIO_LOW);
+        ChangeState (EXIT_MODE_CHANGE_STATE);
     }
 }
 
 //------------------------------------------------------------------------------
 
+static void LeaveModeChangeState (void)
+{
+    SetResetOutput (GPIO_LOW);
+}
+
+//------------------------------------------------------------------------------
+
 static void ExitModeChangeState (void)
 {
-    gp_State = ENTER_DRIVING_STATE; // This checks for neutral and no switches
-                                    // ... before allowing to drive
+    ChangeState (ENTER_DRIVING_STATE); // This checks for neutral and no switches
+                                       // ... before allowing to drive
 }
 
 //------------------------------------------------------------------------------
@@ -516,15 +997,17 @@ static void EnterCalibrationState(void)
     if (IsCalibrationButtonActive() == false)
     {
         TurnBeeper(BEEPER_OFF);
-        if (IsJoystickInNeutral())
+        if (IsInNeutralWindow (g_RawSpeed, g_RawDirection))
         {
             // Preset the min and max to very small.
-            Joystick_Data[SPEED_ARRAY].m_rawMaximum = Joystick_Data[SPEED_ARRAY].m_rawNeutral;
-            Joystick_Data[SPEED_ARRAY].m_rawMinimum = Joystick_Data[SPEED_ARRAY].m_rawNeutral;
-            Joystick_Data[DIRECTION_ARRAY].m_rawMaximum = Joystick_Data[DIRECTION_ARRAY].m_rawNeutral;
-            Joystick_Data[DIRECTION_ARRAY].m_rawMinimum = Joystick_Data[DIRECTION_ARRAY].m_rawNeutral;
+            Joystick_Calibration[SPEED_ARRAY].m_rawMaximum = Joystick_Data[SPEED_ARRAY].m_rawNeutral;
+            Joystick_Calibration[SPEED_ARRAY].m_rawMinimum = Joystick_Data[SPEED_ARRAY].m_rawNeutral;
+            Joystick_Calibration[DIRECTION_ARRAY].m_rawMaximum = Joystick_Data[DIRECTION_ARRAY].m_rawNeutral;
+            Joystick_Calibration[DIRECTION_ARRAY].m_rawMinimum = Joystick_Data[DIRECTION_ARRAY].m_rawNeutral;
+            GateCalibrationStart();
+            g_CalibrationExitArmed = false;
             
-            gp_State = DO_JOYSTICK_CALIBRATION_STATE;
+            ChangeState (DO_JOYSTICK_CALIBRATION_STATE);
         }
     }
 }
@@ -532,8 +1015,9 @@ static void EnterCalibrationState(void)
 //------------------------------------------------------------------------------
 // This function processes the Joystick Signals looking for the Smallest and 
 // largest Speed and Direction ADC values.
-// This function changes state when the Calibration Button is pressed again
-// and then values are stored in the EEPROM.
+// This function changes state when the Calibration Button is pressed again,
+// or the joystick is held out to one side and let back to neutral, and then
+// values are stored in the EEPROM.
 //------------------------------------------------------------------------------
 static void JoystickCalibrationState(void)
 {
@@ -541,35 +1025,39 @@ static void JoystickCalibrationState(void)
     
     // Get the Joystick's Speed and Direction and seek the lowest and highest
     // signals.
-    GetSpeedAndDirection (&rawSpeed, &rawDirection);
+    rawSpeed = g_RawSpeed;
+    rawDirection = g_RawDirection;
     
-    if (rawSpeed > Joystick_Data[SPEED_ARRAY].m_rawMaximum)
-        Joystick_Data[SPEED_ARRAY].m_rawMaximum = rawSpeed;
-    if (rawSpeed < Joystick_Data[SPEED_ARRAY].m_rawMinimum)
-        Joystick_Data[SPEED_ARRAY].m_rawMinimum = rawSpeed;
+    if (rawSpeed > Joystick_Calibration[SPEED_ARRAY].m_rawMaximum)
+        Joystick_Calibration[SPEED_ARRAY].m_rawMaximum = rawSpeed;
+    if (rawSpeed < Joystick_Calibration[SPEED_ARRAY].m_rawMinimum)
+        Joystick_Calibration[SPEED_ARRAY].m_rawMinimum = rawSpeed;
     
-    if (rawDirection > Joystick_Data[DIRECTION_ARRAY].m_rawMaximum)
-        Joystick_Data[DIRECTION_ARRAY].m_rawMaximum = rawDirection;
-    if (rawDirection < Joystick_Data[DIRECTION_ARRAY].m_rawMinimum)
-        Joystick_Data[DIRECTION_ARRAY].m_rawMinimum = rawDirection;
+    if (rawDirection > Joystick_Calibration[DIRECTION_ARRAY].m_rawMaximum)
+        Joystick_Calibration[DIRECTION_ARRAY].m_rawMaximum = rawDirection;
+    if (rawDirection < Joystick_Calibration[DIRECTION_ARRAY].m_rawMinimum)
+        Joystick_Calibration[DIRECTION_ARRAY].m_rawMinimum = rawDirection;
+
+    // And the furthest the joystick goes in each direction around the gate.
+    GateCalibrationSample (rawSpeed, rawDirection);
     
     // Check to see if we want to exit the procedure.
-    if (IsCalibrationButtonActive())
+    if (IsCalibrationButtonActive() || IsCalibrationExitGesture())
     {
         // Calculate the scales and store them in EEPROM and perform and "extreme" evaluation
-        Joystick_Data[SPEED_ARRAY].m_PositiveScale = Joystick_Data[SPEED_ARRAY].m_rawMaximum - Joystick_Data[SPEED_ARRAY].m_rawNeutral;
+        Joystick_Data[SPEED_ARRAY].m_PositiveScale = Joystick_Calibration[SPEED_ARRAY].m_rawMaximum - Joystick_Data[SPEED_ARRAY].m_rawNeutral;
         if (Joystick_Data[SPEED_ARRAY].m_PositiveScale > JOYSTICK_RAW_MAX_DEFLECTION) 
             Joystick_Data[SPEED_ARRAY].m_PositiveScale = JOYSTICK_RAW_MAX_DEFLECTION;
 
-        Joystick_Data[SPEED_ARRAY].m_NegativeScale = Joystick_Data[SPEED_ARRAY].m_rawNeutral - Joystick_Data[SPEED_ARRAY].m_rawMinimum;
+        Joystick_Data[SPEED_ARRAY].m_NegativeScale = Joystick_Data[SPEED_ARRAY].m_rawNeutral - Joystick_Calibration[SPEED_ARRAY].m_rawMinimum;
         if (Joystick_Data[SPEED_ARRAY].m_NegativeScale > JOYSTICK_RAW_MAX_DEFLECTION) 
             Joystick_Data[SPEED_ARRAY].m_NegativeScale = JOYSTICK_RAW_MAX_DEFLECTION;
 
-        Joystick_Data[DIRECTION_ARRAY].m_PositiveScale = Joystick_Data[DIRECTION_ARRAY].m_rawMaximum - Joystick_Data[DIRECTION_ARRAY].m_rawNeutral;
+        Joystick_Data[DIRECTION_ARRAY].m_PositiveScale = Joystick_Calibration[DIRECTION_ARRAY].m_rawMaximum - Joystick_Data[DIRECTION_ARRAY].m_rawNeutral;
         if (Joystick_Data[DIRECTION_ARRAY].m_PositiveScale > JOYSTICK_RAW_MAX_DEFLECTION) 
             Joystick_Data[DIRECTION_ARRAY].m_PositiveScale = JOYSTICK_RAW_MAX_DEFLECTION;
 
-        Joystick_Data[DIRECTION_ARRAY].m_NegativeScale = Joystick_Data[DIRECTION_ARRAY].m_rawNeutral - Joystick_Data[DIRECTION_ARRAY].m_rawMinimum;
+        Joystick_Data[DIRECTION_ARRAY].m_NegativeScale = Joystick_Data[DIRECTION_ARRAY].m_rawNeutral - Joystick_Calibration[DIRECTION_ARRAY].m_rawMinimum;
         if (Joystick_Data[DIRECTION_ARRAY].m_NegativeScale > JOYSTICK_RAW_MAX_DEFLECTION) 
             Joystick_Data[DIRECTION_ARRAY].m_NegativeScale = JOYSTICK_RAW_MAX_DEFLECTION;
 
@@ -580,16 +1068,41 @@ static void JoystickCalibrationState(void)
         EEPROM_writeInt16 (EEPROM_DIRECTION_LOWER_SCALE, Joystick_Data[DIRECTION_ARRAY].m_NegativeScale);
         EEPROM_writeInt16 (EEPROM_DIRECTION_UPPER_SCALE, Joystick_Data[DIRECTION_ARRAY].m_PositiveScale);
 
+        UpdateJoystickThresholds();
+        GateCalibrationFinish (EEPROM_GATE_TABLE);
+
         EEPROM_writeInt16 (EEPROM_1st_CHECK, EEPROM_VALID_DATA1);
         EEPROM_writeInt16 (EEPROM_2nd_CHECK, EEPROM_VALID_DATA2);
+        BlackBoxRecord (BLACKBOX_EVENT_CALIBRATION, IsGateValid());
 
         TurnBeeper(BEEPER_ON);
 
-        gp_State = EXIT_JOYSTICK_CALIBRATION_STATE;
+        ChangeState (EXIT_JOYSTICK_CALIBRATION_STATE);
     }
     
 }
 
+//------------------------------------------------------------------------------
+// The hold gesture ends a calibration as the Calibration button does, but
+// the joystick is out to one side when it is seen, and a stop on the way
+// round the gate would end the calibration half done. So it only counts once
+// the joystick has gone at least CALIBRATION_MIN_SCALE every way, and the
+// calibration ends when the joystick is next back in neutral.
+//------------------------------------------------------------------------------
+static bool IsCalibrationExitGesture (void)
+{
+    if ((g_Gesture == GESTURE_HOLD_DIRECTION)
+        && ((Joystick_Calibration[SPEED_ARRAY].m_rawMaximum - Joystick_Data[SPEED_ARRAY].m_rawNeutral) >= CALIBRATION_MIN_SCALE)
+        && ((Joystick_Data[SPEED_ARRAY].m_rawNeutral - Joystick_Calibration[SPEED_ARRAY].m_rawMinimum) >= CALIBRATION_MIN_SCALE)
+        && ((Joystick_Calibration[DIRECTION_ARRAY].m_rawMaximum - Joystick_Data[DIRECTION_ARRAY].m_rawNeutral) >= CALIBRATION_MIN_SCALE)
+        && ((Joystick_Data[DIRECTION_ARRAY].m_rawNeutral - Joystick_Calibration[DIRECTION_ARRAY].m_rawMinimum) >= CALIBRATION_MIN_SCALE))
+    {
+        g_CalibrationExitArmed = true;
+    }
+
+    return g_CalibrationExitArmed && IsInNeutralWindow (g_RawSpeed, g_RawDirection);
+}
+
 //------------------------------------------------------------------------------
 
 static void ExitCalibrationState(void)
@@ -597,33 +1110,58 @@ static void ExitCalibrationState(void)
     if (IsCalibrationButtonActive() == false)
     {
         TurnBeeper(BEEPER_OFF);
-        gp_State = POWERUP_STATE;   // This will re-establish the "smart neutral" window.
+        ChangeState (POWERUP_STATE); // This will re-establish the "smart neutral" window.
     }
 }
 
 //------------------------------------------------------------------------------
 // This functions sends the Demands to the TPI board via the DAC's.
 // Also perform a min and max text.
+// Whatever the caller asks for, the demands are only allowed off neutral in
+// the driving state with the Calibration and User Port buttons released.
+// The callers already see to that, so g_DemandGuardTrips should stay 0.
 //------------------------------------------------------------------------------
 
 static void SetTPI_Demands (uint16_t speedDemand, uint16_t directionDemand)
 {
     uint16_t mySpeed, myDirection;
     
+    if (((speedDemand != g_NeutralDemand) || (directionDemand != g_NeutralDemand))
+        && ((gp_State != DRIVING_STATE) || IsCalibrationButtonActive() || IsUserPortButtonActive()))
+    {
+        speedDemand = g_NeutralDemand;
+        directionDemand = g_NeutralDemand;
+        if (g_DemandGuardTrips != 0xff)
+            ++g_DemandGuardTrips;
+    }
+
     mySpeed = speedDemand;
-    if (mySpeed > MAX_DAC_OUTPUT)
-        mySpeed = MAX_DAC_OUTPUT;
-    if (mySpeed < MIN_DAC_OUTPUT)
-        mySpeed = MIN_DAC_OUTPUT;
+    if (mySpeed > g_MaxDacOutput)
+        mySpeed = g_MaxDacOutput;
+    if (mySpeed < g_MinDacOutput)
+        mySpeed = g_MinDacOutput;
     
     myDirection = directionDemand;
-    if (myDirection > MAX_DAC_OUTPUT)
-        myDirection = MAX_DAC_OUTPUT;
-    if (myDirection < MIN_DAC_OUTPUT)
-        myDirection = MIN_DAC_OUTPUT;
+    if (myDirection > g_MaxDacOutput)
+        myDirection = g_MaxDacOutput;
+    if (myDirection < g_MinDacOutput)
+        myDirection = g_MinDacOutput;
 
     dacBspSet (DAC_SELECT_FORWARD_BACKWARD, mySpeed);
     dacBspSet (DAC_SELECT_LEFT_RIGHT, myDirection);
+
+    g_TelemetrySample.m_SpeedDemand = mySpeed;
+    g_TelemetrySample.m_DirectionDemand = myDirection;
+}
+
+//------------------------------------------------------------------------------
+// Returns the number of demands SetTPI_Demands() has had to force to neutral,
+// up to 0xff. Its callers should never leave it anything to do, so this is 0
+// unless one of them is wrong.
+//------------------------------------------------------------------------------
+uint8_t GetDemandGuardTrips (void)
+{
+    return g_DemandGuardTrips;
 }
 
 //------------------------------------------------------------------------------
@@ -633,29 +1171,229 @@ static void SetTPI_Demands (uint16_t speedDemand, uint16_t directionDemand)
 
 static void EstablishJoystickNeutral(void)
 {
-    uint16_t speed, direction;
-    
-    if (IsJoystickInNeutral())
+    if (IsInNeutralWindow (g_RawSpeed, g_RawDirection))
     {
-        GetSpeedAndDirection (&speed, &direction);
-        
-        // Setup Speed Neutral Window and Limits
-        Joystick_Data[SPEED_ARRAY].m_rawInput = speed;
-        Joystick_Data[SPEED_ARRAY].m_rawNeutral = speed;
-        Joystick_Data[SPEED_ARRAY].m_rawMinNeutral = speed - NEUTRAL_ERROR_MARGIN;
-        Joystick_Data[SPEED_ARRAY].m_rawMaxNuetral = speed + NEUTRAL_ERROR_MARGIN;
-
-        // Setup Direction Neutral Window and Limits
-        Joystick_Data[DIRECTION_ARRAY].m_rawInput = direction;
-        Joystick_Data[DIRECTION_ARRAY].m_rawNeutral = direction;
-        Joystick_Data[DIRECTION_ARRAY].m_rawMinNeutral = direction - NEUTRAL_ERROR_MARGIN;
-        Joystick_Data[DIRECTION_ARRAY].m_rawMaxNuetral = direction + NEUTRAL_ERROR_MARGIN;
+        SetJoystickNeutral (g_RawSpeed, g_RawDirection);
         
-        gp_State = ENTER_DRIVING_STATE;
+        ChangeState (ENTER_DRIVING_STATE);
     }
             
 }
 
+//------------------------------------------------------------------------------
+// This function sets up the Neutral Window around the given neutral inputs.
+//------------------------------------------------------------------------------
+
+static void SetJoystickNeutral (uint16_t speed, uint16_t direction)
+{
+    // Setup Speed Neutral Window and Limits
+    Joystick_Calibration[SPEED_ARRAY].m_rawInput = speed;
+    Joystick_Data[SPEED_ARRAY].m_rawNeutral = speed;
+    Joystick_Data[SPEED_ARRAY].m_rawMinNeutral = speed - GetNeutralMargin();
+    Joystick_Data[SPEED_ARRAY].m_rawMaxNuetral = speed + GetNeutralMargin();
+
+    // Setup Direction Neutral Window and Limits
+    Joystick_Calibration[DIRECTION_ARRAY].m_rawInput = direction;
+    Joystick_Data[DIRECTION_ARRAY].m_rawNeutral = direction;
+    Joystick_Data[DIRECTION_ARRAY].m_rawMinNeutral = direction - GetNeutralMargin();
+    Joystick_Data[DIRECTION_ARRAY].m_rawMaxNuetral = direction + GetNeutralMargin();
+
+    UpdateJoystickThresholds();
+    NeutralTrackerReset();
+}
+
+//------------------------------------------------------------------------------
+// This function runs the power up sequence. Instead of a fixed delay followed
+// by the beeps and then the neutral search, these all run together, paced by
+// the system tick:
+//  - the EEPROM data is checked first, it only takes a moment,
+//  - the start up beep (on, off, on if the EEPROM data is bad) plays,
+//  - the first few ADC readings are discarded while the ADC settles,
+//  - the joystick neutral is averaged once it is steady in the neutral window,
+//  - the joystick type, and so the neutral window, is found from the
+//    readings at rest, steady or not (see JoystickType.c).
+// It returns once the beeps are done, BOOT_MIN_SETTLE_MS has passed and the
+// joystick has been steady for BOOT_STABLE_SAMPLES readings. A joystick too
+// noisy to ever be that steady is given until BOOT_MAX_SETTLE_MS, the old
+// fixed delay, and then its neutral is averaged from BOOT_STABLE_SAMPLES
+// readings in a row in the neutral window, steady or not. The DACs are left
+// at neutral until then.
+//------------------------------------------------------------------------------
+
+static void BootSequence (void)
+{
+    bool eepromStatus;
+    bool beepDone, settled;
+    uint16_t btMode, curve, gestures;
+    uint16_t start, elapsed;
+    uint16_t speed, direction, lastSpeed, lastDirection;
+    uint16_t speedTotal, directionTotal, restSpeedTotal, restDirectionTotal;
+    uint8_t warmupCount, stableCount, restCount;
+    bool timedOut;
+#if JOYSTICK_AUTO_DETECT
+    uint16_t storedType;
+    uint8_t type;
+#endif
+
+    start = bspGetSysTick();
+
+    eepromStatus = InitializeJoystickData();
+    EEPROM_readInt16 (EEPROM_BT_MODE, &btMode);
+    g_BtProportional = (btMode == EEPROM_BT_MODE_PROPORTIONAL);
+    EEPROM_readInt16 (EEPROM_RESPONSE_CURVE, &curve);
+    SetResponseCurve ((curve < NUM_RESPONSE_CURVES) ? (uint8_t) curve : RESPONSE_CURVE_LINEAR);
+    EEPROM_readInt16 (EEPROM_GESTURES, &gestures);
+    if ((uint8_t) (gestures >> 8) == (uint8_t) ~gestures)
+        g_GestureEnables = (uint8_t) gestures & GESTURE_ENABLE_EEPROM_MASK;
+    else
+        g_GestureEnables = 0;           // Erased, only reverse hold (SW2-1).
+    g_BootTiming.m_EepromLoadedMs = bspGetSysTick();
+
+#if BOOT_MEASURE_ADC_NOISE
+    // The joystick is at rest at power up. Takes a few ms.
+    MeasureAdcNoise();
+#endif
+
+    TurnBeeper(BEEPER_ON);
+
+    beepDone = false;
+    settled = false;
+    timedOut = false;
+    warmupCount = 0;
+    stableCount = 0;
+    speedTotal = 0;
+    directionTotal = 0;
+    restCount = 0;
+    restSpeedTotal = 0;
+    restDirectionTotal = 0;
+    lastSpeed = 0;
+    lastDirection = 0;
+    JoystickTypeReset();
+
+    while ((beepDone == false) || (settled == false)
+           || ((stableCount < BOOT_STABLE_SAMPLES) && ((timedOut == false) || (restCount < BOOT_STABLE_SAMPLES))))
+    {
+        Read_User_Buttons();  // Get and debounce the User Buttons.
+
+        elapsed = bspGetSysTick() - start;
+
+        // Play the start up beep. Bad EEPROM data gets an extra beep.
+        if (beepDone == false)
+        {
+            if (eepromStatus)
+            {
+                if (elapsed >= BOOT_BEEP_MS)
+                    beepDone = true;
+            }
+            else if (elapsed >= (BOOT_BEEP_MS * 3))
+            {
+                beepDone = true;
+            }
+            else if (elapsed >= (BOOT_BEEP_MS * 2))
+            {
+                TurnBeeper(BEEPER_ON);
+            }
+            else if (elapsed >= BOOT_BEEP_MS)
+            {
+                TurnBeeper(BEEPER_OFF);
+            }
+
+            if (beepDone)
+                TurnBeeper(BEEPER_OFF);
+        }
+
+        if (elapsed >= BOOT_MIN_SETTLE_MS)
+            settled = true;
+        if (elapsed >= BOOT_MAX_SETTLE_MS)
+            timedOut = true;
+
+        GetSpeedAndDirection (&speed, &direction);
+
+        if (warmupCount < BOOT_ADC_WARMUP_SAMPLES)
+        {
+            // Throw the first readings away.
+            ++warmupCount;
+            if (warmupCount == BOOT_ADC_WARMUP_SAMPLES)
+                g_BootTiming.m_AdcWarmMs = bspGetSysTick();
+        }
+        else if (IsInNeutralWindow (speed, direction) == false)
+        {
+            // Not at rest, start over.
+            stableCount = 0;
+            speedTotal = 0;
+            directionTotal = 0;
+            restCount = 0;
+            restSpeedTotal = 0;
+            restDirectionTotal = 0;
+            JoystickTypeReset();
+        }
+        else
+        {
+            // The joystick type gets every reading at rest, its noise
+            // included, the neutral only the steady ones.
+            JoystickTypeAddReading (speed, direction);
+
+            // Kept in case the readings are never steady.
+            if (restCount < BOOT_STABLE_SAMPLES)
+            {
+                restSpeedTotal += speed;
+                restDirectionTotal += direction;
+                ++restCount;
+            }
+
+            if ((((speed > lastSpeed) ? (speed - lastSpeed) : (lastSpeed - speed)) <= g_BootStableTolerance)
+                && (((direction > lastDirection) ? (direction - lastDirection) : (lastDirection - direction)) <= g_BootStableTolerance))
+            {
+                // Average the first BOOT_STABLE_SAMPLES steady readings.
+                if (stableCount < BOOT_STABLE_SAMPLES)
+                {
+                    speedTotal += speed;
+                    directionTotal += direction;
+                    ++stableCount;
+                }
+            }
+            else
+            {
+                // Not steady, start over.
+                stableCount = 0;
+                speedTotal = 0;
+                directionTotal = 0;
+            }
+        }
+        lastSpeed = speed;
+        lastDirection = direction;
+
+        bspDelayUs (US_DELAY_100_us);
+    }
+
+    g_BootTiming.m_NeutralStableMs = bspGetSysTick();
+
+    if (stableCount < BOOT_STABLE_SAMPLES)
+    {
+        // Timed out, use the readings at rest as they are.
+        speedTotal = restSpeedTotal;
+        directionTotal = restDirectionTotal;
+    }
+
+#if JOYSTICK_AUTO_DETECT
+    // Pick the neutral window for the joystick from the readings at rest.
+    // A margin set by live tuning stays in use.
+    EEPROM_readInt16 (EEPROM_JOYSTICK_TYPE, &storedType);
+    if (((uint8_t) (storedType >> 8) != (uint8_t) ~storedType) || ((uint8_t) storedType >= NUM_JOYSTICK_TYPES))
+        storedType = JOYSTICK_TYPE_STANDARD;    // Erased, none found yet.
+
+    type = JoystickTypeClassify ((uint8_t) storedType);
+    if (type != (uint8_t) storedType)
+        EEPROM_writeInt16 (EEPROM_JOYSTICK_TYPE, ((uint16_t) (uint8_t) ~type << 8) | type);
+
+    g_AutoNeutralMargin = JoystickTypeMargin (type);
+    if (g_TunedNeutralMargin == 0)
+        SetNeutralMargin (g_AutoNeutralMargin);
+#endif
+
+    SetJoystickNeutral (speedTotal / BOOT_STABLE_SAMPLES, directionTotal / BOOT_STABLE_SAMPLES);
+}
+
 //------------------------------------------------------------------------------
 // This function sets the Joystick data information. Some is retrieved
 // from the EEPROM, i.e. Max Limits.
@@ -667,21 +1405,21 @@ bool InitializeJoystickData (void)
     uint16_t check1, check2;
     bool returnStatus = true;
     
-    Joystick_Data[SPEED_ARRAY].m_rawInput = NEUTRAL_JOYSTICK_INPUT;
+    Joystick_Calibration[SPEED_ARRAY].m_rawInput = NEUTRAL_JOYSTICK_INPUT;
     Joystick_Data[SPEED_ARRAY].m_rawNeutral = NEUTRAL_JOYSTICK_INPUT;
-    Joystick_Data[SPEED_ARRAY].m_rawMinNeutral = NEUTRAL_JOYSTICK_INPUT - NEUTRAL_ERROR_MARGIN;
-    Joystick_Data[SPEED_ARRAY].m_rawMaxNuetral = NEUTRAL_JOYSTICK_INPUT + NEUTRAL_ERROR_MARGIN;
-    Joystick_Data[SPEED_ARRAY].m_rawMinimum = NEUTRAL_JOYSTICK_INPUT - JOYSTICK_RAW_MAX_DEFLECTION;
-    Joystick_Data[SPEED_ARRAY].m_rawMaximum = NEUTRAL_JOYSTICK_INPUT + JOYSTICK_RAW_MAX_DEFLECTION;
+    Joystick_Data[SPEED_ARRAY].m_rawMinNeutral = NEUTRAL_JOYSTICK_INPUT - GetNeutralMargin();
+    Joystick_Data[SPEED_ARRAY].m_rawMaxNuetral = NEUTRAL_JOYSTICK_INPUT + GetNeutralMargin();
+    Joystick_Calibration[SPEED_ARRAY].m_rawMinimum = NEUTRAL_JOYSTICK_INPUT - JOYSTICK_RAW_MAX_DEFLECTION;
+    Joystick_Calibration[SPEED_ARRAY].m_rawMaximum = NEUTRAL_JOYSTICK_INPUT + JOYSTICK_RAW_MAX_DEFLECTION;
     Joystick_Data[SPEED_ARRAY].m_PositiveScale = JOYSTICK_RAW_MAX_DEFLECTION;
     Joystick_Data[SPEED_ARRAY].m_NegativeScale = JOYSTICK_RAW_MAX_DEFLECTION;
 
-    Joystick_Data[DIRECTION_ARRAY].m_rawInput = NEUTRAL_JOYSTICK_INPUT;
+    Joystick_Calibration[DIRECTION_ARRAY].m_rawInput = NEUTRAL_JOYSTICK_INPUT;
     Joystick_Data[DIRECTION_ARRAY].m_rawNeutral = NEUTRAL_JOYSTICK_INPUT;
-    Joystick_Data[DIRECTION_ARRAY].m_rawMinNeutral = NEUTRAL_JOYSTICK_INPUT - NEUTRAL_ERROR_MARGIN;
-    Joystick_Data[DIRECTION_ARRAY].m_rawMaxNuetral = NEUTRAL_JOYSTICK_INPUT + NEUTRAL_ERROR_MARGIN;
-    Joystick_Data[DIRECTION_ARRAY].m_rawMinimum = NEUTRAL_JOYSTICK_INPUT - JOYSTICK_RAW_MAX_DEFLECTION;
-    Joystick_Data[DIRECTION_ARRAY].m_rawMaximum = NEUTRAL_JOYSTICK_INPUT + JOYSTICK_RAW_MAX_DEFLECTION;
+    Joystick_Data[DIRECTION_ARRAY].m_rawMinNeutral = NEUTRAL_JOYSTICK_INPUT - GetNeutralMargin();
+    Joystick_Data[DIRECTION_ARRAY].m_rawMaxNuetral = NEUTRAL_JOYSTICK_INPUT + GetNeutralMargin();
+    Joystick_Calibration[DIRECTION_ARRAY].m_rawMinimum = NEUTRAL_JOYSTICK_INPUT - JOYSTICK_RAW_MAX_DEFLECTION;
+    Joystick_Calibration[DIRECTION_ARRAY].m_rawMaximum = NEUTRAL_JOYSTICK_INPUT + JOYSTICK_RAW_MAX_DEFLECTION;
     Joystick_Data[DIRECTION_ARRAY].m_PositiveScale = JOYSTICK_RAW_MAX_DEFLECTION;
     Joystick_Data[DIRECTION_ARRAY].m_NegativeScale = JOYSTICK_RAW_MAX_DEFLECTION;
 
@@ -690,6 +1428,7 @@ bool InitializeJoystickData (void)
 
     if ((check1 != EEPROM_VALID_DATA1) || (check2 != EEPROM_VALID_DATA2))
     {
+        UpdateJoystickThresholds();
         return (false);
     }
     EEPROM_readInt16 (EEPROM_SPEED_LOWER_SCALE, &Joystick_Data[SPEED_ARRAY].m_NegativeScale);
@@ -725,7 +1464,109 @@ bool InitializeJoystickData (void)
         returnStatus = false;
         Joystick_Data[DIRECTION_ARRAY].m_NegativeScale = JOYSTICK_RAW_MAX_DEFLECTION;
     }
+
+    UpdateJoystickThresholds();
+
+    // The gate table is only trusted with good scales to go with it.
+    if (returnStatus)
+        (void) GateLoad (EEPROM_GATE_TABLE);
     
     return (returnStatus);
 }
 
+//------------------------------------------------------------------------------
+// These functions get and set the live tuning values, see g_TuneParams.
+// LiveTune.c only calls the set functions between passes of the control
+// loop and with values within the limits in the table.
+//------------------------------------------------------------------------------
+
+static uint16_t GetNeutralDemand (void)
+{
+    return g_NeutralDemand;
+}
+
+// The limits move with the neutral so the swing stays the same. Only set
+// outside the driving state (TUNE_FLAG_AT_REST), where the outputs are at
+// neutral, so they go to the new one straight away.
+static void SetNeutralDemand (uint16_t value)
+{
+    g_MinDacOutput = g_MinDacOutput + value - g_NeutralDemand;
+    g_MaxDacOutput = g_MaxDacOutput + value - g_NeutralDemand;
+    g_NeutralDemand = value;
+    SetTPI_Demands (g_NeutralDemand, g_NeutralDemand);
+}
+
+static uint16_t GetDacSwing (void)
+{
+    return g_MaxDacOutput - g_NeutralDemand;
+}
+
+static void SetDacSwing (uint16_t value)
+{
+    g_MinDacOutput = g_NeutralDemand - value;
+    g_MaxDacOutput = g_NeutralDemand + value;
+}
+
+// 0 goes back to the margin for the joystick type, see BootSequence().
+static uint16_t GetTuneNeutralMargin (void)
+{
+    return g_TunedNeutralMargin;
+}
+
+static void SetTuneNeutralMargin (uint16_t value)
+{
+    g_TunedNeutralMargin = value;
+    SetNeutralMargin ((value != 0) ? value : g_AutoNeutralMargin);
+}
+
+static uint16_t GetTuneAdcMode (void)
+{
+    return GetAdcMode();
+}
+
+static void SetTuneAdcMode (uint16_t value)
+{
+    SetAdcMode ((uint8_t) value);
+}
+
+static uint16_t GetTuneResponseCurve (void)
+{
+    return GetResponseCurve();
+}
+
+static void SetTuneResponseCurve (uint16_t value)
+{
+    SetResponseCurve ((uint8_t) value);
+}
+
+static uint16_t GetTuneDecimation (void)
+{
+    return TelemetryGetDecimation();
+}
+
+static void SetTuneDecimation (uint16_t value)
+{
+    TelemetrySetDecimation ((uint8_t) value);
+}
+
+// Only read by BootSequence(), so a new value is used from the next power up.
+static uint16_t GetTuneBootTolerance (void)
+{
+    return g_BootStableTolerance;
+}
+
+static void SetTuneBootTolerance (uint16_t value)
+{
+    g_BootStableTolerance = (uint8_t) value;
+}
+
+static uint16_t GetTuneSaveDiagnostics (void)
+{
+    return g_SaveDiagnosticsRequest;
+}
+
+static void SetTuneSaveDiagnostics (uint16_t value)
+{
+    if (value != 0)
+        g_SaveDiagnosticsRequest = true;
+}
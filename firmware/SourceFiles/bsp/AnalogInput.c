@@ -11,12 +11,78 @@
 #include "device_xc8.h"
 
 #include "bsp.h"
+#include "hal.h"
 #include "AnalogInput.h"
 
-JOYSTICK_STRUCT Joystick_Data[NUM_JS_POTS];
+#ifdef _18F46K40
+// ADC acquisition time. After a channel change the ADC's hold capacitor has
+// to charge through the joystick's source impedance. The ADC times this
+// itself (ADACQ) so no software delay is needed. From the data sheet,
+// Equation 31-1 at 50C:
+//      TACQ = TAMP + TC + TCOFF
+//           = 2us + CHOLD * (RIC + RSS + RS) * ln(2047) + 1.25us
+// with CHOLD = 28pF, RIC = 1k and RSS = 7k. 28pF * ln(2047) = 0.21347 ns/ohm.
+#ifndef JOYSTICK_SOURCE_IMPEDANCE_OHMS
+#define JOYSTICK_SOURCE_IMPEDANCE_OHMS (10000UL)    // Worst case the data sheet allows.
+#endif
+#define ADC_TAD_NS (CLOCK_ADC_TAD_NS)    // ADC clock is Fosc / CLOCK_ADC_DIVIDER.
+#define ADC_TACQ_NS (2000UL + (((8000UL + JOYSTICK_SOURCE_IMPEDANCE_OHMS) * 21347UL) / 100000UL) + 1250UL)
+#define ADC_ACQUISITION_TAD (((ADC_TACQ_NS + ADC_TAD_NS - 1) / ADC_TAD_NS) + 1) // Rounded up, plus 1 TAD margin.
+
+// Optional precharge of the hold capacitor before acquisition, in TAD. It is
+// not needed for the joystick and is left off.
+#ifndef ADC_PRECHARGE_TAD
+#define ADC_PRECHARGE_TAD (0)
+#endif
+
+// In the low noise mode the ADC runs from its FRC clock instead. Its TAD is
+// taken as 1 us, the shortest the data sheet gives, so the input always has
+// at least ADC_TACQ_NS to settle.
+#define ADC_FRC_TAD_NS (1000UL)
+#define ADC_FRC_ACQUISITION_TAD (((ADC_TACQ_NS + ADC_FRC_TAD_NS - 1) / ADC_FRC_TAD_NS) + 1)
+
+#if (ADC_ACQUISITION_TAD > 255) || (ADC_FRC_ACQUISITION_TAD > 255) || (ADC_PRECHARGE_TAD > 255)
+#error "ADC acquisition or precharge time does not fit ADACQ / ADPRE"
+#endif
+#endif
+
+// The control loop reads these on every pass, so they are placed in access
+// RAM where no bank switch is needed to reach them.
+__near JOYSTICK_STRUCT Joystick_Data[NUM_JS_POTS];
+__near JOYSTICK_THRESHOLDS Joystick_Thresholds[NUM_JS_POTS];
+
+JOYSTICK_CAL_STRUCT Joystick_Calibration[NUM_JS_POTS];
+
+// Neutral drift tracking, see NeutralTrackerUpdate().
+typedef struct
+{
+    uint16_t m_Filtered;        // Running neutral << NEUTRAL_TRACK_SHIFT
+    uint16_t m_Captured;        // Neutral when it was last established
+} NEUTRAL_TRACK_STRUCT;
+
+static NEUTRAL_TRACK_STRUCT g_NeutralTrack[NUM_JS_POTS];
+static uint8_t g_NeutralRestCount;
+
+static bool g_AdcTimedOut;              // Set when a conversion does not finish.
+static uint8_t g_AdcMode;               // ADC_MODE_xxx
+static uint8_t g_AdcSamples;            // Readings averaged by GetSpeedAndDirection().
+static uint16_t g_NeutralMargin;        // Half width of the neutral window, see SetNeutralMargin().
+
+ADC_NOISE_REPORT g_AdcNoise[NUM_ADC_MODES];
+
+#if ((256 % ADC_NOISE_SAMPLES) != 0)
+#error "ADC_NOISE_SAMPLES must divide 256"
+#endif
+
+static uint16_t Convert (void);
+static void MeasureNoise (ADC_NOISE_REPORT *report);
+static void ShiftJoystickNeutral (uint8_t axis, bool up);
+static uint16_t ScaleInverse (uint16_t scale);
 
 void AnalogInputInit(void)
 {
+    g_NeutralMargin = NEUTRAL_ERROR_MARGIN;
+
 #ifdef _18F46K40
     ANSELAbits.ANSELA0 = 1;     // Configure A0 as Analog Input
     ANSELAbits.ANSELA1 = 1;     // Configure A1 as Analog Input
@@ -34,11 +100,11 @@ void AnalogInputInit(void)
     ADREFbits.ADPREF = 0x00; // VSS negative voltage reference
     ADREFbits.ADNREF = 0x00; // VDD positive voltage reference
     
-    // Set clock to Fosc/(2*(ADCLKbits.ADCS+1)) = Fosc / 16 = 625 kHz
-    ADCLKbits.ADCS = 7;
+    // Set clock to Fosc/(2*(ADCLKbits.ADCS+1)) = Fosc / CLOCK_ADC_DIVIDER
+    ADCLKbits.ADCS = CLOCK_ADC_ADCS;
     
-    ADPREbits.ADPRE = 0; // No pre-charge before taking an ADC sample.
-    ADACQbits.ADACQ = 4; // 4 AD clock cycles per conversion.
+    ADPREbits.ADPRE = ADC_PRECHARGE_TAD;
+    ADACQbits.ADACQ = ADC_ACQUISITION_TAD;  // Settles the input after a channel change.
     ADCAPbits.ADCAP = 0; // No external capacitance attached to the signal path.
     
     ADRPTbits.ADRPT = 0; // Repeat threshold: don't care since not filtering or averaging.
@@ -47,6 +113,8 @@ void AnalogInputInit(void)
     ADFLTRLbits.ADFLTRL = 0; // Don't care since not filtering or averaging.
     
     ADCON0bits.ADON = 1; // Enable ADC
+
+    SetAdcMode (ADC_DEFAULT_MODE);
 #else
 	ADCON1bits.VCFG01 = 0; // VSS negative voltage reference
 	ADCON1bits.VCFG11 = 0; // VDD positive voltage reference
@@ -54,12 +122,14 @@ void AnalogInputInit(void)
 
 	// NOTE: Time to capture is 6.4 us.  This should be fine for any operational environment as
 	// NOTE: See Equation 21-3 of the PIC18F4550's datasheet.  Also, Table 21-1
-	ADCON2bits.ADCS = 0x05; // FOSC / 16 = 625 kHz
+	ADCON2bits.ADCS = CLOCK_ADC_ADCS; // FOSC / CLOCK_ADC_DIVIDER
 	ADCON2bits.ACQT = 0x02; // 4 AD clock cycles per conversion.
 
 	ADCON2bits.ADFM = 1; // Results right justified
 
 	ADCON0bits.ADON = 1; // Enable ADC
+
+    SetAdcMode (ADC_MODE_NORMAL);
 #endif
     
 }
@@ -69,20 +139,15 @@ void AnalogInputInit(void)
 //------------------------------------------------------------------------------
 uint16_t ReadSpeed (void)
 {
-    ADPCHbits.ADPCH = 0x00; // Channel 0, RA0
+    HAL_ADC_SELECT(0);      // Channel 0, RA0
     
+#ifndef _18F46K40
 	// Need to wait at least Tad * 3. Clock is FOSC/16, which gets us: 3/(625,000) = ~4.8 us.  Our delay resolution is not
-	// great, so we just delay for the min time.
+	// great, so we just delay for the min time. The 46K40 times this itself (ADACQ).
 	bspDelayUs (US_DELAY_50_us);
+#endif
 	
-	// Kick off the conversion
-	ADCON0bits.GO_nDONE = 1;
-	while (ADCON0bits.GO_nDONE == 1)
-	{
-		(void)0;
-	}
-    
-	return ((uint16_t)ADRESL + ((uint16_t)(ADRESH & 0x3) << 8));
+	return Convert();
 }
 
 //------------------------------------------------------------------------------
@@ -90,55 +155,240 @@ uint16_t ReadSpeed (void)
 //------------------------------------------------------------------------------
 uint16_t ReadDirection (void)
 {
-    ADPCHbits.ADPCH = 0x01; // Channel 1, RA1
+    HAL_ADC_SELECT(1);      // Channel 1, RA1
     
+#ifndef _18F46K40
 	// Need to wait at least Tad * 3. Clock is FOSC/16, which gets us: 3/(625,000) = ~4.8 us.  Our delay resolution is not
-	// great, so we just delay for the min time.
+	// great, so we just delay for the min time. The 46K40 times this itself (ADACQ).
 	bspDelayUs (US_DELAY_100_us);
+#endif
 	
-	// Kick off the conversion
-	ADCON0bits.GO_nDONE = 1;
+	return Convert();
+}
+
+//------------------------------------------------------------------------------
+// This function runs a conversion on the selected channel. The wait for it
+// is bounded so a failed ADC cannot stall the control loop. If it does not
+// finish, ADC_TIMEOUT_READING is returned and AdcTimedOut() reports it.
+//------------------------------------------------------------------------------
+static uint16_t Convert (void)
+{
+    uint16_t start;
+#ifdef _18F46K40
+    bool interruptsOn;
+
+    if (g_AdcMode == ADC_MODE_LOW_NOISE)
+    {
+        // Idle the CPU while the ADC converts so its switching noise stays
+        // out of the reading. Interrupts are held off so ADIF just wakes the
+        // CPU. If something else wakes it first, the poll below finishes the
+        // wait.
+        interruptsOn = INTCONbits.GIEH;
+        bspDisableInterrupts();
+        PIR1bits.ADIF = 0;
+        PIE1bits.ADIE = 1;
+        ADCON0bits.GO_nDONE = 1;
+        SLEEP();
+        Nop();
+        PIE1bits.ADIE = 0;
+        PIR1bits.ADIF = 0;
+        if (interruptsOn)
+            bspEnableInterrupts();
+    }
+    else
+#endif
+    {
+        // Kick off the conversion
+        ADCON0bits.GO_nDONE = 1;
+    }
+
+    start = bspGetFastTick();
 	while (ADCON0bits.GO_nDONE == 1)
 	{
-		(void)0;
+        if ((uint16_t) (bspGetFastTick() - start) > ADC_TIMEOUT_TICKS)
+        {
+            ADCON0bits.GO_nDONE = 0;    // Abandon the conversion.
+            g_AdcTimedOut = true;
+            return ADC_TIMEOUT_READING;
+        }
 	}
     
 	return ((uint16_t)ADRESL + ((uint16_t)(ADRESH & 0x3) << 8));
 }
 
+//------------------------------------------------------------------------------
+// This function returns "true" if a conversion has timed out since it was
+// last called.
+//------------------------------------------------------------------------------
+bool AdcTimedOut (void)
+{
+    bool timedOut;
+
+    timedOut = g_AdcTimedOut;
+    g_AdcTimedOut = false;
+    return timedOut;
+}
+
+//------------------------------------------------------------------------------
+// This function selects how conversions are made, ADC_MODE_NORMAL or
+// ADC_MODE_LOW_NOISE, and the number of readings GetSpeedAndDirection()
+// averages in that mode. The low noise mode is only on the 46K40, the 4550
+// stays in the normal mode.
+//
+// The low noise mode idles the CPU rather than sleeping it: in Sleep the HS
+// crystal stops and takes ~100 us to restart, and the system tick stops.
+//------------------------------------------------------------------------------
+void SetAdcMode (uint8_t mode)
+{
+#ifdef _18F46K40
+    if (mode == ADC_MODE_LOW_NOISE)
+    {
+        ADCON0bits.ADCS = 1;                        // FRC clock
+        ADACQbits.ADACQ = ADC_FRC_ACQUISITION_TAD;
+        CPUDOZEbits.IDLEN = 1;                      // SLEEP idles the CPU.
+        g_AdcSamples = ADC_LOW_NOISE_SAMPLES;
+        g_AdcMode = ADC_MODE_LOW_NOISE;
+        return;
+    }
+
+    ADCON0bits.ADCS = 0;                            // Fosc clock, see ADCLK.
+    ADACQbits.ADACQ = ADC_ACQUISITION_TAD;
+    CPUDOZEbits.IDLEN = 0;
+#else
+    (void) mode;
+#endif
+    g_AdcSamples = ADC_NORMAL_SAMPLES;
+    g_AdcMode = ADC_MODE_NORMAL;
+}
+
+//------------------------------------------------------------------------------
+// This function returns the ADC_MODE_xxx in use.
+//------------------------------------------------------------------------------
+uint8_t GetAdcMode (void)
+{
+    return g_AdcMode;
+}
+
+//------------------------------------------------------------------------------
+// This function measures the noise on the joystick inputs in each ADC mode
+// and leaves the results in g_AdcNoise. The joystick must be at rest. The
+// ADC mode in use is restored afterwards.
+//------------------------------------------------------------------------------
+void MeasureAdcNoise (void)
+{
+    uint8_t mode, previous;
+
+    previous = g_AdcMode;
+    for (mode = 0; mode < NUM_ADC_MODES; ++mode)
+    {
+        SetAdcMode (mode);
+        if (g_AdcMode == mode)
+            MeasureNoise (&g_AdcNoise[mode]);
+    }
+    SetAdcMode (previous);
+}
+
+//------------------------------------------------------------------------------
+// This function takes ADC_NOISE_SAMPLES single readings of each joystick
+// input and reports their mean and standard deviation.
+//------------------------------------------------------------------------------
+static void MeasureNoise (ADC_NOISE_REPORT *report)
+{
+    uint8_t i, axis;
+    uint16_t reading[NUM_JS_POTS];
+    uint16_t sum[NUM_JS_POTS];
+    uint32_t sumOfSquares[NUM_JS_POTS];
+    uint32_t deviation;
+
+    for (axis = 0; axis < NUM_JS_POTS; ++axis)
+    {
+        sum[axis] = 0;
+        sumOfSquares[axis] = 0;
+    }
+
+    for (i = 0; i < ADC_NOISE_SAMPLES; ++i)
+    {
+        reading[SPEED_ARRAY] = ReadSpeed();
+        reading[DIRECTION_ARRAY] = ReadDirection();
+        for (axis = 0; axis < NUM_JS_POTS; ++axis)
+        {
+            sum[axis] += reading[axis];
+            sumOfSquares[axis] += (uint32_t) reading[axis] * reading[axis];
+        }
+    }
+
+    for (axis = 0; axis < NUM_JS_POTS; ++axis)
+    {
+        report->m_Mean[axis] = sum[axis] / ADC_NOISE_SAMPLES;
+
+        // N * variance, then variance * 256 so the root is * 16.
+        deviation = sumOfSquares[axis] - (((uint32_t) sum[axis] * sum[axis]) / ADC_NOISE_SAMPLES);
+        deviation *= (256 / ADC_NOISE_SAMPLES);
+        report->m_StdDevQ4[axis] = SquareRoot (deviation);
+    }
+}
+
+//------------------------------------------------------------------------------
+// Integer square root, rounded down. Also used by the gate calibration.
+//------------------------------------------------------------------------------
+uint16_t SquareRoot (uint32_t value)
+{
+    uint32_t root, bit;
+
+    root = 0;
+    bit = (uint32_t) 1 << 30;
+    while (bit > value)
+        bit >>= 2;
+
+    while (bit != 0)
+    {
+        if (value >= root + bit)
+        {
+            value -= root + bit;
+            root = (root >> 1) + bit;
+        }
+        else
+        {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint16_t) root;
+}
+
 void GetSpeedAndDirection (uint16_t *speed, uint16_t *direction)
 {
-    int i;
+    uint8_t i;
     uint16_t speedTotal, directionTotal;
     
     speedTotal = 0;
     directionTotal = 0;
     
-    for (i = 0; i<10; ++i)
+    for (i = 0; i < g_AdcSamples; ++i)
     {
+#ifndef _18F46K40
         bspDelayUs (US_DELAY_20_us);
+#endif
         speedTotal += ReadSpeed();
         //bspDelayUs (US_DELAY_20_us);
         directionTotal += ReadDirection();
     }
-    *speed = speedTotal / 10;
-    *direction = directionTotal / 10;
+    *speed = speedTotal / g_AdcSamples;
+    *direction = directionTotal / g_AdcSamples;
 }
 
 //------------------------------------------------------------------------------
-// This function returns "true" if the joystick signals are within the Neutral
-// window else returns "false".
+// This function returns "true" if the given joystick signals are within the
+// Neutral window else returns "false". Until the neutral is established the
+// window is centred on NEUTRAL_JOYSTICK_INPUT, after that it follows the
+// established (and tracked) neutral.
 //------------------------------------------------------------------------------
-bool IsJoystickInNeutral ()
+bool IsInNeutralWindow (uint16_t rawSpeed, uint16_t rawDirection)
 {
-    uint16_t rawSpeed, rawDirection; 
-    
-    GetSpeedAndDirection (&rawSpeed, &rawDirection);
-    
-    if ((rawSpeed < (NEUTRAL_JOYSTICK_INPUT + NEUTRAL_ERROR_MARGIN))
-    && (rawSpeed > (NEUTRAL_JOYSTICK_INPUT - NEUTRAL_ERROR_MARGIN))
-    && (rawDirection < (NEUTRAL_JOYSTICK_INPUT + NEUTRAL_ERROR_MARGIN))
-    && (rawDirection > (NEUTRAL_JOYSTICK_INPUT - NEUTRAL_ERROR_MARGIN)))
+    if ((rawSpeed < Joystick_Data[SPEED_ARRAY].m_rawMaxNuetral)
+    && (rawSpeed > Joystick_Data[SPEED_ARRAY].m_rawMinNeutral)
+    && (rawDirection < Joystick_Data[DIRECTION_ARRAY].m_rawMaxNuetral)
+    && (rawDirection > Joystick_Data[DIRECTION_ARRAY].m_rawMinNeutral))
     {
         return true;
     }
@@ -148,3 +398,171 @@ bool IsJoystickInNeutral ()
     }
 }
 
+//------------------------------------------------------------------------------
+// This function returns 2^JOYSTICK_INVERSE_SHIFT / scale, so the control loop
+// can normalise a deflection with a multiply instead of a divide. It is
+// rounded up so a full deflection normalises to full scale. Scales too
+// small for the result to fit give the largest inverse.
+//------------------------------------------------------------------------------
+static uint16_t ScaleInverse (uint16_t scale)
+{
+    if (scale <= ((uint32_t) 1 << JOYSTICK_INVERSE_SHIFT) / 0xffff)
+        return 0xffff;
+    return (uint16_t) ((((uint32_t) 1 << JOYSTICK_INVERSE_SHIFT) + scale - 1) / scale);
+}
+
+//------------------------------------------------------------------------------
+// This function recalculates Joystick_Thresholds from Joystick_Data.
+// Call it whenever the neutral or the scales change.
+//------------------------------------------------------------------------------
+void UpdateJoystickThresholds (void)
+{
+    uint8_t i;
+    JOYSTICK_STRUCT *js;
+    JOYSTICK_THRESHOLDS *th;
+
+    for (i = 0; i < NUM_JS_POTS; ++i)
+    {
+        js = &Joystick_Data[i];
+        th = &Joystick_Thresholds[i];
+
+        th->m_ClampMaximum = js->m_rawNeutral + js->m_PositiveScale;
+        th->m_ClampMinimum = js->m_rawNeutral - js->m_NegativeScale;
+        th->m_HalfPositive = js->m_rawNeutral + (js->m_PositiveScale / 2);
+        th->m_HalfNegative = js->m_rawNeutral - (js->m_NegativeScale / 2);
+        th->m_CentredMinimum = js->m_rawNeutral - (g_NeutralMargin * 2);
+        th->m_CentredMaximum = js->m_rawNeutral + (g_NeutralMargin * 2);
+        th->m_PositiveRange = (th->m_ClampMaximum > js->m_rawMaxNuetral) ? (th->m_ClampMaximum - js->m_rawMaxNuetral) : 1;
+        th->m_NegativeRange = (js->m_rawMinNeutral > th->m_ClampMinimum) ? (js->m_rawMinNeutral - th->m_ClampMinimum) : 1;
+        th->m_PositiveInverse = ScaleInverse (js->m_PositiveScale);
+        th->m_NegativeInverse = ScaleInverse (js->m_NegativeScale);
+    }
+}
+
+//------------------------------------------------------------------------------
+// This function sets how far a reading may be from the neutral and still be
+// in the neutral window, and moves the window and the thresholds to match.
+// The margin must be from 1 to less than JOYSTICK_RAW_MAX_DEFLECTION / 2.
+//------------------------------------------------------------------------------
+void SetNeutralMargin (uint16_t margin)
+{
+    uint8_t i;
+
+    g_NeutralMargin = margin;
+    for (i = 0; i < NUM_JS_POTS; ++i)
+    {
+        Joystick_Data[i].m_rawMinNeutral = Joystick_Data[i].m_rawNeutral - margin;
+        Joystick_Data[i].m_rawMaxNuetral = Joystick_Data[i].m_rawNeutral + margin;
+    }
+    UpdateJoystickThresholds();
+}
+
+//------------------------------------------------------------------------------
+// This function returns the half width of the neutral window.
+//------------------------------------------------------------------------------
+uint16_t GetNeutralMargin (void)
+{
+    return g_NeutralMargin;
+}
+
+//------------------------------------------------------------------------------
+// This function restarts neutral drift tracking from the current neutral.
+// Call it whenever the neutral is established.
+//------------------------------------------------------------------------------
+void NeutralTrackerReset (void)
+{
+    uint8_t i;
+
+    for (i = 0; i < NUM_JS_POTS; ++i)
+    {
+        g_NeutralTrack[i].m_Captured = Joystick_Data[i].m_rawNeutral;
+        g_NeutralTrack[i].m_Filtered = Joystick_Data[i].m_rawNeutral << NEUTRAL_TRACK_SHIFT;
+    }
+    g_NeutralRestCount = 0;
+}
+
+//------------------------------------------------------------------------------
+// This function follows slow drift of the joystick's neutral, e.g. from
+// temperature or wear. Call it with each new reading.
+// The readings are only used once the joystick has rested within
+// NEUTRAL_TRACK_REST_BAND of the neutral for NEUTRAL_TRACK_REST_SAMPLES
+// readings in a row. They feed a first order low pass filter and, when the
+// filtered neutral moves by a count, the neutral window and the thresholds
+// are moved by that one count. The neutral never moves more than
+// NEUTRAL_DRIFT_LIMIT from where it was established.
+//------------------------------------------------------------------------------
+void NeutralTrackerUpdate (uint16_t rawSpeed, uint16_t rawDirection)
+{
+    uint8_t i;
+    uint16_t raw, neutral, tracked;
+
+    for (i = 0; i < NUM_JS_POTS; ++i)
+    {
+        raw = (i == SPEED_ARRAY) ? rawSpeed : rawDirection;
+        neutral = Joystick_Data[i].m_rawNeutral;
+        if ((raw > (neutral + NEUTRAL_TRACK_REST_BAND)) || ((raw + NEUTRAL_TRACK_REST_BAND) < neutral))
+        {
+            // The joystick is being used.
+            g_NeutralRestCount = 0;
+            return;
+        }
+    }
+
+    if (g_NeutralRestCount < NEUTRAL_TRACK_REST_SAMPLES)
+    {
+        ++g_NeutralRestCount;
+        return;
+    }
+
+    for (i = 0; i < NUM_JS_POTS; ++i)
+    {
+        raw = (i == SPEED_ARRAY) ? rawSpeed : rawDirection;
+        g_NeutralTrack[i].m_Filtered += raw - (g_NeutralTrack[i].m_Filtered >> NEUTRAL_TRACK_SHIFT);
+
+        tracked = (g_NeutralTrack[i].m_Filtered + (1 << (NEUTRAL_TRACK_SHIFT - 1))) >> NEUTRAL_TRACK_SHIFT;
+        neutral = Joystick_Data[i].m_rawNeutral;
+        if ((tracked > neutral) && (neutral < (g_NeutralTrack[i].m_Captured + NEUTRAL_DRIFT_LIMIT)))
+        {
+            ShiftJoystickNeutral (i, true);
+        }
+        else if ((tracked < neutral) && ((neutral + NEUTRAL_DRIFT_LIMIT) > g_NeutralTrack[i].m_Captured))
+        {
+            ShiftJoystickNeutral (i, false);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+// Returns how far, in ADC counts, the neutral has drifted from where it was
+// established.
+//------------------------------------------------------------------------------
+int16_t GetNeutralDrift (uint8_t axis)
+{
+    return (int16_t) (Joystick_Data[axis].m_rawNeutral - g_NeutralTrack[axis].m_Captured);
+}
+
+//------------------------------------------------------------------------------
+// Moves the neutral and everything measured from it by one count. The
+// scales and ranges do not change, so nothing needs to be recalculated.
+//------------------------------------------------------------------------------
+static void ShiftJoystickNeutral (uint8_t axis, bool up)
+{
+    JOYSTICK_STRUCT *js;
+    JOYSTICK_THRESHOLDS *th;
+    int8_t step;
+
+    js = &Joystick_Data[axis];
+    th = &Joystick_Thresholds[axis];
+    step = up ? 1 : -1;
+
+    js->m_rawNeutral += step;
+    js->m_rawMinNeutral += step;
+    js->m_rawMaxNuetral += step;
+
+    th->m_ClampMaximum += step;
+    th->m_ClampMinimum += step;
+    th->m_HalfPositive += step;
+    th->m_HalfNegative += step;
+    th->m_CentredMinimum += step;
+    th->m_CentredMaximum += step;
+}
@@ -11,12 +11,13 @@
 #include "device_xc8.h"
 
 #include "bsp.h"
+#include "hal.h"
 #include "DigitalOutput.h"
 
 void DigitalOutputInit(void)
 {
-    TRISEbits.TRISE0 = GPIO_BIT_OUTPUT;
-    ANSELEbits.ANSELE0 = 0; // Allow Digital control to operate correctly.
+    HAL_PIN_OUTPUT(E, 0);
+    HAL_PIN_DIGITAL(E, 0);      // Allow Digital control to operate correctly.
     LATEbits.LATE0 = GPIO_LOW;
 }
 
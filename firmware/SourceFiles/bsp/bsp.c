@@ -18,6 +18,7 @@
 
 // from local
 #include "bsp.h"
+#include "uart_bsp.h"
 
 /* ******************************   Macros   ****************************** */
 
@@ -28,6 +29,11 @@
 
 static void InterruptsInit(void);
 static void SysTickTimerInit(void);
+static void FastTickTimerInit(void);
+
+/* ***********************   File Scope Variables   *********************** */
+
+static volatile uint16_t g_SysTickMs;   // Incremented by the Timer 2 interrupt.
 
 /* *******************   Public Function Definitions   ******************** */
 
@@ -41,6 +47,7 @@ void bspInitCore(void)
 {
 #ifdef _18F46K40
 	SysTickTimerInit();
+	FastTickTimerInit();
 	
     INTCONbits.IPEN = 1; // Enable priorities on interrupts.
     INTCONbits.PEIE_GIEL = 1; // Enable peripheral interrupts
@@ -53,6 +60,7 @@ void bspInitCore(void)
     INTCON2bits.nRBPU = 0; // Disable pull ups on all Port B pins
 	
 	SysTickTimerInit();
+	FastTickTimerInit();
 	
     RCONbits.IPEN = 1; // Enable priorities on interrupts.
     INTCONbits.PEIE = 1; // Enable peripheral interrupts
@@ -84,40 +92,93 @@ void bspDisableInterrupts(void)
 }
 
 //-------------------------------
-// Function: bspDelayUs
+// Function: bspGetSysTick
 //
-// Description: Delays for some number of microseconds.
+// Description: Returns the free running system tick, about 1 ms per count.
 //
-// NOTE: Takes about 7.6 us to execute a delay of even 1 us. So, minimum delay is 7.6 us.
+// NOTE: The count is 16 bits and is updated by an interrupt, so it is read
+// NOTE: until two reads agree to avoid a torn value.
 //
 //-------------------------------
-void bspDelayUs(uint16_t delay)
+uint16_t bspGetSysTick(void)
 {
-	if (delay == 0)
+	uint16_t tick;
+
+	do
 	{
-		return;
-	}
-	else if (delay < 256)
+		tick = g_SysTickMs;
+	} while (tick != g_SysTickMs);
+
+	return tick;
+}
+
+//-------------------------------
+// Function: bspLowPriorityIsr
+//
+// Description: Low priority interrupt handler. Maintains the system tick
+//  and feeds the UART.
+//
+//-------------------------------
+void __interrupt(low_priority) bspLowPriorityIsr(void)
+{
+#ifdef _18F46K40
+	if (PIE4bits.TMR2IE && PIR4bits.TMR2IF)
 	{
-		// TODO: Needs calibration
-		for (uint8_t i = 0; i < (uint8_t)delay; i++)
-		{
-			(void)0;
-		}
+		PIR4bits.TMR2IF = 0;
+		++g_SysTickMs;
 	}
-	else
+
+	uartBspIsr();
+#else
+	if (PIE1bits.TMR2IE && PIR1bits.TMR2IF)
 	{
-		// TODO: Needs calibration
-		for (uint16_t i = 0; i < delay - 32; i++)
-		{
-			(void)0;
-		}
+		PIR1bits.TMR2IF = 0;
+		++g_SysTickMs;
 	}
+#endif
+}
+
+//-------------------------------
+// Function: bspGetFastTick
+//
+// Description: Returns the free running Timer 1 count, BSP_FAST_TICK_NS per
+//  count. It wraps every 65536 counts (210 ms at 10 MHz, 33 ms at 64 MHz),
+//  so it is only for timing short intervals.
+//
+//-------------------------------
+uint16_t bspGetFastTick(void)
+{
+	uint8_t low;
+
+	low = TMR1L;	// Latches TMR1H (16 bit read mode).
+	return ((uint16_t)TMR1H << 8) | low;
 }
 
 //-------------------------------
 // Function: bspDelayUs
 //
+// Description: Delays for some number of microseconds.
+//
+// delay: One of the US_DELAY_xxx values, which are fast ticks.
+//
+// NOTE: Timed with the fast tick, so it does not depend on the clock or the
+// NOTE: optimisation level, but it does need bspInitCore() to have run.
+//
+//-------------------------------
+void bspDelayUs(uint16_t delay)
+{
+	uint16_t start;
+
+	start = bspGetFastTick();
+	while ((uint16_t)(bspGetFastTick() - start) < delay)
+	{
+		(void)0;
+	}
+}
+
+//-------------------------------
+// Function: bspDelayMs
+//
 // Description: Delays for some number of milliseconds.
 //
 //-------------------------------
@@ -125,10 +186,7 @@ void bspDelayMs(uint16_t delay)
 {
 	for (uint16_t i = 0; i < delay; i++)
 	{
-		for (uint16_t j = 0; j < 224; j++)
-		{
-			(void)0;
-		}
+		bspDelayUs(US_DELAY_1000_us);
 	}
 }
 
@@ -142,25 +200,53 @@ void bspDelayMs(uint16_t delay)
 //-------------------------------
 static void SysTickTimerInit(void)
 {
-    // Input frequency to Timer2 module is FOSC/4, which is 2.5 MHz for this application.
+    // Input frequency to Timer2 module is FOSC/4. The prescaler and period
+    // for a 1 ms tick come from clock_bsp.h.
 #ifdef _18F46K40
     T2CLKCONbits.CS = 0x01; // Select Fosc/4 as clock source for timer 2
     T2HLTbits.MODE = 0x00; // Free running timer mode, where TMR2ON control on/off
-    T2CONbits.CKPS = 4; // /16 prescaler
+    T2CONbits.CKPS = CLOCK_TIMER2_CKPS; // CLOCK_TIMER2_PRESCALE
     T2CONbits.OUTPS = 0; // /1 postscaler
-    PR2 = 156; // Once the timer reaches this value the interrupt triggers
+    PR2 = CLOCK_TIMER2_PR2; // Once the timer reaches this value the interrupt triggers
     IPR4bits.TMR2IP = ISR_LOW_PRIO_SET_VAL;
     PIE4bits.TMR2IE = 1; // Enable timer interrupt
     T2CONbits.TMR2ON = 1; // Enable the timer.
 #else
+#if (CLOCK_TIMER2_PRESCALE != 16)
+#error "Only the /16 Timer 2 prescaler is set up for the PIC18F4550"
+#endif
     T2CONbits.T2CKPS = 3; // /16 prescaler
     T2CONbits.TOUTPS = 0; // /1 postscaler
-    PR2 = 156; // Once the timer reaches this value the interrupt triggers
+    PR2 = CLOCK_TIMER2_PR2; // Once the timer reaches this value the interrupt triggers
     IPR1bits.TMR2IP = ISR_LOW_PRIO_SET_VAL;
     PIE1bits.TMR2IE = 1; // Enable timer interrupt
     T2CONbits.TMR2ON = 1; // Enable the timer.
 #endif
 }
 
+//-------------------------------
+// Function: FastTickTimerInit
+//
+// Description: Starts Timer 1 free running at FOSC/4 / 8, BSP_FAST_TICK_NS
+//  per count.
+//
+//-------------------------------
+static void FastTickTimerInit(void)
+{
+#ifdef _18F46K40
+    T1CLKbits.CS = 0x01; // Fosc/4
+    T1CONbits.CKPS = 3; // /8 prescaler
+    T1CONbits.RD16 = 1; // Read the 16 bits in one go.
+    PIE4bits.TMR1IE = 0; // No interrupt, it is read when needed.
+    T1CONbits.ON = 1;
+#else
+    T1CONbits.TMR1CS = 0; // Fosc/4
+    T1CONbits.T1CKPS = 3; // /8 prescaler
+    T1CONbits.RD16 = 1; // Read the 16 bits in one go.
+    PIE1bits.TMR1IE = 0; // No interrupt, it is read when needed.
+    T1CONbits.TMR1ON = 1;
+#endif
+}
+
 // end of file.
 //-------------------------------------------------------------------------
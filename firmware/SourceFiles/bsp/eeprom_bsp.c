@@ -2,7 +2,8 @@
 //
 // Filename: eeprom_bsp.c
 //
-// Description: Control driver for the PIC18F4550's internal EEPROM
+// Description: Control driver for the PIC18's internal EEPROM. The registers
+//      of each chip are in hal.h.
 //
 // Author(s): Trevor Parsh (Embedded Wizardry, LLC)
 //
@@ -21,6 +22,7 @@
 #include <stdbool.h>
 
 // from project
+#include "hal.h"
 
 // from local
 #include "eeprom_bsp.h"
@@ -185,41 +187,17 @@ static bool writeBuffer(uint8_t start_address, uint8_t num_bytes_to_write, uint8
 //-------------------------------
 static void writeByte(uint8_t address, uint8_t data)
 {
-#ifdef _18F46K40
-	NVMCON1bits.NVMREG = 0;
-	NVMADRL = address;
-	NVMADRH = 0; // This application does not use that much EEPROM.
-	NVMDAT = data;
-	NVMCON1bits.WREN = 1;
-
-	uint8_t start_gie_state = INTCONbits.GIE;
-	INTCONbits.GIE = 0;
-	NVMCON2 = 0x55;
-	NVMCON2 = 0xAA;
-	NVMCON1bits.WR = 1;
-	INTCONbits.GIE = start_gie_state; // Re-Enable global interrupts if required
-	NVMCON1bits.WREN = 0;
-#else
-	// Set address and data registers accordingly.
-	EEADR = address;
-	EEDATA = data;
-
-	// Point to data section of EEPROM and enable EEPROM writes
-	EECON1bits.CFGS = 0;
-	EECON1bits.EEPGD = 0;
-	EECON1bits.WREN = 1;
+	// Point to the data EEPROM and enable writes.
+	HAL_EEPROM_SELECT(address);
+	HAL_EEPROM_DATA = data;
+	HAL_EEPROM_WRITE_ENABLE();
 
 	// Critical section.  Cannot let any interrupts fire here, so disable global interrupts
 	uint8_t start_gie_state = INTCONbits.GIE;
 	INTCONbits.GIE = 0;
-	EECON2 = 0x55;
-	EECON2 = 0xAA;
-	EECON1bits.WR = 1;
+	HAL_EEPROM_UNLOCK_AND_WRITE();
 	INTCONbits.GIE = start_gie_state; // Re-Enable global interrupts if required
-
-	EECON1bits.WREN = 0; // Disable EEPROM writes
-	EECON1bits.WR = 0;
-#endif
+	HAL_EEPROM_WRITE_DISABLE();
 }
 
 //------------------------------------------------------------------------------
@@ -240,6 +218,26 @@ void EEPROM_readInt16 (uint8_t address, uint16_t *data)
     readIntoBuffer(address, 2, (uint8_t*) data);
 }
 
+//------------------------------------------------------------------------------
+// Starts writing a byte without waiting. If the EEPROM is still busy with
+// the last write, nothing is done and false is returned so the caller can
+// try again later. A byte that already holds the value is not rewritten.
+//------------------------------------------------------------------------------
+
+bool EEPROM_tryWriteByte (uint8_t address, uint8_t data)
+{
+    uint8_t current;
+
+    if (HAL_EEPROM_BUSY())
+        return false;
+
+    readIntoBuffer(address, 1, &current);
+    if (current != data)
+        writeByte(address, data);
+
+    return true;
+}
+
 //------------------------------------------------------------------------------
 // Function: waitForEepromToBeWritable
 //
@@ -252,21 +250,12 @@ static bool waitForEepromToBeWritable(uint16_t timeout_ms)
 {
 	//UNUSED(timeout_ms);
 
-#ifdef _18F46K40
-	// Make sure last attempt to write is complete
-	// TODO: Add timeout and feedback on failure.
-	while(NVMCON1bits.WR)
-	{
-		(void)0;
-	}
-#else
 	// Make sure last attempt to write is complete
 	// TODO: Add timeout and feedback on failure.
-	while(EECON1bits.WR)
+	while(HAL_EEPROM_BUSY())
 	{
 		(void)0;
 	}
-#endif
 
 	return true;
 }
@@ -283,33 +272,12 @@ static void readIntoBuffer(uint8_t start_address, uint8_t num_bytes_to_read, uin
 {
 	for (uint8_t i = 0; i < num_bytes_to_read; i++)
 	{
-#ifdef _18F46K40
-		NVMCON1bits.NVMREG = 0;
-		NVMADRL = (start_address + i);
-		NVMADRH = 0; // This application does not use that much EEPROM.
-        
-        NVMCON1bits.RD = 1;
-        
-		// There's no mention of needing delay between setting up for a read and actually reading
-		// for PIC18(L)F46K40 MCUs.
-		buffer[i] = NVMDAT;
-#else
-		EEADR = (start_address + i);
-
-		// Point to data section of EEPROM and enable EEPROM
-		EECON1bits.CFGS = 0;
-		EECON1bits.EEPGD = 0;
-
-		// Kick off the read operation
-		//NVMCON1bits.RD = 1;
-		EECON1bits.RD = 1;
+		HAL_EEPROM_SELECT(start_address + i);
+		HAL_EEPROM_READ();
 
-		// Nop may be required for latency at high frequencies
-		Nop();
-		Nop();
-
-		buffer[i] = EEDATA;
-#endif
+		// There's no mention of needing delay between setting up for a read and actually reading
+		// for PIC18(L)F46K40 MCUs. The 4550's Nop()s are in HAL_EEPROM_READ().
+		buffer[i] = HAL_EEPROM_DATA;
 	}
 }
 
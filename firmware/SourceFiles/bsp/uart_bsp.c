@@ -0,0 +1,226 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Filename: uart_bsp.c
+//
+// Description: Interrupt driven EUSART1 driver for the PIC18F46K40.
+//
+//  Bytes to send are queued in a ring buffer and sent by the low priority
+//  interrupt, so writing never waits for the UART. A write that does not
+//  fit in the buffer is refused whole.
+//
+//  Bytes received are put in another ring buffer by the same interrupt and
+//  taken out with uartBspRead(). When that buffer is full, further bytes
+//  are dropped and counted, as are hardware overruns.
+//
+//  The 4550 build has no UART support; writes are refused and nothing is
+//  received.
+//
+// Author(s): G. Chopcinski (Kg Solutions, LLC)
+//
+// Created for ASL
+//
+//////////////////////////////////////////////////////////////////////////////
+
+/* **************************   Header Files   *************************** */
+
+// NOTE: This must ALWAYS be the first include in a file.
+#include "device_xc8.h"
+
+// from stdlib
+#include <stdint.h>
+#include <stdbool.h>
+
+// from project
+#include "bsp.h"
+
+// from local
+#include "uart_bsp.h"
+
+/* ******************************   Macros   ****************************** */
+
+#define UART_TX_BUFFER_MASK (UART_TX_BUFFER_SIZE - 1)
+#define UART_RX_BUFFER_MASK (UART_RX_BUFFER_SIZE - 1)
+
+#if ((UART_TX_BUFFER_SIZE & UART_TX_BUFFER_MASK) != 0) || (UART_TX_BUFFER_SIZE > 256)
+#error "UART_TX_BUFFER_SIZE must be a power of 2 no larger than 256"
+#endif
+#if ((UART_RX_BUFFER_SIZE & UART_RX_BUFFER_MASK) != 0) || (UART_RX_BUFFER_SIZE > 256)
+#error "UART_RX_BUFFER_SIZE must be a power of 2 no larger than 256"
+#endif
+
+// BRG16 = 1 and BRGH = 1, so baud = Fosc / (4 * (SP1BRG + 1)).
+#define UART_BRG (((F_CPU + (2 * UART_BAUD_RATE)) / (4 * UART_BAUD_RATE)) - 1)
+#define UART_ACTUAL_BAUD (F_CPU / (4 * (UART_BRG + 1)))
+
+#if ((UART_ACTUAL_BAUD * 100) > (UART_BAUD_RATE * 102)) || ((UART_ACTUAL_BAUD * 100) < (UART_BAUD_RATE * 98))
+#error "UART_BAUD_RATE can not be made within 2% from F_CPU"
+#endif
+
+#define PPS_OUT_TX1 (0x09)              // RxyPPS value for EUSART1 TX.
+#define PPS_IN_RC7 (0x17)               // RX1PPS value for RC7.
+
+/* ***********************   File Scope Variables   *********************** */
+
+static uint8_t g_TxBuffer[UART_TX_BUFFER_SIZE];
+static volatile uint8_t g_TxHead;       // Written by uartBspWrite().
+static volatile uint8_t g_TxTail;       // Written by the interrupt.
+
+static uint8_t g_RxBuffer[UART_RX_BUFFER_SIZE];
+static volatile uint8_t g_RxHead;       // Written by the interrupt.
+static volatile uint8_t g_RxTail;       // Written by uartBspRead().
+
+uint8_t g_UartRxLost;                   // Bytes dropped or overrun, saturates.
+
+/* *******************   Public Function Definitions   ******************** */
+
+//-------------------------------
+// Function: uartBspInit
+//
+// Description: Sets up EUSART1 for UART_BAUD_RATE, 8N1, with TX on RC6
+//  and RX on RC7.
+//
+//-------------------------------
+void uartBspInit(void)
+{
+    g_TxHead = 0;
+    g_TxTail = 0;
+    g_RxHead = 0;
+    g_RxTail = 0;
+    g_UartRxLost = 0;
+
+#ifdef _18F46K40
+    TRISCbits.TRISC6 = GPIO_BIT_OUTPUT;
+    ANSELCbits.ANSELC6 = 0;
+    RC6PPS = PPS_OUT_TX1;
+
+    TRISCbits.TRISC7 = GPIO_BIT_INPUT;
+    ANSELCbits.ANSELC7 = 0;
+    RX1PPS = PPS_IN_RC7;
+
+    BAUD1CONbits.BRG16 = 1;
+    TX1STAbits.BRGH = 1;
+    TX1STAbits.SYNC = 0;    // Asynchronous
+    SP1BRGH = (uint8_t) (UART_BRG >> 8);
+    SP1BRGL = (uint8_t) UART_BRG;
+
+    IPR3bits.TX1IP = 0;     // Low priority, see bspLowPriorityIsr().
+    PIE3bits.TX1IE = 0;     // Only enabled while there is something to send.
+    IPR3bits.RC1IP = 0;
+    PIE3bits.RC1IE = 1;
+    RC1STAbits.SPEN = 1;
+    RC1STAbits.CREN = 1;
+    TX1STAbits.TXEN = 1;
+#endif
+}
+
+//-------------------------------
+// Function: uartBspWrite
+//
+// Description: Queues bytes to be sent.
+//
+// Returns: true if queued, false if there was not room for all of them, in
+//  which case none are queued.
+//
+//-------------------------------
+bool uartBspWrite(const uint8_t *data, uint8_t length)
+{
+#ifdef _18F46K40
+    uint8_t head, room, i;
+
+    head = g_TxHead;
+    room = (uint8_t) (UART_TX_BUFFER_MASK - ((uint8_t) (head - g_TxTail) & UART_TX_BUFFER_MASK));
+    if (length > room)
+        return false;
+
+    for (i = 0; i < length; ++i)
+    {
+        g_TxBuffer[head] = data[i];
+        head = (head + 1) & UART_TX_BUFFER_MASK;
+    }
+    g_TxHead = head;
+
+    PIE3bits.TX1IE = 1;     // The interrupt sends until the buffer is empty.
+    return true;
+#else
+    (void) data;
+    (void) length;
+    return false;
+#endif
+}
+
+//-------------------------------
+// Function: uartBspRead
+//
+// Description: Takes the next received byte.
+//
+// Returns: true if there was one, false if nothing has been received.
+//
+//-------------------------------
+bool uartBspRead(uint8_t *data)
+{
+    uint8_t tail;
+
+    tail = g_RxTail;
+    if (tail == g_RxHead)
+        return false;
+
+    *data = g_RxBuffer[tail];
+    g_RxTail = (tail + 1) & UART_RX_BUFFER_MASK;
+    return true;
+}
+
+//-------------------------------
+// Function: uartBspIsr
+//
+// Description: Stores a received byte and sends the next queued byte.
+//  Called from the low priority interrupt.
+//
+//-------------------------------
+void uartBspIsr(void)
+{
+#ifdef _18F46K40
+    uint8_t head, tail, data;
+
+    if (PIE3bits.RC1IE && PIR3bits.RC1IF)
+    {
+        if (RC1STAbits.OERR)
+        {
+            // The receiver stops on an overrun until it is reset.
+            RC1STAbits.CREN = 0;
+            RC1STAbits.CREN = 1;
+            if (g_UartRxLost != 0xff)
+                ++g_UartRxLost;
+        }
+        else
+        {
+            data = RC1REG;
+            head = g_RxHead;
+            if (((head + 1) & UART_RX_BUFFER_MASK) != g_RxTail)
+            {
+                g_RxBuffer[head] = data;
+                g_RxHead = (head + 1) & UART_RX_BUFFER_MASK;
+            }
+            else if (g_UartRxLost != 0xff)
+            {
+                ++g_UartRxLost;
+            }
+        }
+    }
+
+    if (PIE3bits.TX1IE && PIR3bits.TX1IF)
+    {
+        tail = g_TxTail;
+        if (tail != g_TxHead)
+        {
+            TX1REG = g_TxBuffer[tail];
+            tail = (tail + 1) & UART_TX_BUFFER_MASK;
+            g_TxTail = tail;
+        }
+        if (tail == g_TxHead)
+            PIE3bits.TX1IE = 0;
+    }
+#endif
+}
+
+// end of file.
+//-------------------------------------------------------------------------
@@ -0,0 +1,580 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Filename: bootloader.c
+//
+// Description: Serial bootloader for the PIC18F46K40. Lets the application
+//  be replaced over the UART with tools/uploader.py instead of a PICkit.
+//
+//  The bootloader is the boot block, 0x0000 to BOOT_APP_START - 1, which
+//  WRTB protects from writes by the application. The application is built
+//  with its code offset at BOOT_APP_START (see configurations.xml) and its
+//  interrupts are passed on from here.
+//
+//  After a reset the bootloader waits BOOT_WAIT_MS for the uploader. If it
+//  hears nothing and an application is present, the application is run.
+//  Otherwise it stays here until an application has been loaded. All that
+//  time the drive DACs' load lines are held inactive, so nothing is loaded
+//  into them; see DacLinesIdle().
+//
+//  Requests, multi-byte values little endian:
+//      0   sync BOOT_SYNC_1
+//      1   sync BOOT_SYNC_2
+//      2   command, BOOT_CMD_xxx
+//      3   BOOT_CMD_WRITE only: row address, then BOOT_ROW_SIZE bytes
+//      n   CRC-16/CCITT-FALSE of bytes 2 to n - 1
+//  Each is answered with BOOT_REPLY_SIZE bytes:
+//      0   BOOT_ACK, BOOT_NAK or BOOT_RESEND
+//      1   command
+//      2   value: the row size, the row address or the application CRC
+//
+//  An update is BOOT_CMD_ERASE, a BOOT_CMD_WRITE for each row that is not
+//  blank, the row at BOOT_APP_START last, then BOOT_CMD_VERIFY and
+//  BOOT_CMD_RUN. Until the first row is written the application is not
+//  present, so an update that stops part way leaves the chair here rather
+//  than running half an application. BOOT_CMD_VERIFY checks the linker's
+//  CRC at BOOT_APP_CRC_ADDRESS and erases the first row again if it does
+//  not match.
+//
+//  Each row is checked against the CRC of its request before it is
+//  written, and read back afterwards. The CPU stops while a row is erased
+//  or written, so the next row can not be received meanwhile. Instead the
+//  CRC is worked out as the bytes arrive, the erase is done once for the
+//  whole application with blank rows skipped, and the uploader does not
+//  send blank rows.
+//
+//  "make bootloader" builds it into bootloader/dist/bootloader.hex, and
+//  each Release configuration merges that into its image in Released_Images
+//  as its post build step ("make boot-merge", see the Makefile), so the
+//  image programmed with a PICkit holds both. CLOCK_SOURCE must be the same
+//  as the application's. Release_RNet_Direct builds the application without
+//  the bootloader, to be programmed on its own.
+//
+//  tools/host_test.py runs this file on the PC build's register model and
+//  loads it with tools/uploader.py, see host/host_bootloader.c.
+//
+// Author(s): G. Chopcinski (Kg Solutions, LLC)
+//
+// Created for ASL
+//
+//////////////////////////////////////////////////////////////////////////////
+
+/* **************************   Header Files   *************************** */
+
+// NOTE: This must ALWAYS be the first include in a file.
+#include "device_xc8.h"
+
+// from stdlib
+#include <stdint.h>
+#include <stdbool.h>
+
+// from project
+#include "bsp.h"                        // GPIO_LOW, GPIO_HIGH
+
+#ifndef _18F46K40
+#error "The bootloader is for the PIC18F46K40 only"
+#endif
+
+/* ******************************   Macros   ****************************** */
+
+#define _XTAL_FREQ (F_CPU)              // For __delay_us().
+
+// No brackets, these are pasted into the asm below.
+#define BOOT_APP_START 0x0800           // End of the boot block.
+#define BOOT_HIGH_VECTOR 0x0808         // Application's interrupt vectors.
+#define BOOT_LOW_VECTOR 0x0818
+
+#define BOOT_APP_CRC_ADDRESS (0xfffeUL) // Linker's CRC of BOOT_APP_START up to here.
+#define BOOT_ROW_SIZE (64)              // Erase row and write latches.
+
+#ifndef BOOT_BAUD_RATE
+#define BOOT_BAUD_RATE (230400UL)
+#endif
+#define BOOT_WAIT_MS (50)               // About the time given to the uploader after a reset.
+#define BOOT_WAIT_POLLS (BOOT_WAIT_MS * 100)    // Each 10 us and a little more.
+
+#define BOOT_SYNC_1 (0xa5)              // As the telemetry frames.
+#define BOOT_SYNC_2 (0x5a)
+
+// Commands
+#define BOOT_CMD_SYNC (0x10)            // Stay in the bootloader, returns BOOT_ROW_SIZE.
+#define BOOT_CMD_ERASE (0x11)           // Erase the application.
+#define BOOT_CMD_WRITE (0x12)           // Write a row, returns its address.
+#define BOOT_CMD_VERIFY (0x13)          // Check the application, returns its CRC.
+#define BOOT_CMD_RUN (0x14)             // Run the application.
+
+#define BOOT_ACK (0x06)
+#define BOOT_NAK (0x15)
+#define BOOT_RESEND (0x18)              // The request was damaged, send it again.
+#define BOOT_REPLY_SIZE (4)
+
+#define BOOT_MAX_REQUEST (1 + 2 + BOOT_ROW_SIZE + 2)  // Command, address, row, CRC.
+
+// BRG16 = 1 and BRGH = 1, so baud = Fosc / (4 * (SP1BRG + 1)).
+#define BOOT_BRG (((F_CPU + (2 * BOOT_BAUD_RATE)) / (4 * BOOT_BAUD_RATE)) - 1)
+#define BOOT_ACTUAL_BAUD (F_CPU / (4 * (BOOT_BRG + 1)))
+
+#if ((BOOT_ACTUAL_BAUD * 100) > (BOOT_BAUD_RATE * 102)) || ((BOOT_ACTUAL_BAUD * 100) < (BOOT_BAUD_RATE * 98))
+#error "BOOT_BAUD_RATE can not be made within 2% from F_CPU"
+#endif
+
+#define PPS_OUT_TX1 (0x09)              // As uart_bsp.c
+#define PPS_IN_RC7 (0x17)
+
+#define DAC_LOAD_INACTIVE (GPIO_HIGH)   // As dac_bsp.c
+#define DAC_LINES_MASK (0xF6)           // RD1, RD2, RD4 to RD7
+
+#define NVM_PROGRAM_FLASH (2)           // NVMCON1 NVMREG
+
+#define mkstr(x) #x
+#define str(x) mkstr(x)
+
+// The hardware vectors are in the boot block, pass them on. The PC build
+// has no vectors.
+#ifdef __XC8
+asm ("psect intcode,global,reloc=2,class=CODE,delta=1");
+asm ("goto " str(BOOT_HIGH_VECTOR));
+asm ("psect intcodelo,global,reloc=2,class=CODE,delta=1");
+asm ("goto " str(BOOT_LOW_VECTOR));
+#endif
+
+/* ***********************   File Scope Variables   *********************** */
+
+static uint8_t g_Request[BOOT_MAX_REQUEST];
+static uint8_t g_RequestLength;         // Bytes received after the sync bytes.
+static uint8_t g_SyncCount;             // Sync bytes received.
+static uint16_t g_RequestCrc;           // Of the bytes received so far.
+
+/* ***********************   Function Prototypes   ************************ */
+
+static void DacLinesIdle (void);
+static void UartInit (void);
+static bool PollUart (void);
+static void SendReply (uint8_t status, uint8_t command, uint16_t value);
+static bool ReceiveByte (uint8_t data);
+static uint8_t RequestSize (uint8_t command);
+static void HandleRequest (void);
+static bool IsAppPresent (void);
+static uint16_t AppCrc (void);
+static bool IsRowBlank (uint16_t address);
+static void EraseRow (uint16_t address);
+static bool WriteRow (uint16_t address, const uint8_t *data);
+static void StartNvm (void);
+static uint8_t ReadFlashByte (uint16_t address);
+static uint16_t Crc16 (uint16_t crc, uint8_t data);
+static void RunApp (void);
+
+/* *******************   Public Function Definitions   ******************** */
+
+int main (void)
+{
+    uint16_t wait;
+
+    DacLinesIdle();
+    UartInit();
+
+    // Give the uploader a moment to ask for the bootloader. It is polled
+    // well within a character time so the receiver does not overrun.
+    for (wait = 0; wait < BOOT_WAIT_POLLS; ++wait)
+    {
+        if (PollUart())
+        {
+            HandleRequest();
+            break;
+        }
+        __delay_us (10);
+    }
+
+    if ((wait == BOOT_WAIT_POLLS) && IsAppPresent())
+        RunApp();
+
+    while (1)
+    {
+        if (PollUart())
+            HandleRequest();
+    }
+}
+
+/* ********************   Private Function Definitions   ****************** */
+
+//-------------------------------
+// Function: DacLinesIdle
+//
+// Description: Drives the drive DACs' lines to the idle levels dacBspInit()
+//  gives them: load inactive (high), clock high, data low. Left floating
+//  while the bootloader waits, noise could load a demand. They are not
+//  set to neutral: one bootloader serves every variant, and the neutral
+//  demand differs between them.
+//
+//-------------------------------
+static void DacLinesIdle (void)
+{
+    // Forward / reverse DAC: load RD4, data RD5, clock RD6.
+    LATDbits.LATD4 = DAC_LOAD_INACTIVE;
+    LATDbits.LATD5 = GPIO_LOW;
+    LATDbits.LATD6 = GPIO_HIGH;
+    // Left / right DAC: load RD7, data RD2, clock RD1.
+    LATDbits.LATD7 = DAC_LOAD_INACTIVE;
+    LATDbits.LATD2 = GPIO_LOW;
+    LATDbits.LATD1 = GPIO_HIGH;
+
+    ANSELD &= (uint8_t) ~DAC_LINES_MASK;
+    TRISD &= (uint8_t) ~DAC_LINES_MASK;     // Outputs
+}
+
+//-------------------------------
+// Function: UartInit
+//
+// Description: Sets up EUSART1 for BOOT_BAUD_RATE, 8N1, as uart_bsp.c does
+//  but polled.
+//
+//-------------------------------
+static void UartInit (void)
+{
+    TRISCbits.TRISC6 = GPIO_BIT_OUTPUT;
+    ANSELCbits.ANSELC6 = 0;
+    RC6PPS = PPS_OUT_TX1;
+
+    TRISCbits.TRISC7 = GPIO_BIT_INPUT;
+    ANSELCbits.ANSELC7 = 0;
+    RX1PPS = PPS_IN_RC7;
+
+    BAUD1CONbits.BRG16 = 1;
+    TX1STAbits.BRGH = 1;
+    TX1STAbits.SYNC = 0;    // Asynchronous
+    SP1BRGH = (uint8_t) (BOOT_BRG >> 8);
+    SP1BRGL = (uint8_t) BOOT_BRG;
+
+    RC1STAbits.SPEN = 1;
+    RC1STAbits.CREN = 1;
+    TX1STAbits.TXEN = 1;
+}
+
+//-------------------------------
+// Function: PollUart
+//
+// Description: Takes a received byte, if there is one, and restarts the
+//  receiver after an overrun.
+//
+// Returns: true when g_Request holds a whole, good request.
+//
+//-------------------------------
+static bool PollUart (void)
+{
+    if (RC1STAbits.OERR)
+    {
+        RC1STAbits.CREN = 0;
+        RC1STAbits.CREN = 1;
+    }
+    if (PIR3bits.RC1IF)
+        return ReceiveByte (RC1REG);
+    return false;
+}
+
+//-------------------------------
+// Function: SendReply
+//
+// Description: Sends a reply and waits until it has gone, so nothing is
+//  lost if the application is started next.
+//
+//-------------------------------
+static void SendReply (uint8_t status, uint8_t command, uint16_t value)
+{
+    uint8_t reply[BOOT_REPLY_SIZE];
+    uint8_t i;
+
+    reply[0] = status;
+    reply[1] = command;
+    reply[2] = (uint8_t) value;
+    reply[3] = (uint8_t) (value >> 8);
+
+    for (i = 0; i < BOOT_REPLY_SIZE; ++i)
+    {
+        while (PIR3bits.TX1IF == 0)
+            ;
+        TX1REG = reply[i];
+    }
+    while (TX1STAbits.TRMT == 0)
+        ;
+}
+
+//-------------------------------
+// Function: ReceiveByte
+//
+// Description: Adds a byte to the request being received. A request with
+//  a bad CRC is answered with BOOT_RESEND and dropped.
+//
+// Returns: true when g_Request holds a whole, good request.
+//
+//-------------------------------
+static bool ReceiveByte (uint8_t data)
+{
+    if (g_SyncCount == 0)
+    {
+        if (data == BOOT_SYNC_1)
+            g_SyncCount = 1;
+        return false;
+    }
+    if (g_SyncCount == 1)
+    {
+        if (data == BOOT_SYNC_2)
+        {
+            g_SyncCount = 2;
+            g_RequestLength = 0;
+            g_RequestCrc = 0xffff;
+        }
+        else if (data != BOOT_SYNC_1)
+        {
+            g_SyncCount = 0;
+        }
+        return false;
+    }
+
+    g_Request[g_RequestLength] = data;
+    if (g_RequestLength < (RequestSize (g_Request[0]) - 2))
+        g_RequestCrc = Crc16 (g_RequestCrc, data);  // While the next byte arrives.
+    if (++g_RequestLength < RequestSize (g_Request[0]))
+        return false;
+
+    g_SyncCount = 0;
+    if (g_RequestCrc != (g_Request[g_RequestLength - 2] | ((uint16_t) g_Request[g_RequestLength - 1] << 8)))
+    {
+        SendReply (BOOT_RESEND, g_Request[0], 0);
+        return false;
+    }
+    return true;
+}
+
+//-------------------------------
+// Function: RequestSize
+//
+// Description: Returns the bytes in a request after the sync bytes.
+//
+//-------------------------------
+static uint8_t RequestSize (uint8_t command)
+{
+    return (command == BOOT_CMD_WRITE) ? BOOT_MAX_REQUEST : 3;
+}
+
+//-------------------------------
+// Function: HandleRequest
+//
+// Description: Carries out the request in g_Request and answers it.
+//
+//-------------------------------
+static void HandleRequest (void)
+{
+    uint16_t address, crc;
+
+    switch (g_Request[0])
+    {
+        case BOOT_CMD_SYNC:
+            SendReply (BOOT_ACK, BOOT_CMD_SYNC, BOOT_ROW_SIZE);
+            break;
+
+        case BOOT_CMD_ERASE:
+            // The first row goes first, the application is gone from here on.
+            for (address = BOOT_APP_START; address != 0; address += BOOT_ROW_SIZE)
+            {
+                if (IsRowBlank (address) == false)
+                    EraseRow (address);
+            }
+            SendReply (BOOT_ACK, BOOT_CMD_ERASE, 0);
+            break;
+
+        case BOOT_CMD_WRITE:
+            address = g_Request[1] | ((uint16_t) g_Request[2] << 8);
+            if ((address < BOOT_APP_START) || (address & (BOOT_ROW_SIZE - 1))
+                || (WriteRow (address, &g_Request[3]) == false))
+            {
+                SendReply (BOOT_NAK, BOOT_CMD_WRITE, address);
+            }
+            else
+            {
+                SendReply (BOOT_ACK, BOOT_CMD_WRITE, address);
+            }
+            break;
+
+        case BOOT_CMD_VERIFY:
+            crc = AppCrc();
+            if (crc == (ReadFlashByte (BOOT_APP_CRC_ADDRESS) | ((uint16_t) ReadFlashByte (BOOT_APP_CRC_ADDRESS + 1) << 8)))
+            {
+                SendReply (BOOT_ACK, BOOT_CMD_VERIFY, crc);
+            }
+            else
+            {
+                EraseRow (BOOT_APP_START);
+                SendReply (BOOT_NAK, BOOT_CMD_VERIFY, crc);
+            }
+            break;
+
+        case BOOT_CMD_RUN:
+            if (IsAppPresent())
+            {
+                SendReply (BOOT_ACK, BOOT_CMD_RUN, 0);
+                RunApp();
+            }
+            SendReply (BOOT_NAK, BOOT_CMD_RUN, 0);
+            break;
+
+        default:
+            SendReply (BOOT_NAK, g_Request[0], 0);
+            break;
+    }
+}
+
+//-------------------------------
+// Function: IsAppPresent
+//
+// Description: The first row of the application is written last and
+//  erased when the application does not check out, so an application is
+//  present when its first word is not blank.
+//
+//-------------------------------
+static bool IsAppPresent (void)
+{
+    return (ReadFlashByte (BOOT_APP_START) != 0xff) || (ReadFlashByte (BOOT_APP_START + 1) != 0xff);
+}
+
+//-------------------------------
+// Function: AppCrc
+//
+// Description: Returns the CRC of the application as the linker's
+//  --checksum option works it out, see SelfTest.h.
+//
+//-------------------------------
+static uint16_t AppCrc (void)
+{
+    uint16_t address, crc;
+
+    crc = 0xffff;
+    for (address = BOOT_APP_START; address < BOOT_APP_CRC_ADDRESS; ++address)
+        crc = Crc16 (crc, ReadFlashByte (address));
+    return crc;
+}
+
+//-------------------------------
+// Function: IsRowBlank
+//
+//-------------------------------
+static bool IsRowBlank (uint16_t address)
+{
+    uint8_t i;
+
+    for (i = 0; i < BOOT_ROW_SIZE; ++i)
+    {
+        if (ReadFlashByte (address + i) != 0xff)
+            return false;
+    }
+    return true;
+}
+
+//-------------------------------
+// Function: EraseRow
+//
+//-------------------------------
+static void EraseRow (uint16_t address)
+{
+    TBLPTRU = 0;
+    TBLPTRH = (uint8_t) (address >> 8);
+    TBLPTRL = (uint8_t) address;
+    NVMCON1bits.NVMREG = NVM_PROGRAM_FLASH;
+    NVMCON1bits.FREE = 1;
+    StartNvm();
+}
+
+//-------------------------------
+// Function: WriteRow
+//
+// Description: Programs an erased row and reads it back.
+//
+// Returns: true if the row holds the data.
+//
+//-------------------------------
+static bool WriteRow (uint16_t address, const uint8_t *data)
+{
+    uint8_t i;
+
+    TBLPTRU = 0;
+    TBLPTRH = (uint8_t) (address >> 8);
+    TBLPTRL = (uint8_t) address;
+    for (i = 0; i < BOOT_ROW_SIZE; ++i)
+    {
+        TABLAT = data[i];
+        if (i < (BOOT_ROW_SIZE - 1))
+            asm ("TBLWT*+");
+        else
+            asm ("TBLWT*");     // TBLPTR must stay in the row.
+    }
+
+    NVMCON1bits.NVMREG = NVM_PROGRAM_FLASH;
+    NVMCON1bits.FREE = 0;
+    StartNvm();
+
+    for (i = 0; i < BOOT_ROW_SIZE; ++i)
+    {
+        if (ReadFlashByte (address + i) != data[i])
+            return false;
+    }
+    return true;
+}
+
+//-------------------------------
+// Function: StartNvm
+//
+// Description: Unlocks and starts the erase or write set up in NVMCON1.
+//  The CPU stops until it is done. Interrupts are never enabled here.
+//
+//-------------------------------
+static void StartNvm (void)
+{
+    NVMCON1bits.WREN = 1;
+    NVMCON2 = 0x55;
+    NVMCON2 = 0xAA;
+    NVMCON1bits.WR = 1;
+    NVMCON1bits.WREN = 0;
+}
+
+//-------------------------------
+// Function: ReadFlashByte
+//
+//-------------------------------
+static uint8_t ReadFlashByte (uint16_t address)
+{
+    TBLPTRU = 0;
+    TBLPTRH = (uint8_t) (address >> 8);
+    TBLPTRL = (uint8_t) address;
+    asm ("TBLRD*");
+    return TABLAT;
+}
+
+//-------------------------------
+// Function: Crc16
+//
+// Description: Adds a byte to a CRC-16/CCITT (polynomial 0x1021). A copy
+//  of SourceFiles/app/Crc16.c, the bootloader is built on its own.
+//
+//-------------------------------
+static uint16_t Crc16 (uint16_t crc, uint8_t data)
+{
+    uint8_t x;
+
+    x = (uint8_t) (crc >> 8) ^ data;
+    x ^= x >> 4;
+    return (crc << 8) ^ ((uint16_t) x << 12) ^ ((uint16_t) x << 5) ^ x;
+}
+
+//-------------------------------
+// Function: RunApp
+//
+// Description: Starts the application as if from a reset. The UART is
+//  left set up, the application sets it up again.
+//
+//-------------------------------
+static void RunApp (void)
+{
+    RC1STAbits.SPEN = 0;
+    asm ("goto " str(BOOT_APP_START));
+}
+
+// end of file.
+//-------------------------------------------------------------------------
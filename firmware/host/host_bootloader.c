@@ -0,0 +1,48 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Filename: host_bootloader.c
+//
+// Description: Builds bootloader/bootloader.c for the PC, as host_firmware.c
+//      does main.c. Its main() becomes BootloaderMain(), run by pty_sim
+//      --bootloader against the model's flash. The goto into the
+//      application ends the run, see HostAsm().
+//
+//  HOST_BOOTLOADER_SOURCE is the bootloader.c of the tree being built,
+//  given by tools/host_build.py when the tree has one.
+//
+// Author(s): G. Chopcinski (Kg Solutions, LLC)
+//
+// Created for ASL
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#ifdef HOST_BOOTLOADER_SOURCE
+
+#define main BootloaderMain
+#include HOST_BOOTLOADER_SOURCE
+#undef main
+
+#else
+
+/* ***************************    Includes     **************************** */
+
+// from stdlib
+#include <stdio.h>
+#include <stdlib.h>
+
+// from local
+#include "host_sim.h"
+
+/* *******************   Public Function Definitions   ******************** */
+
+// Older trees have no bootloader.
+int BootloaderMain (void)
+{
+    fprintf(stderr, "no bootloader in this tree\n");
+    exit(1);
+}
+
+#endif
+
+// end of file.
+//-------------------------------------------------------------------------
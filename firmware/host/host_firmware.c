@@ -0,0 +1,133 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Filename: host_firmware.c
+//
+// Description: Builds main.c for the PC. Its main() becomes FirmwareMain(),
+//      called by the host programs once the register model is set up, and
+//      the state and settings the tests look at are read from here, where
+//      main.c's file scope variables can be seen.
+//
+//  HOST_MAIN_SOURCE is the main.c of the tree being built, given by
+//  tools/host_build.py.
+//
+// Author(s): G. Chopcinski (Kg Solutions, LLC)
+//
+// Created for ASL
+//
+//////////////////////////////////////////////////////////////////////////////
+
+// Each pass of the control loop starts with LoopTimingMark(), so the calls
+// are counted for HostFirmwarePasses() on their way through.
+#define LoopTimingMark HostLoopTimingMark
+#define main FirmwareMain
+#include HOST_MAIN_SOURCE
+#undef main
+#undef LoopTimingMark
+
+#include "host_sim.h"
+
+/* *******************   Public Function Definitions   ******************** */
+
+uint8_t HostFirmwareState (void)
+{
+    return (uint8_t) gp_State;
+}
+
+// The FAULT_xxx bits seen, with 0x80 once the fault has latched. Older
+// trees have no failsafe monitor.
+uint8_t HostFirmwareFailsafe (void)
+{
+#ifdef FAILSAFE_PERSISTENCE
+    return GetFailsafeCause() | (IsFailsafeLatched() ? 0x80 : 0x00);
+#else
+    return 0;
+#endif
+}
+
+// Older trees do not time the loop, and their passes are not counted.
+#ifdef LOOP_TIMING_NUM_BINS
+static uint16_t g_Passes;
+
+void LoopTimingMark (uint8_t state);
+
+void HostLoopTimingMark (uint8_t state)
+{
+    ++g_Passes;
+    LoopTimingMark(state);
+}
+
+uint16_t HostFirmwarePasses (void)
+{
+    return g_Passes;
+}
+#else
+uint16_t HostFirmwarePasses (void)
+{
+    return 0;
+}
+#endif
+
+// The states that wait on the user. With the buttons released and the
+// joystick at rest the firmware should come to one of these.
+bool HostFirmwareAtRest (void)
+{
+    return (gp_State == DRIVING_STATE) || (gp_State == BLUETOOTH_STATE)
+        || (gp_State == DO_JOYSTICK_CALIBRATION_STATE) || (gp_State == FAULT_STATE);
+}
+
+// Older trees have the DAC limits as fixed values only, and no demand guard.
+#ifdef TUNE_NEUTRAL_DEMAND_MIN
+uint16_t HostNeutralDemand (void)
+{
+    return g_NeutralDemand;
+}
+
+uint16_t HostMinDacOutput (void)
+{
+    return g_MinDacOutput;
+}
+
+uint16_t HostMaxDacOutput (void)
+{
+    return g_MaxDacOutput;
+}
+
+uint8_t HostDemandGuardTrips (void)
+{
+    return GetDemandGuardTrips();
+}
+#else
+uint16_t HostNeutralDemand (void)
+{
+    return NEUTRAL_DEMAND_OUTPUT;
+}
+
+uint16_t HostMinDacOutput (void)
+{
+    return MIN_DAC_OUTPUT;
+}
+
+uint16_t HostMaxDacOutput (void)
+{
+    return MAX_DAC_OUTPUT;
+}
+
+uint8_t HostDemandGuardTrips (void)
+{
+    return 0;
+}
+#endif
+
+// Where the linker's flash CRC starts, see SelfTest.h. Older trees have no
+// self test to check it.
+uint16_t HostFlashCrcStart (void)
+{
+#ifdef SELFTEST_FLASH_START
+    return (uint16_t) SELFTEST_FLASH_START;
+#else
+    return 0x0800;
+#endif
+}
+
+// end of file.
+//-------------------------------------------------------------------------
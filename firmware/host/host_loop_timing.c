@@ -0,0 +1,125 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Filename: host_loop_timing.c
+//
+// Description: loop_timing_sim, times LoopTimingMark() and checks what it
+//      records for passes of known length.
+//
+//  loop_timing_sim <pass us> ...
+//
+//  With the fast and system ticks running as in the firmware, marks a pass
+//  of each length given, LOOP_TIMING_PASSES times, charging them in turn to
+//  the states 0 to LOOP_TIMING_NUM_STATES - 1. Prints, one per line:
+//
+//      tick_ns <BSP_FAST_TICK_NS>
+//      wrap_ms <LOOP_TIMING_WRAP_MS>
+//      mark <register accesses> <ns> taken by one LoopTimingMark(), the
+//          fewest of all the marks: a timer interrupt that lands in one is
+//          not its cost
+//      report <register accesses> <ns> taken by LOOP_TIMING_REPORT_PASSES
+//          calls of LoopTimingReport(), which queue one telemetry page
+//      histogram <16 counts>
+//      max <16 periods, fast ticks>
+//
+//  Only register accesses take simulated time (see host_build.py), so the
+//  cost of a mark is its timer reads; tools/host_test.py holds it against
+//  the shortest pass.
+//
+// Author(s): G. Chopcinski (Kg Solutions, LLC)
+//
+// Created for ASL
+//
+//////////////////////////////////////////////////////////////////////////////
+
+/* ***************************    Includes     **************************** */
+
+// from stdlib
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// from project
+#include "bsp.h"
+#include "LoopTiming.h"
+#include "Telemetry.h"
+
+// from local
+#include "host_sim.h"
+
+/* ******************************   Macros   ****************************** */
+
+#define LOOP_TIMING_PASSES (20)         // Marks per pass length given.
+#define END_US (3600000000UL)           // Far past any run, the program stops itself.
+
+/* ***********************   File Scope Variables   *********************** */
+
+static const HOST_TRACE_RECORD g_End = {END_US, HOST_IN_END, 0, 0};
+
+/* *******************   Public Function Definitions   ******************** */
+
+int main (int argc, char **argv)
+{
+    uint32_t accesses, fewestAccesses;
+    uint64_t start, ns, fewestNs;
+    uint8_t state;
+    int arg, pass, i;
+
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s <pass us> ...\n", argv[0]);
+        return 1;
+    }
+
+    HostSimInit(&g_End, 1);
+    bspInitCore();
+    TelemetryInit();
+    bspEnableInterrupts();
+    LoopTimingReset();
+
+    fewestAccesses = UINT32_MAX;
+    fewestNs = UINT64_MAX;
+    // The first mark only starts the timing; each one after it charges the
+    // pass that just ended to the state it is given.
+    LoopTimingMark(0);
+    state = 0;
+    for (arg = 1; arg < argc; ++arg)
+    {
+        for (pass = 0; pass < LOOP_TIMING_PASSES; ++pass)
+        {
+            HostDelayNs((uint32_t) (strtoul(argv[arg], NULL, 0) * 1000UL));
+
+            accesses = HostSimSfrAccesses();
+            start = HostSimNow();
+            LoopTimingMark(state);
+            ns = HostSimNow() - start;
+            accesses = HostSimSfrAccesses() - accesses;
+            if (accesses < fewestAccesses)
+                fewestAccesses = accesses;
+            if (ns < fewestNs)
+                fewestNs = ns;
+        }
+        state = (uint8_t) ((state + 1) % LOOP_TIMING_NUM_STATES);
+    }
+
+    printf("tick_ns %lu\n", (unsigned long) BSP_FAST_TICK_NS);
+    printf("wrap_ms %lu\n", (unsigned long) LOOP_TIMING_WRAP_MS);
+    printf("mark %u %llu\n", fewestAccesses, (unsigned long long) fewestNs);
+
+    accesses = HostSimSfrAccesses();
+    start = HostSimNow();
+    for (pass = 0; pass < LOOP_TIMING_REPORT_PASSES; ++pass)
+        LoopTimingReport();
+    printf("report %u %llu\n", HostSimSfrAccesses() - accesses, (unsigned long long) (HostSimNow() - start));
+
+    printf("histogram");
+    for (i = 0; i < LOOP_TIMING_NUM_BINS; ++i)
+        printf(" %u", g_LoopTiming.m_Histogram[i]);
+    printf("\nmax");
+    for (i = 0; i < LOOP_TIMING_NUM_STATES; ++i)
+        printf(" %u", g_LoopTiming.m_MaxPeriod[i]);
+    printf("\n");
+    return 0;
+}
+
+// end of file.
+//-------------------------------------------------------------------------
@@ -0,0 +1,103 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Filename: host_main.c
+//
+// Description: firmware_sim, runs the firmware on one input trace.
+//
+//  firmware_sim <input trace> <output trace> [<EEPROM dump>]
+//
+//  The input trace is mapped, not read, so long traces cost nothing to
+//  open. The run ends at the trace's END record, when the outputs (and the
+//  EEPROM, if asked for) are written. The exit code is 0 for a run that
+//  reached its END, 2 for one the model stopped (see HostFail()) and 1 for
+//  a bad trace or file.
+//
+// Author(s): G. Chopcinski (Kg Solutions, LLC)
+//
+// Created for ASL
+//
+//////////////////////////////////////////////////////////////////////////////
+
+/* ***************************    Includes     **************************** */
+
+// from stdlib
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// from local
+#include "host_sim.h"
+
+/* ***********************   File Scope Variables   *********************** */
+
+static const char *g_OutputPath;
+static const char *g_EepromPath;
+
+/* ***********************   Function Prototypes   ************************ */
+
+static void WriteResults (void);
+
+/* *******************   Public Function Definitions   ******************** */
+
+int main (int argc, char **argv)
+{
+    const HOST_TRACE_HEADER *header;
+    struct stat info;
+    void *map;
+    int file;
+
+    if ((argc < 3) || (argc > 4))
+    {
+        fprintf(stderr, "usage: %s <input trace> <output trace> [<EEPROM dump>]\n", argv[0]);
+        return 1;
+    }
+    g_OutputPath = argv[2];
+    g_EepromPath = (argc == 4) ? argv[3] : NULL;
+
+    file = open(argv[1], O_RDONLY);
+    if ((file < 0) || (fstat(file, &info) != 0) || (info.st_size < (off_t) sizeof(HOST_TRACE_HEADER)))
+    {
+        fprintf(stderr, "%s: can not read %s\n", argv[0], argv[1]);
+        return 1;
+    }
+    map = mmap(NULL, (size_t) info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (map == MAP_FAILED)
+    {
+        perror("mmap");
+        return 1;
+    }
+
+    header = map;
+    if ((header->m_Magic != HOST_TRACE_MAGIC) || (header->m_Version != HOST_TRACE_VERSION)
+        || (header->m_RecordSize != sizeof(HOST_TRACE_RECORD))
+        || ((off_t) (sizeof(*header) + (uint64_t) header->m_Count * sizeof(HOST_TRACE_RECORD)) > info.st_size))
+    {
+        fprintf(stderr, "%s: %s is not a version %d trace\n", argv[0], argv[1], HOST_TRACE_VERSION);
+        return 1;
+    }
+
+    HostSimInit((const HOST_TRACE_RECORD *) (header + 1), header->m_Count);
+    HostSimSetEndHook(WriteResults);
+    FirmwareMain();
+
+    // The firmware does not return; the END record or HostFail() ends the
+    // run through WriteResults().
+    return 1;
+}
+
+/* ********************   Private Function Definitions   ****************** */
+
+static void WriteResults (void)
+{
+    if (!HostSimWriteOutputs(g_OutputPath))
+        fprintf(stderr, "firmware_sim: can not write %s\n", g_OutputPath);
+    if ((g_EepromPath != NULL) && !HostSimWriteEeprom(g_EepromPath))
+        fprintf(stderr, "firmware_sim: can not write %s\n", g_EepromPath);
+}
+
+// end of file.
+//-------------------------------------------------------------------------
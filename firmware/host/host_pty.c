@@ -0,0 +1,285 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Filename: host_pty.c
+//
+// Description: pty_sim, runs the firmware on one input trace, as
+//      firmware_sim does, in real time and with its UART on a
+//      pseudo-terminal, so tools/livetune.py and telemetry_decode.py can be
+//      used with it as with a board.
+//
+//  pty_sim [--bootloader <flash in> <flash out>] <input trace> <output trace>
+//
+//  With --bootloader it runs bootloader/bootloader.c instead, for
+//  tools/uploader.py, on the flash image in <flash in>: HOST_FLASH_SIZE
+//  bytes, blank after a shorter file. The flash is written to <flash out>
+//  when the run ends, at the trace's end or when the bootloader starts the
+//  application.
+//
+//  Prints "pty <path>" once the terminal is open; open that path as the
+//  serial device. The bytes the firmware sends are written to it as they
+//  go out and the bytes written to it reach the firmware's receiver at the
+//  baud rate, PTY_POLL_US of simulated time at most after they were
+//  written. The simulated time is held back to the wall clock, so timeouts
+//  on the host side mean what they would with a board.
+//
+//  The inputs other than the UART come from the trace, which ends the run.
+//  The outputs are written then, the bytes sent on the UART included.
+//
+// Author(s): G. Chopcinski (Kg Solutions, LLC)
+//
+// Created for ASL
+//
+//////////////////////////////////////////////////////////////////////////////
+
+/* ***************************    Includes     **************************** */
+
+// from stdlib
+#define _XOPEN_SOURCE 600
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// from local
+#include "host_sim.h"
+
+/* ******************************   Macros   ****************************** */
+
+#define PTY_POLL_US (1000)              // Simulated time between looks at the terminal.
+#define PTY_TX_BUFFER (256)             // Bytes sent by the firmware, written out each look.
+#define PTY_DRAIN_MS (1000)             // Longest wait at the end for the last bytes to be read.
+
+/* ***********************   File Scope Variables   *********************** */
+
+static const char *g_OutputPath;
+static const char *g_FlashOutPath;      // --bootloader only.
+static int g_Master = -1;
+static int g_Slave = -1;                // Kept open, see OpenTerminal().
+static uint64_t g_WallStartNs;
+
+static uint8_t g_TxBuffer[PTY_TX_BUFFER];
+static uint32_t g_TxCount;
+
+/* ***********************   Function Prototypes   ************************ */
+
+static bool LoadFlash (const char *path);
+static bool OpenTerminal (void);
+static uint64_t WallNs (void);
+static void Poll (void);
+static void FlushTx (void);
+static void CollectTx (const HOST_TRACE_RECORD *record);
+static void WriteResults (void);
+
+/* *******************   Public Function Definitions   ******************** */
+
+int main (int argc, char **argv)
+{
+    const HOST_TRACE_HEADER *header;
+    const char *flashInPath = NULL;
+    struct stat info;
+    void *map;
+    int file;
+
+    if ((argc == 6) && (strcmp(argv[1], "--bootloader") == 0))
+    {
+        flashInPath = argv[2];
+        g_FlashOutPath = argv[3];
+        argv += 3;
+        argc -= 3;
+    }
+    if (argc != 3)
+    {
+        fprintf(stderr, "usage: %s [--bootloader <flash in> <flash out>] <input trace> <output trace>\n", argv[0]);
+        return 1;
+    }
+    g_OutputPath = argv[2];
+
+    file = open(argv[1], O_RDONLY);
+    if ((file < 0) || (fstat(file, &info) != 0) || (info.st_size < (off_t) sizeof(HOST_TRACE_HEADER)))
+    {
+        fprintf(stderr, "%s: can not read %s\n", argv[0], argv[1]);
+        return 1;
+    }
+    map = mmap(NULL, (size_t) info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (map == MAP_FAILED)
+    {
+        perror("mmap");
+        return 1;
+    }
+
+    header = map;
+    if ((header->m_Magic != HOST_TRACE_MAGIC) || (header->m_Version != HOST_TRACE_VERSION)
+        || (header->m_RecordSize != sizeof(HOST_TRACE_RECORD))
+        || ((off_t) (sizeof(*header) + (uint64_t) header->m_Count * sizeof(HOST_TRACE_RECORD)) > info.st_size))
+    {
+        fprintf(stderr, "%s: %s is not a version %d trace\n", argv[0], argv[1], HOST_TRACE_VERSION);
+        return 1;
+    }
+
+    if (!OpenTerminal())
+        return 1;
+
+    HostSimInit((const HOST_TRACE_RECORD *) (header + 1), header->m_Count);
+    if ((flashInPath != NULL) && !LoadFlash(flashInPath))
+        return 1;
+    HostSimSetOutputHook(CollectTx);
+    HostSimSetEndHook(WriteResults);
+    HostSimSetTimeHook(PTY_POLL_US * 1000ULL, Poll);
+    g_WallStartNs = WallNs();
+    if (flashInPath != NULL)
+        BootloaderMain();
+    else
+        FirmwareMain();
+    return 1;
+}
+
+/* ********************   Private Function Definitions   ****************** */
+
+static bool LoadFlash (const char *path)
+{
+    uint8_t *flash = HostSimFlash();
+    FILE *f;
+
+    f = fopen(path, "rb");
+    if (f == NULL)
+    {
+        perror(path);
+        return false;
+    }
+    memset(flash, 0xff, HOST_FLASH_SIZE);
+    fread(flash, 1, HOST_FLASH_SIZE, f);
+    fclose(f);
+    return true;
+}
+
+//-------------------------------
+// Function: OpenTerminal
+//
+// Description: Opens a pseudo-terminal and prints the path of its far end.
+//  That end is put in raw mode and kept open here, so nothing is echoed or
+//  changed on the way and the firmware's bytes are not refused while no
+//  one has it open.
+//
+//-------------------------------
+static bool OpenTerminal (void)
+{
+    struct termios attrs;
+    const char *path;
+
+    g_Master = posix_openpt(O_RDWR | O_NOCTTY);
+    if ((g_Master < 0) || (grantpt(g_Master) != 0) || (unlockpt(g_Master) != 0) || ((path = ptsname(g_Master)) == NULL))
+    {
+        perror("pty_sim: posix_openpt");
+        return false;
+    }
+    g_Slave = open(path, O_RDWR | O_NOCTTY);
+    if ((g_Slave < 0) || (tcgetattr(g_Slave, &attrs) != 0))
+    {
+        perror("pty_sim: open pty");
+        return false;
+    }
+    cfmakeraw(&attrs);
+    tcsetattr(g_Slave, TCSANOW, &attrs);
+    fcntl(g_Master, F_SETFL, fcntl(g_Master, F_GETFL) | O_NONBLOCK);
+
+    printf("pty %s\n", path);
+    fflush(stdout);
+    return true;
+}
+
+static uint64_t WallNs (void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000ULL + (uint64_t) now.tv_nsec;
+}
+
+//-------------------------------
+// Function: Poll
+//
+// Description: Every PTY_POLL_US of simulated time: waits for the wall
+//  clock to catch up, writes out what the firmware has sent and passes on
+//  what has been written to the terminal.
+//
+//-------------------------------
+static void Poll (void)
+{
+    uint8_t data[64];
+    uint64_t wall, now;
+    ssize_t count;
+
+    now = HostSimNow();
+    wall = WallNs() - g_WallStartNs;
+    if (now > wall)
+    {
+        struct timespec wait = {(time_t) ((now - wall) / 1000000000ULL), (long) ((now - wall) % 1000000000ULL)};
+        nanosleep(&wait, NULL);
+    }
+
+    FlushTx();
+    while ((count = read(g_Master, data, sizeof(data))) > 0)
+        HostSimUartInput(data, (uint32_t) count);
+
+    HostSimSetTimeHook(now + PTY_POLL_US * 1000ULL, Poll);
+}
+
+static void FlushTx (void)
+{
+    ssize_t written;
+    uint32_t done;
+
+    for (done = 0; done < g_TxCount; done += (uint32_t) written)
+    {
+        written = write(g_Master, g_TxBuffer + done, g_TxCount - done);
+        if (written <= 0)
+            break;          // Full, no one reading: the bytes are lost, as on a wire.
+    }
+    g_TxCount = 0;
+}
+
+static void CollectTx (const HOST_TRACE_RECORD *record)
+{
+    if (record->m_Type != HOST_OUT_UART_TX)
+        return;
+    if (g_TxCount == PTY_TX_BUFFER)
+        FlushTx();
+    g_TxBuffer[g_TxCount++] = (uint8_t) record->m_Value;
+}
+
+static void WriteResults (void)
+{
+    struct timespec wait = {0, 1000000L};
+    FILE *f;
+    int waiting, i;
+
+    // Closing the terminal drops what has not been read yet, such as the
+    // bootloader's answer to the request that ended the run.
+    FlushTx();
+    for (i = 0; i < PTY_DRAIN_MS; ++i)
+    {
+        if ((ioctl(g_Slave, FIONREAD, &waiting) != 0) || (waiting == 0))
+            break;
+        nanosleep(&wait, NULL);
+    }
+
+    if (!HostSimWriteOutputs(g_OutputPath))
+        fprintf(stderr, "pty_sim: can not write %s\n", g_OutputPath);
+    if (g_FlashOutPath == NULL)
+        return;
+    f = fopen(g_FlashOutPath, "wb");
+    if ((f == NULL) || (fwrite(HostSimFlash(), 1, HOST_FLASH_SIZE, f) != HOST_FLASH_SIZE))
+        fprintf(stderr, "pty_sim: can not write %s\n", g_FlashOutPath);
+    if (f != NULL)
+        fclose(f);
+}
+
+// end of file.
+//-------------------------------------------------------------------------
@@ -0,0 +1,1254 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Filename: host_sim.c
+//
+// Description: Register model of the PIC18F46K40 and the board around it.
+//      The firmware, built for the PC by tools/host_build.py, reaches every
+//      register through HostSfr(), so this is where simulated time passes
+//      and the peripherals it uses are run:
+//
+//  - Timer 1 and Timer 2 (the fast tick and the system tick interrupt)
+//  - the ADC, reading the joystick inputs from the input trace
+//  - EUSART1, fed from the input trace or HostSimUartInput()
+//  - the data EEPROM and the program flash, with the unlock sequence
+//  - PORTB buttons, and the DAC, Bluetooth, beeper and reset outputs
+//    decoded from LATx as the firmware drives them
+//  - the FSR indirect registers and the table read and write latches
+//
+//  Each access costs ACCESS_CYCLES instruction cycles; the code in between
+//  takes none. The low priority interrupt runs before any access once it
+//  is enabled and pending, as the chip would between instructions.
+//
+//  A write through the pointer HostSfr() returns has not happened yet when
+//  it returns. What it did is picked up by Settle() on the next access.
+//
+// Author(s): G. Chopcinski (Kg Solutions, LLC)
+//
+// Created for ASL
+//
+//////////////////////////////////////////////////////////////////////////////
+
+/* ***************************    Includes     **************************** */
+
+// from stdlib
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// from project
+#include "clock_bsp.h"
+#include "host_sfr.h"
+
+// from local
+#include "host_sim.h"
+
+/* ******************************   Macros   ****************************** */
+
+#define SFR(name) (g_Sfr[HOST_SFR_##name])
+#define SFR16(name) (*(uint16_t *) &g_Sfr[HOST_SFR_##name])
+
+#define PS_PER_NS (1000ULL)
+#define PS_PER_US (1000000ULL)
+#define PS_PER_MS (1000000000ULL)
+
+#define ACCESS_CYCLES (4)               // Instruction cycles charged per register access.
+#define TCY_PS ((uint64_t) CLOCK_TCY_PS)
+#define FOSC_PS (TCY_PS / 4)
+#define ACCESS_PS (ACCESS_CYCLES * TCY_PS)
+#define CORE_ACCESS_PS (TCY_PS)         // FSRs, INDFs, PROD, TABLAT and the like, see HostSfr().
+
+#define ADC_FRC_TAD_PS (2 * PS_PER_US)  // The ADC's own RC clock, about 2 us.
+#define ADC_CONVERSION_TAD (12)         // 11.5 TAD rounded up.
+#define EEPROM_WRITE_PS (4 * PS_PER_MS) // Data EEPROM byte write time.
+#define FLASH_WRITE_PS (2 * PS_PER_MS)  // Flash row erase or write, the CPU stalls.
+#define SLEEP_LIMIT_PS (1000 * PS_PER_MS)
+#define UART_RX_FIFO (2)
+
+#define NVMREG_EEPROM (0)
+#define NVMREG_FLASH (2)
+
+#define NEUTRAL_INPUT (0x202)           // Joystick inputs before the trace sets them.
+#define NOISE_SEED (0x2545f491UL)
+
+#define NOT_PENDING (0)
+#define NEVER (UINT64_MAX)
+
+// Outputs decoded from the port latches.
+#define BT_FORWARD (0x01)
+#define BT_REVERSE (0x02)
+#define BT_LEFT (0x04)
+#define BT_RIGHT (0x08)
+#define BT_RIGHT_CLICK (0x10)
+#define BT_LEFT_CLICK (0x20)
+
+/* ******************************   Types   ******************************* */
+
+// One of the LTC1257s, shifted on the clock's rising edge and loaded when
+// the latch goes low.
+typedef struct
+{
+    uint8_t m_LatchBit;
+    uint8_t m_DataBit;
+    uint8_t m_ClockBit;
+    uint16_t m_Shift;
+    uint16_t m_Value;
+} DAC_MODEL;
+
+typedef struct
+{
+    uint8_t m_Data;
+    uint64_t m_ArrivalPs;
+} UART_BYTE;
+
+/* ***********************   File Scope Variables   *********************** */
+
+static uint8_t g_Sfr[0x1000];           // SFRs at their addresses
+static uint8_t g_DataRam[0x1000];       // What the FSRs point to
+static uint8_t g_Eeprom[HOST_EEPROM_SIZE];
+static uint8_t g_Flash[HOST_FLASH_SIZE];
+static uint8_t g_WriteLatch[HOST_FLASH_ROW];
+
+static uint64_t g_NowPs;
+static uint64_t g_NextEventPs;
+static uint32_t g_Accesses;
+static bool g_InIsr;
+static bool g_Finishing;
+
+// Writes and side effects waiting for Settle().
+static uint16_t g_Slot24Address;        // HostSfr24() register being written, 0 for none
+static uint32_t g_Slot24;
+static int8_t g_FsrStep[3];             // POSTINC/POSTDEC still to apply to FSR0 to FSR2
+static bool g_TxPending;
+static bool g_RxPopPending;
+static bool g_Nvmcon2Pending;
+static uint8_t g_UnlockStep;            // 2 once 0x55, 0xAA have been written to NVMCON2
+
+// Snapshots the watched registers are compared against.
+static uint8_t g_LastLat[5];            // LATA to LATE
+static uint8_t g_LastTris[5];           // TRISA to TRISE
+static uint8_t g_LastAdcon0;
+static uint8_t g_LastNvmcon1;
+static uint8_t g_LastRc1sta;
+static uint8_t g_LastBluetooth;
+static uint8_t g_LastBeeper;
+static uint8_t g_LastReset;
+static uint8_t g_LastState;
+static uint8_t g_LastFailsafe;
+
+static DAC_MODEL g_Dac[2] =
+{
+    {4, 5, 6, 0, 0},                    // Forward/back: latch RD4, data RD5, clock RD6
+    {7, 2, 1, 0, 0},                    // Left/right: latch RD7, data RD2, clock RD1
+};
+
+// Inputs
+static const HOST_TRACE_RECORD *g_Inputs;
+static HOST_TRACE_RECORD *g_OwnInputs;  // Set when HostSimReplaceInputs() made a copy
+static uint32_t g_InputCount;
+static uint32_t g_NextInput;
+static uint64_t g_InputOffsetPs;
+static uint16_t g_Analog[2];
+static uint16_t g_Noise[2];
+static bool g_AdcStalled[2];
+static uint32_t g_NoiseState;
+static uint8_t g_Buttons;
+static uint64_t g_PressedPs[8];
+static uint64_t g_LastInputPs;
+static uint64_t g_LastPortReadPs;
+
+// Peripherals
+static uint64_t g_Timer1StartPs;
+static bool g_Timer1On;
+static uint64_t g_Timer2NextPs;
+static uint64_t g_AdcDonePs;
+static uint16_t g_AdcResult;
+static uint64_t g_EepromDonePs;
+static uint64_t g_TxDonePs;
+static uint8_t g_TxShift;
+static bool g_TxBufferFull;
+static uint8_t g_TxBuffer;
+static uint8_t g_RxFifo[UART_RX_FIFO];
+static uint8_t g_RxCount;
+static UART_BYTE *g_RxQueue;
+static uint32_t g_RxQueueHead;
+static uint32_t g_RxQueueCount;
+static uint32_t g_RxQueueSize;
+
+// Outputs
+static HOST_TRACE_RECORD *g_Outputs;
+static uint32_t g_OutputCount;
+static uint32_t g_OutputSize;
+static HOST_OUTPUT_HOOK g_OutputHook;
+static void (*g_EndHook)(void);
+static void (*g_TimeHook)(void);
+static uint64_t g_TimeHookPs = NEVER;
+
+/* ***********************   Function Prototypes   ************************ */
+
+static void Settle (void);
+static void Advance (uint64_t ps);
+static void RunEvents (void);
+static void DispatchInterrupt (void);
+static bool InterruptPending (bool anyPriority);
+static void ApplyInput (const HOST_TRACE_RECORD *input);
+static void WatchPorts (void);
+static void WatchNvm (void);
+static void WatchAdc (void);
+static void UartTransmit (uint8_t data);
+static uint64_t UartBytePs (void);
+static void UartReceiveDue (void);
+static void UpdateUartFlags (void);
+static uint16_t AdcSample (uint8_t channel);
+static void Emit (uint8_t type, uint8_t channel, uint16_t value);
+static void Finish (int code);
+
+/* *******************   Public Function Definitions   ******************** */
+
+//-------------------------------
+// Function: HostSfr
+//
+// Description: Returns where the register at address is read or written.
+//  Everything the model does happens from here.
+//
+//-------------------------------
+void *HostSfr (uint16_t address)
+{
+    uint8_t fsr;
+
+    // The core registers from FSR2L up are in the access bank and are the
+    // operands of single cycle instructions; a loop through INDF/POSTINC
+    // charged as banked C accesses would hold interrupts off four times as
+    // long as on the chip.
+    Settle();
+    Advance((address >= HOST_SFR_FSR2L) ? CORE_ACCESS_PS : ACCESS_PS);
+
+    if (!g_InIsr && InterruptPending(false))
+    {
+        DispatchInterrupt();
+        Settle();
+    }
+
+    ++g_Accesses;
+    switch (address)
+    {
+        case HOST_SFR_PORTB:
+            SFR(PORTB) = (uint8_t) ~g_Buttons;
+            g_LastPortReadPs = g_NowPs;
+            break;
+
+        case HOST_SFR_TMR1L:
+            if (g_Timer1On)
+            {
+                uint64_t count = (g_NowPs - g_Timer1StartPs) / (TCY_PS << ((SFR(T1CON) & _T1CON_CKPS_MASK) >> _T1CON_CKPS_POSN));
+                SFR(TMR1L) = (uint8_t) count;
+                SFR(TMR1H) = (uint8_t) (count >> 8);
+            }
+            break;
+
+        case HOST_SFR_RC1REG:
+            SFR(RC1REG) = g_RxFifo[0];
+            g_RxPopPending = (g_RxCount != 0);
+            break;
+
+        case HOST_SFR_TX1REG:
+            g_TxPending = true;
+            break;
+
+        case HOST_SFR_NVMCON2:
+            g_Nvmcon2Pending = true;
+            break;
+
+        case HOST_SFR_NVMCON1:
+            break;
+
+        default:
+            // The indirect registers: INDFn, POSTINCn, POSTDECn, PREINCn and
+            // PLUSWn for n = 2, 1, 0 sit in eight byte groups from 0xFDB.
+            if ((address >= HOST_SFR_PLUSW2) && (address <= HOST_SFR_INDF0) && ((address & 0x07) >= 0x03))
+            {
+                static const uint16_t fsrAddress[3] = {HOST_SFR_FSR0, HOST_SFR_FSR1, HOST_SFR_FSR2};
+                uint16_t *pointer;
+
+                fsr = (uint8_t) (2 - ((address - HOST_SFR_PLUSW2) >> 3));
+                pointer = (uint16_t *) &g_Sfr[fsrAddress[fsr]];
+                switch (address & 0x07)
+                {
+                    case 0x07: // INDFn
+                        return &g_DataRam[*pointer & 0xfff];
+                    case 0x06: // POSTINCn
+                        ++g_FsrStep[fsr];
+                        return &g_DataRam[*pointer & 0xfff];
+                    case 0x05: // POSTDECn
+                        --g_FsrStep[fsr];
+                        return &g_DataRam[*pointer & 0xfff];
+                    case 0x04: // PREINCn
+                        *pointer = (uint16_t) (*pointer + 1);
+                        return &g_DataRam[*pointer & 0xfff];
+                    default:   // PLUSWn
+                        return &g_DataRam[(*pointer + (int8_t) SFR(WREG)) & 0xfff];
+                }
+            }
+            g_UnlockStep = 0;   // Anything else between the unlock and WR breaks it.
+            break;
+    }
+    return &g_Sfr[address];
+}
+
+//-------------------------------
+// Function: HostSfr24
+//
+// Description: As HostSfr() for the 24 bit registers, which are held in a
+//  slot and copied back to their three bytes on the next access.
+//
+//-------------------------------
+void *HostSfr24 (uint16_t address)
+{
+    HostSfr(address);
+    g_Slot24 = (uint32_t) g_Sfr[address] | ((uint32_t) g_Sfr[address + 1] << 8) | ((uint32_t) g_Sfr[address + 2] << 16);
+    g_Slot24Address = address;
+    return &g_Slot24;
+}
+
+//-------------------------------
+// Function: HostAsm
+//
+// Description: Runs the inline instructions the firmware and the
+//  bootloader use: the table reads and writes, and the bootloader's goto
+//  into the application, which ends the run with a HOST_OUT_JUMP.
+//
+//-------------------------------
+void HostAsm (const char *instruction)
+{
+    uint32_t pointer;
+
+    HostSfr(HOST_SFR_TABLAT);
+    pointer = (uint32_t) SFR(TBLPTRL) | ((uint32_t) SFR(TBLPTRH) << 8) | ((uint32_t) SFR(TBLPTRU) << 16);
+
+    if (strncmp(instruction, "TBLRD*", 6) == 0)
+    {
+        SFR(TABLAT) = (pointer < HOST_FLASH_SIZE) ? g_Flash[pointer] : 0xff;
+    }
+    else if (strncmp(instruction, "TBLWT*", 6) == 0)
+    {
+        g_WriteLatch[pointer % HOST_FLASH_ROW] = SFR(TABLAT);
+    }
+    else if (strncmp(instruction, "goto ", 5) == 0)
+    {
+        Emit(HOST_OUT_JUMP, 0, (uint16_t) strtoul(instruction + 5, NULL, 0));
+        Finish(0);
+        return;
+    }
+    else
+    {
+        fprintf(stderr, "host_sim: unknown instruction \"%s\"\n", instruction);
+        HostFail(HOST_FAIL_ASM);
+        return;
+    }
+
+    if (instruction[6] == '+')
+    {
+        ++pointer;
+        SFR(TBLPTRL) = (uint8_t) pointer;
+        SFR(TBLPTRH) = (uint8_t) (pointer >> 8);
+        SFR(TBLPTRU) = (uint8_t) (pointer >> 16);
+    }
+}
+
+//-------------------------------
+// Function: HostSleep
+//
+// Description: SLEEP. Waits for an enabled interrupt flag, whether or not
+//  interrupts are on, as the chip does.
+//
+//-------------------------------
+void HostSleep (void)
+{
+    uint64_t limit;
+
+    Settle();
+    limit = g_NowPs + SLEEP_LIMIT_PS;
+    while (!InterruptPending(true))
+    {
+        if (g_NowPs > limit)
+        {
+            HostFail(HOST_FAIL_SLEEP);
+            return;
+        }
+        Advance(TCY_PS);
+    }
+}
+
+//-------------------------------
+// Function: HostDelayNs
+//
+// Description: __delay_us() and __delay_ms(). As on the chip, interrupts
+//  are taken during the delay, and the time they take lengthens it.
+//
+//-------------------------------
+void HostDelayNs (uint32_t ns)
+{
+    uint64_t end, start;
+
+    Settle();
+    end = g_NowPs + (uint64_t) ns * PS_PER_NS;
+    while (g_NowPs < end)
+    {
+        Advance(((g_NextEventPs > g_NowPs) && (g_NextEventPs < end)) ? (g_NextEventPs - g_NowPs) : (end - g_NowPs));
+        if (!g_InIsr && InterruptPending(false))
+        {
+            start = g_NowPs;
+            DispatchInterrupt();
+            Settle();
+            end += g_NowPs - start;
+        }
+    }
+}
+
+//-------------------------------
+// Function: HostSimInit
+//
+// Description: Resets the model. The inputs are not copied and must stay
+//  in place for the run; EEPROM records are applied now.
+//
+//-------------------------------
+void HostSimInit (const HOST_TRACE_RECORD *inputs, uint32_t count)
+{
+    uint32_t i;
+    uint16_t crc;
+
+    memset(g_Sfr, 0, sizeof(g_Sfr));
+    memset(&g_Sfr[HOST_SFR_TRISA], 0xff, 5);
+    SFR(IPR0) = SFR(IPR1) = SFR(IPR2) = SFR(IPR3) = 0xff;
+    SFR(IPR4) = SFR(IPR5) = SFR(IPR6) = SFR(IPR7) = 0xff;
+    SFR(PR2) = 0xff;
+    SFR(TX1STA) = _TX1STA_TRMT_MASK;
+    memcpy(g_LastTris, &g_Sfr[HOST_SFR_TRISA], sizeof(g_LastTris));
+
+    memset(g_Eeprom, 0xff, sizeof(g_Eeprom));
+    memset(g_WriteLatch, 0xff, sizeof(g_WriteLatch));
+
+    // Blank flash with the image CRC at the end, as the checksum option in
+    // the Release configurations places it (see SelfTest.c).
+    memset(g_Flash, 0xff, sizeof(g_Flash));
+    crc = 0xffff;
+    for (i = HostFlashCrcStart(); i < 0xfffe; ++i)
+    {
+        uint8_t bit;
+
+        crc ^= (uint16_t) g_Flash[i] << 8;
+        for (bit = 0; bit < 8; ++bit)
+            crc = (crc & 0x8000) ? (uint16_t) ((crc << 1) ^ 0x1021) : (uint16_t) (crc << 1);
+    }
+    g_Flash[0xfffe] = (uint8_t) crc;
+    g_Flash[0xffff] = (uint8_t) (crc >> 8);
+
+    g_Inputs = inputs;
+    g_InputCount = count;
+    for (i = 0; i < count; ++i)
+    {
+        if (inputs[i].m_Type == HOST_IN_EEPROM)
+            g_Eeprom[(inputs[i].m_Channel | (inputs[i].m_Value & 0x300)) % HOST_EEPROM_SIZE] = (uint8_t) inputs[i].m_Value;
+    }
+
+    g_Analog[0] = g_Analog[1] = NEUTRAL_INPUT;
+    g_NoiseState = NOISE_SEED;
+    g_LastBeeper = 0;
+    g_LastReset = 0;
+    g_LastState = HostFirmwareState();
+    g_LastFailsafe = HostFirmwareFailsafe();
+    g_NextEventPs = 0;
+    g_Timer2NextPs = NEVER;
+    g_AdcDonePs = NEVER;
+    g_EepromDonePs = NEVER;
+    g_TxDonePs = NEVER;
+}
+
+void HostSimSetOutputHook (HOST_OUTPUT_HOOK hook)
+{
+    g_OutputHook = hook;
+}
+
+void HostSimSetEndHook (void (*hook)(void))
+{
+    g_EndHook = hook;
+}
+
+//-------------------------------
+// Function: HostSimSetTimeHook
+//
+// Description: Calls hook once, from the first register access at or after
+//  ns from reset.
+//
+//-------------------------------
+void HostSimSetTimeHook (uint64_t ns, void (*hook)(void))
+{
+    g_TimeHook = hook;
+    g_TimeHookPs = ns * PS_PER_NS;
+    g_NextEventPs = 0;
+}
+
+//-------------------------------
+// Function: HostSimReplaceInputs
+//
+// Description: Drops the inputs not yet applied and takes these instead,
+//  their times offset by offsetNs. They are copied.
+//
+//-------------------------------
+void HostSimReplaceInputs (const HOST_TRACE_RECORD *inputs, uint32_t count, uint64_t offsetNs)
+{
+    free(g_OwnInputs);
+    g_OwnInputs = malloc((count ? count : 1) * sizeof(HOST_TRACE_RECORD));
+    memcpy(g_OwnInputs, inputs, count * sizeof(HOST_TRACE_RECORD));
+    g_Inputs = g_OwnInputs;
+    g_InputCount = count;
+    g_NextInput = 0;
+    g_InputOffsetPs = offsetNs * PS_PER_NS;
+    g_NextEventPs = 0;
+}
+
+//-------------------------------
+// Function: HostSimUartInput
+//
+// Description: Sends bytes to the firmware's UART, back to back from now.
+//
+//-------------------------------
+void HostSimUartInput (const uint8_t *data, uint32_t length)
+{
+    uint64_t arrival;
+    uint32_t i;
+
+    arrival = g_NowPs;
+    if (g_RxQueueCount != 0)
+        arrival = g_RxQueue[(g_RxQueueHead + g_RxQueueCount - 1) % g_RxQueueSize].m_ArrivalPs;
+
+    for (i = 0; i < length; ++i)
+    {
+        if (g_RxQueueCount == g_RxQueueSize)
+        {
+            UART_BYTE *queue;
+            uint32_t j, size;
+
+            size = g_RxQueueSize ? g_RxQueueSize * 2 : 256;
+            queue = malloc(size * sizeof(UART_BYTE));
+            for (j = 0; j < g_RxQueueCount; ++j)
+                queue[j] = g_RxQueue[(g_RxQueueHead + j) % g_RxQueueSize];
+            free(g_RxQueue);
+            g_RxQueue = queue;
+            g_RxQueueSize = size;
+            g_RxQueueHead = 0;
+        }
+        arrival += UartBytePs();
+        g_RxQueue[(g_RxQueueHead + g_RxQueueCount) % g_RxQueueSize].m_Data = data[i];
+        g_RxQueue[(g_RxQueueHead + g_RxQueueCount) % g_RxQueueSize].m_ArrivalPs = arrival;
+        ++g_RxQueueCount;
+    }
+    g_NextEventPs = 0;
+}
+
+//-------------------------------
+// Function: HostSimWriteOutputs
+//
+// Description: Writes the outputs so far as a trace file.
+//
+//-------------------------------
+bool HostSimWriteOutputs (const char *path)
+{
+    HOST_TRACE_HEADER header;
+    FILE *file;
+    bool ok;
+
+    file = fopen(path, "wb");
+    if (file == NULL)
+        return false;
+
+    memset(&header, 0, sizeof(header));
+    header.m_Magic = HOST_TRACE_MAGIC;
+    header.m_Version = HOST_TRACE_VERSION;
+    header.m_RecordSize = sizeof(HOST_TRACE_RECORD);
+    header.m_Count = g_OutputCount;
+    ok = (fwrite(&header, sizeof(header), 1, file) == 1);
+    if (g_OutputCount != 0)
+        ok = ok && (fwrite(g_Outputs, sizeof(HOST_TRACE_RECORD), g_OutputCount, file) == g_OutputCount);
+    return (fclose(file) == 0) && ok;
+}
+
+bool HostSimWriteEeprom (const char *path)
+{
+    FILE *file;
+    bool ok;
+
+    file = fopen(path, "wb");
+    if (file == NULL)
+        return false;
+    ok = (fwrite(g_Eeprom, sizeof(g_Eeprom), 1, file) == 1);
+    return (fclose(file) == 0) && ok;
+}
+
+//-------------------------------
+// Function: HostFail
+//
+// Description: Records why the run can not go on and ends it.
+//
+//-------------------------------
+void HostFail (uint16_t reason)
+{
+    Emit(HOST_OUT_FAIL, 0, reason);
+    Finish(2);
+}
+
+uint64_t HostSimNow (void)
+{
+    return g_NowPs / PS_PER_NS;
+}
+
+uint16_t HostSimDac (uint8_t channel)
+{
+    return g_Dac[channel & 1].m_Value;
+}
+
+uint8_t HostSimButtons (void)
+{
+    return g_Buttons;
+}
+
+uint64_t HostSimButtonHeldNs (uint8_t button)
+{
+    uint8_t bit;
+
+    for (bit = 0; bit < 8; ++bit)
+    {
+        if (button == (1 << bit))
+            return (g_Buttons & button) ? (g_NowPs - g_PressedPs[bit]) / PS_PER_NS : 0;
+    }
+    return 0;
+}
+
+uint64_t HostSimInputsQuietNs (void)
+{
+    return (g_NowPs - g_LastInputPs) / PS_PER_NS;
+}
+
+uint64_t HostSimLastPortRead (void)
+{
+    return g_LastPortReadPs / PS_PER_NS;
+}
+
+uint8_t HostSimEeprom (uint16_t address)
+{
+    return g_Eeprom[address % HOST_EEPROM_SIZE];
+}
+
+uint8_t *HostSimFlash (void)
+{
+    return g_Flash;
+}
+
+uint32_t HostSimSfrAccesses (void)
+{
+    return g_Accesses;
+}
+
+// Stand ins for the programs that are not linked with the firmware.
+__attribute__((weak)) uint8_t HostFirmwareState (void)
+{
+    return 0;
+}
+
+__attribute__((weak)) uint8_t HostFirmwareFailsafe (void)
+{
+    return 0;
+}
+
+__attribute__((weak)) uint16_t HostFirmwarePasses (void)
+{
+    return 0;
+}
+
+__attribute__((weak)) void bspLowPriorityIsr (void)
+{
+}
+
+/* ********************   Private Function Definitions   ****************** */
+
+//-------------------------------
+// Function: Settle
+//
+// Description: Carries out what the accesses since the last one did.
+//
+//-------------------------------
+static void Settle (void)
+{
+    uint8_t state, failsafe;
+
+    if (g_Slot24Address != NOT_PENDING)
+    {
+        g_Sfr[g_Slot24Address] = (uint8_t) g_Slot24;
+        g_Sfr[g_Slot24Address + 1] = (uint8_t) (g_Slot24 >> 8);
+        g_Sfr[g_Slot24Address + 2] = (uint8_t) (g_Slot24 >> 16);
+        g_Slot24Address = NOT_PENDING;
+    }
+
+    if (g_FsrStep[0] | g_FsrStep[1] | g_FsrStep[2])
+    {
+        SFR16(FSR0) = (uint16_t) (SFR16(FSR0) + g_FsrStep[0]);
+        SFR16(FSR1) = (uint16_t) (SFR16(FSR1) + g_FsrStep[1]);
+        SFR16(FSR2) = (uint16_t) (SFR16(FSR2) + g_FsrStep[2]);
+        g_FsrStep[0] = g_FsrStep[1] = g_FsrStep[2] = 0;
+    }
+
+    if (g_TxPending)
+    {
+        g_TxPending = false;
+        UartTransmit(SFR(TX1REG));
+    }
+    if (g_RxPopPending)
+    {
+        g_RxPopPending = false;
+        --g_RxCount;
+        g_RxFifo[0] = g_RxFifo[1];
+        UpdateUartFlags();
+    }
+    if (g_Nvmcon2Pending)
+    {
+        g_Nvmcon2Pending = false;
+        if (SFR(NVMCON2) == 0x55)
+            g_UnlockStep = 1;
+        else
+            g_UnlockStep = ((SFR(NVMCON2) == 0xaa) && (g_UnlockStep == 1)) ? 2 : 0;
+    }
+
+    if ((memcmp(g_LastLat, &g_Sfr[HOST_SFR_LATA], sizeof(g_LastLat)) != 0)
+        || (memcmp(g_LastTris, &g_Sfr[HOST_SFR_TRISA], sizeof(g_LastTris)) != 0))
+    {
+        WatchPorts();
+    }
+    if (SFR(NVMCON1) != g_LastNvmcon1)
+        WatchNvm();
+    if (SFR(ADCON0) != g_LastAdcon0)
+        WatchAdc();
+    if (SFR(RC1STA) != g_LastRc1sta)
+    {
+        if (!(SFR(RC1STA) & _RC1STA_CREN_MASK))
+            SFR(RC1STA) &= (uint8_t) ~_RC1STA_OERR_MASK;
+        g_LastRc1sta = SFR(RC1STA);
+    }
+
+    if ((SFR(T1CON) & _T1CON_ON_MASK) && !g_Timer1On)
+        g_Timer1StartPs = g_NowPs;
+    g_Timer1On = (SFR(T1CON) & _T1CON_ON_MASK) != 0;
+    if ((SFR(T2CON) & _T2CON_ON_MASK) && (g_Timer2NextPs == NEVER))
+    {
+        g_Timer2NextPs = g_NowPs + (uint64_t) (SFR(PR2) + 1) * (TCY_PS << ((SFR(T2CON) & _T2CON_CKPS_MASK) >> _T2CON_CKPS_POSN));
+        g_NextEventPs = 0;
+    }
+    else if (!(SFR(T2CON) & _T2CON_ON_MASK))
+    {
+        g_Timer2NextPs = NEVER;
+    }
+
+    state = HostFirmwareState();
+    if (state != g_LastState)
+    {
+        g_LastState = state;
+        Emit(HOST_OUT_STATE, 0, state);
+    }
+
+    failsafe = HostFirmwareFailsafe();
+    if (failsafe != g_LastFailsafe)
+    {
+        g_LastFailsafe = failsafe;
+        Emit(HOST_OUT_FAILSAFE, failsafe, HostFirmwarePasses());
+    }
+}
+
+//-------------------------------
+// Function: Advance
+//
+// Description: Moves time on and runs whatever falls due.
+//
+//-------------------------------
+static void Advance (uint64_t ps)
+{
+    g_NowPs += ps;
+    if (g_NowPs >= g_NextEventPs)
+        RunEvents();
+}
+
+static void RunEvents (void)
+{
+    uint64_t next;
+
+    while ((g_NextInput < g_InputCount)
+           && ((uint64_t) g_Inputs[g_NextInput].m_TimeUs * PS_PER_US + g_InputOffsetPs <= g_NowPs))
+    {
+        ApplyInput(&g_Inputs[g_NextInput++]);
+    }
+
+    if (g_NowPs >= g_TimeHookPs)
+    {
+        void (*hook)(void) = g_TimeHook;
+
+        g_TimeHookPs = NEVER;
+        g_TimeHook = NULL;
+        if (hook != NULL)
+            hook();
+    }
+
+    while (g_NowPs >= g_Timer2NextPs)
+    {
+        SFR(PIR4) |= _PIR4_TMR2IF_MASK;
+        g_Timer2NextPs += (uint64_t) (SFR(PR2) + 1) * (TCY_PS << ((SFR(T2CON) & _T2CON_CKPS_MASK) >> _T2CON_CKPS_POSN));
+    }
+
+    if (g_NowPs >= g_AdcDonePs)
+    {
+        g_AdcDonePs = NEVER;
+        SFR(ADRESL) = (uint8_t) g_AdcResult;
+        SFR(ADRESH) = (uint8_t) (g_AdcResult >> 8);
+        SFR(ADCON0) &= (uint8_t) ~_ADCON0_GO_nDONE_MASK;
+        g_LastAdcon0 = SFR(ADCON0);
+        SFR(PIR1) |= _PIR1_ADIF_MASK;
+    }
+
+    if (g_NowPs >= g_EepromDonePs)
+    {
+        g_EepromDonePs = NEVER;
+        SFR(NVMCON1) &= (uint8_t) ~_NVMCON1_WR_MASK;
+        g_LastNvmcon1 = SFR(NVMCON1);
+        SFR(PIR7) |= _PIR7_NVMIF_MASK;
+    }
+
+    if (g_NowPs >= g_TxDonePs)
+    {
+        Emit(HOST_OUT_UART_TX, 0, g_TxShift);
+        g_TxDonePs = NEVER;
+        if (g_TxBufferFull)
+        {
+            g_TxBufferFull = false;
+            g_TxShift = g_TxBuffer;
+            g_TxDonePs = g_NowPs + UartBytePs();
+        }
+        UpdateUartFlags();
+    }
+
+    UartReceiveDue();
+
+    // When to look again.
+    next = g_TimeHookPs;
+    if (g_NextInput < g_InputCount)
+    {
+        uint64_t input = (uint64_t) g_Inputs[g_NextInput].m_TimeUs * PS_PER_US + g_InputOffsetPs;
+        if (input < next)
+            next = input;
+    }
+    if (g_Timer2NextPs < next)
+        next = g_Timer2NextPs;
+    if (g_AdcDonePs < next)
+        next = g_AdcDonePs;
+    if (g_EepromDonePs < next)
+        next = g_EepromDonePs;
+    if (g_TxDonePs < next)
+        next = g_TxDonePs;
+    if ((g_RxQueueCount != 0) && (g_RxQueue[g_RxQueueHead].m_ArrivalPs < next))
+        next = g_RxQueue[g_RxQueueHead].m_ArrivalPs;
+    g_NextEventPs = next;
+}
+
+//-------------------------------
+// Function: InterruptPending
+//
+// Description: Whether an enabled low priority interrupt is waiting and
+//  interrupts are on, or, for SLEEP, whether any enabled flag is set.
+//
+//-------------------------------
+static bool InterruptPending (bool anyPriority)
+{
+    uint8_t i, intcon;
+
+    intcon = SFR(INTCON);
+    if (!anyPriority && ((intcon & (_INTCON_GIEH_MASK | _INTCON_GIEL_MASK)) != (_INTCON_GIEH_MASK | _INTCON_GIEL_MASK)))
+        return false;
+
+    for (i = 0; i < 8; ++i)
+    {
+        uint8_t pending = g_Sfr[HOST_SFR_PIR0 + i] & g_Sfr[HOST_SFR_PIE0 + i];
+        if (!anyPriority)
+            pending &= (uint8_t) ~g_Sfr[HOST_SFR_IPR0 + i];
+        if (pending)
+            return true;
+    }
+    return false;
+}
+
+static void DispatchInterrupt (void)
+{
+    g_InIsr = true;
+    g_UnlockStep = 0;
+    SFR(INTCON) &= (uint8_t) ~_INTCON_GIEL_MASK;
+    bspLowPriorityIsr();
+    Settle();
+    SFR(INTCON) |= _INTCON_GIEL_MASK;   // RETFIE
+    g_InIsr = false;
+}
+
+static void ApplyInput (const HOST_TRACE_RECORD *input)
+{
+    uint8_t bit;
+
+    switch (input->m_Type)
+    {
+        case HOST_IN_SPEED:
+        case HOST_IN_DIRECTION:
+            g_Analog[input->m_Type - HOST_IN_SPEED] = input->m_Value & 0x3ff;
+            g_LastInputPs = g_NowPs;
+            break;
+
+        case HOST_IN_BUTTONS:
+            for (bit = 0; bit < 8; ++bit)
+            {
+                if ((input->m_Value & ~g_Buttons) & (1 << bit))
+                    g_PressedPs[bit] = g_NowPs;
+            }
+            g_Buttons = (uint8_t) input->m_Value;
+            g_LastInputPs = g_NowPs;
+            break;
+
+        case HOST_IN_UART_RX:
+        {
+            uint8_t data = (uint8_t) input->m_Value;
+            HostSimUartInput(&data, 1);
+            g_LastInputPs = g_NowPs;
+            break;
+        }
+
+        case HOST_IN_NOISE:
+            g_Noise[input->m_Channel & 1] = input->m_Value;
+            break;
+
+        case HOST_IN_ADC_STALL:
+            g_AdcStalled[input->m_Channel & 1] = (input->m_Value != 0);
+            break;
+
+        case HOST_IN_END:
+            Finish(0);
+            break;
+
+        default:
+            break;
+    }
+}
+
+//-------------------------------
+// Function: WatchPorts
+//
+// Description: Decodes the outputs from the port latches after a write.
+//  A pin only counts as driven once its TRIS bit makes it an output.
+//
+//-------------------------------
+static void WatchPorts (void)
+{
+    const uint8_t *lat = &g_Sfr[HOST_SFR_LATA];
+    const uint8_t *tris = &g_Sfr[HOST_SFR_TRISA];
+    uint8_t i, bluetooth, beeper, reset;
+
+    // Driven low: A = 0, C = 2, D = 3, E = 4.
+    #define DRIVEN_LOW(port, bit) (!(lat[port] & (1 << (bit))) && !(tris[port] & (1 << (bit))))
+
+    for (i = 0; i < 2; ++i)
+    {
+        DAC_MODEL *dac = &g_Dac[i];
+        uint8_t before = g_LastLat[3], after = lat[3];
+
+        if (!(before & (1 << dac->m_ClockBit)) && (after & (1 << dac->m_ClockBit)))
+            dac->m_Shift = (uint16_t) (((dac->m_Shift << 1) | ((after >> dac->m_DataBit) & 1)) & 0xfff);
+        if ((before & (1 << dac->m_LatchBit)) && !(after & (1 << dac->m_LatchBit)))
+        {
+            HOST_TRACE_RECORD record;
+            bool changed = (dac->m_Shift != dac->m_Value);
+
+            dac->m_Value = dac->m_Shift;
+            if (changed)
+            {
+                Emit(HOST_OUT_DAC, i, dac->m_Value);
+            }
+            else if (g_OutputHook != NULL)
+            {
+                // Every load goes to the hook, only changes to the trace.
+                record.m_TimeUs = (uint32_t) (g_NowPs / PS_PER_US);
+                record.m_Type = HOST_OUT_DAC;
+                record.m_Channel = i;
+                record.m_Value = dac->m_Value;
+                g_OutputHook(&record);
+            }
+        }
+    }
+
+    bluetooth = 0;
+    if (DRIVEN_LOW(3, 3))
+        bluetooth |= BT_FORWARD;
+    if (DRIVEN_LOW(2, 2))
+        bluetooth |= BT_REVERSE;
+    if (DRIVEN_LOW(4, 1))
+        bluetooth |= BT_LEFT;
+    if (DRIVEN_LOW(2, 1))
+        bluetooth |= BT_RIGHT;
+    if (DRIVEN_LOW(0, 4))
+        bluetooth |= BT_RIGHT_CLICK;
+    if (DRIVEN_LOW(0, 5))
+        bluetooth |= BT_LEFT_CLICK;
+    if (bluetooth != g_LastBluetooth)
+    {
+        g_LastBluetooth = bluetooth;
+        Emit(HOST_OUT_BLUETOOTH, 0, bluetooth);
+    }
+
+    beeper = DRIVEN_LOW(3, 0) ? 1 : 0;
+    if (beeper != g_LastBeeper)
+    {
+        g_LastBeeper = beeper;
+        Emit(HOST_OUT_BEEPER, 0, beeper);
+    }
+
+    reset = (!(tris[4] & 0x01) && (lat[4] & 0x01)) ? 1 : 0;
+    if (reset != g_LastReset)
+    {
+        g_LastReset = reset;
+        Emit(HOST_OUT_RESET, 0, reset);
+    }
+    #undef DRIVEN_LOW
+
+    memcpy(g_LastLat, lat, sizeof(g_LastLat));
+    memcpy(g_LastTris, tris, sizeof(g_LastTris));
+}
+
+//-------------------------------
+// Function: WatchNvm
+//
+// Description: Starts the EEPROM or flash operation NVMCON1 asks for.
+//
+//-------------------------------
+static void WatchNvm (void)
+{
+    uint8_t nvmcon1 = SFR(NVMCON1);
+    uint8_t region = (nvmcon1 & _NVMCON1_NVMREG_MASK) >> _NVMCON1_NVMREG_POSN;
+    uint16_t address = (uint16_t) (SFR(NVMADRL) | (SFR(NVMADRH) << 8));
+
+    if (nvmcon1 & _NVMCON1_RD_MASK)
+    {
+        if (region == NVMREG_EEPROM)
+            SFR(NVMDAT) = g_Eeprom[address % HOST_EEPROM_SIZE];
+        nvmcon1 &= (uint8_t) ~_NVMCON1_RD_MASK;
+    }
+
+    if ((nvmcon1 & _NVMCON1_WR_MASK) && !(g_LastNvmcon1 & _NVMCON1_WR_MASK))
+    {
+        if ((g_UnlockStep != 2) || !(nvmcon1 & _NVMCON1_WREN_MASK))
+        {
+            SFR(NVMCON1) = nvmcon1;
+            HostFail(HOST_FAIL_NVM_UNLOCK);
+            return;
+        }
+        g_UnlockStep = 0;
+
+        if (region == NVMREG_EEPROM)
+        {
+            g_Eeprom[address % HOST_EEPROM_SIZE] = SFR(NVMDAT);
+            Emit(HOST_OUT_EEPROM, (uint8_t) address, (uint16_t) ((address & 0x300) | SFR(NVMDAT)));
+            g_EepromDonePs = g_NowPs + EEPROM_WRITE_PS;
+            g_NextEventPs = 0;
+        }
+        else if (region == NVMREG_FLASH)
+        {
+            uint32_t row = ((uint32_t) SFR(TBLPTRL) | ((uint32_t) SFR(TBLPTRH) << 8) | ((uint32_t) SFR(TBLPTRU) << 16))
+                           & ~(uint32_t) (HOST_FLASH_ROW - 1);
+            if (row < HOST_FLASH_SIZE)
+            {
+                if (nvmcon1 & _NVMCON1_FREE_MASK)
+                {
+                    memset(&g_Flash[row], 0xff, HOST_FLASH_ROW);
+                }
+                else
+                {
+                    uint8_t i;
+                    // Programming can only clear bits.
+                    for (i = 0; i < HOST_FLASH_ROW; ++i)
+                        g_Flash[row + i] &= g_WriteLatch[i];
+                }
+            }
+            memset(g_WriteLatch, 0xff, sizeof(g_WriteLatch));
+            g_NowPs += FLASH_WRITE_PS;  // The CPU stalls for the write.
+            nvmcon1 &= (uint8_t) ~_NVMCON1_WR_MASK;
+        }
+        else
+        {
+            nvmcon1 &= (uint8_t) ~_NVMCON1_WR_MASK;
+        }
+    }
+
+    SFR(NVMCON1) = nvmcon1;
+    g_LastNvmcon1 = nvmcon1;
+}
+
+//-------------------------------
+// Function: WatchAdc
+//
+// Description: Starts a conversion when GO is set, or drops it when GO is
+//  cleared first. The input is sampled at the start. A conversion of a
+//  stalled input never finishes.
+//
+//-------------------------------
+static void WatchAdc (void)
+{
+    uint8_t adcon0 = SFR(ADCON0);
+
+    if ((adcon0 & _ADCON0_GO_nDONE_MASK) && !(g_LastAdcon0 & _ADCON0_GO_nDONE_MASK) && (adcon0 & _ADCON0_ADON_MASK))
+    {
+        uint64_t tad, cycles;
+        uint8_t channel = SFR(ADPCH) & _ADPCH_ADPCH_MASK;
+
+        if (adcon0 & _ADCON0_ADCS_MASK)
+            tad = ADC_FRC_TAD_PS;
+        else
+            tad = 2 * ((SFR(ADCLK) & _ADCLK_ADCS_MASK) + 1) * FOSC_PS;
+
+        cycles = (uint64_t) SFR(ADACQ) + SFR(ADPRE) + ADC_CONVERSION_TAD;
+        g_AdcResult = AdcSample(channel);
+        g_AdcDonePs = ((channel < 2) && g_AdcStalled[channel]) ? NEVER : g_NowPs + cycles * tad;
+        g_NextEventPs = 0;
+    }
+    else if (!(adcon0 & _ADCON0_GO_nDONE_MASK))
+    {
+        g_AdcDonePs = NEVER;
+    }
+    g_LastAdcon0 = adcon0;
+}
+
+static uint16_t AdcSample (uint8_t channel)
+{
+    int32_t value;
+
+    if (channel > 1)
+        return 0;
+
+    value = g_Analog[channel];
+    if (g_Noise[channel] != 0)
+    {
+        // xorshift32, the same sequence every run.
+        g_NoiseState ^= g_NoiseState << 13;
+        g_NoiseState ^= g_NoiseState >> 17;
+        g_NoiseState ^= g_NoiseState << 5;
+        value += (int32_t) (g_NoiseState % (2U * g_Noise[channel] + 1U)) - g_Noise[channel];
+    }
+    if (value < 0)
+        value = 0;
+    if (value > 1023)
+        value = 1023;
+    return (uint16_t) value;
+}
+
+//-------------------------------
+// Function: UartTransmit
+//
+// Description: A byte written to TX1REG goes to the shift register, or
+//  waits in TX1REG while the shift register is busy.
+//
+//-------------------------------
+static void UartTransmit (uint8_t data)
+{
+    if (g_TxDonePs == NEVER)
+    {
+        g_TxShift = data;
+        g_TxDonePs = g_NowPs + UartBytePs();
+        g_NextEventPs = 0;
+    }
+    else
+    {
+        g_TxBuffer = data;
+        g_TxBufferFull = true;
+    }
+    UpdateUartFlags();
+}
+
+// 10 bits, with BRG16 = 1 and BRGH = 1 as uart_bsp.c sets them.
+static uint64_t UartBytePs (void)
+{
+    uint32_t brg = (uint32_t) SFR(SP1BRGL) | ((uint32_t) SFR(SP1BRGH) << 8);
+    return 10ULL * 4 * (brg + 1) * FOSC_PS;
+}
+
+static void UartReceiveDue (void)
+{
+    while ((g_RxQueueCount != 0) && (g_RxQueue[g_RxQueueHead].m_ArrivalPs <= g_NowPs))
+    {
+        uint8_t data = g_RxQueue[g_RxQueueHead].m_Data;
+
+        g_RxQueueHead = (g_RxQueueHead + 1) % g_RxQueueSize;
+        --g_RxQueueCount;
+
+        if (!(SFR(RC1STA) & _RC1STA_CREN_MASK) || (SFR(RC1STA) & _RC1STA_OERR_MASK))
+            continue;
+        if (g_RxCount < UART_RX_FIFO)
+            g_RxFifo[g_RxCount++] = data;
+        else
+            SFR(RC1STA) |= _RC1STA_OERR_MASK;
+        g_LastRc1sta = SFR(RC1STA);
+    }
+    UpdateUartFlags();
+}
+
+static void UpdateUartFlags (void)
+{
+    if (g_RxCount != 0)
+        SFR(PIR3) |= _PIR3_RC1IF_MASK;
+    else
+        SFR(PIR3) &= (uint8_t) ~_PIR3_RC1IF_MASK;
+
+    if (g_TxBufferFull)
+        SFR(PIR3) &= (uint8_t) ~_PIR3_TX1IF_MASK;
+    else
+        SFR(PIR3) |= _PIR3_TX1IF_MASK;
+
+    if (g_TxDonePs == NEVER)
+        SFR(TX1STA) |= _TX1STA_TRMT_MASK;
+    else
+        SFR(TX1STA) &= (uint8_t) ~_TX1STA_TRMT_MASK;
+}
+
+static void Emit (uint8_t type, uint8_t channel, uint16_t value)
+{
+    HOST_TRACE_RECORD *record;
+
+    if (g_OutputCount == g_OutputSize)
+    {
+        g_OutputSize = g_OutputSize ? g_OutputSize * 2 : 4096;
+        g_Outputs = realloc(g_Outputs, g_OutputSize * sizeof(HOST_TRACE_RECORD));
+        if (g_Outputs == NULL)
+        {
+            fprintf(stderr, "host_sim: out of memory\n");
+            exit(3);
+        }
+    }
+    record = &g_Outputs[g_OutputCount++];
+    record->m_TimeUs = (uint32_t) (g_NowPs / PS_PER_US);
+    record->m_Type = type;
+    record->m_Channel = channel;
+    record->m_Value = value;
+
+    if (g_OutputHook != NULL)
+        g_OutputHook(record);
+}
+
+static void Finish (int code)
+{
+    if (g_Finishing)
+        return;
+    g_Finishing = true;
+    if (g_EndHook != NULL)
+        g_EndHook();
+    exit(code);
+}
+
+// end of file.
+//-------------------------------------------------------------------------
@@ -0,0 +1,143 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Filename: host_sim.h
+//
+// Description: Register model of the PIC18F46K40 and the board around it,
+//      for running the firmware on a PC. See host_sim.c.
+//
+//  Inputs and outputs are traces of HOST_TRACE_RECORDs, see
+//  tools/host_trace.py for the file layout and the scenario text the input
+//  traces are made from.
+//
+// Author(s): G. Chopcinski (Kg Solutions, LLC)
+//
+// Created for ASL
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef HOST_SIM_H
+#define HOST_SIM_H
+
+/* ***************************    Includes     **************************** */
+
+// from stdlib
+#include <stdint.h>
+#include <stdbool.h>
+
+/* ******************************   Macros   ****************************** */
+
+#define HOST_TRACE_MAGIC (0x53414c41UL)  // "ALAS" little endian
+#define HOST_TRACE_VERSION (1)
+
+// Input records. Times are us from reset.
+#define HOST_IN_SPEED (0x01)            // value: joystick speed input, ADC counts
+#define HOST_IN_DIRECTION (0x02)        // value: joystick direction input, ADC counts
+#define HOST_IN_BUTTONS (0x03)          // value: HOST_BUTTON_xxx held, the rest released
+#define HOST_IN_UART_RX (0x04)          // value: byte received
+#define HOST_IN_NOISE (0x05)            // channel: 0 speed, 1 direction; value: peak ADC noise
+#define HOST_IN_EEPROM (0x06)           // channel: address bits 0-7; value: byte | address bits 8-9 << 8, at reset
+#define HOST_IN_END (0x07)              // The run ends at this time.
+#define HOST_IN_ADC_STALL (0x08)        // channel: 0 speed, 1 direction; value: 1 its conversions never finish, 0 they do
+
+// Output records.
+#define HOST_OUT_DAC (0x81)             // channel: 0 forward/back, 1 left/right; value: DAC counts latched
+#define HOST_OUT_BLUETOOTH (0x82)       // value: BT_xxx_MASK outputs active
+#define HOST_OUT_BEEPER (0x83)          // value: 1 on
+#define HOST_OUT_RESET (0x84)           // value: reset output level
+#define HOST_OUT_UART_TX (0x85)         // value: byte sent
+#define HOST_OUT_STATE (0x86)           // value: gp_State entered
+#define HOST_OUT_EEPROM (0x87)          // as HOST_IN_EEPROM, a byte written
+#define HOST_OUT_FAIL (0x88)            // value: HOST_FAIL_xxx, see HostFail()
+#define HOST_OUT_JUMP (0x89)            // value: address of a goto out of the program, the run ends
+#define HOST_OUT_FAILSAFE (0x8a)        // channel: FAULT_xxx seen, 0x80 latched; value: control loop passes so far
+
+// The user buttons and switches on PORTB, all active low on the board.
+#define HOST_BUTTON_MODE (0x01)         // RB0
+#define HOST_BUTTON_SW2_1 (0x02)        // RB1, reverse is the mode switch
+#define HOST_BUTTON_CALIBRATION (0x04)  // RB2
+#define HOST_BUTTON_SW2_2 (0x20)        // RB5
+#define HOST_BUTTON_RIGHT_CLICK (0x40)  // RB6
+#define HOST_BUTTON_USER_PORT (0x80)    // RB7
+
+// Why a run was stopped, see HostFail().
+#define HOST_FAIL_SLEEP (0x01)          // SLEEP with nothing enabled to wake it.
+#define HOST_FAIL_NVM_UNLOCK (0x02)     // NVMCON1 WR set without the unlock sequence.
+#define HOST_FAIL_ASM (0x03)            // An inline instruction the model does not know.
+#define HOST_FAIL_HANG (0x04)           // Reported by the test programs.
+#define HOST_FAIL_INVARIANT (0x05)      // Reported by the test programs.
+
+#define HOST_EEPROM_SIZE (1024)
+#define HOST_FLASH_SIZE (0x10000UL)
+#define HOST_FLASH_ROW (64)
+
+/* ******************************   Types   ******************************* */
+
+typedef struct
+{
+    uint32_t m_Magic;
+    uint16_t m_Version;
+    uint16_t m_RecordSize;
+    uint32_t m_Count;
+    uint32_t m_Reserved;
+} HOST_TRACE_HEADER;
+
+typedef struct
+{
+    uint32_t m_TimeUs;
+    uint8_t m_Type;
+    uint8_t m_Channel;
+    uint16_t m_Value;
+} HOST_TRACE_RECORD;
+
+// Told of each output as it happens, see HostSimSetOutputHook().
+typedef void (*HOST_OUTPUT_HOOK)(const HOST_TRACE_RECORD *record);
+
+/* ***********************   Function Prototypes   ************************ */
+
+// Called through the registers and keywords in xc.h.
+void *HostSfr (uint16_t address);
+void *HostSfr24 (uint16_t address);
+void HostAsm (const char *instruction);
+void HostSleep (void);
+void HostDelayNs (uint32_t ns);
+
+// Set up and run.
+void HostSimInit (const HOST_TRACE_RECORD *inputs, uint32_t count);
+void HostSimSetOutputHook (HOST_OUTPUT_HOOK hook);
+void HostSimSetEndHook (void (*hook)(void));
+void HostSimSetTimeHook (uint64_t ns, void (*hook)(void));
+void HostSimReplaceInputs (const HOST_TRACE_RECORD *inputs, uint32_t count, uint64_t offsetNs);
+void HostSimUartInput (const uint8_t *data, uint32_t length);
+bool HostSimWriteOutputs (const char *path);
+bool HostSimWriteEeprom (const char *path);
+void HostFail (uint16_t reason);
+
+// State of the model, for the test programs.
+uint64_t HostSimNow (void);
+uint16_t HostSimDac (uint8_t channel);
+uint8_t HostSimButtons (void);
+uint64_t HostSimButtonHeldNs (uint8_t button);
+uint64_t HostSimInputsQuietNs (void);
+uint64_t HostSimLastPortRead (void);
+uint8_t HostSimEeprom (uint16_t address);
+uint8_t *HostSimFlash (void);
+uint32_t HostSimSfrAccesses (void);
+
+// Provided by the firmware build, see host_firmware.c.
+int FirmwareMain (void);
+int BootloaderMain (void);
+uint16_t HostFlashCrcStart (void);
+uint8_t HostFirmwareState (void);
+uint8_t HostFirmwareFailsafe (void);
+uint16_t HostFirmwarePasses (void);
+bool HostFirmwareAtRest (void);
+uint16_t HostNeutralDemand (void);
+uint16_t HostMinDacOutput (void);
+uint16_t HostMaxDacOutput (void);
+uint8_t HostDemandGuardTrips (void);
+void bspLowPriorityIsr (void);
+
+#endif // HOST_SIM_H
+
+// end of file.
+//-------------------------------------------------------------------------
@@ -0,0 +1,180 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Filename: host_stress.c
+//
+// Description: stress_sim, runs the firmware on one input trace, as
+//      firmware_sim does, and checks the safety invariants as it goes.
+//
+//  stress_sim <input trace> <output trace>
+//
+//  Checked for each DAC as it is loaded, and for both at every state change:
+//  - the DAC is within the build's (or the tuned) min and max;
+//  - the DAC is at the neutral demand outside DRIVING_STATE;
+//  - the DAC is not off neutral while the Calibration or User Port button
+//    is held, as the firmware has debounced them.
+//
+//  Checked at the END record, which tools/stress.py puts after every button
+//  is released and the joystick has rested for its REST_MS:
+//  - the firmware is in a state that waits on the user, not stuck in one
+//    that should have moved on (see HostFirmwareAtRest());
+//  - SetTPI_Demands() never had to force a demand to neutral: its callers
+//    keep to the first two rules themselves.
+//
+//  A broken invariant prints "invariant <name>: <what>" and ends the run
+//  with HOST_FAIL_INVARIANT (exit 2). The outputs are written either way.
+//
+// Author(s): G. Chopcinski (Kg Solutions, LLC)
+//
+// Created for ASL
+//
+//////////////////////////////////////////////////////////////////////////////
+
+/* ***************************    Includes     **************************** */
+
+// from stdlib
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// from project
+#include "UserButton.h"
+
+// from local
+#include "host_sim.h"
+
+/* ******************************   Macros   ****************************** */
+
+#define STATE_DRIVING (4)               // DRIVING_STATE, see main.c.
+
+/* ***********************   File Scope Variables   *********************** */
+
+static const char *g_OutputPath;
+static bool g_DacLoaded[2];             // The firmware has set the DAC.
+static bool g_Failed;
+
+/* ***********************   Function Prototypes   ************************ */
+
+static void CheckOutput (const HOST_TRACE_RECORD *record);
+static void CheckDac (uint8_t channel, uint32_t timeUs);
+static void CheckEnd (void);
+static void Broken (const char *name, uint32_t timeUs, const char *what, unsigned value);
+
+/* *******************   Public Function Definitions   ******************** */
+
+int main (int argc, char **argv)
+{
+    const HOST_TRACE_HEADER *header;
+    struct stat info;
+    void *map;
+    int file;
+
+    if (argc != 3)
+    {
+        fprintf(stderr, "usage: %s <input trace> <output trace>\n", argv[0]);
+        return 1;
+    }
+    g_OutputPath = argv[2];
+
+    file = open(argv[1], O_RDONLY);
+    if ((file < 0) || (fstat(file, &info) != 0) || (info.st_size < (off_t) sizeof(HOST_TRACE_HEADER)))
+    {
+        fprintf(stderr, "%s: can not read %s\n", argv[0], argv[1]);
+        return 1;
+    }
+    map = mmap(NULL, (size_t) info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (map == MAP_FAILED)
+    {
+        perror("mmap");
+        return 1;
+    }
+
+    header = map;
+    if ((header->m_Magic != HOST_TRACE_MAGIC) || (header->m_Version != HOST_TRACE_VERSION)
+        || (header->m_RecordSize != sizeof(HOST_TRACE_RECORD))
+        || ((off_t) (sizeof(*header) + (uint64_t) header->m_Count * sizeof(HOST_TRACE_RECORD)) > info.st_size))
+    {
+        fprintf(stderr, "%s: %s is not a version %d trace\n", argv[0], argv[1], HOST_TRACE_VERSION);
+        return 1;
+    }
+
+    HostSimInit((const HOST_TRACE_RECORD *) (header + 1), header->m_Count);
+    HostSimSetOutputHook(CheckOutput);
+    HostSimSetEndHook(CheckEnd);
+    FirmwareMain();
+    return 1;
+}
+
+/* ********************   Private Function Definitions   ****************** */
+
+static void CheckOutput (const HOST_TRACE_RECORD *record)
+{
+    if (g_Failed)
+        return;
+
+    // The two DACs are loaded one after the other, so a load is checked on
+    // its own: the other DAC may still hold the last pass's demand.
+    if (record->m_Type == HOST_OUT_DAC)
+    {
+        g_DacLoaded[record->m_Channel & 1] = true;
+        CheckDac(record->m_Channel & 1, record->m_TimeUs);
+    }
+    else if (record->m_Type == HOST_OUT_STATE)
+    {
+        CheckDac(0, record->m_TimeUs);
+        CheckDac(1, record->m_TimeUs);
+    }
+}
+
+//-------------------------------
+// Function: CheckDac
+//
+// Description: The DAC invariants for one DAC, against the state and
+//  buttons the firmware has at this moment.
+//
+//-------------------------------
+static void CheckDac (uint8_t channel, uint32_t timeUs)
+{
+    uint16_t value;
+
+    if (g_Failed || !g_DacLoaded[channel])
+        return;
+
+    value = HostSimDac(channel);
+    if ((value < HostMinDacOutput()) || (value > HostMaxDacOutput()))
+        Broken("dac_range", timeUs, channel ? "left/right DAC out of range" : "forward/back DAC out of range", value);
+    else if ((value != HostNeutralDemand()) && (HostFirmwareState() != STATE_DRIVING))
+        Broken("neutral_outside_driving", timeUs, "DAC off neutral in state", HostFirmwareState());
+    else if ((value != HostNeutralDemand()) && (IsCalibrationButtonActive() || IsUserPortButtonActive()))
+        Broken("drive_with_button", timeUs, "DAC off neutral with a button held, DAC", value);
+}
+
+static void CheckEnd (void)
+{
+    uint32_t timeUs;
+
+    timeUs = (uint32_t) (HostSimNow() / 1000);
+    if (!g_Failed && !HostFirmwareAtRest())
+        Broken("stuck_state", timeUs, "at rest in state", HostFirmwareState());
+    if (!g_Failed && (HostDemandGuardTrips() != 0))
+        Broken("demand_guard", timeUs, "demands forced to neutral by SetTPI_Demands()", HostDemandGuardTrips());
+
+    if (!HostSimWriteOutputs(g_OutputPath))
+        fprintf(stderr, "stress_sim: can not write %s\n", g_OutputPath);
+    if (g_Failed)
+        exit(2);
+}
+
+static void Broken (const char *name, uint32_t timeUs, const char *what, unsigned value)
+{
+    g_Failed = true;
+    printf("invariant %s: %s %u at %.3f ms\n", name, what, value, timeUs / 1000.0);
+    fflush(stdout);
+    HostFail(HOST_FAIL_INVARIANT);
+}
+
+// end of file.
+//-------------------------------------------------------------------------
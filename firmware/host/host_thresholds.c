@@ -0,0 +1,238 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Filename: host_thresholds.c
+//
+// Description: thresholds_sim, times the control loop's use of the
+//      joystick thresholds with Joystick_Thresholds cached, as the firmware
+//      does, and recomputed on every pass, as it did before the cache.
+//
+//  thresholds_sim <passes>
+//
+//  One pass makes the decisions the loop makes from the thresholds for one
+//  reading of each axis: the clamp to the calibrated travel, the normalised
+//  deflection, the Bluetooth half travel switch points and ranges, and the
+//  centred window of the mode switch. The uncached pass first runs
+//  UpdateJoystickThresholds(), which is the work the cache saves. Both run
+//  <passes> times, the readings sweeping the ADC range, best of
+//  THRESHOLDS_REPEATS. Prints, one per line:
+//
+//      cached <ns per 1000 passes>
+//      uncached <ns per 1000 passes>
+//
+//  The times are of this PC's processor, not of the PIC, where the 16 bit
+//  sums take several instructions each and the divides of the inverses are
+//  library calls: they show the direction and the order of the saving.
+//
+//  Exits 1 if a pass gives a different result the two ways, for any of a
+//  set of calibrations and margins.
+//
+// Author(s): G. Chopcinski (Kg Solutions, LLC)
+//
+// Created for ASL
+//
+//////////////////////////////////////////////////////////////////////////////
+
+/* ***************************    Includes     **************************** */
+
+// from stdlib
+#define _POSIX_C_SOURCE 199309L
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// from project
+#include "device_xc8.h"
+#include "AnalogInput.h"
+
+// from local
+#include "host_sim.h"
+
+/* ******************************   Macros   ****************************** */
+
+#define THRESHOLDS_REPEATS (5)          // Timings taken, the best is printed.
+#define THRESHOLDS_STEP (7)             // ADC counts between readings.
+#define END_US (3600000000UL)           // Far past any run.
+
+/* ******************************   Types   ******************************* */
+
+typedef struct
+{
+    uint16_t m_Neutral;
+    uint16_t m_PositiveScale;
+    uint16_t m_NegativeScale;
+    uint16_t m_Margin;
+} CALIBRATION;
+
+/* ***********************   File Scope Variables   *********************** */
+
+static const HOST_TRACE_RECORD g_End = {END_US, HOST_IN_END, 0, 0};
+
+static const CALIBRATION g_Calibrations[] =
+{
+    {NEUTRAL_JOYSTICK_INPUT, JOYSTICK_RAW_MAX_DEFLECTION, JOYSTICK_RAW_MAX_DEFLECTION, NEUTRAL_MARGIN_STANDARD},
+    {NEUTRAL_JOYSTICK_INPUT, 200, 200, NEUTRAL_MARGIN_STANDARD},
+    {NEUTRAL_JOYSTICK_INPUT + 9, 150, 180, NEUTRAL_MARGIN_COMPACT},
+    {NEUTRAL_JOYSTICK_INPUT - 12, 60, 40, NEUTRAL_MARGIN_STANDARD},
+};
+
+/* ***********************   Function Prototypes   ************************ */
+
+static uint32_t Pass (uint16_t speed, uint16_t direction);
+static uint32_t CachedPass (uint16_t speed, uint16_t direction);
+static uint32_t UncachedPass (uint16_t speed, uint16_t direction);
+static uint64_t Time (uint32_t (*pass)(uint16_t, uint16_t), uint32_t passes);
+static void Calibrate (const CALIBRATION *calibration);
+
+/* *******************   Public Function Definitions   ******************** */
+
+int main (int argc, char **argv)
+{
+    uint64_t cached, uncached;
+    uint32_t passes;
+    uint16_t speed, direction;
+    uint8_t i;
+
+    if (argc != 2)
+    {
+        fprintf(stderr, "usage: %s <passes>\n", argv[0]);
+        return 1;
+    }
+    passes = (uint32_t) strtoul(argv[1], NULL, 0);
+    HostSimInit(&g_End, 1);
+
+    for (i = 0; i < sizeof(g_Calibrations) / sizeof(g_Calibrations[0]); ++i)
+    {
+        Calibrate(&g_Calibrations[i]);
+        for (speed = 0; speed < 1024; speed += THRESHOLDS_STEP)
+        {
+            for (direction = 0; direction < 1024; direction += THRESHOLDS_STEP)
+            {
+                if (CachedPass(speed, direction) != UncachedPass(speed, direction))
+                {
+                    printf("mismatch calibration %u speed %u direction %u\n", i, speed, direction);
+                    return 1;
+                }
+            }
+        }
+    }
+
+    Calibrate(&g_Calibrations[1]);
+    cached = Time(CachedPass, passes);
+    uncached = Time(UncachedPass, passes);
+    printf("cached %llu\n", (unsigned long long) (cached * 1000 / passes));
+    printf("uncached %llu\n", (unsigned long long) (uncached * 1000 / passes));
+    return 0;
+}
+
+/* ********************   Private Function Definitions   ****************** */
+
+//-------------------------------
+// Function: Pass
+//
+// Description: The decisions of one pass from Joystick_Thresholds, folded
+//  into one value so the two ways can be compared.
+//
+//-------------------------------
+static uint32_t Pass (uint16_t speed, uint16_t direction)
+{
+    const JOYSTICK_THRESHOLDS *th;
+    const JOYSTICK_STRUCT *js;
+    uint16_t readings[NUM_JS_POTS] = {speed, direction};
+    uint16_t reading, deflection;
+    uint32_t result;
+    uint8_t axis;
+
+    result = 0;
+    for (axis = 0; axis < NUM_JS_POTS; ++axis)
+    {
+        th = &Joystick_Thresholds[axis];
+        js = &Joystick_Data[axis];
+        reading = readings[axis];
+
+        if (reading > js->m_rawMaxNuetral)
+        {
+            if (reading > th->m_ClampMaximum)
+                reading = th->m_ClampMaximum;
+            deflection = reading - js->m_rawNeutral;
+            result = result * 31 + (((uint32_t) deflection * th->m_PositiveInverse) >> JOYSTICK_INVERSE_SHIFT);
+            result = result * 31 + ((reading - js->m_rawMaxNuetral) >= th->m_PositiveRange);
+        }
+        else if (reading < js->m_rawMinNeutral)
+        {
+            if (reading < th->m_ClampMinimum)
+                reading = th->m_ClampMinimum;
+            deflection = js->m_rawNeutral - reading;
+            result = result * 31 + (((uint32_t) deflection * th->m_NegativeInverse) >> JOYSTICK_INVERSE_SHIFT);
+            result = result * 31 + ((js->m_rawMinNeutral - reading) >= th->m_NegativeRange);
+        }
+        result = result * 31 + reading;
+        result = result * 31 + (readings[axis] > th->m_HalfPositive) + 2 * (readings[axis] < th->m_HalfNegative);
+        result = result * 31 + ((readings[axis] > th->m_CentredMinimum) && (readings[axis] < th->m_CentredMaximum));
+    }
+    return result;
+}
+
+static __attribute__((noinline, noclone)) uint32_t CachedPass (uint16_t speed, uint16_t direction)
+{
+    return Pass(speed, direction);
+}
+
+static __attribute__((noinline, noclone)) uint32_t UncachedPass (uint16_t speed, uint16_t direction)
+{
+    UpdateJoystickThresholds();
+    return Pass(speed, direction);
+}
+
+//-------------------------------
+// Function: Time
+//
+// Description: Returns the fewest ns, of THRESHOLDS_REPEATS tries, that
+//  passes calls of pass take.
+//
+//-------------------------------
+static uint64_t Time (uint32_t (*pass)(uint16_t, uint16_t), uint32_t passes)
+{
+    struct timespec start, end;
+    volatile uint32_t sink;
+    uint64_t ns, fewest;
+    uint32_t i;
+    uint16_t speed, direction;
+    uint8_t repeat;
+
+    fewest = UINT64_MAX;
+    for (repeat = 0; repeat < THRESHOLDS_REPEATS; ++repeat)
+    {
+        speed = 0;
+        direction = 512;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (i = 0; i < passes; ++i)
+        {
+            sink = pass(speed, direction);
+            speed = (uint16_t) ((speed + THRESHOLDS_STEP) & 0x3ff);
+            direction = (uint16_t) ((direction + 3 * THRESHOLDS_STEP) & 0x3ff);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        (void) sink;
+        ns = (uint64_t) (end.tv_sec - start.tv_sec) * 1000000000ULL + (uint64_t) end.tv_nsec - (uint64_t) start.tv_nsec;
+        if (ns < fewest)
+            fewest = ns;
+    }
+    return fewest;
+}
+
+static void Calibrate (const CALIBRATION *calibration)
+{
+    uint8_t axis;
+
+    for (axis = 0; axis < NUM_JS_POTS; ++axis)
+    {
+        Joystick_Data[axis].m_rawNeutral = calibration->m_Neutral;
+        Joystick_Data[axis].m_PositiveScale = calibration->m_PositiveScale;
+        Joystick_Data[axis].m_NegativeScale = calibration->m_NegativeScale;
+    }
+    SetNeutralMargin(calibration->m_Margin);    // Places the window and updates the thresholds.
+}
+
+// end of file.
+//-------------------------------------------------------------------------
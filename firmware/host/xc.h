@@ -0,0 +1,59 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Filename: xc.h
+//
+// Description: Stands in for the XC8 <xc.h> when the firmware is built for
+//      the PC with tools/host_build.py. The registers come from host_sfr.h,
+//      generated from the chip header, and are accessed through HostSfr().
+//      The XC8 keywords the firmware uses are dropped and its inline
+//      instructions go to the register model, see host_sim.c.
+//
+// Author(s): G. Chopcinski (Kg Solutions, LLC)
+//
+// Created for ASL
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef HOST_XC_H
+#define HOST_XC_H
+
+/* ***************************    Includes     **************************** */
+
+// from stdlib
+#include <stdint.h>
+
+// from local
+#include "host_sim.h"
+
+/* ******************************   Macros   ****************************** */
+
+#define __interrupt(priority)
+#define __section(name)
+#define __near
+#define __far
+#define __persistent
+#define __eeprom
+#define __bit _Bool
+
+#define asm(instruction) HostAsm (instruction)
+#define Nop() ((void) 0)
+#define NOP() ((void) 0)
+#define CLRWDT() ((void) 0)
+#define SLEEP() HostSleep()
+#define di() (INTCONbits.GIE = 0)
+#define ei() (INTCONbits.GIE = 1)
+
+#define _XTAL_FREQ (F_CPU)
+#define __delay_us(us) HostDelayNs ((us) * 1000UL)
+#define __delay_ms(ms) HostDelayNs ((ms) * 1000000UL)
+
+/* ******************************   Types   ******************************* */
+
+typedef uint32_t __uint24;
+
+#include "host_sfr.h"
+
+#endif // HOST_XC_H
+
+// end of file.
+//-------------------------------------------------------------------------
@@ -0,0 +1,97 @@
+#!/usr/bin/env python3
+###############################################################################
+# File Name: adc_noise.py
+# Project:  Prop ASL130 with Bluetooth Module
+#
+# Compares the noise on the joystick readings in two telemetry captures
+# taken with the joystick at rest, e.g. before and after a change to how
+# the ADC converts, or in each ADC mode (livetune.py set adc_mode). Each
+# capture is a CSV from telemetry_decode.py --csv; raw_speed and
+# raw_direction are the readings the control loop uses, averaged as
+# GetSpeedAndDirection() averages them.
+#
+# Samples further than --rest counts from the capture's median are left
+# out, so a knock on the joystick does not count as noise. For each input
+# the mean and standard deviation of both captures are printed, and the
+# change in the standard deviation.
+#
+# The second capture is worse when its standard deviation is more than two
+# standard errors above the first's, the standard error of each being about
+# std / sqrt(2 (n - 1)) for n samples. The exit status is then 1.
+#
+# The host build's noise is drawn from the scenario, not made by the CPU,
+# so only captures from a board show what a change to the conversions does.
+#
+# Usage:
+#   adc_noise.py <before.csv> <after.csv> [--rest <counts>]
+###############################################################################
+
+import argparse
+import csv
+import math
+import sys
+
+CHANNELS = ["raw_speed", "raw_direction"]
+REST_COUNTS = 16
+
+
+def load(path, rest):
+    """{channel: [readings]} from a CSV, those near the median only."""
+    with open(path, newline="") as f:
+        rows = list(csv.DictReader(f))
+    readings = {}
+    for channel in CHANNELS:
+        values = sorted(int(row[channel]) for row in rows)
+        if not values:
+            raise ValueError("%s: no samples" % path)
+        median = values[len(values) // 2]
+        readings[channel] = [v for v in values if abs(v - median) <= rest]
+    return readings
+
+
+def stats(values):
+    """(count, mean, sample standard deviation)."""
+    count = len(values)
+    mean = sum(values) / float(count)
+    if count < 2:
+        return count, mean, 0.0
+    return count, mean, math.sqrt(sum((v - mean) ** 2 for v in values) / (count - 1))
+
+
+def compare(before, after):
+    """[(channel, before stats, after stats, worse)] for each input."""
+    results = []
+    for channel in CHANNELS:
+        first, second = stats(before[channel]), stats(after[channel])
+        error = math.sqrt(sum((s[2] ** 2) / (2.0 * max(s[0] - 1, 1)) for s in (first, second)))
+        results.append((channel, first, second, second[2] > first[2] + 2 * error))
+    return results
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compare the joystick noise in two telemetry captures.")
+    parser.add_argument("before", help="CSV from telemetry_decode.py --csv")
+    parser.add_argument("after", help="CSV from telemetry_decode.py --csv")
+    parser.add_argument("--rest", type=int, default=REST_COUNTS,
+                        help="counts from the median a sample at rest may be (default %(default)s)")
+    args = parser.parse_args()
+
+    try:
+        results = compare(load(args.before, args.rest), load(args.after, args.rest))
+    except (OSError, KeyError, ValueError) as error:
+        print("adc_noise.py: %s" % error, file=sys.stderr)
+        return 2
+
+    print("%-14s %6s %9s %7s   %6s %9s %7s   %7s" % ("input", "n", "mean", "std", "n", "mean", "std", "change"))
+    worse = False
+    for channel, first, second, channel_worse in results:
+        change = "%+.0f%%" % (100.0 * (second[2] - first[2]) / first[2]) if first[2] else "-"
+        print("%-14s %6d %9.2f %7.3f   %6d %9.2f %7.3f   %7s%s" % (
+            channel, first[0], first[1], first[2], second[0], second[1], second[2], change,
+            "  worse" if channel_worse else ""))
+        worse = worse or channel_worse
+    return 1 if worse else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
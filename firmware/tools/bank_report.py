@@ -0,0 +1,136 @@
+#!/usr/bin/env python3
+###############################################################################
+# File Name: bank_report.py
+# Project:  Prop ASL130 with Bluetooth Module
+#
+# Reports where the control loop's hot data was placed and how many bank
+# switches (MOVLB) the compiler emitted in the control loop functions.
+#
+# Inputs are the XC8 map file and assembler listing of a build. When a
+# baseline report (saved with --save) is given, the before/after counts are
+# shown side by side.
+#
+# Usage:
+#   bank_report.py --map <file.map> --lst <file.lst> [--baseline <file>] [--save <file>]
+###############################################################################
+
+import argparse
+import json
+import re
+import sys
+
+# Functions executed on every pass through the control loop.
+LOOP_FUNCTIONS = [
+    "_main",
+    "_Read_User_Buttons",
+    "_GetMouseClickInputs",
+    "_IsCalibrationButtonActive",
+    "_IsUserPortButtonActive",
+    "_IsModeButtonActive",
+    "_GetSpeedAndDirection",
+    "_IsInNeutralWindow",
+    "_DrivingState",
+    "_BluetoothControlState",
+    "_SendBlueToothSignals",
+    "_SetTPI_Demands",
+]
+
+# Data the control loop reads or writes on every pass.
+HOT_SYMBOLS = [
+    "_Joystick_Data",
+    "_Joystick_Thresholds",
+    "_gp_State",
+    "_g_CalButton_DebounceCounter",
+    "_g_CalButtonState",
+    "_g_UserPort_DebounceCounter",
+    "_g_UserPort_State",
+    "_g_ModeButton_DebounceCounter",
+    "_g_ModeButton_State",
+    "_g_MouseClick_DebounceCounter",
+    "_g_MouseClick_State",
+    "_g_MouseClicksEnabled",
+]
+
+ACCESS_RAM_LIMIT = 0x60     # GPRs below this are in the access bank on the 46K40.
+
+LABEL_RE = re.compile(r"^\s*\d*\s*(?:[0-9A-Fa-f]{4,6}\s+)?(_\w+):")
+MOVLB_RE = re.compile(r"\bmovlb\b", re.IGNORECASE)
+SYMBOL_RE = re.compile(r"^\s*(_\w+)\s+(\w+)\s+([0-9A-Fa-f]+)\s*$")
+
+
+def count_bank_switches(lst_path):
+    counts = {}
+    current = None
+    with open(lst_path, errors="replace") as lst:
+        for line in lst:
+            label = LABEL_RE.match(line)
+            if label:
+                current = label.group(1)
+                continue
+            if current in LOOP_FUNCTIONS and MOVLB_RE.search(line):
+                counts[current] = counts.get(current, 0) + 1
+    return counts
+
+
+def find_placement(map_path):
+    placement = {}
+    with open(map_path, errors="replace") as map_file:
+        for line in map_file:
+            match = SYMBOL_RE.match(line)
+            if match and match.group(1) in HOT_SYMBOLS:
+                placement[match.group(1)] = (match.group(2), int(match.group(3), 16))
+    return placement
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("--map", required=True)
+    parser.add_argument("--lst", required=True)
+    parser.add_argument("--baseline")
+    parser.add_argument("--save")
+    args = parser.parse_args()
+
+    counts = count_bank_switches(args.lst)
+    placement = find_placement(args.map)
+
+    baseline = {}
+    if args.baseline:
+        with open(args.baseline) as base:
+            baseline = json.load(base)
+
+    print("Hot data placement")
+    for name in HOT_SYMBOLS:
+        if name in placement:
+            psect, address = placement[name]
+            where = "access" if address < ACCESS_RAM_LIMIT else "bank %d" % (address >> 8)
+            print("  %-32s %-12s 0x%03X  %s" % (name, psect, address, where))
+        else:
+            print("  %-32s (not found)" % name)
+
+    print("")
+    print("Bank switches (MOVLB) per control loop function")
+    total = 0
+    base_total = 0
+    for name in LOOP_FUNCTIONS:
+        count = counts.get(name, 0)
+        total += count
+        if baseline:
+            before = baseline.get(name, 0)
+            base_total += before
+            print("  %-32s %5d -> %5d" % (name, before, count))
+        else:
+            print("  %-32s %5d" % (name, count))
+    if baseline:
+        print("  %-32s %5d -> %5d" % ("total", base_total, total))
+    else:
+        print("  %-32s %5d" % ("total", total))
+
+    if args.save:
+        with open(args.save, "w") as out:
+            json.dump(counts, out, indent=1, sort_keys=True)
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
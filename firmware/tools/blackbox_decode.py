@@ -0,0 +1,185 @@
+#!/usr/bin/env python3
+###############################################################################
+# File Name: blackbox_decode.py
+# Project:  Prop ASL130 with Bluetooth Module
+#
+# Prints the black box copy (see SourceFiles/app/BlackBox.c) held in an
+# EEPROM dump as a timeline.
+#
+# The dump is either an Intel HEX file exported by the programmer, in which
+# the EEPROM starts at --hex-base, or a binary image of the EEPROM.
+#
+# Event times are the 16 bit system tick (ms), which wraps every 65.5 s.
+# The times shown assume no two events are further apart than that.
+#
+# Usage:
+#   blackbox_decode.py <dump.hex | dump.bin> [--offset <n>] [--hex-base <n>]
+###############################################################################
+
+import argparse
+import sys
+
+# Must match BlackBox.h and EEPROM_BLACKBOX in main.c.
+EEPROM_BLACKBOX = 0x80
+MAGIC = 0xB7
+HEADER_SIZE = 4
+EVENT_SIZE = 4
+NUM_EVENTS = 31
+
+# EEPROM address in the programmer's HEX files.
+HEX_BASE_46K40 = 0x310000
+
+EVENT_POWER_UP = 0x01
+EVENT_STATE = 0x02
+EVENT_BUTTONS = 0x03
+EVENT_FAULT = 0x04
+EVENT_FAULT_LATCHED = 0x05
+EVENT_CALIBRATION = 0x06
+EVENT_SELF_TEST = 0x07
+EVENT_GESTURE = 0x08
+EVENT_SPEED_DRIFT = 0x09
+EVENT_DIRECTION_DRIFT = 0x0A
+
+CAUSE_NAMES = {0x01: "fault", 0x02: "request"}
+
+# Must match enum STATE_ENUM in main.c.
+STATE_NAMES = [
+    "NO_STATE",
+    "POWERUP_STATE",
+    "ANNOUNCE_ENTER_DRIVING_STATE",
+    "ENTER_DRIVING_STATE",
+    "DRIVING_STATE",
+    "ANNOUNCE_ENTER_BLUETOOTH_STATE",
+    "ENTER_BLUETOOTH_STATE",
+    "BLUETOOTH_STATE",
+    "EXIT_BLUETOOTH_STATE",
+    "ENTER_MODE_CHANGE_STATE",
+    "MODE_CHANGE_STATE",
+    "EXIT_MODE_CHANGE_STATE",
+    "ENTER_CALIBRATION_STATE",
+    "DO_JOYSTICK_CALIBRATION_STATE",
+    "EXIT_JOYSTICK_CALIBRATION_STATE",
+    "FAULT_STATE",
+]
+
+# Must match BUTTON_MASK_xxx in UserButton.h.
+BUTTON_NAMES = [(0x01, "CAL"), (0x02, "USER_PORT"), (0x04, "MODE"), (0x08, "SW2_1"), (0x10, "SW2_2")]
+
+# Must match FAULT_xxx in FailsafeMonitor.h.
+FAULT_NAMES = [(0x01, "ADC_TIMEOUT"), (0x02, "RAIL"), (0x04, "OUT_OF_GATE"), (0x08, "SLEW")]
+
+# Must match SELFTEST_FAIL_xxx in SelfTest.h.
+SELF_TEST_NAMES = [(0x01, "FLASH_CRC"), (0x02, "RAM")]
+
+# Must match GESTURE_xxx in Gesture.h.
+GESTURE_NAMES = {0x01: "DOUBLE_FLICK", 0x02: "HOLD_DIRECTION"}
+
+# PCON0 on the 46K40. The n flags read 0 when they caused the reset.
+RESET_FLAGS = [(0x80, "STKOVF", True), (0x40, "STKUNF", True), (0x20, "WDT_WINDOW", False),
+               (0x10, "WDT", False), (0x08, "MCLR", False), (0x04, "RESET_INSTR", False),
+               (0x02, "POR", False), (0x01, "BOR", False)]
+
+
+def bit_names(value, names):
+    found = [name for mask, name in names if value & mask]
+    return "|".join(found) if found else "none"
+
+
+def reset_names(value):
+    found = [name for mask, name, set_high in RESET_FLAGS if bool(value & mask) == set_high]
+    return "|".join(found) if found else "unknown"
+
+
+def describe(event_type, data):
+    if event_type == EVENT_POWER_UP:
+        return "POWER_UP", "reset=%s (PCON0 0x%02X)" % (reset_names(data), data)
+    if event_type == EVENT_STATE:
+        name = STATE_NAMES[data] if data < len(STATE_NAMES) else "state %d" % data
+        return "STATE", name
+    if event_type == EVENT_BUTTONS:
+        return "BUTTONS", bit_names(data, BUTTON_NAMES)
+    if event_type == EVENT_FAULT:
+        return "FAULT", bit_names(data, FAULT_NAMES)
+    if event_type == EVENT_FAULT_LATCHED:
+        return "FAULT_LATCHED", bit_names(data, FAULT_NAMES)
+    if event_type == EVENT_CALIBRATION:
+        return "CALIBRATION", "saved, gate %s" % ("valid" if data else "not valid")
+    if event_type == EVENT_SELF_TEST:
+        return "SELF_TEST", "failed %s" % bit_names(data, SELF_TEST_NAMES)
+    if event_type == EVENT_GESTURE:
+        return "GESTURE", GESTURE_NAMES.get(data, "gesture %d" % data)
+    if event_type in (EVENT_SPEED_DRIFT, EVENT_DIRECTION_DRIFT):
+        name = "SPEED_DRIFT" if event_type == EVENT_SPEED_DRIFT else "DIRECTION_DRIFT"
+        return name, "%+d counts" % (data - 256 if data & 0x80 else data)
+    return "TYPE_0x%02X" % event_type, "0x%02X" % data
+
+
+def read_intel_hex(path, base):
+    memory = {}
+    upper = 0
+    with open(path) as hex_file:
+        for number, line in enumerate(hex_file, 1):
+            line = line.strip()
+            if not line:
+                continue
+            if not line.startswith(":"):
+                raise ValueError("line %d: not Intel HEX" % number)
+            record = bytes.fromhex(line[1:])
+            if sum(record) & 0xFF:
+                raise ValueError("line %d: bad checksum" % number)
+            length, address, kind = record[0], (record[1] << 8) | record[2], record[3]
+            data = record[4:4 + length]
+            if kind == 0x00:
+                for i, byte in enumerate(data):
+                    memory[upper + address + i] = byte
+            elif kind == 0x04:
+                upper = ((data[0] << 8) | data[1]) << 16
+            elif kind == 0x01:
+                break
+    size = max([address - base + 1 for address in memory if address >= base] + [0])
+    return bytes(memory.get(base + i, 0xFF) for i in range(size))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("dump")
+    parser.add_argument("--offset", type=lambda x: int(x, 0), default=EEPROM_BLACKBOX)
+    parser.add_argument("--hex-base", type=lambda x: int(x, 0), default=HEX_BASE_46K40)
+    args = parser.parse_args()
+
+    if args.dump.lower().endswith(".hex"):
+        eeprom = read_intel_hex(args.dump, args.hex_base)
+    else:
+        with open(args.dump, "rb") as dump:
+            eeprom = dump.read()
+
+    image = eeprom[args.offset:args.offset + HEADER_SIZE + (NUM_EVENTS * EVENT_SIZE)]
+    if len(image) < HEADER_SIZE:
+        print("dump does not reach the black box at 0x%02X" % args.offset, file=sys.stderr)
+        return 1
+    if image[0] != MAGIC:
+        print("no complete black box copy (magic 0x%02X)" % image[0], file=sys.stderr)
+        return 1
+
+    copy_number, cause, count = image[1], image[2], image[3]
+    count = min(count, NUM_EVENTS, (len(image) - HEADER_SIZE) // EVENT_SIZE)
+    print("Black box copy %d, cause %s, %d events" % (copy_number, CAUSE_NAMES.get(cause, "0x%02X" % cause), count))
+    print("")
+    print("  %10s  %5s  %-15s %s" % ("time (s)", "tick", "event", "detail"))
+
+    elapsed = 0
+    last_tick = None
+    for i in range(count):
+        offset = HEADER_SIZE + (i * EVENT_SIZE)
+        tick = image[offset] | (image[offset + 1] << 8)
+        if last_tick is not None:
+            elapsed += (tick - last_tick) & 0xFFFF
+        last_tick = tick
+        name, detail = describe(image[offset + 2], image[offset + 3])
+        print("  %10.3f  %5d  %-15s %s" % (elapsed / 1000.0, tick, name, detail))
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,136 @@
+#!/usr/bin/env python3
+###############################################################################
+# File Name: gen_response_curves.py
+# Project:  Prop ASL130 with Bluetooth Module
+#
+# Generates HeaderFiles/app/ResponseCurveTable.h, the joystick response
+# curves used by ResponseCurve.c. Each curve maps the normalised joystick
+# deflection (0 = neutral, 1024 = full) to the normalised demand, sampled at
+# RESPONSE_CURVE_POINTS evenly spaced deflections.
+#
+# Every curve is checked to start at 0, end at full scale and never fall,
+# before anything is written. The order of CURVES must match the
+# RESPONSE_CURVE_xxx values in ResponseCurve.h.
+#
+# Usage:
+#   gen_response_curves.py [--output <file>] [--check]
+#
+#   --check  Only verify the existing table is up to date (used by the build).
+###############################################################################
+
+import argparse
+import os
+import sys
+
+FULL_SCALE = 1024       # Q10
+SEGMENTS = 32           # Table has SEGMENTS + 1 points.
+
+# (macro name, description, function of x in 0..1)
+CURVES = [
+    ("LINEAR", "Linear, as before curves were added.",
+     lambda x: x),
+    ("QUADRATIC", "Quadratic, finer control at low speed.",
+     lambda x: x * x),
+    ("CUBIC_BLEND", "30% linear plus 70% cubic.",
+     lambda x: 0.3 * x + 0.7 * x * x * x),
+    ("S_CURVE", "S-curve (smoothstep), soft at both ends.",
+     lambda x: x * x * (3.0 - 2.0 * x)),
+]
+
+DEFAULT_OUTPUT = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                              "..", "HeaderFiles", "app", "ResponseCurveTable.h")
+
+
+def build_table(function):
+    return [int(round(function(i / SEGMENTS) * FULL_SCALE)) for i in range(SEGMENTS + 1)]
+
+
+def check_table(name, table):
+    errors = []
+    if table[0] != 0:
+        errors.append("%s: starts at %d, not 0" % (name, table[0]))
+    if table[-1] != FULL_SCALE:
+        errors.append("%s: ends at %d, not %d" % (name, table[-1], FULL_SCALE))
+    for i in range(1, len(table)):
+        if table[i] < table[i - 1]:
+            errors.append("%s: falls between points %d and %d" % (name, i - 1, i))
+    return errors
+
+
+def render(tables):
+    lines = []
+    lines.append("//////////////////////////////////////////////////////////////////////////////")
+    lines.append("//")
+    lines.append("// Filename: ResponseCurveTable.h")
+    lines.append("//")
+    lines.append("// Description: Joystick response curve tables.")
+    lines.append("//")
+    lines.append("// GENERATED by tools/gen_response_curves.py, do not edit by hand.")
+    lines.append("// Only to be included by ResponseCurve.c.")
+    lines.append("//")
+    lines.append("//////////////////////////////////////////////////////////////////////////////")
+    lines.append("")
+    lines.append("#ifndef RESPONSE_CURVE_TABLE_H")
+    lines.append("#define RESPONSE_CURVE_TABLE_H")
+    lines.append("")
+    lines.append("#define RESPONSE_CURVE_TABLE_COUNT (%d)" % len(tables))
+    lines.append("#define RESPONSE_CURVE_POINTS (%d)" % (SEGMENTS + 1))
+    lines.append("#define RESPONSE_CURVE_SEGMENT_SHIFT (%d)   // Deflection per segment is 2^n."
+                 % ((FULL_SCALE // SEGMENTS).bit_length() - 1))
+    lines.append("")
+    lines.append("static const uint16_t g_ResponseCurveTable[RESPONSE_CURVE_TABLE_COUNT][RESPONSE_CURVE_POINTS] =")
+    lines.append("{")
+    for index, ((name, description, _), table) in enumerate(zip(CURVES, tables)):
+        lines.append("    // %d: RESPONSE_CURVE_%s - %s" % (index, name, description))
+        lines.append("    {")
+        for start in range(0, len(table), 11):
+            chunk = ", ".join("%4d" % v for v in table[start:start + 11])
+            last = start + 11 >= len(table)
+            lines.append("        %s%s" % (chunk, "" if last else ","))
+        lines.append("    }%s" % ("" if index == len(tables) - 1 else ","))
+    lines.append("};")
+    lines.append("")
+    lines.append("#endif // RESPONSE_CURVE_TABLE_H")
+    lines.append("")
+    lines.append("// end of file.")
+    lines.append("//-------------------------------------------------------------------------")
+    return "\n".join(lines) + "\n"
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Generate the joystick response curve tables.")
+    parser.add_argument("--output", default=DEFAULT_OUTPUT, help="header to write")
+    parser.add_argument("--check", action="store_true",
+                        help="fail if the existing header is out of date")
+    args = parser.parse_args()
+
+    tables = [build_table(function) for _, _, function in CURVES]
+    errors = []
+    for (name, _, _), table in zip(CURVES, tables):
+        errors.extend(check_table(name, table))
+    if errors:
+        for error in errors:
+            print("gen_response_curves: " + error, file=sys.stderr)
+        return 1
+
+    text = render(tables)
+
+    if args.check:
+        try:
+            with open(args.output) as f:
+                current = f.read()
+        except IOError:
+            current = None
+        if current != text:
+            print("gen_response_curves: %s is out of date, run tools/gen_response_curves.py"
+                  % args.output, file=sys.stderr)
+            return 1
+        return 0
+
+    with open(args.output, "w") as f:
+        f.write(text)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,276 @@
+#!/usr/bin/env python3
+###############################################################################
+# File Name: host_build.py
+# Project:  Prop ASL130 with Bluetooth Module
+#
+# Builds the firmware for the PC, one program per MPLAB configuration, to be
+# run against the register model in host/ (see host/host_sim.c).
+#
+# The sources are compiled unchanged with gcc. In place of the chip's
+# <xc.h>, host/xc.h includes a header generated from the same
+# HeaderFiles/chip_def/pic18f46k40.h the firmware is built with: each
+# register becomes an access through HostSfr(), which runs the simulated
+# peripherals, so every poll loop in the firmware sees time pass.
+#
+# The defines of each configuration are read from
+# nbproject/configurations.xml. The configurations are built in parallel,
+# each into build/host/<configuration>/. The bootloader is built with each,
+# see host/host_bootloader.c.
+#
+# Known differences from XC8: int is 32 bits rather than 16, and nothing
+# but the register accesses takes simulated time.
+#
+# Usage:
+#   host_build.py [--conf <name> ...] [--jobs <n>] [-D<define> ...]
+#                 [--tree <firmware dir>] [--out <dir>] [--program <name>]
+###############################################################################
+
+import argparse
+import concurrent.futures
+import os
+import re
+import shutil
+import subprocess
+import sys
+
+FIRMWARE_DIR = os.path.normpath(os.path.join(os.path.dirname(os.path.abspath(__file__)), ".."))
+HOST_DIR = os.path.join(FIRMWARE_DIR, "host")
+CHIP_HEADER = os.path.join("HeaderFiles", "chip_def", "pic18f46k40.h")
+INCLUDE_DIRS = [os.path.join("HeaderFiles", d) for d in ("app", "bsp", "common")]
+
+CFLAGS = ["-std=gnu99", "-fshort-enums", "-O2", "-g", "-fno-strict-aliasing",
+          "-Wno-pointer-to-int-cast", "-Wno-int-to-pointer-cast", "-Wno-pragmas",
+          "-Wno-unknown-pragmas", "-D_18F46K40=1"]
+
+# The simulator, and the programs that can be linked with the firmware. Each
+# program is its own main() and the host files it needs.
+HOST_SOURCES = ["host_sim.c", "host_firmware.c", "host_bootloader.c"]
+PROGRAMS = {
+    "firmware_sim": ["host_main.c"],
+    "loop_timing_sim": ["host_loop_timing.c"],
+    "stress_sim": ["host_stress.c"],
+    "pty_sim": ["host_pty.c"],
+    "thresholds_sim": ["host_thresholds.c"],
+}
+
+
+def read_configurations(tree=FIRMWARE_DIR):
+    """Returns {configuration: [defines]} from the MPLAB project."""
+    with open(os.path.join(tree, "nbproject", "configurations.xml")) as f:
+        text = f.read()
+    confs = {}
+    for match in re.finditer(r'<conf name="([^"]+)"(.*?)</conf>', text, re.S):
+        compiler = re.search(r"<HI-TECH-COMP>(.*?)</HI-TECH-COMP>", match.group(2), re.S)
+        macros = re.search(r'key="define-macros"\s+value="([^"]*)"', compiler.group(1))
+        confs[match.group(1)] = [d for d in macros.group(1).split(";") if d]
+    return confs
+
+
+def firmware_sources(tree):
+    """The firmware's .c files. main.c is compiled through host_firmware.c."""
+    sources = []
+    for folder in ("app", "bsp"):
+        path = os.path.join(tree, "SourceFiles", folder)
+        sources += [os.path.join(path, name) for name in sorted(os.listdir(path))
+                    if name.endswith(".c") and name != "main.c"]
+    return sources
+
+
+def sfr_header(tree, sources):
+    """Turns the chip header into host_sfr.h: every register, and every
+    bitfield view of one, is read and written through HostSfr(address).
+
+    A register with the same name as a field of its bitfield view (ADACQ
+    and ADACQbits.ADACQ) can only be one of the two in C. The register is
+    kept unless the sources use the field."""
+    with open(os.path.join(tree, CHIP_HEADER)) as f:
+        lines = f.read().splitlines()
+
+    used = ""
+    for path in sources:
+        with open(path, errors="replace") as f:
+            used += f.read()
+
+    registers = []
+    members = set()
+    for line in lines:
+        match = re.match(r"extern volatile (unsigned char|unsigned short|__uint24)\s+(\w+)\s+__at\((0x[0-9A-F]+)\);", line)
+        if match:
+            registers.append(match.group(2))
+        match = re.match(r"\s+unsigned (\w+)\s+:\d+;", line)
+        if match:
+            members.add(match.group(1))
+
+    # Fields the sources use as Xbits.FIELD stay fields.
+    field_uses = set(re.findall(r"\b\w+bits\.(\w+)", used))
+    dropped = {name for name in registers if name in members and name in field_uses}
+
+    out = ["// Generated by tools/host_build.py from %s, do not edit." % CHIP_HEADER.replace(os.sep, "/"),
+           "#ifndef HOST_SFR_H", "#define HOST_SFR_H", ""]
+    union = []
+    for line in lines:
+        match = re.match(r"extern volatile (unsigned char|unsigned short|__uint24)\s+(\w+)\s+__at\((0x[0-9A-F]+)\);", line)
+        if match:
+            kind, name, address = match.groups()
+            out.append("#define HOST_SFR_%s (%s)" % (name, address))
+            if name in dropped:
+                continue
+            if kind == "__uint24":
+                out.append("#define %s (*(volatile __uint24 *) HostSfr24 (%s))" % (name, address))
+            else:
+                out.append("#define %s (*(volatile %s *) HostSfr (%s))" % (name, kind, address))
+            continue
+
+        match = re.match(r"extern volatile (\w+bits_t) (\w+) __at\((0x[0-9A-F]+)\);", line)
+        if match:
+            kind, name, address = match.groups()
+            out.append("#define %s (*(volatile %s *) HostSfr (%s))" % (name, kind, address))
+            continue
+
+        if (line.startswith("extern volatile __bit") or line.startswith("asm(")
+                or line.startswith("#include <__at.h>") or line.startswith("#warning")
+                or re.match(r"#define (\w+) \1$", line)):
+            continue
+
+        # Bitfields in a byte wide unsigned char, so the union is the size
+        # of the register as it is on the chip.
+        if line.startswith("typedef union"):
+            union = [line]
+            continue
+        if union:
+            union.append(line)
+            if line.startswith("}"):
+                widths = [sum(int(w) for w in re.findall(r":(\d+);", part))
+                          for part in "\n".join(union).split("struct")]
+                field = "unsigned char" if max(widths) <= 8 else "unsigned short"
+                for entry in union:
+                    match = re.match(r"(\s+)unsigned (\w*)(\s+:\d+;)", entry)
+                    if match:
+                        member = match.group(2)
+                        if member and member in registers and member not in dropped:
+                            member += "_"   # Not used, the register name is.
+                        entry = "%s%s %s%s" % (match.group(1), field, member, match.group(3))
+                    out.append(entry)
+                union = []
+            continue
+
+        out.append(line)
+
+    out += ["", "#endif // HOST_SFR_H", ""]
+    return "\n".join(out)
+
+
+def compile_commands(conf, defines, tree, out_dir, programs):
+    """Returns the gcc commands that build the programs for a configuration,
+    objects first, in an order that can be run as listed."""
+    includes = ["-I" + HOST_DIR, "-I" + out_dir] + ["-I" + os.path.join(tree, d) for d in INCLUDE_DIRS]
+    flags = CFLAGS + includes + ["-D" + d for d in defines] + ["-DHOST_MAIN_SOURCE=\"%s\"" % os.path.join(tree, "SourceFiles", "app", "main.c")]
+    bootloader = os.path.join(tree, "bootloader", "bootloader.c")
+    if os.path.exists(bootloader):
+        flags.append("-DHOST_BOOTLOADER_SOURCE=\"%s\"" % bootloader)
+
+    objects, commands = [], []
+    for source in firmware_sources(tree) + [os.path.join(HOST_DIR, s) for s in HOST_SOURCES]:
+        obj = os.path.join(out_dir, os.path.basename(source)[:-2] + ".o")
+        commands.append(["gcc"] + flags + ["-c", source, "-o", obj])
+        objects.append(obj)
+
+    for program in programs:
+        mains = [os.path.join(HOST_DIR, s) for s in PROGRAMS[program]]
+        commands.append(["gcc"] + flags + mains + objects + ["-o", os.path.join(out_dir, program), "-lm"])
+    return commands
+
+
+def build(conf, defines, tree=FIRMWARE_DIR, out_root=None, programs=("firmware_sim",), jobs=None):
+    """Builds one configuration and returns its output directory. Raises
+    RuntimeError with the compiler output on failure."""
+    out_dir = os.path.join(out_root or os.path.join(FIRMWARE_DIR, "build", "host"), conf)
+    os.makedirs(out_dir, exist_ok=True)
+
+    sources = firmware_sources(tree) + [os.path.join(tree, "SourceFiles", "app", "main.c")]
+    if os.path.exists(os.path.join(tree, "bootloader", "bootloader.c")):
+        sources.append(os.path.join(tree, "bootloader", "bootloader.c"))
+    for folder in INCLUDE_DIRS:
+        path = os.path.join(tree, folder)
+        sources += [os.path.join(path, name) for name in sorted(os.listdir(path)) if name.endswith(".h")]
+    header = sfr_header(tree, sources)
+    path = os.path.join(out_dir, "host_sfr.h")
+    if not os.path.exists(path) or open(path).read() != header:
+        with open(path, "w") as f:
+            f.write(header)
+
+    commands = compile_commands(conf, defines, tree, out_dir, programs)
+    compiles = [c for c in commands if "-c" in c]
+    links = [c for c in commands if "-c" not in c]
+    with concurrent.futures.ThreadPoolExecutor(max_workers=jobs or os.cpu_count()) as pool:
+        for result in pool.map(run, compiles):
+            if result:
+                raise RuntimeError("%s: %s" % (conf, result))
+    for command in links:
+        result = run(command)
+        if result:
+            raise RuntimeError("%s: %s" % (conf, result))
+    return out_dir
+
+
+def run(command):
+    process = subprocess.run(command, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, text=True)
+    return process.stdout if process.returncode != 0 else ""
+
+
+def build_all(confs, extra_defines=(), tree=FIRMWARE_DIR, out_root=None, programs=("firmware_sim",), jobs=None,
+              failed=None):
+    """Builds the configurations in parallel. Returns {configuration: output
+    directory}, raises RuntimeError naming each one that failed, or, given
+    a list as failed, adds (configuration, error) to it for each instead."""
+    available = read_configurations(tree)
+    unknown = [c for c in confs if c not in available]
+    if unknown:
+        raise RuntimeError("unknown configuration(s): %s" % ", ".join(unknown))
+
+    results, errors = {}, []
+    # Each configuration compiles its files one at a time, the configurations
+    # run side by side.
+    with concurrent.futures.ThreadPoolExecutor(max_workers=jobs or os.cpu_count()) as pool:
+        futures = {pool.submit(build, conf, available[conf] + list(extra_defines), tree, out_root, programs, 1): conf
+                   for conf in confs}
+        for future in concurrent.futures.as_completed(futures):
+            try:
+                results[futures[future]] = future.result()
+            except RuntimeError as error:
+                if failed is None:
+                    errors.append(str(error))
+                else:
+                    failed.append((futures[future], str(error)))
+    if errors:
+        raise RuntimeError("\n".join(errors))
+    return results
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Build the firmware for the PC register model.")
+    parser.add_argument("--conf", action="append", help="configuration to build (default all)")
+    parser.add_argument("--jobs", type=int, default=os.cpu_count(), help="builds run at once (default %(default)s)")
+    parser.add_argument("-D", dest="defines", action="append", default=[], help="extra define")
+    parser.add_argument("--tree", default=FIRMWARE_DIR, help="firmware sources to build (default this one)")
+    parser.add_argument("--out", help="output directory (default build/host)")
+    parser.add_argument("--program", action="append", choices=sorted(PROGRAMS), help="program to link (default firmware_sim)")
+    parser.add_argument("--clean", action="store_true", help="remove the output directory first")
+    args = parser.parse_args()
+
+    confs = args.conf or list(read_configurations(args.tree))
+    if args.clean and args.out is None:
+        shutil.rmtree(os.path.join(FIRMWARE_DIR, "build", "host"), ignore_errors=True)
+    try:
+        results = build_all(confs, args.defines, os.path.abspath(args.tree), args.out,
+                            tuple(args.program or ["firmware_sim"]), args.jobs)
+    except RuntimeError as error:
+        print(error, file=sys.stderr)
+        return 1
+    for conf in confs:
+        print("%-28s %s" % (conf, os.path.relpath(results[conf])))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,1440 @@
+#!/usr/bin/env python3
+###############################################################################
+# File Name: host_test.py
+# Project:  Prop ASL130 with Bluetooth Module
+#
+# Checks of the firmware's behaviour on the host build (tools/host_build.py),
+# most of them a scenario (see tools/host_trace.py) run on firmware_sim and
+# a test of what came out on the pins, the UART and the EEPROM. The rest run
+# one of the other host programs and test what it prints.
+#
+# Where replay.py says whether the outputs have changed, these say whether
+# they are right: a check names the property it tests and fails with the
+# times and values that broke it.
+#
+# The configurations the checks need are built first, then the checks run
+# side by side, as many at once as there are cores.
+#
+# Usage:
+#   host_test.py [--check <name> ...] [--jobs <n>] [--list]
+###############################################################################
+
+import argparse
+import concurrent.futures
+import math
+import os
+import random
+import struct
+import subprocess
+import sys
+import tempfile
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import adc_noise                                    # noqa: E402
+import blackbox_decode                              # noqa: E402
+import gen_response_curves                          # noqa: E402
+import host_build                                   # noqa: E402
+import host_trace                                   # noqa: E402
+import livetune                                     # noqa: E402
+import telemetry_decode                             # noqa: E402
+import uploader                                     # noqa: E402
+
+BUILD_ROOT = os.path.join(host_build.FIRMWARE_DIR, "build", "host")
+DEFAULT_CONF = "Release_RNet"
+RUN_TIMEOUT_S = 120
+
+# Bluetooth outputs, see BluetoothControl.h.
+BT_FWD, BT_REV, BT_LEFT, BT_RIGHT = 0x01, 0x02, 0x04, 0x08
+
+# The EEPROM address of the Bluetooth mode and its proportional value, see
+# main.c.
+EEPROM_BT_MODE = 12
+EEPROM_BT_MODE_PROPORTIONAL = 0x5aa5
+
+# A scenario that boots calibrated and goes into Bluetooth with the User
+# Port button, in the Bluetooth state from BT_READY_MS.
+BT_ENTRY = """
+0       eeprom calibrated 200
+1000    press user
+1300    release user
+"""
+BT_READY_MS = 3500
+
+CHECKS = {}
+
+
+class CheckFailed(Exception):
+    pass
+
+
+def check(name, conf=DEFAULT_CONF, program="firmware_sim"):
+    """Registers a check, run on the given configuration. A firmware_sim
+    check is given sim(scenario text), which returns a Run; any other is
+    given run(arguments ...), which returns what the program printed, with
+    the program's path as run.path."""
+    def register(function):
+        CHECKS[name] = (function, conf, program)
+        return function
+    return register
+
+
+def expect(condition, message, *args):
+    if not condition:
+        raise CheckFailed(message % args if args else message)
+
+
+class Run:
+    """The outputs of one firmware_sim run."""
+
+    def __init__(self, records, end_us):
+        self.records = records
+        self.end_us = end_us
+
+    def of(self, kind, channel=None):
+        """[(time us, value)] for one output."""
+        return [(t, v) for t, k, c, v in self.records
+                if k == kind and (channel is None or c == channel)]
+
+    def states(self):
+        return [(t, host_trace.STATES[v]) for t, v in self.of(host_trace.OUT_STATE)]
+
+    def state_at(self, time_ms):
+        state = "NO_STATE"
+        for t, name in self.states():
+            if t > time_ms * 1000:
+                break
+            state = name
+        return state
+
+    def eeprom_writes(self):
+        """[(time us, address, byte)] in the order written."""
+        return [(t, c | (v & 0x300), v & 0xFF) for t, k, c, v in self.records
+                if k == host_trace.OUT_EEPROM]
+
+    def uart_bytes(self, start_ms=0, stop_ms=None):
+        stop_us = self.end_us if stop_ms is None else stop_ms * 1000
+        return bytes(v for t, v in self.of(host_trace.OUT_UART_TX) if start_ms * 1000 <= t < stop_us)
+
+    def frames(self):
+        """[(time us, type, sequence, payload)] for each good frame sent on
+        the UART, the time that of its last byte, and the number of bytes
+        that were not part of one. A frame cut short by the end of the run
+        is not counted."""
+        sent = self.of(host_trace.OUT_UART_TX)
+        data = bytes(v for _, v in sent)
+        frames, index, skipped = [], 0, 0
+        size = telemetry_decode.FRAME_SIZE
+        while True:
+            found = data.find(telemetry_decode.SYNC, index)
+            if found < 0 or found + size > len(data):
+                tail = data[index:]
+                if len(tail) < size and telemetry_decode.SYNC.startswith(tail[:2]):
+                    tail = b""
+                return frames, skipped + len(tail)
+            skipped += found - index
+            frame = data[found:found + size]
+            if telemetry_decode.crc16(frame[2:size - 2]) != struct.unpack_from("<H", frame, size - 2)[0]:
+                skipped += 1
+                index = found + 1
+                continue
+            frames.append((sent[found + size - 1][0], frame[2], frame[3], frame[4:size - 2]))
+            index = found + size
+
+    def telemetry(self):
+        """[(time us, sample)] for each sample frame sent. See
+        telemetry_decode.decode_sample()."""
+        samples = []
+        for t, kind, sequence, payload in self.frames()[0]:
+            if kind == telemetry_decode.FRAME_SAMPLE:
+                sample = telemetry_decode.decode_sample(payload)
+                sample["sequence"] = sequence
+                samples.append((t, sample))
+        return samples
+
+    def value_at(self, kind, channel, time_us):
+        """The last value of an output at or before time_us, else None."""
+        found = None
+        for t, value in self.of(kind, channel):
+            if t > time_us:
+                break
+            found = value
+        return found
+
+    def sample_at(self, time_ms):
+        """The last telemetry sample sent by time_ms."""
+        found = None
+        for t, sample in self.telemetry():
+            if t > time_ms * 1000:
+                break
+            found = sample
+        return found
+
+    def active_fraction(self, mask, start_ms, stop_ms):
+        """The part of start_ms to stop_ms that a Bluetooth output in mask was
+        active."""
+        start_us, stop_us = start_ms * 1000, stop_ms * 1000
+        level, since, active = 0, start_us, 0
+        for t, value in self.of(host_trace.OUT_BLUETOOTH) + [(stop_us, None)]:
+            if t <= start_us:
+                level = value
+                continue
+            if t > stop_us:
+                t = stop_us
+            if level & mask:
+                active += t - since
+            since = t
+            if value is None or t >= stop_us:
+                break
+            level = value
+        return active / float(stop_us - start_us)
+
+
+def simulate(program, text, work_dir, name="scenario"):
+    """Runs scenario text on firmware_sim and returns its Run."""
+    scenarios = host_trace.parse_scenarios(text, name)
+    records = scenarios[0][1]
+    trace = os.path.join(work_dir, name + ".trace")
+    output = os.path.join(work_dir, name + ".out")
+    host_trace.write_trace(trace, records)
+    process = subprocess.run([program, trace, output], stdout=subprocess.PIPE,
+                             stderr=subprocess.STDOUT, text=True, timeout=RUN_TIMEOUT_S)
+    if process.returncode not in (0, 2):
+        raise CheckFailed("firmware_sim exit %d\n%s" % (process.returncode, process.stdout))
+    end_us = max(r[0] for r in records if r[1] == host_trace.IN_END)
+    return Run(host_trace.read_trace(output), end_us)
+
+
+def run_program(program, args):
+    """Runs a host program other than firmware_sim and returns its output."""
+    process = subprocess.run([program] + [str(a) for a in args], stdout=subprocess.PIPE,
+                             stderr=subprocess.STDOUT, text=True, timeout=RUN_TIMEOUT_S)
+    if process.returncode != 0:
+        raise CheckFailed("%s exit %d\n%s" % (os.path.basename(program), process.returncode, process.stdout))
+    return process.stdout
+
+
+class Program:
+    """A host program other than firmware_sim, run with its arguments."""
+
+    def __init__(self, path):
+        self.path = path
+
+    def __call__(self, *args):
+        return run_program(self.path, args)
+
+
+def run_check(name, program):
+    """Runs one check, returns (name, None) or (name, what failed)."""
+    function, _, _ = CHECKS[name]
+    with tempfile.TemporaryDirectory(prefix="host_test_") as work_dir:
+        count = [0]
+
+        def sim(text):
+            count[0] += 1
+            return simulate(program, text, work_dir, "%s_%d" % (name, count[0]))
+        try:
+            if CHECKS[name][2] == "firmware_sim":
+                function(sim)
+            else:
+                function(Program(program))
+        except CheckFailed as error:
+            return name, str(error)
+    return name, None
+
+
+###############################################################################
+# Bluetooth
+###############################################################################
+
+def bt_scenario(speed, proportional, hold_ms=2000):
+    """In Bluetooth, speed held for hold_ms from BT_READY_MS. There is no ADC
+    noise, so a deflection gives one duty rather than two neighbouring ones."""
+    text = BT_ENTRY
+    if proportional:
+        text += "0 eeprom %d 0x%02x 0x%02x\n" % (EEPROM_BT_MODE, EEPROM_BT_MODE_PROPORTIONAL & 0xFF,
+                                                 EEPROM_BT_MODE_PROPORTIONAL >> 8)
+    text += "%d speed %d\n%d end\n" % (BT_READY_MS, speed, BT_READY_MS + hold_ms)
+    return text
+
+
+@check("bt_pdm_duty")
+def check_bt_pdm_duty(sim):
+    """The proportional cursor's duty, measured on the FWD pin, rises with
+    the deflection from none at neutral to all of the time at full, in
+    steps of 1/16 (BT_PDM_FULL_SCALE). Switched mode is all or nothing,
+    at half travel."""
+    settle_ms = 100
+    last = -1.0
+    for speed in (host_trace.NEUTRAL, 560, 580, 600, 640, 680, 720, 800):
+        run = sim(bt_scenario(speed, True))
+        duty = run.active_fraction(BT_FWD, BT_READY_MS + settle_ms, run.end_us // 1000)
+        expect(run.state_at(BT_READY_MS) == "BT", "speed %d: not in Bluetooth at %d ms", speed, BT_READY_MS)
+        # 95 slots of 20 ms are measured, a slot either way is about 0.01.
+        steps = duty * 16
+        expect(abs(steps - round(steps)) < 0.25, "speed %d: duty %.3f is not a multiple of 1/16", speed, duty)
+        expect(duty >= last - 0.01, "speed %d: duty %.3f fell from %.3f", speed, duty, last)
+        expect(run.active_fraction(BT_REV | BT_LEFT | BT_RIGHT, BT_READY_MS + settle_ms, run.end_us // 1000) == 0,
+               "speed %d: another direction was active", speed)
+        if speed == host_trace.NEUTRAL:
+            expect(duty == 0, "neutral: duty %.3f", duty)
+        last = duty
+    expect(last > 0.99, "full forward: duty %.3f", last)
+
+    # Switched mode is off below half travel and on above it.
+    for speed, on in ((600, False), (700, True), (800, True)):
+        run = sim(bt_scenario(speed, False))
+        duty = run.active_fraction(BT_FWD, BT_READY_MS + settle_ms, run.end_us // 1000)
+        expect(duty > 0.99 if on else duty == 0, "switched, speed %d: duty %.3f", speed, duty)
+
+
+@check("bt_mode_saved")
+def check_bt_mode_saved(sim):
+    """Toggling the mode with the Calibration button writes it to the
+    EEPROM a byte at a time, without holding up the cursor, and the next
+    power up comes back in that mode."""
+    run = sim(BT_ENTRY + """
+4000    speed 800
+4500    press cal
+4800    release cal
+6000    end
+""")
+    writes = [(t, a, b) for t, a, b in run.eeprom_writes() if a in (EEPROM_BT_MODE, EEPROM_BT_MODE + 1)]
+    expect([(a, b) for _, a, b in writes] == [(EEPROM_BT_MODE, 0xa5), (EEPROM_BT_MODE + 1, 0x5a)],
+           "Bluetooth mode writes %s", writes)
+
+    # A blocking write would hold the outputs still for both bytes (8 ms);
+    # the cursor is full forward, so the FWD pin must keep being driven.
+    pulses = [t for t, v in run.of(host_trace.OUT_BLUETOOTH) if writes[0][0] - 20000 <= t <= writes[1][0] + 20000]
+    expect(run.active_fraction(BT_FWD, 4600, 5000) > 0.99, "FWD dropped while the mode was saved: %s", pulses)
+
+    run = sim(bt_scenario(600, True))
+    duty = run.active_fraction(BT_FWD, BT_READY_MS + 100, run.end_us // 1000)
+    expect(0 < duty < 0.99, "saved proportional mode not used after power up, duty %.3f", duty)
+
+
+###############################################################################
+# Gate normalisation
+###############################################################################
+
+TELEMETRY_FLAG_GATE = 0x10              # See Telemetry.h.
+NEUTRAL_MARGIN_COMPACT = 0x18           # The neutral windows, see AnalogInput.h.
+NEUTRAL_MARGIN_STANDARD = 0x40
+NEUTRAL_TRACK_REST_BAND = 8
+GATE_RADIUS = 180                       # ADC counts from neutral to the gate, on the axes.
+
+
+def gate_radius(shape, angle):
+    """The distance to the edge of a round, square or octagonal gate, its
+    flats GATE_RADIUS from the centre, at angle (radians from full right)."""
+    c, s = abs(math.cos(angle)), abs(math.sin(angle))
+    if shape == "round":
+        return GATE_RADIUS
+    if shape == "square":
+        return GATE_RADIUS / max(c, s)
+    return GATE_RADIUS / max(c, s, abs(math.cos(angle - math.pi / 4)), abs(math.cos(angle + math.pi / 4)))
+
+
+def gate_point(shape, degrees, fraction=1.0):
+    """(speed, direction) ADC counts at fraction of the way to the gate."""
+    angle = math.radians(degrees)
+    radius = gate_radius(shape, angle) * fraction
+    return (int(round(host_trace.NEUTRAL + radius * math.sin(angle))),
+            int(round(host_trace.NEUTRAL + radius * math.cos(angle))))
+
+
+def gate_scenario(shape, calibrate, hold_ms=200):
+    """Calibrates by running the joystick once round the gate (if asked),
+    then holds it against the gate every 15 degrees, back at neutral
+    between. Returns the scenario and [(degrees, time ms at the end of the
+    hold)]."""
+    lines = ["0 eeprom calibrated %d" % GATE_RADIUS]
+    t = 2000
+    if calibrate:
+        lines += ["1000 press cal", "1300 release cal"]
+        for degrees in range(0, 361, 3):
+            speed, direction = gate_point(shape, degrees)
+            lines += ["%d speed %d" % (t, speed), "%d direction %d" % (t, direction)]
+            t += 10
+        lines += ["%d speed neutral" % t, "%d direction neutral" % t,
+                  "%d press cal" % (t + 500), "%d release cal" % (t + 800)]
+        t += 3500
+
+    holds = []
+    for degrees in range(0, 360, 15):
+        speed, direction = gate_point(shape, degrees)
+        lines += ["%d speed %d" % (t, speed), "%d direction %d" % (t, direction)]
+        t += hold_ms
+        holds.append((degrees, t))
+        lines += ["%d speed neutral" % t, "%d direction neutral" % t]
+        t += 100
+    lines.append("%d end" % t)
+    return "\n".join(lines), holds
+
+
+def gate_errors(run, holds):
+    """[(degrees, radius / GATE_RADIUS, angle error in degrees)] of the
+    readings after the gate normalisation, from the telemetry."""
+    errors = []
+    for degrees, t in holds:
+        sample = run.sample_at(t - 10)
+        expect(sample is not None and sample["state_name"] == "DRIVING_STATE",
+               "%d degrees: not driving at %d ms", degrees, t)
+        dy = sample["filtered_speed"] - host_trace.NEUTRAL
+        dx = sample["filtered_direction"] - host_trace.NEUTRAL
+        error = (math.degrees(math.atan2(dy, dx)) - degrees + 180) % 360 - 180
+        errors.append((degrees, math.hypot(dx, dy) / GATE_RADIUS, error))
+    return errors
+
+
+@check("gate_shapes")
+def check_gate_shapes(sim):
+    """After calibrating on a round, square or octagonal gate, the joystick
+    held against the gate never reads further from neutral than on the
+    axes, so no diagonal over-drives, and reads in the direction it is
+    pushed.
+
+    A sector's gain is set by its furthest point, so within a sector the
+    reading falls short by the gate's change of radius across it: a
+    square's corner sectors start up to a quarter short, a round gate is
+    exact."""
+    for shape in ("round", "square", "octagon"):
+        text, holds = gate_scenario(shape, True)
+        run = sim(text)
+        expect(any(name == "EXIT_JOYSTICK_CALIBRATION" for _, name in run.states()),
+               "%s: calibration not saved", shape)
+        expect(run.telemetry()[-1][1]["flags"] & TELEMETRY_FLAG_GATE, "%s: gate normalisation not in use", shape)
+        for degrees, radius, error in gate_errors(run, holds):
+            low = 0.97 if shape == "round" else 0.75
+            expect(low <= radius <= 1.03, "%s, %d degrees: radius %.2f of the gate", shape, degrees, radius)
+            expect(abs(error) <= 1.5, "%s, %d degrees: %.1f degrees off", shape, degrees, error)
+
+    # Without a gate table the square's corners read 1.41 times as far.
+    text, holds = gate_scenario("square", False)
+    corners = [radius for degrees, radius, _ in gate_errors(sim(text), holds) if degrees % 90 == 45]
+    expect(min(corners) > 1.35, "square, not calibrated: corners at %s", corners)
+
+
+###############################################################################
+# Response curves
+###############################################################################
+
+# The EEPROM addresses of the response curve and the DAC swing, and the
+# demand at full deflection, see main.c.
+EEPROM_RESPONSE_CURVE = 32
+EEPROM_DAC_SWING = 38
+JOYSTICK_DEMAND_SWING = 630
+CURVE_SCALE = 200                       # Calibrated travel, ADC counts.
+
+
+def curve_scenario(curve, axis, step_ms=10):
+    """Steps the axis out from neutral a count at a time to past full
+    forward (or right), then the same to full reverse (or left), on the
+    given response curve. The DAC swing is opened up to
+    JOYSTICK_DEMAND_SWING, so no demand is clipped.
+
+    Each side starts just past NEUTRAL_TRACK_REST_BAND, so the slow steps
+    are not taken for the neutral drifting."""
+    lines = ["0 eeprom calibrated %d" % CURVE_SCALE,
+             "0 eeprom %d %d 0" % (EEPROM_RESPONSE_CURVE, curve),
+             "0 eeprom %d 0x%02x 0x%02x" % (EEPROM_DAC_SWING, JOYSTICK_DEMAND_SWING & 0xFF,
+                                            JOYSTICK_DEMAND_SWING >> 8)]
+    t = 1000
+    for sign in (1, -1):
+        for deflection in range(NEUTRAL_TRACK_REST_BAND + 1, CURVE_SCALE + 11):
+            lines.append("%d %s %d" % (t, axis, host_trace.NEUTRAL + sign * deflection))
+            t += step_ms
+        lines.append("%d %s neutral" % (t, axis))
+        t += 300
+    lines.append("%d end" % t)
+    return "\n".join(lines)
+
+
+@check("response_curves")
+def check_response_curves(sim):
+    """On every response curve and both axes, the demand never falls as the
+    joystick moves out from neutral either way, is neutral inside the
+    neutral window, reaches exactly the full swing at full deflection, and
+    follows the curve of tools/gen_response_curves.py in between."""
+    for curve, (name, _, function) in enumerate(gen_response_curves.CURVES):
+        for axis in ("speed", "direction"):
+            run = sim(curve_scenario(curve, axis))
+            samples = [sample for _, sample in run.telemetry() if sample["state_name"] == "DRIVING_STATE"]
+            expect(samples and all(sample["curve"] == curve for sample in samples),
+                   "%s: curve %d not in use", name, curve)
+            neutral = samples[0][axis + "_demand"]
+            last, furthest = None, 0
+            for sample in samples:
+                reading, demand = sample["filtered_" + axis], sample[axis + "_demand"]
+                deflection = reading - host_trace.NEUTRAL
+                where = "%s, %s at %d" % (name, axis, reading)
+                if last is not None and (deflection > 0) == (last[0] > host_trace.NEUTRAL) \
+                        and abs(deflection) >= abs(last[0] - host_trace.NEUTRAL):
+                    expect(abs(demand - neutral) >= abs(last[1] - neutral),
+                           "%s: demand %d fell from %d at %d", where, demand, last[1], last[0])
+                last = (reading, demand)
+                furthest = max(furthest, abs(deflection))
+
+                magnitude = min(abs(deflection), CURVE_SCALE) / float(CURVE_SCALE)
+                expected = int(JOYSTICK_DEMAND_SWING * function(magnitude)) * (1 if deflection >= 0 else -1)
+                if abs(deflection) <= NEUTRAL_MARGIN_COMPACT:
+                    expect(demand == neutral, "%s: demand %d inside the neutral window", where, demand)
+                elif abs(deflection) > NEUTRAL_MARGIN_STANDARD:
+                    expect(abs(demand - neutral - expected) <= 4, "%s: demand %+d, the curve gives %+d",
+                           where, demand - neutral, expected)
+                if abs(deflection) >= CURVE_SCALE:
+                    expect(abs(demand - neutral) == JOYSTICK_DEMAND_SWING,
+                           "%s: demand %+d at full deflection", where, demand - neutral)
+            expect(furthest >= CURVE_SCALE, "%s, %s: never reached full", name, axis)
+
+
+###############################################################################
+# Telemetry
+###############################################################################
+
+# BUTTON_MASK_xxx, see UserButton.h.
+BUTTON_MASK_SW2_1, BUTTON_MASK_SW2_2 = 0x08, 0x10
+
+TELEMETRY_SCENARIO = """
+0       eeprom calibrated 200
+1000    speed 600
+1400    speed 680
+1800    direction 400
+2200    speed neutral
+2200    direction neutral
+2600    press sw22
+3000    release sw22
+3000    press sw21
+3400    release sw21
+3600    uart %s
+3600    speed 300
+4000    speed neutral
+4400    end
+"""
+# Readings and demands settle this long after an input changes.
+TELEMETRY_SETTLE_MS = 20
+
+
+@check("telemetry")
+def check_telemetry(sim):
+    """The telemetry sent on the simulated UART is whole frames with good
+    CRCs and no gaps in the sequence, one sample frame per
+    TELEMETRY_DEFAULT_DECIMATION passes, and each sample holds what the
+    firmware did at the time: the joystick input, the state, the DAC
+    outputs and the switches. A live tuning request received on the UART
+    is answered in the same stream, and telemetry_decode.py reads the
+    capture without error."""
+    request = livetune.request(livetune.CMD_GET, 0x42, livetune.PARAM_NAMES.index("response_curve"))
+    scenario = TELEMETRY_SCENARIO % " ".join("%02x" % b for b in request)
+    run = sim(scenario)
+
+    frames, skipped = run.frames()
+    expect(skipped == 0, "%d bytes sent outside good frames", skipped)
+    expect(len(frames) > 300, "only %d frames in 4.4 s", len(frames))
+    for (_, _, previous, _), (t, _, sequence, _) in zip(frames, frames[1:]):
+        expect(sequence == (previous + 1) & 0xFF, "sequence %d after %d at %.1f ms", sequence, previous, t / 1000.0)
+
+    inputs = host_trace.parse_scenarios(scenario)[0][1]
+    changes = [t for t, kind, _, _ in inputs if kind in (host_trace.IN_SPEED, host_trace.IN_DIRECTION, host_trace.IN_BUTTONS)]
+    speed = direction = host_trace.NEUTRAL
+    buttons = 0
+    index = 0
+    for t, sample in run.telemetry():
+        while index < len(inputs) and inputs[index][0] <= t - TELEMETRY_SETTLE_MS * 1000:
+            _, kind, _, value = inputs[index]
+            speed = value if kind == host_trace.IN_SPEED else speed
+            direction = value if kind == host_trace.IN_DIRECTION else direction
+            buttons = value if kind == host_trace.IN_BUTTONS else buttons
+            index += 1
+        if any(t - TELEMETRY_SETTLE_MS * 1000 < change <= t for change in changes):
+            continue
+        where = "sample %d at %.1f ms" % (sample["sequence"], t / 1000.0)
+        state = host_trace.STATES[run.value_at(host_trace.OUT_STATE, 0, t)]
+        expect(sample["state_name"].startswith(state.replace("_BT", "_BLUETOOTH")),
+               "%s: state %s, the firmware was in %s", where, sample["state_name"], state)
+        if state != "DRIVING":
+            continue
+        expect((sample["raw_speed"], sample["raw_direction"]) == (speed, direction),
+               "%s: joystick %d, %d, the input was %d, %d", where,
+               sample["raw_speed"], sample["raw_direction"], speed, direction)
+        dacs = (run.value_at(host_trace.OUT_DAC, 0, t), run.value_at(host_trace.OUT_DAC, 1, t))
+        expect((sample["speed_demand"], sample["direction_demand"]) == dacs,
+               "%s: demands %d, %d, the DACs were at %d, %d", where,
+               sample["speed_demand"], sample["direction_demand"], dacs[0], dacs[1])
+        switches = (BUTTON_MASK_SW2_1 if buttons & host_trace.BUTTONS["sw21"] else 0) \
+            | (BUTTON_MASK_SW2_2 if buttons & host_trace.BUTTONS["sw22"] else 0)
+        expect(sample["buttons"] == switches, "%s: buttons 0x%02x, expected 0x%02x", where, sample["buttons"], switches)
+
+    answers = [(t, payload) for t, kind, _, payload in frames if kind == livetune.FRAME_TUNE]
+    expect(len(answers) == 1, "%d answers to one tuning request", len(answers))
+    t, payload = answers[0]
+    expect(payload[:6] == bytes([livetune.CMD_GET, 0x42, 0, request[4], 0, 0]),
+           "tuning answer %s", payload.hex())
+    expect(t < 3700 * 1000, "tuning request answered at %.1f ms", t / 1000.0)
+
+    capture = bytes(v for _, v in run.of(host_trace.OUT_UART_TX))
+    process = subprocess.run([sys.executable, os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                                                           "telemetry_decode.py"), "-", "--csv", os.devnull],
+                             input=capture, stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+    report = process.stdout.decode()
+    expect(process.returncode == 0 and "dropped: 0, CRC errors: 0" in report,
+           "telemetry_decode.py: %s", report.strip())
+
+
+###############################################################################
+# ADC noise
+###############################################################################
+
+EEPROM_TUNE_ADC_MODE = 42               # EEPROM_TUNING + 6, see g_TuneParams in main.c.
+ADC_MODES = [(0, 10), (1, 4)]           # ADC_MODE_xxx and the readings averaged in it.
+ADC_NOISE_PEAK = 8
+ADC_NOISE_START_MS = 500
+ADC_NOISE_END_MS = 5000
+
+
+def rest_capture(sim, work_dir, name, mode):
+    """Powers up in an ADC mode with ADC_NOISE_PEAK noise and the joystick
+    at rest, and writes the telemetry as telemetry_decode.py's CSV. Returns
+    the CSV's path."""
+    run = sim("0 eeprom calibrated 200\n0 eeprom %d 0x%02x 0x00\n0 noise both %d\n%d end"
+              % (EEPROM_TUNE_ADC_MODE, mode, ADC_NOISE_PEAK, ADC_NOISE_END_MS))
+    path = os.path.join(work_dir, name + ".csv")
+    process = subprocess.run([sys.executable, os.path.join(TOOLS_DIR, "telemetry_decode.py"), "-",
+                              "--csv", path, "--no-stats"],
+                             input=run.uart_bytes(ADC_NOISE_START_MS), stdout=subprocess.PIPE,
+                             stderr=subprocess.STDOUT)
+    if process.returncode != 0:
+        raise CheckFailed("telemetry_decode.py: %s" % process.stdout.decode())
+    return path
+
+
+@check("adc_noise")
+def check_adc_noise(sim):
+    """adc_noise.py, on captures from the host build with a known noise:
+    the standard deviation it finds in each ADC mode is the model's, that
+    of the noise averaged over the mode's readings, and it calls the mode
+    that averages fewer readings the worse."""
+    with tempfile.TemporaryDirectory(prefix="adc_noise_") as work_dir:
+        captures = []
+        for mode, samples in ADC_MODES:
+            captures.append(rest_capture(sim, work_dir, "mode%d" % mode, mode))
+            # Uniform over 2 * peak + 1 counts, then averaged.
+            expected = math.sqrt((((2 * ADC_NOISE_PEAK + 1) ** 2 - 1) / 12.0) / samples)
+            for channel, (count, _, std) in zip(adc_noise.CHANNELS,
+                                                (adc_noise.stats(v) for v in
+                                                 adc_noise.load(captures[-1], adc_noise.REST_COUNTS).values())):
+                expect(count > 200, "mode %d %s: %d samples", mode, channel, count)
+                expect(abs(std - expected) <= 0.2 * expected, "mode %d %s: std %.3f, expected %.3f",
+                       mode, channel, std, expected)
+
+        for before, after, worse in ((captures[0], captures[1], True), (captures[1], captures[0], False),
+                                     (captures[0], captures[0], False)):
+            process = subprocess.run([sys.executable, os.path.join(TOOLS_DIR, "adc_noise.py"), before, after],
+                                     stdout=subprocess.PIPE, stderr=subprocess.STDOUT, text=True)
+            expect(process.returncode == (1 if worse else 0), "adc_noise.py %s %s: exit %d\n%s",
+                   os.path.basename(before), os.path.basename(after), process.returncode, process.stdout)
+
+
+###############################################################################
+# Failsafe
+###############################################################################
+
+# See FailsafeMonitor.h.
+FAULT_ADC_TIMEOUT, FAULT_RAIL, FAULT_OUT_OF_GATE, FAULT_SLEW = 0x01, 0x02, 0x04, 0x08
+FAILSAFE_PERSISTENCE = 3
+FAILSAFE_LATCHED = 0x80                 # See HOST_OUT_FAILSAFE in host_sim.h.
+# host/scenarios/ file, the fault it is of and when it starts.
+FAULT_SCENARIOS = [
+    ("fault", FAULT_RAIL, 1500),
+    ("out_of_gate", FAULT_OUT_OF_GATE, 1000),
+    ("slew", FAULT_SLEW, 1000),
+    ("adc_timeout", FAULT_ADC_TIMEOUT, 2000),
+]
+
+
+@check("fault_latency")
+def check_fault_latency(sim):
+    """Each kind of fault in its replay scenario latches on the
+    FAILSAFE_PERSISTENCE'th pass of the control loop that sees it, the
+    first of them at once. Nothing is seen before the fault starts: an ADC
+    timeout during the power up is not held against the first pass of
+    driving."""
+    for name, fault, start_ms in FAULT_SCENARIOS:
+        with open(os.path.join(host_build.HOST_DIR, "scenarios", name + ".txt")) as scenario:
+            run = sim(scenario.read())
+        changes = [(t, bits, passes) for t, kind, bits, passes in run.records if kind == host_trace.OUT_FAILSAFE]
+        seen = [(t, passes) for t, bits, passes in changes if bits & fault]
+        latched = [(t, passes) for t, bits, passes in changes if bits & FAILSAFE_LATCHED]
+        expect(seen and latched, "%s: fault 0x%02x %s, %s", name, fault,
+               "seen" if seen else "never seen", "latched" if latched else "never latched")
+        expect(changes[0][0] >= start_ms * 1000, "%s: 0x%02x seen at %.1f ms, before the fault at %d ms",
+               name, changes[0][1], changes[0][0] / 1000.0, start_ms)
+        expect(seen[0][0] <= (start_ms + 500) * 1000, "%s: seen at %.1f ms", name, seen[0][0] / 1000.0)
+        first = min(passes for _, _, passes in changes)
+        loops = latched[0][1] - first + 1
+        expect(loops == FAILSAFE_PERSISTENCE, "%s: latched on the %d. pass with the fault, expected %d",
+               name, loops, FAILSAFE_PERSISTENCE)
+
+
+###############################################################################
+# Neutral drift
+###############################################################################
+
+EEPROM_BLACKBOX = blackbox_decode.EEPROM_BLACKBOX
+DRIFT_SCENARIO = """
+0       eeprom calibrated 200
+1000    speed %d
+1000    direction %d
+4000    speed 0
+6000    end
+"""
+DRIFT = (6, -5)                         # Speed and direction, inside NEUTRAL_TRACK_REST_BAND.
+
+
+@check("neutral_drift")
+def check_neutral_drift(sim):
+    """A joystick resting a few counts off the neutral it powered up with is
+    followed, and the drift of each axis, to a count, is in the black box
+    copied when a fault latches."""
+    run = sim(DRIFT_SCENARIO % (host_trace.NEUTRAL + DRIFT[0], host_trace.NEUTRAL + DRIFT[1]))
+    eeprom = bytearray(b"\xff" * 256)
+    for _, address, byte in run.eeprom_writes():
+        eeprom[address] = byte
+    image = eeprom[EEPROM_BLACKBOX:]
+    expect(image[0] == blackbox_decode.MAGIC, "no black box copy, magic 0x%02x", image[0])
+    events = [(image[i + 2], image[i + 3]) for i in range(blackbox_decode.HEADER_SIZE,
+                                                          blackbox_decode.HEADER_SIZE + image[3] * blackbox_decode.EVENT_SIZE,
+                                                          blackbox_decode.EVENT_SIZE)]
+    found = {}
+    for kind, data in events:
+        if kind in (blackbox_decode.EVENT_SPEED_DRIFT, blackbox_decode.EVENT_DIRECTION_DRIFT):
+            found[kind] = data - 256 if data & 0x80 else data
+    for kind, drift in zip((blackbox_decode.EVENT_SPEED_DRIFT, blackbox_decode.EVENT_DIRECTION_DRIFT), DRIFT):
+        name = blackbox_decode.describe(kind, 0)[0]
+        # The tracker's filter settles within a count of the reading.
+        expect(kind in found and abs(found[kind] - drift) <= 1, "%s %s, expected %+d",
+               name, "%+d" % found[kind] if kind in found else "not recorded", drift)
+
+
+###############################################################################
+# Gestures
+###############################################################################
+
+# See main.c and Gesture.h.
+EEPROM_GESTURES = 34
+GESTURE_ENABLE_DOUBLE_FLICK, GESTURE_ENABLE_HOLD_DIRECTION = 0x02, 0x04
+GESTURE_HOLD_DIRECTION_MS = 3000
+GESTURE_FLICK_MAX_MS, GESTURE_FLICK_GAP_MS = 400, 600
+JOYSTICK_RAW_MAX_DEFLECTION = 220
+CALIBRATION_MIN_SCALE = JOYSTICK_RAW_MAX_DEFLECTION // 8
+
+GESTURES_ON = "0 eeprom %d 0x%02x 0x%02x\n" % (
+    EEPROM_GESTURES, GESTURE_ENABLE_DOUBLE_FLICK | GESTURE_ENABLE_HOLD_DIRECTION,
+    ~(GESTURE_ENABLE_DOUBLE_FLICK | GESTURE_ENABLE_HOLD_DIRECTION) & 0xFF)
+# Out to one side (past half travel of the 200 count scale) and well clear
+# of it.
+GESTURE_SIDE = 190
+# A gesture is acted on within this of the input that completes it.
+GESTURE_LATENCY_MS = 30
+# Driving moves in the false trigger run, and the seed they are made from.
+GESTURE_DRIVING_MOVES = 150
+GESTURE_DRIVING_SEED = 43
+
+CALIBRATION_START = """
+0       eeprom calibrated 200
+%s
+1000    press cal
+1300    release cal
+""" % GESTURES_ON
+CALIBRATION_READY_MS = 1500
+
+
+def sweep(start_ms, axis, to, over_ms=400):
+    """Out to "to" from neutral and back, on one axis."""
+    middle = start_ms + over_ms
+    return "%d ramp %s %d %d %d\n%d ramp %s %d %d %d\n" % (
+        start_ms, axis, host_trace.NEUTRAL, to, over_ms, middle, axis, to, host_trace.NEUTRAL, over_ms)
+
+
+def first_state_after(run, name, time_ms):
+    """When the firmware next entered the named state after time_ms, or None."""
+    return next((t for t, state in run.states() if state == name and t > time_ms * 1000), None)
+
+
+@check("gestures")
+def check_gestures(sim):
+    """A double flick in driving goes to Bluetooth, and a hold out to one
+    side ends a calibration once the joystick is back in neutral, each
+    within GESTURE_LATENCY_MS of the movement that completes it. A hold
+    part way round the gate, before the joystick has been out
+    CALIBRATION_MIN_SCALE every way, does not end the calibration, and
+    ordinary driving, quick single moves and holds included, never sets a
+    gesture off."""
+    neutral = host_trace.NEUTRAL
+
+    # Double flick, from driving.
+    text = "0 eeprom calibrated 200\n" + GESTURES_ON
+    t = 3000
+    for _ in range(2):
+        text += "%d direction %d\n%d direction neutral\n" % (t, neutral + GESTURE_SIDE, t + 150)
+        t += 400
+    done_ms = t - 400 + 150
+    text += "%d end\n" % (done_ms + 1000)
+    run = sim(text)
+    expect(run.state_at(3000) == "DRIVING", "not driving before the flicks")
+    entered = first_state_after(run, "ANNOUNCE_ENTER_BT", 3000)
+    expect(entered is not None, "a double flick did not go to Bluetooth")
+    expect(done_ms * 1000 <= entered <= (done_ms + GESTURE_LATENCY_MS) * 1000,
+           "a double flick finished at %d ms went to Bluetooth at %.1f ms", done_ms, entered / 1000.0)
+
+    # Calibration, ended by a hold once all four ways have been seen.
+    text = CALIBRATION_START
+    t = CALIBRATION_READY_MS
+    for axis, to in (("speed", 720), ("speed", 300), ("direction", 720), ("direction", 300)):
+        text += sweep(t, axis, to)
+        t += 1000
+    hold_ms, back_ms = t, t + GESTURE_HOLD_DIRECTION_MS + 500
+    text += "%d direction %d\n%d direction neutral\n%d end\n" % (hold_ms, neutral + GESTURE_SIDE, back_ms,
+                                                                 back_ms + 2000)
+    run = sim(text)
+    expect(run.state_at(CALIBRATION_READY_MS) == "DO_JOYSTICK_CALIBRATION", "not calibrating")
+    expect(first_state_after(run, "EXIT_JOYSTICK_CALIBRATION", CALIBRATION_READY_MS) is not None,
+           "a hold did not end the calibration")
+    # The scales are written, a byte at a time, before the state changes.
+    ended = min(t for t, address, _ in run.eeprom_writes() if address < 8)
+    expect(back_ms * 1000 <= ended <= (back_ms + GESTURE_LATENCY_MS) * 1000,
+           "the joystick was back in neutral at %d ms, the calibration ended at %.1f ms",
+           back_ms, ended / 1000.0)
+    scales = {}
+    for _, address, byte in run.eeprom_writes():
+        if address < 8:
+            scales[address] = byte
+    scales = [scales.get(a, 0) | (scales.get(a + 1, 0) << 8) for a in range(0, 8, 2)]
+    expect(all(scale >= 200 for scale in scales), "scales %s saved, the joystick went out 206 or more", scales)
+
+    # A hold forward before the other ways have been seen.
+    text = CALIBRATION_START
+    t = CALIBRATION_READY_MS
+    text += "%d speed %d\n%d speed neutral\n" % (t, 720, t + GESTURE_HOLD_DIRECTION_MS + 500)
+    t += GESTURE_HOLD_DIRECTION_MS + 1500
+    for axis, to in (("speed", 300), ("direction", 720), ("direction", 300)):
+        text += sweep(t, axis, to)
+        t += 1000
+    text += "%d press cal\n%d release cal\n%d end\n" % (t, t + 300, t + 1500)
+    run = sim(text)
+    ended = first_state_after(run, "EXIT_JOYSTICK_CALIBRATION", CALIBRATION_READY_MS)
+    expect(ended is not None and ended >= t * 1000,
+           "a hold forward before the other ways were seen ended the calibration at %.1f ms",
+           (ended or 0) / 1000.0)
+
+    # Ordinary driving: moves anywhere, some quick, some held, each followed
+    # by a rest longer than GESTURE_FLICK_GAP_MS, so none is a gesture.
+    rng = random.Random(GESTURE_DRIVING_SEED)
+    text = "0 eeprom calibrated 200\n%s0 noise both 2\n" % GESTURES_ON
+    t, quick = 3000, 0
+    for _ in range(GESTURE_DRIVING_MOVES):
+        angle = rng.uniform(0, 2 * math.pi)
+        reach = rng.uniform(0.2, 1.0) * 200
+        hold = rng.choice((rng.uniform(50, GESTURE_FLICK_MAX_MS), rng.uniform(500, 2500)))
+        quick += hold < GESTURE_FLICK_MAX_MS
+        text += "%d speed %d\n%d direction %d\n" % (t, neutral + reach * math.cos(angle), t,
+                                                      neutral + reach * math.sin(angle))
+        t += int(hold)
+        text += "%d speed neutral\n%d direction neutral\n" % (t, t)
+        t += int(rng.uniform(GESTURE_FLICK_GAP_MS + 100, 1500))
+    text += "%d end\n" % t
+    run = sim(text)
+    left = [(time, state) for time, state in run.states() if time > 3000 * 1000]
+    expect(not left, "driving for %.0f s with %d quick moves set off %s", (t - 3000) / 1000.0, quick,
+           ", ".join("%s at %.1f ms" % (state, time / 1000.0) for time, state in left[:3]))
+
+
+###############################################################################
+# Live tuning
+###############################################################################
+
+# The Release_RNet neutral demand and swing, see main.c, and the EEPROM
+# addresses of the saved ones.
+TUNE_NEUTRAL, TUNE_SWING = 2002, 344
+EEPROM_TUNE_NEUTRAL, EEPROM_TUNE_SWING = 36, 38
+NEUTRAL_DEMAND, DAC_SWING, DECIMATION = (livetune.PARAM_NAMES.index(n) for n in
+                                         ("neutral_demand", "dac_swing", "telemetry_decimation"))
+
+# Boots with a saved neutral demand of 2040 and a saved swing of 700, past
+# its limit, takes SETs while driving and leaves driving for Bluetooth with
+# the User Port button at 3000 ms. The announcement holds the loop until the
+# Bluetooth state, so the held values are used then.
+LIVE_TUNE_SCENARIO = """
+0       eeprom calibrated 200
+0       eeprom %d 0xf8 0x07 0xbc 0x02
+1000    uart %%s
+1500    uart %%s
+2000    uart %%s
+3000    press user
+3300    release user
+6000    uart %%s
+6500    end
+""" % EEPROM_TUNE_NEUTRAL
+
+
+def uart_requests(*requests):
+    """A scenario's uart bytes for (command, sequence, param, value) requests."""
+    return " ".join("%02x" % b for r in requests for b in livetune.request(*r))
+
+
+def tune_answers(run):
+    """{sequence: (time us, response)} for the tuning answers sent."""
+    return {payload[1]: (t, livetune.decode(payload))
+            for t, kind, _, payload in run.frames()[0] if kind == livetune.FRAME_TUNE}
+
+
+@check("live_tune")
+def check_live_tune(sim):
+    """Saved settings are checked against their limits again at power up. A
+    SET of the neutral demand or the swing while driving is answered held
+    and leaves the DACs as they are; both are used, and the DACs go to the
+    new neutral, once out of the driving state."""
+    run = sim(LIVE_TUNE_SCENARIO % (
+        uart_requests((livetune.CMD_GET, 1, NEUTRAL_DEMAND), (livetune.CMD_GET, 2, DAC_SWING)),
+        uart_requests((livetune.CMD_SET, 3, NEUTRAL_DEMAND, 2050), (livetune.CMD_SET, 4, DAC_SWING, 300)),
+        uart_requests((livetune.CMD_GET, 5, NEUTRAL_DEMAND)),
+        uart_requests((livetune.CMD_GET, 6, NEUTRAL_DEMAND), (livetune.CMD_GET, 7, DAC_SWING))))
+    answers = tune_answers(run)
+    expect(sorted(answers) == list(range(1, 8)), "answers to requests %s of 1..7", sorted(answers))
+
+    def answer(sequence, status, value):
+        t, response = answers[sequence]
+        expect((response["status"], response["value"]) == (status, value),
+               "request %d at %.1f ms: status %d value %d, expected %d %d", sequence, t / 1000.0,
+               response["status"], response["value"], status, value)
+
+    answer(1, 0, 2040)
+    answer(2, 0, TUNE_SWING)
+    answer(3, livetune.STATUS_HELD, 2050)
+    answer(4, livetune.STATUS_HELD, 300)
+    answer(5, livetune.STATUS_HELD, 2050)
+    answer(6, 0, 2050)
+    answer(7, 0, 300)
+
+    left = next(t for t, name in run.states() if t > 3000 * 1000 and name != "DRIVING")
+    bluetooth = next(t for t, name in run.states() if name == "BT")
+    for channel in (0, 1):
+        dacs = run.of(host_trace.OUT_DAC, channel)
+        expect(all(v == 2040 for t, v in dacs if t < left), "DAC %d off 2040 before leaving driving", channel)
+        moved = [t for t, v in dacs if v == 2050]
+        expect(moved and left <= moved[0] <= bluetooth,
+               "DAC %d at 2050 from %s, left driving at %.1f ms, Bluetooth at %.1f ms", channel,
+               "%.1f ms" % (moved[0] / 1000.0) if moved else "never", left / 1000.0, bluetooth / 1000.0)
+        expect(all(v == 2050 for t, v in dacs if t >= moved[0]), "DAC %d off 2050 after", channel)
+
+
+PTY_SCENARIO = """
+0       eeprom calibrated 200
+5000    end
+"""
+PTY_TIMEOUT_S = 0.5
+PTY_RETRIES = 6
+
+
+@check("live_tune_pty", program="pty_sim")
+def check_live_tune_pty(run):
+    """livetune.py works with pty_sim as with a board: list answers every
+    parameter, a SET of the neutral demand while driving is held, a SET of
+    the decimation is taken, and a save writes the held neutral demand
+    while the DACs stay where they were."""
+    with tempfile.TemporaryDirectory(prefix="live_tune_pty_") as work_dir:
+        trace, output = os.path.join(work_dir, "pty.trace"), os.path.join(work_dir, "pty.out")
+        records = host_trace.parse_scenarios(PTY_SCENARIO)[0][1]
+        host_trace.write_trace(trace, records)
+        process = subprocess.Popen([run.path, trace, output], stdout=subprocess.PIPE,
+                                   stderr=subprocess.STDOUT, text=True)
+        try:
+            words = process.stdout.readline().split()
+            expect(words[:1] == ["pty"], "pty_sim printed %s", " ".join(words))
+            tool = subprocess.run([sys.executable, os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                                                               "livetune.py"), words[1], "list",
+                                   "--retries", str(PTY_RETRIES)],
+                                  stdout=subprocess.PIPE, stderr=subprocess.STDOUT, text=True)
+            expect(tool.returncode == 0 and all(n in tool.stdout for n in livetune.PARAM_NAMES),
+                   "livetune.py list: %s", tool.stdout.strip())
+
+            link = livetune.Link(words[1])
+            try:
+                held, taken = link.transact([(livetune.CMD_SET, NEUTRAL_DEMAND, 2050),
+                                             (livetune.CMD_SET, DECIMATION, 4)], PTY_TIMEOUT_S, PTY_RETRIES)
+                (got,) = link.transact([(livetune.CMD_GET, DECIMATION, 0)], PTY_TIMEOUT_S, PTY_RETRIES)
+                (saved,) = link.transact([(livetune.CMD_SAVE, 0, 0)], 2.0, PTY_RETRIES)
+            except TimeoutError as error:
+                raise CheckFailed("pty: %s" % error)
+            finally:
+                link.close()
+            expect(held["status"] == livetune.STATUS_HELD, "SET neutral_demand: status %d", held["status"])
+            expect(taken["status"] == 0 and got["value"] == 4, "SET decimation: status %d, then %d",
+                   taken["status"], got["value"])
+            expect(saved["status"] == 0, "SAVE: status %d", saved["status"])
+            process.wait(timeout=RUN_TIMEOUT_S)
+        finally:
+            if process.poll() is None:
+                process.kill()
+                process.wait()
+        expect(process.returncode == 0, "pty_sim exit %d: %s", process.returncode, process.stdout.read().strip())
+        result = Run(host_trace.read_trace(output), max(r[0] for r in records))
+
+    writes = {address: byte for _, address, byte in result.eeprom_writes()}
+    expect((writes.get(EEPROM_TUNE_NEUTRAL), writes.get(EEPROM_TUNE_NEUTRAL + 1)) == (2050 & 0xff, 2050 >> 8),
+           "neutral demand saved as %s", [writes.get(EEPROM_TUNE_NEUTRAL), writes.get(EEPROM_TUNE_NEUTRAL + 1)])
+    expect(all(v == TUNE_NEUTRAL for _, v in result.of(host_trace.OUT_DAC)), "a DAC left %d while driving",
+           TUNE_NEUTRAL)
+
+
+# Where SaveDiagnostics() copies the loop timing, see main.c and LoopTiming.h.
+EEPROM_LOOP_TIMING, LOOP_TIMING_EEPROM_SIZE = 0x40, 64
+SAVE_DIAGNOSTICS = livetune.PARAM_NAMES.index("save_diagnostics")
+
+# Asks for the diagnostics while driving, then holds the Calibration button
+# for longer than the 5 s the save once took.
+SAVE_DIAGNOSTICS_SCENARIO = """
+0       eeprom calibrated 200
+1000    uart %s
+2000    press cal
+8000    release cal
+9000    end
+"""
+
+
+@check("save_diagnostics")
+def check_save_diagnostics(sim):
+    """A save_diagnostics set while driving is taken, but the loop timing is
+    only written to the EEPROM once out of the driving state. Holding the
+    Calibration button still starts a calibration however long it is held."""
+    run = sim(SAVE_DIAGNOSTICS_SCENARIO % uart_requests((livetune.CMD_SET, 1, SAVE_DIAGNOSTICS, 1)))
+    answers = tune_answers(run)
+    expect(1 in answers and answers[1][1]["status"] == 0, "SET save_diagnostics: %s",
+           answers[1][1] if 1 in answers else "no answer")
+
+    left = next((t for t, name in run.states() if t > 2000 * 1000 and name != "DRIVING"), None)
+    writes = [t for t, address, _ in run.eeprom_writes()
+              if EEPROM_LOOP_TIMING <= address < EEPROM_LOOP_TIMING + LOOP_TIMING_EEPROM_SIZE]
+    expect(left is not None, "never left driving")
+    expect(writes and writes[0] >= left, "loop timing written from %s, left driving at %.1f ms",
+           "%.1f ms" % (writes[0] / 1000.0) if writes else "never", left / 1000.0)
+    calibrating = [t for t, name in run.states() if name == "DO_JOYSTICK_CALIBRATION"]
+    expect(calibrating and calibrating[0] >= 8000 * 1000, "calibration started at %s",
+           "%.1f ms" % (calibrating[0] / 1000.0) if calibrating else "never")
+
+
+###############################################################################
+# Joystick type
+###############################################################################
+
+# Where the joystick type found is kept, as the type and its complement, and
+# the types, see main.c and JoystickType.h.
+EEPROM_JOYSTICK_TYPE = 44
+EEPROM_TUNE_MARGIN = EEPROM_TUNE_NEUTRAL + 4
+JOYSTICK_TYPE_STANDARD, JOYSTICK_TYPE_COMPACT = 0, 1
+JOYSTICK_SHORT_TRAVEL = NEUTRAL_MARGIN_STANDARD * 3
+# Held from JOYSTICK_TYPE_PUSH_MS, outside the compact neutral window but
+# inside the standard one.
+JOYSTICK_TYPE_PUSH = (NEUTRAL_MARGIN_COMPACT + NEUTRAL_MARGIN_STANDARD) // 2
+JOYSTICK_TYPE_PUSH_MS = 3000
+JOYSTICK_TYPE_END_MS = 4000
+
+
+def joystick_type(sim, travel, noise, stored=None, margin=None):
+    """Powers up calibrated to travel with noise (peak counts) on the inputs,
+    the type stored last time if not None and a saved neutral_margin if not
+    None, then pushes the joystick to JOYSTICK_TYPE_PUSH. Returns (the type
+    stored after the power up, whether the push drove)."""
+    lines = ["0 eeprom calibrated %d" % travel, "0 noise both %d" % noise]
+    if stored is not None:
+        lines.append("0 eeprom %d 0x%02x 0x%02x" % (EEPROM_JOYSTICK_TYPE, stored, ~stored & 0xff))
+    if margin is not None:
+        lines.append("0 eeprom %d 0x%02x 0x%02x" % (EEPROM_TUNE_MARGIN, margin & 0xff, margin >> 8))
+    lines += ["%d speed %d" % (JOYSTICK_TYPE_PUSH_MS, host_trace.NEUTRAL + JOYSTICK_TYPE_PUSH),
+              "%d end" % JOYSTICK_TYPE_END_MS]
+    run = sim("\n".join(lines))
+
+    writes = {address: byte for _, address, byte in run.eeprom_writes()}
+    found = writes.get(EEPROM_JOYSTICK_TYPE, JOYSTICK_TYPE_STANDARD if stored is None else stored)
+    if EEPROM_JOYSTICK_TYPE in writes:
+        expect(writes.get(EEPROM_JOYSTICK_TYPE + 1) == ~found & 0xff, "type %d stored without its complement", found)
+    demand = run.value_at(host_trace.OUT_DAC, 0, (JOYSTICK_TYPE_END_MS - 100) * 1000)
+    return found, demand != TUNE_NEUTRAL
+
+
+@check("joystick_type")
+def check_joystick_type(sim):
+    """The compact neutral window is only used with a calibrated travel too
+    short for the standard one and a joystick quiet at rest. A well centred,
+    quiet joystick with the standard travel keeps the standard window, and
+    noise the boot's steadiness test lets through still counts. A joystick
+    found compact before stays compact up to twice the noise. A saved
+    neutral_margin is used whatever the type."""
+    short = JOYSTICK_SHORT_TRAVEL - 42
+    cases = [
+        # travel, noise, stored, margin, type, drives
+        (short, 2, None, None, JOYSTICK_TYPE_COMPACT, True),
+        (200, 0, None, None, JOYSTICK_TYPE_STANDARD, False),
+        (200, 0, JOYSTICK_TYPE_COMPACT, None, JOYSTICK_TYPE_STANDARD, False),
+        (short, 5, None, None, JOYSTICK_TYPE_STANDARD, False),
+        (short, 5, JOYSTICK_TYPE_COMPACT, None, JOYSTICK_TYPE_COMPACT, True),
+        (short, 9, JOYSTICK_TYPE_COMPACT, None, JOYSTICK_TYPE_STANDARD, False),
+        (200, 0, None, NEUTRAL_MARGIN_COMPACT, JOYSTICK_TYPE_STANDARD, True),
+    ]
+    for travel, noise, stored, margin, want, drives in cases:
+        found, drove = joystick_type(sim, travel, noise, stored, margin)
+        where = "travel %d, noise %d, stored %s, margin %s" % (travel, noise, stored, margin)
+        expect(found == want, "%s: type %d, expected %d", where, found, want)
+        expect(drove == drives, "%s: the push %s", where, "drove" if drove else "did not drive")
+
+
+###############################################################################
+# Power up
+###############################################################################
+
+# See BootSequence() in main.c.
+EEPROM_BOOT_TOLERANCE = EEPROM_JOYSTICK_TYPE + 2
+BOOT_MIN_SETTLE_MS = 250
+BOOT_MAX_SETTLE_MS = 1000
+BOOT_SLACK_MS = 100
+BOOT_PUSH = 120                         # Counts from neutral, drives with any neutral found.
+BOOT_PUSH_MS = 2000
+BOOT_END_MS = 2500
+
+
+@check("boot_settle")
+def check_boot_settle(sim):
+    """A quiet joystick is driving from BOOT_MIN_SETTLE_MS. One too noisy for
+    the steadiness test is driving from BOOT_MAX_SETTLE_MS instead of never,
+    with a neutral that leaves the DACs at neutral at rest and drives when
+    pushed. A saved boot_tolerance is used at power up."""
+    cases = [
+        # noise, tolerance, earliest, latest ms
+        (0, None, BOOT_MIN_SETTLE_MS, BOOT_MIN_SETTLE_MS + BOOT_SLACK_MS),
+        (32, None, BOOT_MAX_SETTLE_MS - 10, BOOT_MAX_SETTLE_MS + BOOT_SLACK_MS),
+        (32, 60, BOOT_MIN_SETTLE_MS, BOOT_MIN_SETTLE_MS + BOOT_SLACK_MS),
+    ]
+    for noise, tolerance, earliest, latest in cases:
+        lines = ["0 eeprom calibrated 200", "0 noise both %d" % noise]
+        if tolerance is not None:
+            lines.append("0 eeprom %d 0x%02x 0x00" % (EEPROM_BOOT_TOLERANCE, tolerance))
+        lines += ["%d speed %d" % (BOOT_PUSH_MS, host_trace.NEUTRAL + BOOT_PUSH),
+                  "%d end" % BOOT_END_MS]
+        run = sim("\n".join(lines))
+        where = "noise %d, tolerance %s" % (noise, tolerance)
+
+        driving = [t for t, name in run.states() if name == "DRIVING"]
+        expect(driving and earliest * 1000 <= driving[0] <= latest * 1000,
+               "%s: driving from %s, expected %d to %d ms", where,
+               "%.1f ms" % (driving[0] / 1000.0) if driving else "never", earliest, latest)
+        for channel in (0, 1):
+            at_rest = run.value_at(host_trace.OUT_DAC, channel, (BOOT_PUSH_MS - 10) * 1000)
+            expect(at_rest == TUNE_NEUTRAL, "%s: DAC %d at %s at rest", where, channel, at_rest)
+        pushed = run.value_at(host_trace.OUT_DAC, 0, (BOOT_END_MS - 10) * 1000)
+        expect(pushed != TUNE_NEUTRAL, "%s: the push did not drive", where)
+
+
+###############################################################################
+# Bootloader
+###############################################################################
+
+BOOT_WAIT_MS = 50                       # See bootloader.c.
+BOOT_RUN_END_MS = 30000                 # Unless the application is started first.
+BOOT_TIMEOUT_S = 0.5
+TOOLS_DIR = os.path.dirname(os.path.abspath(__file__))
+
+
+def flash_image(rng, rows, crc_error=0):
+    """64 KB of flash: a made up bootloader below APP_START, random bytes in
+    the given application rows, the rest blank, and the linker's CRC."""
+    image = bytearray(b"\xff" * uploader.FLASH_END)
+    image[:uploader.APP_START] = bytes(rng.randrange(256) for _ in range(uploader.APP_START))
+    for address in rows:
+        image[address:address + uploader.ROW_SIZE] = bytes(rng.randrange(256) for _ in range(uploader.ROW_SIZE))
+    crc = uploader.crc16(image[uploader.APP_START:uploader.APP_CRC_ADDRESS]) ^ crc_error
+    struct.pack_into("<H", image, uploader.APP_CRC_ADDRESS, crc)
+    return image
+
+
+def intel_hex(image):
+    """An image as Intel HEX, the blank lines left out."""
+    lines = []
+    for address in range(0, len(image), 16):
+        data = image[address:address + 16]
+        if data != b"\xff" * len(data):
+            record = bytes([len(data), address >> 8, address & 0xff, 0]) + data
+            lines.append(":%s%02X" % (record.hex().upper(), -sum(record) & 0xff))
+    return "\n".join(lines + [":00000001FF", ""])
+
+
+def boot_run(run, work_dir, name, flash, talk=None, end_ms=BOOT_RUN_END_MS):
+    """Runs the bootloader on pty_sim from the given flash, calls talk(pty
+    path) if given, and returns (Run, the flash at the end)."""
+    paths = [os.path.join(work_dir, "%s.%s" % (name, kind)) for kind in ("flash", "flash_out", "trace", "out")]
+    with open(paths[0], "wb") as f:
+        f.write(flash)
+    records = host_trace.parse_scenarios("%d end" % end_ms)[0][1]
+    host_trace.write_trace(paths[2], records)
+    process = subprocess.Popen([run.path, "--bootloader"] + paths, stdout=subprocess.PIPE,
+                               stderr=subprocess.STDOUT, text=True)
+    try:
+        words = process.stdout.readline().split()
+        expect(words[:1] == ["pty"], "pty_sim printed %s", " ".join(words))
+        if talk:
+            talk(words[1])
+        process.wait(timeout=RUN_TIMEOUT_S)
+    finally:
+        if process.poll() is None:
+            process.kill()
+            process.wait()
+    expect(process.returncode == 0, "pty_sim exit %d: %s", process.returncode, process.stdout.read().strip())
+    with open(paths[1], "rb") as f:
+        return Run(host_trace.read_trace(paths[3]), end_ms * 1000), f.read()
+
+
+@check("bootloader", program="pty_sim")
+def check_bootloader(run):
+    """The bootloader, run on the PC build against a RAM flash: uploader.py
+    loads a Released_Images style image, bootloader and all, into an empty
+    application area through ERASE, WRITE, VERIFY and RUN, leaving the boot
+    block as it was. After a reset with nothing on the UART the application
+    is started after BOOT_WAIT_MS. A damaged request is answered RESEND,
+    a write outside the application NAK, and an image whose CRC does not
+    match fails VERIFY and is not started."""
+    rng = random.Random(48)
+    rows = [0x0800, 0x0840, 0x1000, 0x4fc0, 0xffc0]
+    blank = flash_image(rng, [])
+    image = flash_image(rng, rows)      # Its bootloader differs from blank's.
+
+    with tempfile.TemporaryDirectory(prefix="bootloader_") as work_dir:
+        hex_path = os.path.join(work_dir, "image.hex")
+        with open(hex_path, "w") as f:
+            f.write(intel_hex(image))
+        result = []
+
+        def upload(path):
+            result.append(subprocess.run([sys.executable, os.path.join(TOOLS_DIR, "uploader.py"), path, hex_path,
+                                          "--wait", "5"], stdout=subprocess.PIPE, stderr=subprocess.STDOUT,
+                                         text=True))
+        loaded, flash = boot_run(run, work_dir, "upload", blank, upload)
+        expect(result[0].returncode == 0, "uploader.py: %s", result[0].stdout.strip())
+        expect(loaded.of(host_trace.OUT_JUMP) and loaded.of(host_trace.OUT_JUMP)[0][1] == uploader.APP_START,
+               "after the upload the bootloader jumped to %s", loaded.of(host_trace.OUT_JUMP))
+        expect(flash[:uploader.APP_START] == blank[:uploader.APP_START], "the boot block was written")
+        differ = [a for a in range(uploader.APP_START, uploader.FLASH_END, uploader.ROW_SIZE)
+                  if flash[a:a + uploader.ROW_SIZE] != image[a:a + uploader.ROW_SIZE]]
+        expect(not differ, "rows %s differ from the image", ["0x%04x" % a for a in differ])
+
+        started, _ = boot_run(run, work_dir, "reset", flash, end_ms=1000)
+        jumps = started.of(host_trace.OUT_JUMP)
+        expect(jumps and BOOT_WAIT_MS * 1000 <= jumps[0][0] <= 2 * BOOT_WAIT_MS * 1000,
+               "after a reset the application was started at %s", jumps)
+
+        # An old application without its first row, as an update cut short
+        # leaves it, and a new one with a bad CRC.
+        old = flash_image(rng, [0x0840, 0x2000, 0x8000])
+        old[uploader.APP_START:uploader.APP_START + uploader.ROW_SIZE] = b"\xff" * uploader.ROW_SIZE
+        bad = flash_image(rng, rows, crc_error=1)
+        answers = {}
+
+        def errors(path):
+            link = uploader.Bootloader(path, 230400)
+            try:
+                answers["sync"] = link.connect(5.0)
+                damaged = bytearray(uploader.request(uploader.CMD_WRITE, struct.pack("<H", 0x0840)
+                                                     + bytes(bad[0x0840:0x0880])))
+                damaged[10] ^= 0x01
+                os.write(link.fd, bytes(damaged))
+                answers["damaged"] = link.reply(BOOT_TIMEOUT_S)
+                for address in (0x0400, 0x0810):
+                    answers[address] = link.command(uploader.CMD_WRITE, struct.pack("<H", address) + bytes(64))
+                answers["erase"] = link.command(uploader.CMD_ERASE, timeout=10.0)
+                for address in rows[1:] + rows[:1]:
+                    answers[address] = link.command(uploader.CMD_WRITE, struct.pack("<H", address)
+                                                    + bytes(bad[address:address + uploader.ROW_SIZE]))
+                answers["verify"] = link.command(uploader.CMD_VERIFY, timeout=10.0)
+                answers["run"] = link.command(uploader.CMD_RUN)
+            finally:
+                link.close()
+        failed, flash = boot_run(run, work_dir, "errors", old, errors, end_ms=5000)
+
+    expect(answers["sync"] == uploader.ROW_SIZE, "SYNC answered row size %s", answers["sync"])
+    expect(answers["damaged"] and answers["damaged"][0] == uploader.RESEND,
+           "a damaged request was answered %s", answers["damaged"])
+    for address in (0x0400, 0x0810):
+        expect(answers[address][0] == uploader.NAK, "a write to 0x%04x was answered %s", address, answers[address])
+    expect(answers["erase"][0] == uploader.ACK, "ERASE answered %s", answers["erase"])
+    for address in rows:
+        expect(answers[address] == (uploader.ACK, address), "a write to 0x%04x was answered %s",
+               address, answers[address])
+    crc = uploader.crc16(bad[uploader.APP_START:uploader.APP_CRC_ADDRESS])
+    expect(answers["verify"] == (uploader.NAK, crc), "VERIFY of a bad image answered %s, its CRC is 0x%04x",
+           answers["verify"], crc)
+    expect(answers["run"][0] == uploader.NAK, "RUN after a failed VERIFY answered %s", answers["run"])
+    expect(not failed.of(host_trace.OUT_JUMP), "a bad image was started")
+    expect(flash[:uploader.APP_START] == old[:uploader.APP_START], "the boot block was written")
+    expect(flash[uploader.APP_START:uploader.APP_START + uploader.ROW_SIZE] == b"\xff" * uploader.ROW_SIZE,
+           "the first row of a bad image was left in place")
+    expect(flash[0x2000:0x2040] == b"\xff" * 64 and flash[0x8000:0x8040] == b"\xff" * 64,
+           "ERASE left rows of the old application")
+
+
+###############################################################################
+# Loop timing
+###############################################################################
+
+# Pass lengths loop_timing_sim is run with, us: from shorter than any real
+# pass to longer than the fast tick's wrap.
+LOOP_PASSES_US = (20, 100, 150, 400, 1000, 3000, 20000, 100000, 250000)
+LOOP_TIMING_PASSES = 20                 # Marks per pass length, see host_loop_timing.c.
+LOOP_TIMING_REPORT_PASSES = 250
+LOOP_FIXED_DELAY_US = 100               # US_DELAY_100_us at the end of every pass, main.c.
+LOOP_SATURATED = 0xffff
+
+
+def loop_timing(run, *passes_us):
+    """What loop_timing_sim printed, {name: [values]}."""
+    return {words[0]: [int(w) for w in words[1:]]
+            for words in (line.split() for line in run(*passes_us).splitlines()) if words}
+
+
+def loop_bin(ticks):
+    return min(ticks.bit_length(), 15)
+
+
+@check("loop_timing", program="loop_timing_sim")
+def check_loop_timing(run):
+    """LoopTimingMark() costs no more than its two timer register reads,
+    under 5% of the shortest pass the control loop can make, and
+    LoopTimingReport() one register write per page. A pass of known length
+    lands in its log2 bin, or the next one up when interrupts during the
+    pass lengthen it past a power of two, and its length is the worst case
+    of the state it was charged to; a pass longer than the fast tick can
+    time is recorded as saturated."""
+    result = loop_timing(run, *LOOP_PASSES_US)
+    tick_ns, wrap_ms = result["tick_ns"][0], result["wrap_ms"][0]
+    accesses, ns = result["mark"]
+    expect(accesses <= 2, "a mark takes %d register accesses", accesses)
+    expect(ns * 100 < 5 * LOOP_FIXED_DELAY_US * 1000, "a mark takes %d ns", ns)
+    expect(result["report"][0] <= 1, "%d register accesses in %d reports",
+           result["report"][0], LOOP_TIMING_REPORT_PASSES)
+
+    for state, pass_us in enumerate(LOOP_PASSES_US):
+        worst = result["max"][state]
+        if pass_us >= wrap_ms * 1000:
+            expect(worst == LOOP_SATURATED, "%d us passes: worst %d, not saturated", pass_us, worst)
+            continue
+        ticks = pass_us * 1000 // tick_ns
+        # Up to 2% for the tick interrupts, and a few ticks for the one that
+        # may land in the pass, the mark itself and the rounding.
+        expect(ticks <= worst <= ticks * 1.02 + 8, "%d us passes (%d ticks): worst %d ticks",
+               pass_us, ticks, worst)
+    expect(all(worst == 0 for worst in result["max"][len(LOOP_PASSES_US):]),
+           "worst cases in states never run: %s", result["max"][len(LOOP_PASSES_US):])
+
+    for pass_us in LOOP_PASSES_US:
+        single = loop_timing(run, pass_us)
+        ticks, worst = pass_us * 1000 // tick_ns, single["max"][0]
+        bins = set(range(loop_bin(ticks), loop_bin(worst) + 1))
+        histogram = single["histogram"]
+        expect(sum(histogram) == LOOP_TIMING_PASSES, "%d us passes: %d counted", pass_us, sum(histogram))
+        expect(all(count == 0 or index in bins for index, count in enumerate(histogram)),
+               "%d us passes (%d ticks) binned as %s", pass_us, ticks, histogram)
+
+
+# Drives, then goes to Bluetooth with the User Port button: the
+# announcement blocks in its entry handler for about 2 s.
+LOOP_STATES_SCENARIO = """
+0       eeprom calibrated 200
+3000    press user
+3300    release user
+8000    end
+"""
+LOOP_STATE_MAX_MS = 5                   # Longest pass that stays in one state.
+
+
+@check("loop_timing_states")
+def check_loop_timing_states(sim):
+    """A pass that changes state is charged to the transition slot, not to
+    the state it started or ended in: the announcement's block shows there,
+    saturated, and the longest driving and Bluetooth passes stay short."""
+    run = sim(LOOP_STATES_SCENARIO)
+    values = {}
+    for _, kind, _, payload in run.frames()[0]:
+        if kind == telemetry_decode.FRAME_TIMING:
+            start = payload[0] * telemetry_decode.TIMING_VALUES_PER_PAGE
+            for i, value in enumerate(struct.unpack_from("<%dH" % telemetry_decode.TIMING_VALUES_PER_PAGE,
+                                                         payload, 2)):
+                values[start + i] = value
+    maximum = [values.get(telemetry_decode.TIMING_BINS + state, 0)
+               for state in range(telemetry_decode.TIMING_STATES)]
+    expect(maximum[telemetry_decode.TIMING_TRANSITION] == LOOP_SATURATED,
+           "longest pass that changed state %d ticks, not saturated",
+           maximum[telemetry_decode.TIMING_TRANSITION])
+    for name in ("DRIVING", "BT"):
+        worst = maximum[host_trace.STATES.index(name)]
+        expect(0 < worst * telemetry_decode.FAST_TICK_US < LOOP_STATE_MAX_MS * 1000,
+               "longest %s pass %d ticks", name, worst)
+
+
+###############################################################################
+# Joystick thresholds
+###############################################################################
+
+THRESHOLDS_PASSES = 200000
+
+
+@check("thresholds", program="thresholds_sim")
+def check_thresholds(run):
+    """The control loop decides the same from the cached Joystick_Thresholds
+    as from thresholds recomputed on every pass, for every reading and a
+    set of calibrations, and a pass costs less with the cache. The times
+    are of the PC running the check, see host_thresholds.c."""
+    result = dict(line.split() for line in run(THRESHOLDS_PASSES).splitlines())
+    cached, uncached = int(result["cached"]), int(result["uncached"])
+    expect(cached < uncached, "%d ns per 1000 passes cached, %d recomputed", cached, uncached)
+
+
+###############################################################################
+
+def main():
+    parser = argparse.ArgumentParser(description="Check the firmware's behaviour on the host build.")
+    parser.add_argument("--check", action="append", help="check to run (default all)")
+    parser.add_argument("--jobs", type=int, default=os.cpu_count(), help="checks run at once (default %(default)s)")
+    parser.add_argument("--list", action="store_true", help="list the checks")
+    args = parser.parse_args()
+
+    if args.list:
+        for name in sorted(CHECKS):
+            print("%-24s %s" % (name, CHECKS[name][0].__doc__.split("\n")[0].strip()))
+        return 0
+    names = args.check or sorted(CHECKS)
+    unknown = [n for n in names if n not in CHECKS]
+    if unknown:
+        print("no check named %s" % ", ".join(unknown), file=sys.stderr)
+        return 1
+
+    confs = sorted(set(CHECKS[n][1] for n in names))
+    programs = tuple(sorted(set(CHECKS[n][2] for n in names)))
+    try:
+        built = host_build.build_all(confs, tree=host_build.FIRMWARE_DIR, out_root=BUILD_ROOT,
+                                     programs=programs, jobs=args.jobs)
+    except RuntimeError as error:
+        print(error, file=sys.stderr)
+        return 1
+
+    failed = 0
+    with concurrent.futures.ThreadPoolExecutor(max_workers=args.jobs) as pool:
+        futures = [pool.submit(run_check, n, os.path.join(built[CHECKS[n][1]], CHECKS[n][2])) for n in names]
+        for future in futures:
+            name, error = future.result()
+            if error:
+                failed += 1
+                print("%-24s FAIL\n    %s" % (name, error.replace("\n", "\n    ")))
+            else:
+                print("%-24s ok" % name)
+    print("%d of %d checks failed" % (failed, len(names)))
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,238 @@
+#!/usr/bin/env python3
+###############################################################################
+# File Name: host_trace.py
+# Project:  Prop ASL130 with Bluetooth Module
+#
+# Reads and writes the traces the host build of the firmware runs on (see
+# host/host_sim.h), and makes input traces from scenario text.
+#
+# A trace is a 16 byte header, then 8 byte records, all little endian:
+#
+#   header: uint32 magic "ALAS", uint16 version (1), uint16 record size (8),
+#           uint32 record count, uint32 reserved
+#   record: uint32 time in us from reset, uint8 type, uint8 channel,
+#           uint16 value
+#
+# Traces are read through mmap, so a long one costs nothing until used.
+#
+# A scenario is one command per line, "<time ms> <command> <arguments>",
+# '#' starts a comment:
+#
+#   0      eeprom calibrated [<scale>]   valid calibration, every scale <scale>
+#   0      eeprom erased                 (the default)
+#   0      eeprom <address> <byte> ...
+#   0      noise speed|direction|both <peak counts>
+#   100    stall speed|direction|both on|off   its conversions never finish
+#   100    speed <counts>|neutral        joystick input, ADC counts
+#   100    direction <counts>|neutral
+#   100    ramp speed|direction <from> <to> <over ms>
+#   100    square speed|direction <first> <second> <each ms> <over ms>
+#   2000   press cal|mode|user|sw21|sw22|click ...
+#   2500   release <button> ...|all
+#   3000   uart <hex byte> ...
+#   9000   end                            the run stops here
+#
+# A scenario file may hold several scenarios, each after a "[name]" line.
+#
+# Usage:
+#   host_trace.py compile <scenario file> <trace>   (a file of one scenario)
+#   host_trace.py dump <trace>
+###############################################################################
+
+import mmap
+import struct
+import sys
+
+MAGIC = 0x53414C41
+VERSION = 1
+HEADER = struct.Struct("<IHHII")
+RECORD = struct.Struct("<IBBH")
+
+IN_SPEED, IN_DIRECTION, IN_BUTTONS, IN_UART_RX, IN_NOISE, IN_EEPROM, IN_END, IN_ADC_STALL = range(1, 9)
+OUT_DAC, OUT_BLUETOOTH, OUT_BEEPER, OUT_RESET, OUT_UART_TX, OUT_STATE, OUT_EEPROM, OUT_FAIL, OUT_JUMP, \
+    OUT_FAILSAFE = range(0x81, 0x8b)
+
+NAMES = {
+    IN_SPEED: "speed", IN_DIRECTION: "direction", IN_BUTTONS: "buttons", IN_UART_RX: "uart_rx",
+    IN_NOISE: "noise", IN_EEPROM: "eeprom", IN_END: "end", IN_ADC_STALL: "stall",
+    OUT_DAC: "dac", OUT_BLUETOOTH: "bluetooth", OUT_BEEPER: "beeper", OUT_RESET: "reset",
+    OUT_UART_TX: "uart_tx", OUT_STATE: "state", OUT_EEPROM: "eeprom_write", OUT_FAIL: "fail",
+    OUT_JUMP: "jump", OUT_FAILSAFE: "failsafe",
+}
+
+STATES = ["NO_STATE", "POWERUP", "ANNOUNCE_ENTER_DRIVING", "ENTER_DRIVING", "DRIVING",
+          "ANNOUNCE_ENTER_BT", "ENTER_BT", "BT", "EXIT_BT", "ENTER_MODE_CHANGE", "MODE_CHANGE",
+          "EXIT_MODE_CHANGE", "ENTER_CALIBRATION", "DO_JOYSTICK_CALIBRATION",
+          "EXIT_JOYSTICK_CALIBRATION", "FAULT"]
+
+BUTTONS = {"mode": 0x01, "sw21": 0x02, "cal": 0x04, "sw22": 0x20, "click": 0x40, "user": 0x80}
+
+NEUTRAL = 0x202
+RAMP_STEP_MS = 5
+
+# The calibration block at the start of the EEPROM, see main.c.
+EEPROM_SCALES = 0
+EEPROM_VALID_DATA1 = 0xDEAD
+EEPROM_VALID_DATA2 = 0xAA55
+
+
+class ScenarioError(Exception):
+    pass
+
+
+def parse_scenarios(text, source="<scenario>"):
+    """Returns [(name, [records])] from scenario text. A text with no
+    "[name]" line is one scenario named after the source."""
+    scenarios, name, lines = [], None, []
+    for number, line in enumerate(text.splitlines(), 1):
+        stripped = line.split("#", 1)[0].strip()
+        if stripped.startswith("[") and stripped.endswith("]"):
+            if name is not None or lines:
+                scenarios.append((name or source, compile_lines(lines, source)))
+            name, lines = stripped[1:-1].strip(), []
+        elif stripped:
+            lines.append((number, stripped))
+    if name is not None or lines:
+        scenarios.append((name or source, compile_lines(lines, source)))
+    return scenarios
+
+
+def compile_lines(lines, source):
+    records, buttons, ended = [], 0, False
+    for number, line in lines:
+        where = "%s:%d" % (source, number)
+        words = line.split()
+        try:
+            time_us = int(round(float(words[0]) * 1000))
+        except (ValueError, IndexError):
+            raise ScenarioError("%s: expected a time in ms" % where)
+        if len(words) < 2:
+            raise ScenarioError("%s: expected a command" % where)
+        command, args = words[1], words[2:]
+        try:
+            if command in ("speed", "direction"):
+                value = NEUTRAL if args[0] == "neutral" else int(args[0], 0)
+                records.append((time_us, IN_SPEED if command == "speed" else IN_DIRECTION, 0, value))
+            elif command == "ramp":
+                kind = {"speed": IN_SPEED, "direction": IN_DIRECTION}[args[0]]
+                start, stop, over = int(args[1], 0), int(args[2], 0), float(args[3])
+                steps = max(1, int(over / RAMP_STEP_MS))
+                for step in range(steps + 1):
+                    value = start + (stop - start) * step // steps
+                    records.append((time_us + int(step * over * 1000 / steps), kind, 0, value))
+            elif command == "square":
+                kind = {"speed": IN_SPEED, "direction": IN_DIRECTION}[args[0]]
+                levels, each, over = (int(args[1], 0), int(args[2], 0)), float(args[3]), float(args[4])
+                for step in range(int(over / each)):
+                    records.append((time_us + int(step * each * 1000), kind, 0, levels[step % 2]))
+            elif command == "noise":
+                channels = {"speed": [0], "direction": [1], "both": [0, 1]}[args[0]]
+                for channel in channels:
+                    records.append((time_us, IN_NOISE, channel, int(args[1], 0)))
+            elif command == "stall":
+                channels = {"speed": [0], "direction": [1], "both": [0, 1]}[args[0]]
+                for channel in channels:
+                    records.append((time_us, IN_ADC_STALL, channel, {"off": 0, "on": 1}[args[1]]))
+            elif command in ("press", "release"):
+                for button in args:
+                    if command == "release" and button == "all":
+                        buttons = 0
+                    elif command == "press":
+                        buttons |= BUTTONS[button]
+                    else:
+                        buttons &= ~BUTTONS[button]
+                records.append((time_us, IN_BUTTONS, 0, buttons))
+            elif command == "uart":
+                for byte in args:
+                    records.append((time_us, IN_UART_RX, 0, int(byte, 16)))
+            elif command == "eeprom":
+                records += eeprom_records(args)
+            elif command == "end":
+                records.append((time_us, IN_END, 0, 0))
+                ended = True
+            else:
+                raise ScenarioError("%s: unknown command %s" % (where, command))
+        except (IndexError, KeyError, ValueError):
+            raise ScenarioError("%s: bad arguments for %s" % (where, command))
+    if not ended:
+        raise ScenarioError("%s: no end" % source)
+    # Stable, so records at the same time keep the order they were given in.
+    return sorted(records, key=lambda r: r[0])
+
+
+def eeprom_records(args):
+    if args[0] == "erased":
+        return []
+    if args[0] == "calibrated":
+        scale = int(args[1], 0) if len(args) > 1 else 200
+        words = [scale] * 4 + [EEPROM_VALID_DATA1, EEPROM_VALID_DATA2]
+        data = b"".join(struct.pack("<H", w) for w in words)
+        address = EEPROM_SCALES
+    else:
+        address = int(args[0], 0)
+        data = bytes(int(b, 0) for b in args[1:])
+    return [(0, IN_EEPROM, (address + i) & 0xFF, ((address + i) & 0x300) | b) for i, b in enumerate(data)]
+
+
+def pack(records):
+    out = bytearray(HEADER.pack(MAGIC, VERSION, RECORD.size, len(records), 0))
+    for record in records:
+        out += RECORD.pack(*record)
+    return bytes(out)
+
+
+def write_trace(path, records):
+    with open(path, "wb") as f:
+        f.write(pack(records))
+
+
+def read_trace(path):
+    """Returns the records of a trace as (time us, type, channel, value)."""
+    with open(path, "rb") as f:
+        with mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ) as data:
+            magic, version, size, count, _ = HEADER.unpack_from(data, 0)
+            if magic != MAGIC or version != VERSION or size != RECORD.size:
+                raise ValueError("%s is not a version %d trace" % (path, VERSION))
+            end = HEADER.size + count * RECORD.size
+            if end > len(data):
+                raise ValueError("%s is cut short" % path)
+            return list(RECORD.iter_unpack(data[HEADER.size:end]))
+
+
+def describe(record):
+    time_us, kind, channel, value = record
+    text = "%10.3f ms  %-12s" % (time_us / 1000.0, NAMES.get(kind, "0x%02x" % kind))
+    if kind == OUT_STATE:
+        return text + " " + (STATES[value] if value < len(STATES) else str(value))
+    if kind in (OUT_DAC, IN_NOISE):
+        return text + " %d: %d" % (channel, value)
+    if kind in (IN_EEPROM, OUT_EEPROM):
+        return text + " 0x%03x: 0x%02x" % (channel | (value & 0x300), value & 0xFF)
+    if kind in (OUT_BLUETOOTH, IN_BUTTONS, IN_UART_RX, OUT_UART_TX):
+        return text + " 0x%02x" % value
+    return text + " %d" % value
+
+
+def main():
+    if len(sys.argv) == 4 and sys.argv[1] == "compile":
+        with open(sys.argv[2]) as f:
+            scenarios = parse_scenarios(f.read(), sys.argv[2])
+        if len(scenarios) != 1:
+            print("%s holds %d scenarios, expected one" % (sys.argv[2], len(scenarios)), file=sys.stderr)
+            return 1
+        write_trace(sys.argv[3], scenarios[0][1])
+        return 0
+    if len(sys.argv) == 3 and sys.argv[1] == "dump":
+        for record in read_trace(sys.argv[2]):
+            print(describe(record))
+        return 0
+    print(__doc__ if __doc__ else "usage: host_trace.py compile <scenario> <trace> | dump <trace>", file=sys.stderr)
+    return 1
+
+
+if __name__ == "__main__":
+    try:
+        sys.exit(main())
+    except ScenarioError as error:
+        print(error, file=sys.stderr)
+        sys.exit(1)
@@ -0,0 +1,255 @@
+#!/usr/bin/env python3
+###############################################################################
+# File Name: livetune.py
+# Project:  Prop ASL130 with Bluetooth Module
+#
+# Reads and changes the live tuning values (see SourceFiles/app/LiveTune.c
+# and g_TuneParams in main.c) over the UART while the firmware runs.
+#
+# The device is any tty: a USB serial adapter on the UART pins, or a
+# pseudo-terminal with something else on the other end. Telemetry frames
+# arriving in between the responses are skipped.
+#
+# Values set are used from the next pass of the control loop, except the
+# neutral demand, the DAC swing and the neutral margin, which are held while
+# the chair is in the driving state and used once it has left it. They are
+# lost at power off unless "save" is sent afterwards.
+#
+# Setting save_diagnostics to 1 copies the loop timing and the black box to
+# the EEPROM, once the chair is out of the driving and Bluetooth states.
+#
+# Usage:
+#   livetune.py <device> list
+#   livetune.py <device> get <name>
+#   livetune.py <device> set <name> <value> [<name> <value> ...]
+#   livetune.py <device> save
+###############################################################################
+
+import argparse
+import os
+import select
+import struct
+import sys
+import termios
+import time
+
+SYNC = b"\xa5\x5a"
+PAYLOAD_SIZE = 16
+FRAME_SIZE = PAYLOAD_SIZE + 6
+FRAME_TUNE = 0x03
+
+# Must match LiveTune.h.
+CMD_GET = 0x01
+CMD_SET = 0x02
+CMD_SAVE = 0x03
+
+STATUS_NAMES = {
+    0x00: "ok",
+    0x01: "unknown command",
+    0x02: "no such parameter",
+    0x03: "out of range",
+}
+STATUS_HELD = 0x04              # Taken, used once out of the driving state.
+
+TYPE_NAMES = {0x01: "uint8", 0x02: "uint16"}
+
+# Must match the order of g_TuneParams in main.c.
+PARAM_NAMES = [
+    "neutral_demand",
+    "dac_swing",
+    "neutral_margin",
+    "adc_mode",
+    "response_curve",
+    "telemetry_decimation",
+    "boot_tolerance",
+    "save_diagnostics",
+]
+
+BAUD_RATE = termios.B115200     # UART_BAUD_RATE in uart_bsp.h.
+
+
+def crc16(data):
+    """CRC-16/CCITT-FALSE, as Crc16() in Crc16.c."""
+    crc = 0xffff
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if (crc & 0x8000) else (crc << 1)
+            crc &= 0xffff
+    return crc
+
+
+def request(command, sequence, param=0, value=0):
+    body = struct.pack("<BBBH", command, sequence, param, value)
+    return SYNC + body + struct.pack("<H", crc16(body))
+
+
+class Link:
+    """A tty in raw mode with the frames received from it."""
+
+    def __init__(self, path):
+        self.fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+        attrs = termios.tcgetattr(self.fd)
+        attrs[0] = 0                                    # iflag
+        attrs[1] = 0                                    # oflag
+        attrs[2] = termios.CS8 | termios.CREAD | termios.CLOCAL
+        attrs[3] = 0                                    # lflag
+        attrs[4] = attrs[5] = BAUD_RATE
+        attrs[6][termios.VMIN] = 0
+        attrs[6][termios.VTIME] = 0
+        termios.tcsetattr(self.fd, termios.TCSANOW, attrs)
+        termios.tcflush(self.fd, termios.TCIFLUSH)
+        self.buffer = b""
+        self.sequence = int(time.time()) & 0xff
+
+    def close(self):
+        os.close(self.fd)
+
+    def next_sequence(self):
+        self.sequence = (self.sequence + 1) & 0xff
+        return self.sequence
+
+    def send(self, data):
+        os.write(self.fd, data)
+
+    def tune_frames(self, timeout):
+        """Yields the payload of each good tune frame until the timeout."""
+        end = time.monotonic() + timeout
+        while True:
+            while True:
+                index = self.buffer.find(SYNC)
+                if index < 0:
+                    self.buffer = self.buffer[-1:]
+                    break
+                if index + FRAME_SIZE > len(self.buffer):
+                    self.buffer = self.buffer[index:]
+                    break
+                frame = self.buffer[index:index + FRAME_SIZE]
+                (crc,) = struct.unpack_from("<H", frame, FRAME_SIZE - 2)
+                if crc16(frame[2:FRAME_SIZE - 2]) != crc:
+                    self.buffer = self.buffer[index + 1:]   # Resync.
+                    continue
+                self.buffer = self.buffer[index + FRAME_SIZE:]
+                if frame[2] == FRAME_TUNE:
+                    yield frame[4:4 + PAYLOAD_SIZE]
+
+            left = end - time.monotonic()
+            if left <= 0:
+                return
+            ready, _, _ = select.select([self.fd], [], [], left)
+            if ready:
+                self.buffer += os.read(self.fd, 256)
+
+    def transact(self, requests, timeout, retries):
+        """Sends the (command, param, value) requests together and returns
+        their responses in the same order. Requests not answered are sent
+        again."""
+        pending = {}
+        for command, param, value in requests:
+            pending[self.next_sequence()] = (command, param, value)
+        order = list(pending)
+        responses = {}
+
+        for _ in range(retries + 1):
+            self.send(b"".join(request(c, s, p, v) for s, (c, p, v) in pending.items()))
+            for payload in self.tune_frames(timeout):
+                sequence = payload[1]
+                if sequence in pending and payload[0] == pending[sequence][0]:
+                    responses[sequence] = decode(payload)
+                    del pending[sequence]
+                    if not pending:
+                        return [responses[s] for s in order]
+        raise TimeoutError("no response to %d request(s)" % len(pending))
+
+
+def decode(payload):
+    (command, sequence, status, param, value, kind, count,
+     minimum, maximum, saved) = struct.unpack_from("<BBBBHBBHHB", payload)
+    return {
+        "command": command, "status": status, "param": param,
+        "value": value, "type": kind, "count": count,
+        "minimum": minimum, "maximum": maximum, "saved": bool(saved),
+    }
+
+
+def param_number(name):
+    if name in PARAM_NAMES:
+        return PARAM_NAMES.index(name)
+    try:
+        return int(name, 0)
+    except ValueError:
+        raise SystemExit("unknown parameter %s, one of: %s" % (name, ", ".join(PARAM_NAMES)))
+
+
+def param_name(number):
+    return PARAM_NAMES[number] if number < len(PARAM_NAMES) else "param%d" % number
+
+
+def show(response):
+    print("%-22s %5d  (%s %d..%d%s)%s" % (
+        param_name(response["param"]), response["value"],
+        TYPE_NAMES.get(response["type"], "?"), response["minimum"], response["maximum"],
+        ", saved" if response["saved"] else "",
+        ", held until out of driving" if response["status"] == STATUS_HELD else ""))
+
+
+def check(response):
+    if response["status"] not in (0, STATUS_HELD):
+        raise SystemExit("%s: %s" % (param_name(response["param"]),
+                                     STATUS_NAMES.get(response["status"], "status %d" % response["status"])))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Read and change the live tuning values.")
+    parser.add_argument("device", help="serial device or pseudo-terminal")
+    parser.add_argument("command", choices=["list", "get", "set", "save"])
+    parser.add_argument("args", nargs="*", help="parameter names, and values for set")
+    parser.add_argument("--timeout", type=float, default=0.5, help="seconds to wait for a response (default %(default)s)")
+    parser.add_argument("--retries", type=int, default=3, help="times to send a request again (default %(default)s)")
+    args = parser.parse_args()
+
+    link = Link(args.device)
+    try:
+        if args.command == "list":
+            (first,) = link.transact([(CMD_GET, 0, 0)], args.timeout, args.retries)
+            check(first)
+            show(first)
+            rest = [(CMD_GET, i, 0) for i in range(1, first["count"])]
+            for response in link.transact(rest, args.timeout, args.retries) if rest else []:
+                check(response)
+                show(response)
+
+        elif args.command == "get":
+            if not args.args:
+                parser.error("get needs a parameter name")
+            requests = [(CMD_GET, param_number(name), 0) for name in args.args]
+            for response in link.transact(requests, args.timeout, args.retries):
+                check(response)
+                show(response)
+
+        elif args.command == "set":
+            if not args.args or len(args.args) % 2:
+                parser.error("set needs <name> <value> pairs")
+            # Sent in one go so they are normally used from the same pass.
+            requests = [(CMD_SET, param_number(name), int(value, 0))
+                        for name, value in zip(args.args[0::2], args.args[1::2])]
+            for response in link.transact(requests, args.timeout, args.retries):
+                check(response)
+                show(response)
+
+        else:
+            # The EEPROM is written a byte per loop pass, allow for it.
+            (response,) = link.transact([(CMD_SAVE, 0, 0)], max(args.timeout, 2.0), args.retries)
+            check(response)
+            print("saved")
+    except TimeoutError as error:
+        print("%s: %s" % (args.device, error), file=sys.stderr)
+        return 1
+    finally:
+        link.close()
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
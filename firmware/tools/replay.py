@@ -0,0 +1,310 @@
+#!/usr/bin/env python3
+###############################################################################
+# File Name: replay.py
+# Project:  Prop ASL130 with Bluetooth Module
+#
+# Replays the scenarios in host/scenarios/ on the host build of every MPLAB
+# configuration and checks the outputs against host/golden/<conf>.txt.
+#
+# The configurations are built (tools/host_build.py), then every
+# configuration and scenario pair is run as its own firmware_sim process,
+# as many at once as there are cores.
+#
+# A golden file holds, for each scenario, the state, both DAC outputs, the
+# Bluetooth outputs and the beeper sampled every SAMPLE_MS (a row only where
+# one of them changed), and a hash of the complete output trace, telemetry
+# and EEPROM writes included. A sampled row that differs fails the replay;
+# a hash that differs with the same rows is only reported (the outputs moved
+# by less than a sample), unless --strict is given.
+#
+# --update rewrites the golden files from this run, after a change that is
+# meant to change the outputs. Review the diff before committing it.
+#
+# --against compares with the same runs on another tree instead of the
+# golden files. --tree and --against each take a firmware directory or a
+# git revision of this one, which is exported under build/host/against/.
+# Only the configurations both trees have are run; one that does not build
+# in either tree is reported and left out. This checks a rework that is
+# meant to change nothing, e.g. the state table against the switch before
+# it (make host-state-table, which takes the two revisions from
+# STATE_TABLE_TREE and STATE_TABLE_BASE):
+#   replay.py --tree a1a1823 --against fbbe6ef --slack 50 --no-noise
+#
+# --slack lets a row be up to that many ms early or late, for a change that
+# moves outputs by less than a loop pass or two (the state table runs a
+# chain of states in one pass) but across a sample time.
+#
+# --no-noise leaves out the scenarios' input noise. The model draws one
+# noise value per ADC conversion, so a tree that reads the inputs a
+# different number of times sees different noise from the same scenario.
+#
+# Usage:
+#   replay.py [--conf <name> ...] [--scenario <name> ...] [--jobs <n>]
+#             [--update] [--strict] [--tree <firmware dir>|<git revision>]
+#             [--against <firmware dir>|<git revision>] [--slack <ms>]
+#             [--no-noise]
+###############################################################################
+
+import argparse
+import concurrent.futures
+import hashlib
+import io
+import os
+import shutil
+import subprocess
+import sys
+import tarfile
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import host_build                                   # noqa: E402
+import host_trace                                   # noqa: E402
+
+SCENARIO_DIR = os.path.join(host_build.HOST_DIR, "scenarios")
+GOLDEN_DIR = os.path.join(host_build.HOST_DIR, "golden")
+BUILD_ROOT = os.path.join(host_build.FIRMWARE_DIR, "build", "host")
+SAMPLE_MS = 50
+RUN_TIMEOUT_S = 120
+
+
+def load_scenarios(names=None):
+    """Returns {name: records} for the scenario files, or just those named."""
+    scenarios = {}
+    for file_name in sorted(os.listdir(SCENARIO_DIR)):
+        if not file_name.endswith(".txt"):
+            continue
+        path = os.path.join(SCENARIO_DIR, file_name)
+        with open(path) as f:
+            for name, records in host_trace.parse_scenarios(f.read(), file_name[:-4]):
+                scenarios[name] = records
+    if names:
+        missing = [n for n in names if n not in scenarios]
+        if missing:
+            raise host_trace.ScenarioError("no scenario named %s" % ", ".join(missing))
+        scenarios = {n: scenarios[n] for n in names}
+    return scenarios
+
+
+def summarise(records, end_us):
+    """The sampled rows, as text, and the hash of the whole trace."""
+    rows, last = [], None
+    state, dac, bluetooth, beeper, fail = 0, [0, 0], 0, 0, None
+    index = 0
+    for t_ms in range(0, end_us // 1000 + 1, SAMPLE_MS):
+        while index < len(records) and records[index][0] <= t_ms * 1000:
+            _, kind, channel, value = records[index]
+            if kind == host_trace.OUT_STATE:
+                state = value
+            elif kind == host_trace.OUT_DAC:
+                dac[channel & 1] = value
+            elif kind == host_trace.OUT_BLUETOOTH:
+                bluetooth = value
+            elif kind == host_trace.OUT_BEEPER:
+                beeper = value
+            elif kind == host_trace.OUT_FAIL:
+                fail = value
+            index += 1
+        sample = (host_trace.STATES[state] if state < len(host_trace.STATES) else str(state),
+                  dac[0], dac[1], bluetooth, beeper)
+        if sample != last:
+            rows.append("%d %s %d %d 0x%02x %d" % ((t_ms,) + sample))
+            last = sample
+    if fail is not None:
+        rows.append("FAIL %d" % fail)
+
+    digest = hashlib.sha1()
+    for record in records:
+        digest.update(host_trace.RECORD.pack(*record))
+    return rows, "records=%d hash=%s" % (len(records), digest.hexdigest()[:16])
+
+
+def run_one(program, trace, output):
+    """Runs one scenario and returns its output records."""
+    process = subprocess.run([program, trace, output], stdout=subprocess.PIPE,
+                             stderr=subprocess.STDOUT, text=True, timeout=RUN_TIMEOUT_S)
+    if process.returncode not in (0, 2):
+        raise RuntimeError("%s %s: exit %d\n%s" % (program, trace, process.returncode, process.stdout))
+    return host_trace.read_trace(output)
+
+
+def run_all(confs, scenarios, tree=host_build.FIRMWARE_DIR, out_root=BUILD_ROOT, jobs=None, defines=(),
+            failed=None):
+    """Builds the configurations and runs every scenario on each. Returns
+    {conf: {scenario: (rows, hash line)}}. Given a list as failed, a
+    configuration that does not build is added to it and left out."""
+    built = host_build.build_all(confs, defines, tree, out_root, ("firmware_sim",), jobs, failed)
+    confs = [conf for conf in confs if conf in built]
+
+    trace_dir = os.path.join(out_root, "traces")
+    os.makedirs(trace_dir, exist_ok=True)
+    traces, ends = {}, {}
+    for name, records in scenarios.items():
+        traces[name] = os.path.join(trace_dir, name + ".trace")
+        ends[name] = max(r[0] for r in records if r[1] == host_trace.IN_END)
+        host_trace.write_trace(traces[name], records)
+
+    results = {conf: {} for conf in confs}
+    with concurrent.futures.ThreadPoolExecutor(max_workers=jobs or os.cpu_count()) as pool:
+        futures = {}
+        for conf in confs:
+            program = os.path.join(built[conf], "firmware_sim")
+            for name in scenarios:
+                output = os.path.join(built[conf], name + ".out")
+                futures[pool.submit(run_one, program, traces[name], output)] = (conf, name)
+        for future in concurrent.futures.as_completed(futures):
+            conf, name = futures[future]
+            results[conf][name] = summarise(future.result(), ends[name])
+    return results
+
+
+def export_revision(revision):
+    """Exports the firmware directory at a git revision and returns where
+    it went."""
+    top, prefix = subprocess.run(["git", "rev-parse", "--show-toplevel", "--show-prefix"],
+                                 cwd=host_build.FIRMWARE_DIR, stdout=subprocess.PIPE, text=True,
+                                 check=True).stdout.split("\n")[:2]
+    archive = subprocess.run(["git", "archive", "%s:%s" % (revision, prefix)], cwd=top,
+                             stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+    if archive.returncode != 0:
+        raise RuntimeError("git archive %s: %s" % (revision, archive.stderr.decode().strip()))
+    tree = os.path.join(BUILD_ROOT, "against", revision.replace("/", "_"))
+    shutil.rmtree(tree, ignore_errors=True)
+    with tarfile.open(fileobj=io.BytesIO(archive.stdout)) as tar:
+        tar.extractall(tree)
+    return tree
+
+
+def golden_path(conf):
+    return os.path.join(GOLDEN_DIR, conf + ".txt")
+
+
+def write_golden(conf, summaries):
+    lines = ["# Outputs of the host build of %s, made by tools/replay.py --update." % conf,
+             "# time ms, state, DAC forward/back, DAC left/right, Bluetooth, beeper;",
+             "# sampled every %d ms, a row only where one of them changed." % SAMPLE_MS]
+    for name in sorted(summaries):
+        rows, digest = summaries[name]
+        lines += ["", "[%s] %s" % (name, digest)] + rows
+    os.makedirs(GOLDEN_DIR, exist_ok=True)
+    with open(golden_path(conf), "w") as f:
+        f.write("\n".join(lines) + "\n")
+
+
+def read_golden(conf):
+    """Returns {scenario: (rows, hash line)} from a golden file."""
+    golden, name = {}, None
+    if not os.path.exists(golden_path(conf)):
+        return golden
+    with open(golden_path(conf)) as f:
+        for line in f.read().splitlines():
+            if not line or line.startswith("#"):
+                continue
+            if line.startswith("["):
+                name, _, digest = line[1:].partition("] ")
+                golden[name] = ([], digest)
+            elif name is not None:
+                golden[name][0].append(line)
+    return golden
+
+
+def same_row(want, got, slack_ms):
+    if want == got:
+        return True
+    want_time, _, want_values = want.partition(" ")
+    got_time, _, got_values = got.partition(" ")
+    return (want_values == got_values and want_time.isdigit() and got_time.isdigit()
+            and abs(int(want_time) - int(got_time)) <= slack_ms)
+
+
+def compare(expected, actual, slack_ms=0):
+    """Returns the first few differing rows as text, empty if they match.
+    Rows with the same values slack_ms or less apart match."""
+    if expected == actual:
+        return ""
+    lines = []
+    for i in range(max(len(expected), len(actual))):
+        want = expected[i] if i < len(expected) else "(none)"
+        got = actual[i] if i < len(actual) else "(none)"
+        if not same_row(want, got, slack_ms):
+            lines.append("      expected %-36s got %s" % (want, got))
+            if len(lines) == 5:
+                break
+    return "\n".join(lines)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Replay the scenarios on every build variant.")
+    parser.add_argument("--conf", action="append", help="configuration (default all)")
+    parser.add_argument("--scenario", action="append", help="scenario (default all)")
+    parser.add_argument("--jobs", type=int, default=os.cpu_count(), help="runs at once (default %(default)s)")
+    parser.add_argument("--update", action="store_true", help="rewrite the golden files")
+    parser.add_argument("--strict", action="store_true", help="a hash difference fails too")
+    parser.add_argument("--tree", default=host_build.FIRMWARE_DIR, help="firmware sources (default this one)")
+    parser.add_argument("--against", help="compare with another firmware directory or git revision")
+    parser.add_argument("--slack", type=int, default=0, help="ms a row may move (default 0)")
+    parser.add_argument("--no-noise", dest="noise", action="store_false", help="leave out the input noise")
+    args = parser.parse_args()
+    if args.update and args.against:
+        parser.error("--update and --against can not be used together")
+
+    try:
+        tree = os.path.abspath(args.tree if os.path.isdir(args.tree) else export_revision(args.tree))
+        other, unbuilt = None, None
+        if args.against:
+            other = os.path.abspath(args.against if os.path.isdir(args.against) else export_revision(args.against))
+            unbuilt = []
+        confs = args.conf or list(host_build.read_configurations(tree))
+        if other:
+            confs = [c for c in confs if c in host_build.read_configurations(other)]
+        scenarios = load_scenarios(args.scenario)
+        if not args.noise:
+            scenarios = {name: [r for r in records if r[1] != host_trace.IN_NOISE]
+                         for name, records in scenarios.items()}
+        out_root = os.path.join(BUILD_ROOT, "against", "tree") if other else BUILD_ROOT
+        results = run_all(confs, scenarios, tree, out_root, args.jobs, failed=unbuilt)
+        if other:
+            against = run_all(confs, scenarios, other, os.path.join(BUILD_ROOT, "against", "out"), args.jobs,
+                              failed=unbuilt)
+            for conf, error in unbuilt:
+                lines = error.splitlines()
+                print("%-28s does not build, left out: %s"
+                      % (conf, next((l for l in lines if "error:" in l), lines[0]).strip()))
+            confs = [c for c in confs if c in results and c in against]
+    except (RuntimeError, host_trace.ScenarioError, subprocess.TimeoutExpired,
+            subprocess.CalledProcessError) as error:
+        print(error, file=sys.stderr)
+        return 1
+
+    failed = 0
+    for conf in confs:
+        if args.update:
+            golden = read_golden(conf)
+            golden.update(results[conf])
+            write_golden(conf, golden)
+            print("%-28s %d scenarios written" % (conf, len(results[conf])))
+            continue
+
+        golden = against[conf] if other else read_golden(conf)
+        for name in sorted(results[conf]):
+            rows, digest = results[conf][name]
+            if name not in golden:
+                print("%-28s %-16s NO GOLDEN (run with --update)" % (conf, name))
+                failed += 1
+                continue
+            diff = compare(golden[name][0], rows, args.slack)
+            if diff:
+                print("%-28s %-16s FAIL\n%s" % (conf, name, diff))
+                failed += 1
+            elif digest != golden[name][1]:
+                print("%-28s %-16s %s (timing changed: %s, was %s)"
+                      % (conf, name, "FAIL" if args.strict else "ok", digest, golden[name][1]))
+                failed += 1 if args.strict else 0
+            else:
+                print("%-28s %-16s ok" % (conf, name))
+
+    if not args.update:
+        print("%d of %d runs failed" % (failed, len(confs) * len(scenarios)))
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
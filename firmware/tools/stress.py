@@ -0,0 +1,229 @@
+#!/usr/bin/env python3
+###############################################################################
+# File Name: stress.py
+# Project:  Prop ASL130 with Bluetooth Module
+#
+# Runs random scenarios on the host build's stress_sim (host/host_stress.c),
+# which checks the safety invariants as the firmware runs:
+#
+#   dac_range                both DACs within the min and max output
+#   neutral_outside_driving  both DACs neutral in every state but DRIVING
+#   drive_with_button        both DACs neutral with Calibration or User held
+#   stuck_state              at rest in a state that waits on the user once
+#                            the buttons are released and the joystick rests
+#   demand_guard             SetTPI_Demands() never forces a demand itself
+#
+# Each scenario starts from a random EEPROM (erased or calibrated, with
+# random scales, gestures and Bluetooth mode) and input noise, then makes
+# random joystick moves, ramps and button presses and releases. It ends with
+# every button released and the joystick at neutral for REST_MS.
+#
+# The scenarios run side by side, as many at once as there are cores. A
+# failing one is cut down, by delta debugging over its moves and presses,
+# to a smallest scenario that still breaks the same invariant, which is
+# written to build/host/stress/ where host_trace.py and firmware_sim can
+# run it again. Scenarios are numbered from --seed, so a run is repeated by
+# giving the same seed and count.
+#
+# Usage:
+#   stress.py [--count <n>] [--seed <n>] [--conf <name> ...] [--jobs <n>]
+#             [--no-minimise]
+###############################################################################
+
+import argparse
+import concurrent.futures
+import os
+import random
+import subprocess
+import sys
+import tempfile
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import host_build                                   # noqa: E402
+import host_trace                                   # noqa: E402
+
+BUILD_ROOT = os.path.join(host_build.FIRMWARE_DIR, "build", "host")
+OUT_DIR = os.path.join(BUILD_ROOT, "stress")
+DEFAULT_CONF = "Release_RNet"
+RUN_TIMEOUT_S = 120
+
+# The quiet tail every scenario ends with: long enough for any timed state
+# (a mode change, an announcement, the Bluetooth entry) to have moved on.
+REST_MS = 8000
+EVENTS = (4, 40)                # Moves and presses per scenario.
+GAP_MS = (10, 1500)             # Between them.
+
+# EEPROM addresses, see main.c.
+EEPROM_BT_MODE = 12
+EEPROM_GESTURES = 34
+
+# Peak ADC noise. The boot takes the joystick's neutral from readings that
+# change by no more than BOOT_STABLE_TOLERANCE (8) from one to the next, or
+# waits until BOOT_MAX_SETTLE_MS for them: more noise only slows the boot.
+NOISE_MAX = 2
+
+BUTTONS = ["mode", "sw21", "cal", "user", "sw22", "click"]
+
+
+def random_scenario(rng):
+    """Returns scenario text as (header lines, event lines, tail lines)."""
+    header = []
+    if rng.random() < 0.8:
+        header.append("0 eeprom calibrated %d" % rng.randint(40, 511))
+    else:
+        header.append("0 eeprom erased")
+    if rng.random() < 0.5:
+        gestures = rng.randint(0, 7) & 0x06
+        header.append("0 eeprom %d 0x%02x 0x%02x" % (EEPROM_GESTURES, gestures, ~gestures & 0xff))
+    if rng.random() < 0.5:
+        header.append("0 eeprom %d 0xa5 0x5a" % EEPROM_BT_MODE)
+    if rng.random() < 0.5:
+        header.append("0 noise both %d" % rng.randint(1, NOISE_MAX))
+
+    events, now = [], 0
+    for _ in range(rng.randint(*EVENTS)):
+        now += rng.randint(*GAP_MS)
+        kind = rng.random()
+        if kind < 0.35:
+            axis = rng.choice(["speed", "direction"])
+            events.append("%d %s %s" % (now, axis, "neutral" if rng.random() < 0.3 else rng.randint(0, 1023)))
+        elif kind < 0.55:
+            axis = rng.choice(["speed", "direction"])
+            events.append("%d ramp %s %d %d %d" % (now, axis, rng.randint(0, 1023), rng.randint(0, 1023),
+                                                   rng.randint(20, 1500)))
+        elif kind < 0.8:
+            events.append("%d press %s" % (now, " ".join(rng.sample(BUTTONS, rng.randint(1, 2)))))
+        else:
+            events.append("%d release %s" % (now, rng.choice(BUTTONS + ["all"])))
+
+    # A ramp may run on past the last event.
+    now += 1500
+    tail = ["%d release all" % now, "%d speed neutral" % now, "%d direction neutral" % now,
+            "%d end" % (now + REST_MS)]
+    return header, events, tail
+
+
+def run_scenario(program, lines, work_dir, name):
+    """Runs scenario lines on stress_sim. Returns (None, simulated s) for a
+    pass or (what broke, simulated s)."""
+    records = host_trace.parse_scenarios("\n".join(lines), name)[0][1]
+    trace = os.path.join(work_dir, name + ".trace")
+    output = os.path.join(work_dir, name + ".out")
+    host_trace.write_trace(trace, records)
+    simulated = max(r[0] for r in records) / 1e6
+    try:
+        process = subprocess.run([program, trace, output], stdout=subprocess.PIPE,
+                                 stderr=subprocess.STDOUT, text=True, timeout=RUN_TIMEOUT_S)
+    except subprocess.TimeoutExpired:
+        return "timeout: no END after %d s" % RUN_TIMEOUT_S, simulated
+    finally:
+        os.remove(trace)
+    if os.path.exists(output):
+        os.remove(output)
+    if process.returncode == 0:
+        return None, simulated
+    for line in process.stdout.splitlines():
+        if line.startswith("invariant "):
+            return line, simulated
+    return "stress_sim exit %d: %s" % (process.returncode, process.stdout.strip()), simulated
+
+
+def invariant(failure):
+    """The name of what broke, "invariant dac_range: ..." -> "dac_range"."""
+    return failure.split(":", 1)[0]
+
+
+def minimise(program, header, events, tail, failure, work_dir, name):
+    """Delta debugging over the events: returns the fewest that still break
+    the same invariant, with the number of runs it took."""
+    want, runs = invariant(failure), [0]
+
+    def fails(subset):
+        runs[0] += 1
+        result, _ = run_scenario(program, header + subset + tail, work_dir, "%s_min%d" % (name, runs[0]))
+        return result is not None and invariant(result) == want
+
+    parts = 2
+    while len(events) >= 2:
+        size = len(events) // parts
+        chunks = [events[i:i + size] for i in range(0, len(events), size)]
+        for index, chunk in enumerate(chunks):
+            if fails(chunk):
+                events, parts = chunk, 2
+                break
+            complement = [e for c in chunks[:index] + chunks[index + 1:] for e in c]
+            if parts > 2 and fails(complement):
+                events, parts = complement, max(parts - 1, 2)
+                break
+        else:
+            if parts >= len(events):
+                break
+            parts = min(parts * 2, len(events))
+    if len(events) == 1 and fails([]):
+        events = []
+    return events, runs[0]
+
+
+def stress_one(program, conf, seed, work_dir, shrink):
+    """Runs the scenario of one seed. Returns (seed, simulated s, failure,
+    path of the minimal scenario)."""
+    header, events, tail = random_scenario(random.Random(seed))
+    name = "%s_%d" % (conf, seed)
+    failure, simulated = run_scenario(program, header + events + tail, work_dir, name)
+    if failure is None:
+        return seed, simulated, None, None
+
+    runs = 0
+    if shrink and failure.startswith("invariant "):
+        events, runs = minimise(program, header, events, tail, failure, work_dir, name)
+    path = os.path.join(OUT_DIR, name + ".scenario")
+    with open(path, "w") as f:
+        f.write("# stress.py --conf %s --seed %d --count 1\n# %s\n" % (conf, seed, failure))
+        if runs:
+            f.write("# %d events left after %d minimising runs\n" % (len(events), runs))
+        f.write("\n".join(header + events + tail) + "\n")
+    return seed, simulated, failure, path
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Stress the firmware's invariants with random scenarios.")
+    parser.add_argument("--count", type=int, default=200, help="scenarios per configuration (default %(default)s)")
+    parser.add_argument("--seed", type=int, default=1, help="first scenario number (default %(default)s)")
+    parser.add_argument("--conf", action="append", help="configuration (default %s)" % DEFAULT_CONF)
+    parser.add_argument("--jobs", type=int, default=os.cpu_count(), help="runs at once (default %(default)s)")
+    parser.add_argument("--no-minimise", dest="shrink", action="store_false",
+                        help="keep failing scenarios as they were")
+    args = parser.parse_args()
+
+    confs = args.conf or [DEFAULT_CONF]
+    try:
+        built = host_build.build_all(confs, out_root=BUILD_ROOT, programs=("stress_sim",), jobs=args.jobs)
+    except RuntimeError as error:
+        print(error, file=sys.stderr)
+        return 1
+    os.makedirs(OUT_DIR, exist_ok=True)
+
+    failed, simulated = 0, 0.0
+    start = time.monotonic()
+    with tempfile.TemporaryDirectory(prefix="stress_") as work_dir:
+        with concurrent.futures.ThreadPoolExecutor(max_workers=args.jobs) as pool:
+            futures = [pool.submit(stress_one, os.path.join(built[conf], "stress_sim"), conf, seed, work_dir,
+                                   args.shrink)
+                       for conf in confs for seed in range(args.seed, args.seed + args.count)]
+            for future in concurrent.futures.as_completed(futures):
+                seed, seconds, failure, path = future.result()
+                simulated += seconds
+                if failure:
+                    failed += 1
+                    print("seed %d FAIL %s\n    %s" % (seed, failure, os.path.relpath(path)))
+    elapsed = time.monotonic() - start
+
+    total = len(confs) * args.count
+    print("%d of %d scenarios failed, %.1f scenarios/s, %.0f simulated s/s" %
+          (failed, total, total / elapsed, simulated / elapsed))
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,362 @@
+#!/usr/bin/env python3
+###############################################################################
+# File Name: sweep.py
+# Project:  Prop ASL130 with Bluetooth Module
+#
+# Sweeps the joystick tuning values that can be set per build across
+# recorded joystick movements, through the firmware built for the host
+# (tools/host_build.py), and prints a Pareto table of the results:
+#
+#   NEUTRAL_ERROR_MARGIN         --margin      (fixes the margin, so the
+#                                               joystick type is not detected)
+#   MAX_DEBOUNCE                 --debounce
+#   JOYSTICK_RAW_MAX_DEFLECTION  --deflection
+#   ADC_NORMAL_SAMPLES           --samples
+#
+# Every combination is built as its own firmware_sim, under
+# build/host/sweep/, and every recording is run on each, all side by side
+# on as many cores as there are. Each combination is scored on:
+#
+#   latency   ms from the joystick leaving rest to the first demand off
+#             neutral, averaged over the movements that go past
+#             MOTION_COUNTS; a movement with no demand at all is a miss
+#   false     false triggers per minute: a demand off neutral while the
+#             joystick is at rest (within REST_COUNTS of neutral, as a hand
+#             resting on it or a drifting neutral leaves it), other than
+#             one that leads straight into a movement
+#   jitter    RMS of the standard deviation of each DAC, in DAC counts,
+#             through every steady hold of the joystick away from neutral
+#
+# A combination is marked * on the Pareto front when no other one is as good
+# on all three and better on one.
+#
+# A recording is a scenario file (see tools/host_trace.py) or a CSV of
+# telemetry samples from telemetry_decode.py --csv, whose raw_speed and
+# raw_direction are replayed one per --sample-ms after a rest at neutral
+# for the boot. With no recordings, a set made up here of rests, steps and
+# ramps with ADC noise is used. MAX_DEBOUNCE only moves the scores of
+# recordings that press buttons.
+#
+# Usage:
+#   sweep.py [--margin <n>,...] [--debounce <n>,...] [--deflection <n>,...]
+#            [--samples <n>,...] [--conf <name>] [--jobs <n>] [--seed <n>]
+#            [--sample-ms <ms>] [--csv <file>] [<recording> ...]
+###############################################################################
+
+import argparse
+import bisect
+import concurrent.futures
+import csv
+import itertools
+import math
+import os
+import random
+import subprocess
+import sys
+import tempfile
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import host_build                                   # noqa: E402
+import host_trace                                   # noqa: E402
+
+BUILD_ROOT = os.path.join(host_build.FIRMWARE_DIR, "build", "host", "sweep")
+DEFAULT_CONF = "Release_RNet"
+RUN_TIMEOUT_S = 600
+
+PARAMETERS = [
+    # (define, option, default values swept)
+    ("NEUTRAL_ERROR_MARGIN", "margin", "0x18,0x28,0x40"),
+    ("MAX_DEBOUNCE", "debounce", "5"),
+    ("JOYSTICK_RAW_MAX_DEFLECTION", "deflection", "220"),
+    ("ADC_NORMAL_SAMPLES", "samples", "4,10,16"),
+]
+
+NEUTRAL = host_trace.NEUTRAL
+REST_COUNTS = 0x20              # A hand resting on the joystick moves it this far ..
+REST_SETTLE_MS = 300            # .. and it is at rest once it has been there this long.
+MOVE_GRACE_MS = 200             # A trigger this soon before a movement starts it.
+MOTION_COUNTS = 100             # A movement this far is meant to drive.
+HOLD_SETTLE_MS = 150            # A hold is measured from this long after it starts ..
+HOLD_MIN_MS = 300               # .. if it lasts at least this long.
+BOOT_MS = 2000                  # The boot's rest before a telemetry recording.
+
+# A telemetry sample is sent every TELEMETRY_DEFAULT_DECIMATION (8) passes,
+# about 8 ms in the host build's driving state.
+SAMPLE_MS = 8.0
+
+
+###############################################################################
+# Recordings
+###############################################################################
+
+def made_up_recordings(seed):
+    """Returns [(name, scenario text)]: a long rest with noise and drift,
+    steps to random deflections and back, and pushes at random rates."""
+    rng = random.Random(seed)
+    rest = ["0 eeprom calibrated 200", "0 noise both 2"]
+    now = 3000
+    for _ in range(20):
+        drift = rng.randint(-REST_COUNTS, REST_COUNTS)
+        rest.append("%d ramp %s %d %d 1000" % (now, rng.choice(["speed", "direction"]), NEUTRAL, NEUTRAL + drift))
+        rest.append("%d %s neutral" % (now + 2000, "speed"))
+        rest.append("%d %s neutral" % (now + 2000, "direction"))
+        now += 3000
+    rest.append("%d end" % now)
+
+    steps = ["0 eeprom calibrated 200", "0 noise both 2"]
+    now = 3000
+    for _ in range(24):
+        axis = rng.choice(["speed", "direction"])
+        steps.append("%d %s %d" % (now, axis, NEUTRAL + rng.choice([-1, 1]) * rng.randint(MOTION_COUNTS, 200)))
+        steps.append("%d %s neutral" % (now + rng.randint(600, 1500), axis))
+        now += 2500
+    steps.append("%d end" % now)
+
+    ramps = ["0 eeprom calibrated 200", "0 noise both 2"]
+    now = 3000
+    for _ in range(24):
+        axis = rng.choice(["speed", "direction"])
+        to = NEUTRAL + rng.choice([-1, 1]) * rng.randint(MOTION_COUNTS + 20, 200)
+        over = rng.randint(100, 1200)
+        ramps.append("%d ramp %s %d %d %d" % (now, axis, NEUTRAL, to, over))
+        ramps.append("%d %s neutral" % (now + over + 800, axis))
+        now += over + 2500
+    ramps.append("%d end" % now)
+
+    return [("rest", "\n".join(rest)), ("steps", "\n".join(steps)), ("ramps", "\n".join(ramps))]
+
+
+def telemetry_recording(path, sample_ms):
+    """Turns a telemetry CSV into scenario text."""
+    lines = ["0 eeprom calibrated 200"]
+    now = BOOT_MS
+    with open(path, newline="") as f:
+        for row in csv.DictReader(f):
+            lines.append("%.3f speed %s" % (now, row["raw_speed"]))
+            lines.append("%.3f direction %s" % (now, row["raw_direction"]))
+            now += sample_ms
+    lines.append("%.3f end" % (now + REST_SETTLE_MS))
+    return "\n".join(lines)
+
+
+def load_recordings(paths, sample_ms):
+    """Returns [(name, records)]."""
+    recordings = []
+    for path in paths:
+        name = os.path.splitext(os.path.basename(path))[0]
+        if path.endswith(".csv"):
+            recordings.append((name, host_trace.parse_scenarios(telemetry_recording(path, sample_ms), name)[0][1]))
+        else:
+            with open(path) as f:
+                recordings += host_trace.parse_scenarios(f.read(), name)
+    return recordings
+
+
+###############################################################################
+# Scoring
+###############################################################################
+
+def steps_of(records, kinds, channel=None):
+    """The values of a step function as [(time us, value)], in time order."""
+    return [(r[0], r[3]) for r in records if r[1] in kinds and (channel is None or r[2] == channel)]
+
+
+def value_at(steps, times, time_us, default):
+    """The value of a step function at time_us, times its step times."""
+    index = bisect.bisect_right(times, time_us)
+    return steps[index - 1][1] if index else default
+
+
+def score(inputs, outputs, end_us):
+    """Returns (latencies ms, misses, false triggers, rest minutes, hold
+    deviations) of one run."""
+    speed = steps_of(inputs, (host_trace.IN_SPEED,))
+    direction = steps_of(inputs, (host_trace.IN_DIRECTION,))
+    dacs = [steps_of(outputs, (host_trace.OUT_DAC,), c) for c in (0, 1)]
+    states = steps_of(outputs, (host_trace.OUT_STATE,))
+    driving = [t for t, s in states if host_trace.STATES[s] == "DRIVING"]
+    if not driving:
+        return [], 0, 0, 0.0, []
+    start = driving[0]
+    dac_times = [[t for t, _ in d] for d in dacs]
+    neutral = [value_at(d, t, start, None) for d, t in zip(dacs, dac_times)]
+
+    # Walk the inputs and outputs together, a millisecond at a time.
+    latencies, misses, false, rest_ms, deviations = [], 0, 0, 0, []
+    rest_since, onset, peak, latency = start, None, 0, None
+    triggered, hold, hold_since = None, None, None
+    indices = [0, 0, 0, 0]
+    sources = [speed, direction] + dacs
+    values = [NEUTRAL, NEUTRAL] + neutral
+    for time_us in range(start, end_us, 1000):
+        for n, source in enumerate(sources):
+            while indices[n] < len(source) and source[indices[n]][0] <= time_us:
+                values[n] = source[indices[n]][1]
+                indices[n] += 1
+        deflection = max(abs(values[0] - NEUTRAL), abs(values[1] - NEUTRAL))
+        driven = (values[2] != neutral[0]) or (values[3] != neutral[1])
+
+        if deflection <= REST_COUNTS:
+            # A movement has ended; only one meant to drive is timed.
+            if (onset is not None) and (peak >= MOTION_COUNTS):
+                if latency is None:
+                    misses += 1
+                else:
+                    latencies.append(latency / 1000.0)
+            onset = None
+            if time_us - rest_since >= REST_SETTLE_MS * 1000:
+                rest_ms += 1
+                if driven and (triggered is None):
+                    triggered = time_us
+                elif not driven and (triggered is not None):
+                    false, triggered = false + 1, None
+        else:
+            rest_since = time_us
+            if onset is None:
+                # A trigger just before this was the movement starting.
+                if (triggered is not None) and (time_us - triggered > MOVE_GRACE_MS * 1000):
+                    false += 1
+                triggered = None
+                onset, peak, latency = time_us, 0, None
+            peak = max(peak, deflection)
+            if driven and (latency is None):
+                latency = time_us - onset
+
+        # Holds: the inputs unchanged and off neutral.
+        if (values[0], values[1]) != hold:
+            hold_end(hold, hold_since, time_us, dacs, dac_times, deviations)
+            hold, hold_since = (values[0], values[1]), time_us
+    hold_end(hold, hold_since, end_us, dacs, dac_times, deviations)
+    return latencies, misses, false, rest_ms / 60000.0, deviations
+
+
+def hold_end(hold, since_us, end_us, dacs, dac_times, deviations):
+    """Adds the DAC deviations through a hold that has just ended."""
+    if (hold is None) or (max(abs(hold[0] - NEUTRAL), abs(hold[1] - NEUTRAL)) <= REST_COUNTS):
+        return
+    if end_us - since_us < HOLD_MIN_MS * 1000:
+        return
+    for dac, times in zip(dacs, dac_times):
+        samples = [value_at(dac, times, t, 0) for t in range(since_us + HOLD_SETTLE_MS * 1000, end_us, 1000)]
+        mean = sum(samples) / float(len(samples))
+        deviations.append(math.sqrt(sum((v - mean) ** 2 for v in samples) / len(samples)))
+
+
+###############################################################################
+# Running
+###############################################################################
+
+def run_one(program, name, records, work_dir):
+    """Runs one recording on one build and returns its score."""
+    trace = os.path.join(work_dir, name + ".trace")
+    output = os.path.join(work_dir, name + ".out")
+    host_trace.write_trace(trace, records)
+    process = subprocess.run([program, trace, output], stdout=subprocess.PIPE,
+                             stderr=subprocess.STDOUT, text=True, timeout=RUN_TIMEOUT_S)
+    if process.returncode not in (0, 2):
+        raise RuntimeError("%s: firmware_sim exit %d\n%s" % (name, process.returncode, process.stdout))
+    outputs = host_trace.read_trace(output)
+    os.remove(trace)
+    os.remove(output)
+    end_us = max(r[0] for r in records if r[1] == host_trace.IN_END)
+    return score(records, outputs, end_us)
+
+
+def combine(scores):
+    """Sums the scores of the recordings into (latency ms, misses, false
+    triggers per minute, jitter)."""
+    latencies = [latency for s in scores for latency in s[0]]
+    misses = sum(s[1] for s in scores)
+    false = sum(s[2] for s in scores)
+    rest_minutes = sum(s[3] for s in scores)
+    deviations = [d for s in scores for d in s[4]]
+    return (sum(latencies) / len(latencies) if latencies else float("inf"), misses,
+            false / rest_minutes if rest_minutes else 0.0,
+            math.sqrt(sum(d * d for d in deviations) / len(deviations)) if deviations else 0.0)
+
+
+def pareto(results):
+    """Marks each result that no other one dominates on latency, false
+    triggers and jitter."""
+    def objectives(result):
+        latency, _, false, jitter = result["score"]
+        return (latency, false, jitter)
+
+    for result in results:
+        mine = objectives(result)
+        result["pareto"] = not any(
+            all(o <= m for o, m in zip(objectives(other), mine)) and objectives(other) != mine
+            for other in results if other is not result)
+
+
+def values_of(text):
+    return [int(v, 0) for v in text.split(",") if v]
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Sweep the joystick tuning values over recordings.")
+    for define, option, default in PARAMETERS:
+        parser.add_argument("--" + option, default=default, help="%s values (default %s)" % (define, default))
+    parser.add_argument("--conf", default=DEFAULT_CONF, help="configuration to build on (default %(default)s)")
+    parser.add_argument("--jobs", type=int, default=os.cpu_count(), help="builds and runs at once (default %(default)s)")
+    parser.add_argument("--seed", type=int, default=46, help="for the made up recordings (default %(default)s)")
+    parser.add_argument("--sample-ms", type=float, default=SAMPLE_MS,
+                        help="time between telemetry samples (default %(default)s)")
+    parser.add_argument("--csv", help="write the table to this CSV file as well")
+    parser.add_argument("recordings", nargs="*", help="scenario files or telemetry CSVs")
+    args = parser.parse_args()
+
+    if args.recordings:
+        recordings = load_recordings(args.recordings, args.sample_ms)
+    else:
+        recordings = [(name, host_trace.parse_scenarios(text, name)[0][1])
+                      for name, text in made_up_recordings(args.seed)]
+
+    grid = [dict(zip([p[0] for p in PARAMETERS], values))
+            for values in itertools.product(*[values_of(getattr(args, p[1])) for p in PARAMETERS])]
+    grid = [g for g in grid if g["NEUTRAL_ERROR_MARGIN"] * 2 < g["JOYSTICK_RAW_MAX_DEFLECTION"]]
+    base = host_build.read_configurations()[args.conf]
+
+    results = []
+    with tempfile.TemporaryDirectory(prefix="sweep_") as work_dir:
+        with concurrent.futures.ThreadPoolExecutor(max_workers=args.jobs) as pool:
+            def build(values):
+                name = "_".join("%s%d" % (p[1], values[p[0]]) for p in PARAMETERS)
+                defines = base + ["%s=%d" % item for item in values.items()]
+                return values, name, host_build.build(name, defines, out_root=BUILD_ROOT, jobs=1)
+
+            try:
+                builds = list(pool.map(build, grid))
+            except RuntimeError as error:
+                print(error, file=sys.stderr)
+                return 1
+
+            runs = {}
+            for values, name, out_dir in builds:
+                program = os.path.join(out_dir, "firmware_sim")
+                runs[name] = (values, [pool.submit(run_one, program, "%s_%s" % (name, recording), records, work_dir)
+                                       for recording, records in recordings])
+            for name, (values, futures) in sorted(runs.items()):
+                results.append({"values": values, "score": combine([f.result() for f in futures])})
+
+    pareto(results)
+    results.sort(key=lambda r: r["score"][0])
+    header = [p[1] for p in PARAMETERS] + ["latency_ms", "misses", "false_per_min", "jitter", "pareto"]
+    rows = [[r["values"][p[0]] for p in PARAMETERS]
+            + ["%.1f" % r["score"][0], r["score"][1], "%.2f" % r["score"][2], "%.2f" % r["score"][3],
+               "*" if r["pareto"] else ""]
+            for r in results]
+    print("%d combinations, %d recordings: %s" % (len(results), len(recordings), ", ".join(n for n, _ in recordings)))
+    print(" ".join("%13s" % h for h in header))
+    for row in rows:
+        print(" ".join("%13s" % (("0x%02x" % v) if i == 0 else v) for i, v in enumerate(row)))
+    if args.csv:
+        with open(args.csv, "w", newline="") as f:
+            writer = csv.writer(f)
+            writer.writerow(header)
+            writer.writerows(rows)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,204 @@
+#!/usr/bin/env python3
+###############################################################################
+# File Name: telemetry_decode.py
+# Project:  Prop ASL130 with Bluetooth Module
+#
+# Decodes a captured telemetry byte stream (see SourceFiles/app/Telemetry.c)
+# into CSV and prints per-field statistics. The latest loop timing pages
+# (see SourceFiles/app/LoopTiming.c) are shown with the statistics.
+#
+# The stream is searched for the sync bytes, so a capture may start part
+# way through a frame. Frames with a bad CRC are skipped and counted, and
+# gaps in the sequence numbers are counted as dropped frames.
+#
+# Usage:
+#   telemetry_decode.py <capture.bin | -> [--csv <file>] [--no-stats]
+###############################################################################
+
+import argparse
+import csv
+import math
+import struct
+import sys
+
+SYNC = b"\xa5\x5a"
+PAYLOAD_SIZE = 16
+FRAME_SIZE = PAYLOAD_SIZE + 6
+
+FRAME_SAMPLE = 0x01
+FRAME_TIMING = 0x02
+
+# Must match LoopTiming.h and BSP_FAST_TICK_NS.
+TIMING_BINS = 16
+TIMING_STATES = 16
+TIMING_TRANSITION = 0          # Passes that changed state, LOOP_TIMING_TRANSITION.
+TIMING_VALUES_PER_PAGE = 7
+FAST_TICK_US = 3.2             # At 10 MHz, see --fast-tick-us.
+
+# Must match enum STATE_ENUM in main.c.
+STATE_NAMES = [
+    "NO_STATE",
+    "POWERUP_STATE",
+    "ANNOUNCE_ENTER_DRIVING_STATE",
+    "ENTER_DRIVING_STATE",
+    "DRIVING_STATE",
+    "ANNOUNCE_ENTER_BLUETOOTH_STATE",
+    "ENTER_BLUETOOTH_STATE",
+    "BLUETOOTH_STATE",
+    "EXIT_BLUETOOTH_STATE",
+    "ENTER_MODE_CHANGE_STATE",
+    "MODE_CHANGE_STATE",
+    "EXIT_MODE_CHANGE_STATE",
+    "ENTER_CALIBRATION_STATE",
+    "DO_JOYSTICK_CALIBRATION_STATE",
+    "EXIT_JOYSTICK_CALIBRATION_STATE",
+    "FAULT_STATE",
+]
+
+SAMPLE_FIELDS = [
+    "state", "buttons",
+    "raw_speed", "raw_direction",
+    "filtered_speed", "filtered_direction",
+    "speed_demand", "direction_demand",
+    "flags", "curve",
+]
+SAMPLE_FORMAT = "<BBHHHHHHBB"
+
+# Fields that statistics make sense for.
+STAT_FIELDS = SAMPLE_FIELDS[2:8]
+
+
+def crc16(data):
+    """CRC-16/CCITT-FALSE, as Crc16() in Crc16.c."""
+    crc = 0xffff
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if (crc & 0x8000) else (crc << 1)
+            crc &= 0xffff
+    return crc
+
+
+def frames(stream):
+    """Yields (type, sequence, payload) for every good frame, and returns
+    the number of CRC errors through the "errors" list."""
+    errors = [0]
+    index = 0
+
+    def generator():
+        nonlocal index
+        while True:
+            index = stream.find(SYNC, index)
+            if index < 0 or index + FRAME_SIZE > len(stream):
+                return
+            frame = stream[index:index + FRAME_SIZE]
+            (crc,) = struct.unpack_from("<H", frame, FRAME_SIZE - 2)
+            if crc16(frame[2:FRAME_SIZE - 2]) != crc:
+                errors[0] += 1
+                index += 1      # Resync on the next sync pattern.
+                continue
+            yield frame[2], frame[3], frame[4:4 + PAYLOAD_SIZE]
+            index += FRAME_SIZE
+
+    return generator(), errors
+
+
+def decode_sample(payload):
+    values = dict(zip(SAMPLE_FIELDS, struct.unpack(SAMPLE_FORMAT, payload)))
+    state = values["state"]
+    values["state_name"] = STATE_NAMES[state] if state < len(STATE_NAMES) else "?"
+    return values
+
+
+def print_stats(rows, out):
+    print("%-20s %8s %8s %8s %10s %10s" % ("field", "count", "min", "max", "mean", "std"), file=out)
+    for field in STAT_FIELDS:
+        data = [row[field] for row in rows]
+        if not data:
+            continue
+        mean = sum(data) / len(data)
+        std = math.sqrt(sum((v - mean) ** 2 for v in data) / len(data))
+        print("%-20s %8d %8d %8d %10.2f %10.2f" % (field, len(data), min(data), max(data), mean, std), file=out)
+
+
+def print_timing(values, out, tick_us):
+    histogram = values[:TIMING_BINS]
+    maximum = values[TIMING_BINS:TIMING_BINS + TIMING_STATES]
+    print("loop period histogram:", file=out)
+    for n, count in enumerate(histogram):
+        low = 0 if n == 0 else (1 << (n - 1))
+        high = "" if n == TIMING_BINS - 1 else "%.0f" % (((1 << n) - 1) * tick_us)
+        if count is not None:
+            print("  %8.0f - %8s us  %6d" % (low * tick_us, high, count), file=out)
+    print("longest pass per state:", file=out)
+    for state, period in enumerate(maximum):
+        if period:
+            if state == TIMING_TRANSITION:
+                name = "(changed state)"
+            else:
+                name = STATE_NAMES[state] if state < len(STATE_NAMES) else str(state)
+            text = "saturated" if period == 0xffff else "%.1f us" % (period * tick_us)
+            print("  %-32s %s" % (name, text), file=out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Decode a telemetry capture.")
+    parser.add_argument("capture", help="raw capture file, or - for stdin")
+    parser.add_argument("--csv", help="write the sample frames to this CSV file (default stdout)")
+    parser.add_argument("--no-stats", action="store_true", help="do not print the statistics")
+    parser.add_argument("--fast-tick-us", type=float, default=FAST_TICK_US,
+                        help="BSP_FAST_TICK_NS / 1000 of the build (default %(default)s)")
+    args = parser.parse_args()
+
+    if args.capture == "-":
+        stream = sys.stdin.buffer.read()
+    else:
+        with open(args.capture, "rb") as f:
+            stream = f.read()
+
+    rows = []
+    dropped = 0
+    other = 0
+    last_sequence = None
+    timing = [None] * (TIMING_BINS + TIMING_STATES)
+    generator, errors = frames(stream)
+    for frame_type, sequence, payload in generator:
+        if last_sequence is not None:
+            dropped += (sequence - last_sequence - 1) & 0xff
+        last_sequence = sequence
+
+        if frame_type == FRAME_SAMPLE:
+            row = decode_sample(payload)
+            row["sequence"] = sequence
+            rows.append(row)
+        elif frame_type == FRAME_TIMING:
+            start = payload[0] * TIMING_VALUES_PER_PAGE
+            page = struct.unpack_from("<%dH" % TIMING_VALUES_PER_PAGE, payload, 2)
+            for i, value in enumerate(page):
+                if start + i < len(timing):
+                    timing[start + i] = value
+            other += 1
+        else:
+            other += 1
+
+    columns = ["sequence", "state_name"] + SAMPLE_FIELDS
+    out = open(args.csv, "w", newline="") if args.csv else sys.stdout
+    writer = csv.DictWriter(out, fieldnames=columns, extrasaction="ignore")
+    writer.writeheader()
+    writer.writerows(rows)
+    if args.csv:
+        out.close()
+
+    if not args.no_stats:
+        report = sys.stderr if not args.csv else sys.stdout
+        print("sample frames: %d, other frames: %d, dropped: %d, CRC errors: %d"
+              % (len(rows), other, dropped, errors[0]), file=report)
+        print_stats(rows, report)
+        if any(v is not None for v in timing):
+            print_timing([v if v is not None else 0 for v in timing], report, args.fast_tick_us)
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,242 @@
+#!/usr/bin/env python3
+###############################################################################
+# File Name: uploader.py
+# Project:  Prop ASL130 with Bluetooth Module
+#
+# Loads a new application into a PIC18F46K40 through the serial bootloader
+# (see bootloader/bootloader.c), in place of a PICkit.
+#
+# The image is an Intel HEX file from a Release configuration, built with
+# its code offset at 0x800 and the linker's checksum at 0xFFFE, or a binary
+# image of the flash from 0x800 (see --binary). The Released_Images files
+# hold the bootloader as well, below 0x800, which is not loaded, nor are
+# configuration words and EEPROM data.
+#
+# Start the uploader, then power the chair up. The bootloader only listens
+# for a moment after a reset.
+#
+# Usage:
+#   uploader.py <device> <image.hex> [--baud <rate>]
+#   uploader.py <device> <image.bin> --binary
+###############################################################################
+
+import argparse
+import os
+import select
+import struct
+import sys
+import termios
+import time
+
+# Must match bootloader.c.
+SYNC = b"\xa5\x5a"
+APP_START = 0x0800
+APP_CRC_ADDRESS = 0xfffe
+FLASH_END = 0x10000
+ROW_SIZE = 64
+
+CMD_SYNC = 0x10
+CMD_ERASE = 0x11
+CMD_WRITE = 0x12
+CMD_VERIFY = 0x13
+CMD_RUN = 0x14
+
+ACK = 0x06
+NAK = 0x15
+RESEND = 0x18
+REPLY_SIZE = 4
+
+BAUD_RATES = {
+    115200: termios.B115200,
+    230400: termios.B230400,    # BOOT_BAUD_RATE
+}
+
+SYNC_INTERVAL = 0.02            # Well inside BOOT_WAIT_MS.
+
+
+def crc16(data):
+    """CRC-16/CCITT-FALSE, as Crc16() in Crc16.c."""
+    crc = 0xffff
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if (crc & 0x8000) else (crc << 1)
+            crc &= 0xffff
+    return crc
+
+
+def read_hex(path):
+    """Returns {address: byte} of the data records in an Intel HEX file."""
+    memory = {}
+    base = 0
+    with open(path) as f:
+        for number, line in enumerate(f, 1):
+            line = line.strip()
+            if not line:
+                continue
+            if not line.startswith(":"):
+                raise SystemExit("%s:%d: not an Intel HEX record" % (path, number))
+            record = bytes.fromhex(line[1:])
+            if sum(record) & 0xff:
+                raise SystemExit("%s:%d: bad checksum" % (path, number))
+            length, address, kind = record[0], (record[1] << 8) | record[2], record[3]
+            data = record[4:4 + length]
+            if kind == 0x00:
+                for i, byte in enumerate(data):
+                    memory[base + address + i] = byte
+            elif kind == 0x01:
+                break
+            elif kind == 0x02:
+                base = ((data[0] << 8) | data[1]) << 4
+            elif kind == 0x04:
+                base = ((data[0] << 8) | data[1]) << 16
+    return memory
+
+
+def read_binary(path):
+    with open(path, "rb") as f:
+        image = f.read()
+    return {APP_START + i: byte for i, byte in enumerate(image)}
+
+
+def build_image(memory):
+    """Returns the application flash, APP_START to FLASH_END, blank filled."""
+    image = bytearray(b"\xff" * (FLASH_END - APP_START))
+    skipped = 0
+    for address, byte in memory.items():
+        if address < APP_START or address >= FLASH_END:
+            skipped += 1        # The bootloader, configuration words and EEPROM.
+            continue
+        image[address - APP_START] = byte
+    if skipped:
+        print("%d bytes outside the application flash not loaded" % skipped)
+
+    # An image built without the code offset (Release_RNet_Direct) has its
+    # CRC from 0, so it fails here rather than being loaded in part.
+    (stored,) = struct.unpack_from("<H", image, APP_CRC_ADDRESS - APP_START)
+    crc = crc16(image[:APP_CRC_ADDRESS - APP_START])
+    if crc != stored:
+        raise SystemExit("the image CRC at 0x%04x is 0x%04x, expected 0x%04x. Was it built "
+                         "from a Release configuration with the code offset at 0x%x?"
+                         % (APP_CRC_ADDRESS, stored, crc, APP_START))
+    if image[:ROW_SIZE] == b"\xff" * ROW_SIZE:
+        raise SystemExit("the image has no code at 0x%04x" % APP_START)
+    return image, crc
+
+
+def request(command, payload=b""):
+    body = bytes([command]) + payload
+    return SYNC + body + struct.pack("<H", crc16(body))
+
+
+class Bootloader:
+    def __init__(self, path, baud):
+        self.fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+        attrs = termios.tcgetattr(self.fd)
+        attrs[0] = 0                                    # iflag
+        attrs[1] = 0                                    # oflag
+        attrs[2] = termios.CS8 | termios.CREAD | termios.CLOCAL
+        attrs[3] = 0                                    # lflag
+        attrs[4] = attrs[5] = BAUD_RATES[baud]
+        attrs[6][termios.VMIN] = 0
+        attrs[6][termios.VTIME] = 0
+        termios.tcsetattr(self.fd, termios.TCSANOW, attrs)
+        termios.tcflush(self.fd, termios.TCIOFLUSH)
+
+    def close(self):
+        os.close(self.fd)
+
+    def reply(self, timeout):
+        """Returns (status, command, value), or None on a timeout."""
+        data = b""
+        end = time.monotonic() + timeout
+        while len(data) < REPLY_SIZE:
+            left = end - time.monotonic()
+            if left <= 0:
+                return None
+            ready, _, _ = select.select([self.fd], [], [], left)
+            if ready:
+                data += os.read(self.fd, REPLY_SIZE - len(data))
+        return struct.unpack("<BBH", data)
+
+    def connect(self, timeout):
+        """Asks for the bootloader until it answers."""
+        end = time.monotonic() + timeout
+        while time.monotonic() < end:
+            os.write(self.fd, request(CMD_SYNC))
+            answer = self.reply(SYNC_INTERVAL)
+            if answer and answer[0] == ACK and answer[1] == CMD_SYNC:
+                time.sleep(SYNC_INTERVAL)           # Let any other replies in ..
+                termios.tcflush(self.fd, termios.TCIFLUSH)  # .. and drop them.
+                return answer[2]
+        raise SystemExit("no answer from the bootloader")
+
+    def command(self, command, payload=b"", timeout=0.5, retries=5):
+        """Sends a request until it is answered. Returns (status, value)."""
+        for _ in range(retries + 1):
+            os.write(self.fd, request(command, payload))
+            answer = self.reply(timeout)
+            if answer is None:
+                continue
+            status, answered, value = answer
+            if status == RESEND or answered != command:
+                continue        # Damaged on the way, send it again.
+            return status, value
+        raise SystemExit("no answer to command 0x%02x" % command)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Load an application through the serial bootloader.")
+    parser.add_argument("device", help="serial device")
+    parser.add_argument("image", help="Intel HEX file, or binary with --binary")
+    parser.add_argument("--binary", action="store_true", help="the image is binary, starting at 0x%x" % APP_START)
+    parser.add_argument("--baud", type=int, default=230400, choices=sorted(BAUD_RATES),
+                        help="BOOT_BAUD_RATE of the bootloader (default %(default)s)")
+    parser.add_argument("--wait", type=float, default=30.0, help="seconds to wait for the chair to be powered up")
+    args = parser.parse_args()
+
+    memory = read_binary(args.image) if args.binary else read_hex(args.image)
+    image, crc = build_image(memory)
+    rows = [offset for offset in range(0, len(image), ROW_SIZE)
+            if image[offset:offset + ROW_SIZE] != b"\xff" * ROW_SIZE]
+    # The first row makes the application present, it goes last.
+    rows = rows[1:] + rows[:1]
+
+    link = Bootloader(args.device, args.baud)
+    try:
+        print("waiting for the bootloader, power the chair up ..")
+        row_size = link.connect(args.wait)
+        if row_size != ROW_SIZE:
+            raise SystemExit("the bootloader writes %d byte rows, expected %d" % (row_size, ROW_SIZE))
+
+        start = time.monotonic()
+        status, _ = link.command(CMD_ERASE, timeout=10.0)
+        if status != ACK:
+            raise SystemExit("erase failed")
+
+        for count, offset in enumerate(rows, 1):
+            address = APP_START + offset
+            payload = struct.pack("<H", address) + bytes(image[offset:offset + ROW_SIZE])
+            status, _ = link.command(CMD_WRITE, payload)
+            if status != ACK:
+                raise SystemExit("row 0x%04x did not write" % address)
+            print("\r%d / %d rows" % (count, len(rows)), end="", flush=True)
+        print()
+
+        status, value = link.command(CMD_VERIFY, timeout=10.0)
+        if status != ACK:
+            raise SystemExit("verify failed: flash CRC 0x%04x, image 0x%04x. "
+                             "The chair stays in the bootloader." % (value, crc))
+        print("loaded %d rows in %.1f s, CRC 0x%04x" % (len(rows), time.monotonic() - start, value))
+
+        status, _ = link.command(CMD_RUN)
+        if status != ACK:
+            raise SystemExit("the application did not start")
+    finally:
+        link.close()
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())